@@ -177,6 +177,40 @@ namespace ta_test
                 return true;
             }
         };
+
+        // A command line flag that takes a non-negative integer.
+        struct IntFlag : StringFlag
+        {
+            using IntCallback = std::function<void(const Runner &runner, BasicModule &this_module, std::size_t value)>;
+
+            // `short_flag` can be zero if none.
+            IntFlag(std::string flag, char short_flag, std::string help_desc, IntCallback int_callback)
+                : StringFlag(flag, short_flag, std::move(help_desc),
+                    [flag, int_callback = std::move(int_callback)](const Runner &runner, BasicModule &this_module, std::string_view value)
+                    {
+                        // Copy to get a null terminator.
+                        std::string str(value);
+                        const char *end = str.c_str();
+                        std::size_t number = string_conv::strto<std::size_t>(str.c_str(), &end, 10);
+                        if (str.empty() || str.starts_with('-') || *end != '\0')
+                            HardError(CFG_TA_FMT_NAMESPACE::format("Expected a non-negative integer after `--{}`, but got `{}`.", flag, value), HardErrorKind::user);
+                        int_callback(runner, this_module, number);
+                    }
+                )
+            {}
+
+            std::string HelpFlagSpelling() const override
+            {
+                std::string ret;
+                if (short_flag)
+                {
+                    ret += '-';
+                    ret += short_flag;
+                    ret += ',';
+                }
+                return ret + "--" + flag + " N";
+            }
+        };
     }
 
     // The common base of all modules.
@@ -215,6 +249,21 @@ namespace ta_test
         // If `state` ends up as `enabled`, the test will run.
         virtual void OnFilterTest(const data::BasicTest &test, TestFilterState &state) noexcept {(void)test; (void)state;}
 
+        // This is called once after `OnFilterTest()` was called for every test, with all enabled tests, in an unspecified order.
+        // Erase the tests from `tests` to disable them. Don't add new ones.
+        // Use this instead of `OnFilterTest()` if the decision depends on what other tests are enabled.
+        virtual void OnFilterTestList(std::vector<const data::BasicTest *> &tests) noexcept {(void)tests;}
+
+        // This is called once for every enabled test, after `OnPreRunTests()`, to decide the order of the tests.
+        // The tests with larger `priority` run first. The tests with equal priorities keep the default order (grouped by name).
+        // The groups are never split, each group runs at the largest priority of its tests.
+        // `priority` starts at 0.
+        virtual void OnScheduleTest(const data::BasicTest &test, double &priority) noexcept {(void)test; (void)priority;}
+
+        // This is called once before running the tests, to decide how many unscoped log entries to keep in each test, see `--log-capacity`.
+        // `capacity` defaults to unlimited.
+        virtual void OnChooseLogCapacity(context::LogCapacity &capacity) noexcept {(void)capacity;}
+
         // This is called first, before any tests run.
         virtual void OnPreRunTests(const data::RunTestsInfo &data) noexcept {(void)data;}
         // This is called after all tests run.
@@ -271,8 +320,48 @@ namespace ta_test
         // This is called before entering try/catch blocks, so you can choose between that and just executing directly. (See `--catch`.)
         // `should_catch` defaults to true.
         // This is NOT called by `TA_MUST_THROW(...)`.
+        // The assertions don't call this directly, but use `RunSingleTestProgress::should_catch`. Reset it if your answer changes mid-test.
         virtual void OnPreTryCatch(bool &should_catch) noexcept {(void)should_catch;}
 
+        // --- RUNNING IN PARALLEL ---
+
+        // This is called once before running the tests, to decide how many worker threads to use.
+        // `num_jobs` defaults to 1, which means running everything on the calling thread.
+        virtual void OnChooseNumJobs(std::size_t &num_jobs) noexcept {(void)num_jobs;}
+        // This is called once before running the tests, to decide how many worker processes to fork. If more than 1, this overrides `OnChooseNumJobs()`.
+        // `num_processes` defaults to 1, which means not forking. 0 means one per hardware thread.
+        virtual void OnChooseNumProcesses(std::size_t &num_processes) noexcept {(void)num_processes;}
+        enum class ParallelTestMode
+        {
+            // Run on the main thread, as if there were no worker threads.
+            main_thread,
+            // Run on a worker thread.
+            worker,
+            // Run on worker threads, distributing the values of the outermost `TA_GENERATE(...)` between them.
+            worker_split_generators,
+        };
+
+        // When running on several threads or processes, this is called for every test to decide if it can run on worker threads or processes.
+        // The workers run the tests with their own copies of the modules (the modules that aren't copyable are left out), which print nothing.
+        //   The main thread then replays every repetition to the original modules, in the same order as without the workers:
+        //   `OnPreRunSingleTest()`, `OnPostGenerate()`, `OnPrePruneGenerator()`, `OnPreFailTest()`, and `OnPostRunSingleTest()` are called again,
+        //   with recorded generators that can't generate new values. The text printed by the copies in the other callbacks
+        //   (such as the failure messages) is printed as is.
+        // Set `mode` to `main_thread` if your module needs to observe this test while it runs (e.g. to override its generators).
+        // `mode` defaults to `worker`.
+        virtual void OnCheckParallelTest(const data::BasicTest &test, ParallelTestMode &mode) noexcept {(void)test; (void)mode;}
+
+        // --- BENCHMARKS ---
+
+        // Called when a `BenchmarkLoop` starts, to configure it.
+        virtual void OnPreBenchmark(const data::RunSingleTestInfo &test, data::BenchmarkSettings &settings) noexcept {(void)test; (void)settings;}
+        // Called when a `BenchmarkLoop` finishes measuring.
+        virtual void OnPostBenchmark(const data::BenchmarkResults &results) noexcept {(void)results;}
+
+        // Called when a worker process crashes while running a test, after the test is marked as failed.
+        // `reason` is a human-readable description of how the process ended.
+        virtual void OnTestProcessCrashed(const data::RunSingleTestInfo &test, std::string_view reason) noexcept {(void)test; (void)reason;}
+
 
         // All virtual functions of this interface must be listed here.
         // See `class ModuleLists` for how this list is used.
@@ -281,6 +370,9 @@ namespace ta_test
             x(BasicModule, OnUnknownFlag) \
             x(BasicModule, OnMissingFlagArgument) \
             x(BasicModule, OnFilterTest) \
+            x(BasicModule, OnFilterTestList) \
+            x(BasicModule, OnScheduleTest) \
+            x(BasicModule, OnChooseLogCapacity) \
             x(BasicModule, OnPreRunTests) \
             x(BasicModule, OnPostRunTests) \
             x(BasicModule, OnPreRunSingleTest) \
@@ -295,6 +387,12 @@ namespace ta_test
             x(BasicModule, OnMissingException) \
             x(BasicModule, OnExplainException) \
             x(BasicModule, OnPreTryCatch) \
+            x(BasicModule, OnChooseNumJobs) \
+            x(BasicModule, OnChooseNumProcesses) \
+            x(BasicModule, OnCheckParallelTest) \
+            x(BasicModule, OnTestProcessCrashed) \
+            x(BasicModule, OnPreBenchmark) \
+            x(BasicModule, OnPostBenchmark) \
             x(BasicPrintingModule, EnableUnicode) /* Not needed, but could be useful later. */ \
             x(BasicPrintingModule, PrintContextFrame) \
             x(BasicPrintingModule, PrintLogEntries) \
@@ -313,6 +411,8 @@ namespace ta_test
         };
         // For internal use, don't use and don't override. Returns the mask of functions implemented by this class.
         [[nodiscard]] virtual unsigned int Detail_ImplementedFunctionsMask() const noexcept = 0;
+        // For internal use, don't use and don't override. Returns a copy of this module, or null if it's not copyable.
+        [[nodiscard]] virtual ModulePtr Detail_Clone() const = 0;
         // For internal use. Returns true if the specified function is overridden in the derived class.
         [[nodiscard]] bool ImplementsFunction(InterfaceFunc func) const noexcept
         {
@@ -417,160 +517,6 @@ namespace ta_test
                 return false;
             }
         }
-
-        // Parsing C++ expressions.
-        namespace expr
-        {
-            // The state of the parser state machine.
-            enum class CharKind
-            {
-                normal,
-                string, // A string literal (not raw), not including things outside quotes.
-                character, // A character literal, not including things outside quotes.
-                string_escape_slash, // Escaping slashes in a string literal.
-                character_escape_slash, // Escaping slashes in a character literal.
-                raw_string, // A raw string literal, starting from `(` and until the closing `"` inclusive.
-                raw_string_initial_sep // A raw string literal, from the opening `"` to the `(` exclusive.
-            };
-
-            // `emit_char` is `(const char &ch, CharKind kind) -> void`.
-            // It's called for every character, classifying it. The character address is guaranteed to be in `expr`.
-            // `function_call` is `(bool exiting, std::string_view name, std::string_view args, std::size_t depth) -> void`.
-            // It's called for every pair of parentheses. `args` is the contents of parentheses, possibly with leading and trailing whitespace.
-            // `name` is the identifier preceding the `(`, without whitespace. It can be empty, or otherwise invalid.
-            // `depth` is the parentheses nesting depth, starting at 0.
-            // It's called both when entering parentheses (`exiting` == false, `args` == "") and when exiting them (`exiting` == true).
-            // If `function_call_uses_brackets` is true, `function_call` expects square brackets instead of parentheses.
-            template <typename EmitCharFunc, typename FunctionCallFunc>
-            void ParseExpr(std::string_view expr, EmitCharFunc &&emit_char, bool function_call_uses_brackets, FunctionCallFunc &&function_call)
-            {
-                CharKind state = CharKind::normal;
-
-                // The previous character.
-                char prev_ch = '\0';
-                // The current identifier. Only makes sense in `state == normal`.
-                std::string_view identifier;
-                // Points at the start of the initial separator of a raw string.
-                const char *raw_string_sep_start = nullptr;
-                // The separator at the end of the raw string.
-                std::string_view raw_string_sep;
-
-                struct Entry
-                {
-                    // The identifier preceding the `(`, such as the function name. if any.
-                    std::string_view ident;
-                    // Points to the beginning of the arguments, right after `(`.
-                    const char *args = nullptr;
-                };
-
-                // A stack of `()` parentheses.
-                std::vector<Entry> parens_stack;
-
-                for (const char &ch : expr)
-                {
-                    const CharKind prev_state = state;
-
-                    switch (state)
-                    {
-                      case CharKind::normal:
-                        if (ch == '"' && prev_ch == 'R')
-                        {
-                            state = CharKind::raw_string_initial_sep;
-                            raw_string_sep_start = &ch + 1;
-                        }
-                        else if (ch == '"')
-                        {
-                            state = CharKind::string;
-                        }
-                        else if (ch == '\'')
-                        {
-                            // This condition handles `'` digit separators.
-                            if (identifier.empty() || &identifier.back() + 1 != &ch || !chars::IsDigit(identifier.front()))
-                                state = CharKind::character;
-                        }
-                        else if (chars::IsIdentifierChar(ch))
-                        {
-                            // We reset `identifier` lazily here, as opposed to immediately,
-                            // to allow function calls with whitespace (and/or `)`, even) between the identifier and `(`.
-                            if (!chars::IsIdentifierChar(prev_ch))
-                                identifier = {};
-
-                            if (identifier.empty())
-                                identifier = {&ch, 1};
-                            else
-                                identifier = {identifier.data(), identifier.size() + 1};
-                        }
-                        else
-                        {
-                            if constexpr (!std::is_null_pointer_v<FunctionCallFunc>)
-                            {
-                                if (ch == "(["[function_call_uses_brackets])
-                                {
-                                    function_call(false, identifier, {}, parens_stack.size());
-
-                                    parens_stack.push_back({
-                                        .ident = identifier,
-                                        .args = &ch + 1,
-                                    });
-                                    identifier = {};
-                                }
-                                else if (ch == ")]"[function_call_uses_brackets] && !parens_stack.empty())
-                                {
-                                    function_call(true, parens_stack.back().ident, std::string_view(parens_stack.back().args, &ch), parens_stack.size() - 1);
-                                    parens_stack.pop_back();
-                                }
-                            }
-                        }
-                        break;
-                      case CharKind::string:
-                        if (ch == '"')
-                            state = CharKind::normal;
-                        else if (ch == '\\')
-                            state = CharKind::string_escape_slash;
-                        break;
-                      case CharKind::character:
-                        if (ch == '\'')
-                            state = CharKind::normal;
-                        else if (ch == '\\')
-                            state = CharKind::character_escape_slash;
-                        break;
-                      case CharKind::string_escape_slash:
-                        state = CharKind::string;
-                        break;
-                      case CharKind::character_escape_slash:
-                        state = CharKind::character;
-                        break;
-                      case CharKind::raw_string_initial_sep:
-                        if (ch == '(')
-                        {
-                            state = CharKind::raw_string;
-                            raw_string_sep = {raw_string_sep_start, &ch};
-                        }
-                        break;
-                      case CharKind::raw_string:
-                        if (ch == '"')
-                        {
-                            std::string_view content(raw_string_sep_start, &ch);
-                            if (content.size() >/*sic*/ raw_string_sep.size() && content[content.size() - raw_string_sep.size() - 1] == ')' && content.ends_with(raw_string_sep))
-                                state = CharKind::normal;
-                        }
-                        break;
-                    }
-
-                    if (prev_state != CharKind::normal && state == CharKind::normal)
-                        identifier = {};
-
-                    CharKind fixed_state = state;
-                    if (prev_state == CharKind::string || prev_state == CharKind::character || prev_state == CharKind::raw_string)
-                        fixed_state = prev_state;
-
-                    if constexpr (!std::is_null_pointer_v<EmitCharFunc>)
-                        emit_char(ch, fixed_state);
-
-                    prev_ch = ch;
-                }
-            }
-        }
     }
 
     // Terminal output.
@@ -638,6 +584,8 @@ namespace ta_test
         struct Terminal
         {
             bool enable_color = false;
+            // If true, nothing is printed. The modules can set this temporarily to hide some output.
+            bool muted = false;
 
             // The characters are written to this `std::vprintf`-style callback.
             std::function<void(std::string_view fmt, CFG_TA_FMT_NAMESPACE::format_args args)> output_func;
@@ -1132,6 +1080,11 @@ namespace ta_test
         // Prints the current log, using the current modules.
         // Returns true if at least one module has printed something.
         CFG_TA_API void PrintLog(Terminal::StyleGuard &cur_style);
+
+        // Returns a string describing the first `num_generators` generators of the test, that's suitable for passing to `--generate` (after `test//`).
+        // The values are printed as `name=value` if they're not longer than `max_value_length` and survive a roundtrip through a string,
+        // otherwise as `name#index`. Returns an empty optional if a custom value can't be printed either way.
+        [[nodiscard]] CFG_TA_API std::optional<std::string> MakeGeneratorSummary(const data::RunSingleTestProgress &test, std::size_t num_generators, std::size_t max_value_length);
     }
 
     // The base for modules that print stuff.
@@ -1161,9 +1114,11 @@ namespace ta_test
         virtual bool PrintContextFrame(output::Terminal::StyleGuard &cur_style, const context::BasicFrame &frame, output::ContextFrameState &state) noexcept {(void)cur_style; (void)frame; (void)state; return false;}
         // This is called to print the log.
         // Return true to prevent other modules from receiving this call.
-        // `unscoped_log` can alternatively be obtained from `BasicModule::RunSingleTestResults`.
+        // `unscoped_log` is a flattened `RunSingleTestProgress::unscoped_log`, see `context::UnscopedLog::ForEach()`.
         // `scoped_log` can alternatively be obtained from `context::CurrentScopedLog()`.
-        virtual bool PrintLogEntries(output::Terminal::StyleGuard &cur_style, std::span<const context::LogEntry> unscoped_log, std::span<const context::LogEntry *const> scoped_log) noexcept {(void)cur_style; (void)unscoped_log; (void)scoped_log; return false;}
+        // `unscoped_log` can contain a `context::LogOmitted` entry, if `--log-capacity` is used.
+        // NOTE: `unscoped_log` used to be a `std::span<const context::LogEntry>`. This is a breaking change, the old overrides must be updated.
+        virtual bool PrintLogEntries(output::Terminal::StyleGuard &cur_style, std::span<const context::LogEntry *const> unscoped_log, std::span<const context::LogEntry *const> scoped_log) noexcept {(void)cur_style; (void)unscoped_log; (void)scoped_log; return false;}
 
       protected:
         CFG_TA_API void PrintWarning(output::Terminal::StyleGuard &cur_style, std::string_view text) const;
@@ -1277,6 +1232,12 @@ namespace ta_test
         {
             using T::T;
 
+            // Catch the overrides of the old signature, which would otherwise silently hide the function instead of overriding it.
+            static_assert(!requires(T &t, output::Terminal::StyleGuard &cur_style, std::span<const context::LogEntry> unscoped_log, std::span<const context::LogEntry *const> scoped_log)
+            {
+                t.PrintLogEntries(cur_style, unscoped_log, scoped_log);
+            }, "`PrintLogEntries()` now receives `unscoped_log` as `std::span<const context::LogEntry *const>`, update your override.");
+
             unsigned int Detail_ImplementedFunctionsMask() const noexcept override final
             {
                 using MaskType = decltype(Detail_ImplementedFunctionsMask());
@@ -1292,6 +1253,14 @@ namespace ta_test
                 }();
                 return ret;
             }
+
+            ModulePtr Detail_Clone() const override final
+            {
+                ModulePtr ret;
+                if constexpr (std::is_copy_constructible_v<ModuleWrapper>)
+                    ret.ptr = std::make_unique<ModuleWrapper>(*this);
+                return ret;
+            }
         };
     }
 
@@ -1388,6 +1357,88 @@ namespace ta_test
             CFG_TA_API static flags::StringFlag::Callback GetFlagCallback(bool exclude, bool force);
         };
 
+        // Responds to `--shard` to run only a subset of the tests, to split them between several machines.
+        // This only shards the tests enabled by the other modules, such as `TestSelector`, since it works in `OnFilterTestList()`.
+        struct TestSharder : BasicModule
+        {
+            // The 0-based shard index, and the number of shards. `num_shards == 1` disables sharding.
+            std::size_t shard_index = 0;
+            std::size_t num_shards = 1;
+
+            // If not empty, a file with test durations, to balance the shards by time rather than by the number of tests.
+            // This uses the format of `TimingDatabase`. The tests missing from this file are distributed by their name hashes.
+            // Only the enabled tests are weighed, so that the shards stay balanced with `--include` and `--exclude`.
+            std::string weights_file;
+
+            flags::StringFlag flag_shard;
+            flags::StringFlag flag_shard_weights;
+
+            CFG_TA_API TestSharder();
+            std::vector<flags::BasicFlag *> GetFlags() noexcept override;
+            void OnFilterTestList(std::vector<const data::BasicTest *> &tests) noexcept override;
+
+            // A hash of the test name, which is the same on all platforms and in all builds.
+            [[nodiscard]] CFG_TA_API static std::uint64_t HashTestName(std::string_view name);
+
+            // Reads `weights_file` and distributes those of `enabled_tests` that are listed in it between the shards, longest first.
+            // Returns a map from test names to shard indices.
+            [[nodiscard]] CFG_TA_API virtual std::map<std::string_view, std::size_t, std::less<>> LoadWeightedShards(std::span<const data::BasicTest *const> enabled_tests);
+        };
+
+        // Responds to `--timing-db` to remember how long each test took and whether it failed, between runs.
+        // Responds to `--schedule` to reorder the tests based on this information.
+        // The entries are per test, not per generator value: the scheduler and the sharder only ever move whole tests,
+        //   and the generated values can change between runs (e.g. with a different `--generate` or random seed), which would leave stale entries.
+        struct TimingDatabase : BasicModule
+        {
+            struct Entry
+            {
+                // The total time of all repetitions of the test in the last run.
+                double seconds = 0;
+                // How many repetitions the test had in the last run.
+                std::size_t num_repetitions = 0;
+                // How many runs in a row the test has failed. Zero if it passed the last time.
+                std::size_t fail_streak = 0;
+            };
+            using Entries = std::map<std::string, Entry, std::less<>>;
+
+            // Each line is `<seconds> <repetitions> <fail streak> <test name>`.
+            // The tests that didn't run this time keep their old entries.
+            std::string file_path;
+
+            enum class Schedule
+            {
+                // Keep the default order.
+                none,
+                // Run the slowest tests first. This reduces the total time when running in parallel.
+                longest_first,
+                // Run the tests that failed last time first, to get faster feedback.
+                failed_first,
+            };
+            Schedule schedule = Schedule::none;
+
+            flags::StringFlag flag_timing_db;
+            flags::StringFlag flag_schedule;
+
+            // Loaded from `file_path` in `OnPreRunTests()`, updated as tests run, and saved in `OnPostRunTests()`.
+            Entries entries;
+
+            // Whether the current test has failed in any of the repetitions so far.
+            bool current_test_failed = false;
+
+            CFG_TA_API TimingDatabase();
+            std::vector<flags::BasicFlag *> GetFlags() noexcept override;
+            void OnPreRunTests(const data::RunTestsInfo &data) noexcept override;
+            void OnScheduleTest(const data::BasicTest &test, double &priority) noexcept override;
+            void OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept override;
+            void OnPostRunTests(const data::RunTestsResults &data) noexcept override;
+
+            // Reads the database file. Raises a hard error on failure.
+            [[nodiscard]] CFG_TA_API static Entries LoadFile(const std::string &path);
+            // Writes the database file. Raises a hard error on failure.
+            CFG_TA_API static void SaveFile(const std::string &path, const Entries &entries);
+        };
+
         // Responds to `--generate` to override the generated values.
         struct GeneratorOverrider : BasicPrintingModule
         {
@@ -1540,6 +1591,7 @@ namespace ta_test
             bool OnRegisterGeneratorOverride(const data::RunSingleTestProgress &test, const data::BasicGenerator &generator) noexcept override;
             bool OnOverrideGenerator(const data::RunSingleTestProgress &test, data::BasicGenerator &generator) noexcept override;
             void OnPrePruneGenerator(const data::RunSingleTestProgress &test) noexcept override;
+            void OnCheckParallelTest(const data::BasicTest &test, ParallelTestMode &mode) noexcept override;
 
             // Parses a `GeneratorOverrideSeq` object. `target` must initially be empty.
             // Returns the error on failure, or an empty string on success.
@@ -1567,6 +1619,385 @@ namespace ta_test
             [[noreturn]] CFG_TA_API void HardErrorInFlag(std::string_view message, const Entry &entry, FlagErrorDetails details, HardErrorKind kind);
         };
 
+        // Responds to `--jobs` to run tests on several threads.
+        struct ParallelTestRunner : BasicModule
+        {
+            // How many worker threads to use. 1 means no extra threads, 0 means one per hardware thread.
+            std::size_t num_jobs = 1;
+            // Whether to distribute the values of the outermost generator of each test between the worker threads.
+            bool split_generators = false;
+
+            // How many worker processes to fork. 1 means no extra processes, 0 means one per hardware thread.
+            std::size_t num_processes = 1;
+
+            flags::IntFlag flag_jobs;
+            flags::BoolFlag flag_split_generators;
+            flags::IntFlag flag_processes;
+
+            // The runner adds this to worker threads to split the values of the outermost generator of a test between several jobs.
+            // Each job keeps every `num_parts`-th value, and skips the rest (or jumps over them, if the generator supports `GenerateAt()`).
+            // There are at most `num_parts` jobs per test, so each value is generated at most `num_parts` times in total.
+            struct GeneratorSplitter : BasicModule
+            {
+                // How many jobs share the generator values.
+                std::size_t num_parts = 1;
+                // This job keeps the values with the 0-based index equal to this modulo `num_parts`.
+                // Part 0 is the original job of the test, it spawns the other parts when it reaches their first values.
+                std::size_t part_index = 0;
+                // Called by part 0 to start another part as a separate job.
+                std::function<void(std::size_t part_index)> spawn_job;
+
+                bool OnRegisterGeneratorOverride(const data::RunSingleTestProgress &test, const data::BasicGenerator &generator) noexcept override;
+                bool OnOverrideGenerator(const data::RunSingleTestProgress &test, data::BasicGenerator &generator) noexcept override;
+            };
+
+            // The workers run the tests with copies of the modules, and record what happens in every repetition as a list of `WorkerEvent`s.
+            // The main thread then replays them to the original modules, see `BasicModule::OnCheckParallelTest()`.
+
+            // The state of a generator at some point of a repetition on a worker.
+            struct GeneratorSnapshot
+            {
+                // This points into the test code, so it's valid in all threads and in all forked processes.
+                const SourceLocWithCounter *location = nullptr;
+                std::string name;
+                std::type_index type = typeid(void);
+                std::string type_name;
+                GeneratorFlags flags{};
+                std::optional<std::size_t> num_values;
+
+                bool has_value = false;
+                bool is_last_value = false;
+                bool callback_threw_exception = false;
+                bool is_custom_value = false;
+                std::size_t num_generated_values = 0;
+                std::size_t num_custom_values = 0;
+
+                bool value_convertible_to_string = false;
+                bool value_convertible_from_string = false;
+                bool value_equality_comparable_to_string = false;
+                // Whether `ValueEqualsToString()` accepted `value`, see `output::MakeGeneratorSummary()`.
+                bool value_roundtrips = false;
+                // The result of `ValueToString()`.
+                std::string value;
+
+                // Records the current state of `generator`.
+                [[nodiscard]] CFG_TA_API static GeneratorSnapshot Make(const data::BasicGenerator &generator);
+            };
+
+            // Replays a `GeneratorSnapshot` on the main thread. It can't generate new values.
+            struct RecordedGenerator : data::BasicGenerator
+            {
+                std::shared_ptr<const GeneratorSnapshot> snapshot;
+
+                CFG_TA_API RecordedGenerator(std::shared_ptr<const GeneratorSnapshot> snapshot);
+
+                [[nodiscard]] const SourceLocWithCounter &SourceLocation() const override {return *snapshot->location;}
+                [[nodiscard]] std::string_view Name() const override {return snapshot->name;}
+                [[nodiscard]] std::type_index Type() const override {return snapshot->type;}
+                [[nodiscard]] std::string_view TypeName() const override {return snapshot->type_name;}
+                [[nodiscard]] GeneratorFlags Flags() const override {return snapshot->flags;}
+                [[nodiscard]] std::optional<std::size_t> NumValuesIfKnown() const override {return snapshot->num_values;}
+                [[nodiscard]] bool HasValue() const override {return snapshot->has_value;}
+                [[nodiscard]] bool ValueConvertibleToString() const override {return snapshot->value_convertible_to_string;}
+                [[nodiscard]] std::string ValueToString() const noexcept override {return snapshot->value;}
+                [[nodiscard]] bool ValueConvertibleFromString() const override {return snapshot->value_convertible_from_string;}
+                [[nodiscard]] bool ValueEqualityComparableToString() const override {return snapshot->value_equality_comparable_to_string;}
+                CFG_TA_API void Generate() override;
+                [[nodiscard]] CFG_TA_API std::string ReplaceValueFromString(const char *&string) noexcept override;
+                [[nodiscard]] CFG_TA_API std::string ValueEqualsToString(const char *&string, bool &equal) const noexcept override;
+            };
+
+            // Something that happened on a worker while running a test.
+            struct WorkerEvent
+            {
+                enum class Kind
+                {
+                    // The copy of the module at `module_index` printed `text`, in a callback that isn't replayed.
+                    output,
+                    // Those call the same callbacks on the main thread.
+                    pre_run_single_test,
+                    post_generate,
+                    pre_prune_generator,
+                    pre_fail_test,
+                    post_run_single_test,
+                };
+                Kind kind = Kind::output;
+
+                // Whether the copies of the printing modules were muted, e.g. by `GeneratorShrinker` while it tries the candidates.
+                bool muted = false;
+
+                // Those are added to the counters in `RunTestsProgress` before replaying this event.
+                std::size_t num_checks_total = 0;
+                std::size_t num_checks_failed = 0;
+                std::size_t num_tests_with_repetitions_total = 0;
+                std::size_t num_tests_with_repetitions_failed = 0;
+
+                // The state of the repetition, for the callbacks other than `output`.
+                std::vector<std::shared_ptr<const GeneratorSnapshot>> generator_stack;
+                std::size_t generator_index = 0;
+                bool failed = false;
+                // For `pre_run_single_test` and `post_run_single_test`.
+                bool is_first_generator_repetition = false;
+                // For `post_run_single_test`.
+                bool is_last_generator_repetition = false;
+                std::chrono::nanoseconds repetition_duration{};
+                std::chrono::nanoseconds repetition_cpu_duration{};
+                data::AllocationStats allocations;
+                // For `post_generate`.
+                bool generating_new_value = false;
+
+                // For `output`, the index in `Runner::modules`.
+                std::size_t module_index = 0;
+                std::string text;
+
+                // Converts this to bytes and back, to send it from a worker process.
+                // The snapshots in `generator_stack` are duplicated, and `location` is sent as is, since the processes are forked.
+                CFG_TA_API void Serialize(std::string &target) const;
+                // Returns false if the data is malformed.
+                [[nodiscard]] CFG_TA_API bool Deserialize(std::string_view source);
+            };
+
+            // The runner adds this after the module copies on every worker to record the events.
+            // The copies of the printing modules print into this, see `AppendOutput()`.
+            struct EventRecorder : BasicPrintingModule
+            {
+                // Receives the events.
+                std::function<void(WorkerEvent &&event)> on_event;
+
+                // The text printed since the last event, by the module with this index in `Runner::modules`.
+                std::string output;
+                std::size_t output_module_index = 0;
+
+                // The snapshots of the generators in the current repetition, reused until they change.
+                std::vector<std::shared_ptr<const GeneratorSnapshot>> generator_snapshots;
+
+                // The counters at the last event, to compute the deltas.
+                data::RunTestsProgress prev_counters;
+
+                // Appends the text printed by the module with this index in `Runner::modules`.
+                CFG_TA_API void AppendOutput(std::size_t module_index, std::string_view text);
+                // Sends the text printed so far as an `output` event.
+                CFG_TA_API void FlushOutput();
+
+                // The runner adds this before the module copies. It sends the text printed before each of the replayed callbacks,
+                //   since the recorder itself discards the text printed in them (the original modules print it again when replaying).
+                struct Flusher : BasicModule
+                {
+                    EventRecorder *recorder = nullptr;
+
+                    void OnPreRunSingleTest(const data::RunSingleTestInfo &data) noexcept override;
+                    void OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept override;
+                    void OnPostGenerate(const data::GeneratorCallInfo &data) noexcept override;
+                    void OnPrePruneGenerator(const data::RunSingleTestProgress &test) noexcept override;
+                    void OnPreFailTest(const data::RunSingleTestProgress &data) noexcept override;
+                };
+
+                void OnPreRunSingleTest(const data::RunSingleTestInfo &data) noexcept override;
+                void OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept override;
+                void OnPostGenerate(const data::GeneratorCallInfo &data) noexcept override;
+                void OnPrePruneGenerator(const data::RunSingleTestProgress &test) noexcept override;
+                void OnPreFailTest(const data::RunSingleTestProgress &data) noexcept override;
+
+              private:
+                // Creates an event with the state of the current repetition, and updates `prev_counters`.
+                WorkerEvent MakeEvent(WorkerEvent::Kind kind);
+            };
+
+            CFG_TA_API ParallelTestRunner();
+
+            std::vector<flags::BasicFlag *> GetFlags() noexcept override;
+            void OnChooseNumJobs(std::size_t &num_jobs) noexcept override;
+            void OnChooseNumProcesses(std::size_t &num_processes) noexcept override;
+            void OnCheckParallelTest(const data::BasicTest &test, ParallelTestMode &mode) noexcept override;
+        };
+
+        // Shrinks the values of the generators that support it (see `BasicGenerator::CanShrink()`, e.g. `ta_test::RandomValues(...)`).
+        // When a repetition fails, we keep the generator in place, and rerun the test with the simpler candidates of its value, until none of them fail.
+        // Then we rerun the test once more with the simplest failing value, so the last failure message shows it, and print it.
+        // If there are nested generators, a candidate counts as failing if the test fails with any of their values.
+        // This should be placed before `GeneratorSampler` and `GeneratorCoverage`, so that they don't take over those generators.
+        struct GeneratorShrinker : BasicPrintingModule
+        {
+            bool enabled = true;
+            // At most this many repetitions per generator when shrinking, to make sure it finishes in a reasonable time.
+            std::size_t max_shrink_repetitions = 1000;
+
+            flags::BoolFlag flag_shrink;
+
+            struct Elem
+            {
+                // The index in the generator stack.
+                std::size_t generator_index = 0;
+                // Whether a repetition has failed since this generator got its current value.
+                bool failed = false;
+                // Whether we're looking for a simpler failing value.
+                bool shrinking = false;
+                // Whether the current value is the simplest known failing one, as opposed to a candidate.
+                bool value_is_base = false;
+                // Whether we're rerunning the test with the simplest failing value, before finishing.
+                bool final_repetition = false;
+                // Whether the next repetition tries a candidate. Its output is hidden, only the final repetition is printed.
+                bool next_repetition_is_candidate = false;
+
+                // The candidates from the last `MakeShrinkCandidates()`.
+                std::size_t num_candidates = 0;
+                std::size_t next_candidate = 0;
+
+                // How many times we've found a simpler failing value.
+                std::size_t num_steps = 0;
+                // How many candidates we've tried.
+                std::size_t num_repetitions = 0;
+            };
+            // Our generators in the current stack, outermost first.
+            // Some of those can get stale, but we prune the trailing elements every time we register a new generator.
+            std::vector<Elem> elems;
+
+            // Whether we've muted the terminals of all printing modules, see `SetOutputMuted()`.
+            bool output_muted = false;
+
+            CFG_TA_API GeneratorShrinker();
+
+            // Mutes or unmutes the terminals of all printing modules, including this one.
+            CFG_TA_API void SetOutputMuted(const data::RunTestsProgress &all_tests, bool mute);
+
+            std::vector<flags::BasicFlag *> GetFlags() noexcept override;
+            void OnPreRunSingleTest(const data::RunSingleTestInfo &data) noexcept override;
+            void OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept override;
+            void OnPreFailTest(const data::RunSingleTestProgress &data) noexcept override;
+            bool OnRegisterGeneratorOverride(const data::RunSingleTestProgress &test, const data::BasicGenerator &generator) noexcept override;
+            bool OnOverrideGenerator(const data::RunSingleTestProgress &test, data::BasicGenerator &generator) noexcept override;
+            void OnPrePruneGenerator(const data::RunSingleTestProgress &test) noexcept override;
+        };
+
+        // Responds to `--generate-sample` to run a fixed number of random repetitions of each test, instead of all combinations of the generated values.
+        // The outermost generator gets distinct sampled values, sorted since it can only move forward, so the number of repetitions is at most its size. The nested generators are recreated in every repetition,
+        //   and skip to a random value each time. If a generator doesn't know its size in advance (see `BasicGenerator::NumValuesIfKnown()`),
+        //   we use the size we've seen so far instead, while occasionally overshooting it to explore more values.
+        //   For the outermost generator we can't do that, so if it doesn't know its size, we use each of its values in order, with one repetition each.
+        // On failure, prints a `--generate` flag to reproduce the failed repetition.
+        // This needs to see the generators as they're created, so when enabled, all tests run on the main thread, and `--jobs` and `--processes` have no effect.
+        // This should be placed before `GeneratorCoverage`.
+        struct GeneratorSampler : BasicPrintingModule
+        {
+            // How many repetitions to run per test. Zero if disabled.
+            std::size_t num_samples = 0;
+            // If not specified, `OnPreRunTests()` picks a random one.
+            std::optional<std::uint64_t> seed;
+
+            // In the `--generate` flag suggested for a failed repetition, the values longer than this are printed as `#` indices.
+            std::size_t max_generator_summary_value_length = 20;
+
+            flags::IntFlag flag_generate_sample;
+            flags::IntFlag flag_seed;
+
+            struct TestState
+            {
+                // Seeded with `seed` and the test name, so the other tests don't affect the values.
+                std::mt19937_64 random_generator;
+
+                // A generator we've seen in this test, identified by its source location.
+                struct Slot
+                {
+                    const SourceLocWithCounter *location = nullptr;
+                    // How many different values we've seen so far.
+                    std::size_t num_known_values = 0;
+                    // Whether `num_known_values` is the total number of values.
+                    bool size_is_known = false;
+                };
+                std::vector<Slot> slots;
+
+                // The remaining value indices of the outermost generator, distinct and sorted in descending order.
+                // Empty if the outermost generator doesn't know its size, then we take its values in order.
+                std::vector<std::size_t> outermost_values;
+                // How many repetitions are left, including the current one.
+                std::size_t num_samples_left = 0;
+
+                // If the current repetition has failed, the `--generate` flag to reproduce it.
+                std::string failed_repetition_flag;
+
+                // Need this for `std::optional<TestState>` to register the default-constructibility.
+                TestState() {}
+            };
+            std::optional<TestState> test_state;
+
+            CFG_TA_API GeneratorSampler();
+
+            std::vector<flags::BasicFlag *> GetFlags() noexcept override;
+            void OnPreRunTests(const data::RunTestsInfo &data) noexcept override;
+            void OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept override;
+            bool OnRegisterGeneratorOverride(const data::RunSingleTestProgress &test, const data::BasicGenerator &generator) noexcept override;
+            bool OnOverrideGenerator(const data::RunSingleTestProgress &test, data::BasicGenerator &generator) noexcept override;
+            void OnCheckParallelTest(const data::BasicTest &test, ParallelTestMode &mode) noexcept override;
+        };
+
+        // Responds to `--generate-coverage` and to the `ta_test::pairwise` test flag.
+        // In the pairwise mode, instead of running every combination of the generated values, the generators are driven
+        //   through a covering array, which is built greedily as we go: every pair of values of any two generators appears in at least
+        //   one repetition, which takes roughly as many repetitions as the product of the two largest generator sizes.
+        // The outermost generator produces its values in order. For each of them we run repetitions until all pairs with it are covered,
+        //   and the nested generators skip to the values that cover the most uncovered pairs in each repetition.
+        //   If that greedy choice stops covering new pairs, one more repetition is forced to a specific uncovered pair.
+        //   This guarantees the coverage, unless some generators are only reached conditionally and the forced pair doesn't come up.
+        // Generators overridden by `--generate` and everything nested in them run exhaustively, as usual.
+        struct GeneratorCoverage : BasicModule
+        {
+            enum class Mode
+            {
+                // Only the tests with the `ta_test::pairwise` flag use the pairwise mode.
+                per_test,
+                // All tests use the pairwise mode.
+                pairwise,
+                // All tests run every combination, ignoring the test flags.
+                exhaustive,
+            };
+            Mode mode = Mode::per_test;
+
+            flags::StringFlag flag_generate_coverage;
+
+            struct TestState
+            {
+                // A generator we've seen in this test, identified by its source location.
+                struct Slot
+                {
+                    const SourceLocWithCounter *location = nullptr;
+                    // How many different values we've seen so far.
+                    std::size_t num_known_values = 0;
+                    // Whether `num_known_values` is the total number of values.
+                    bool size_is_known = false;
+                };
+                std::vector<Slot> slots;
+
+                // The covered pairs, as `{slot_a, value_a, slot_b, value_b}`, with `slot_a < slot_b`.
+                std::set<std::array<std::size_t, 4>> covered_pairs;
+
+                // The current repetition, as `{slot, value}` for each generator in the stack.
+                std::vector<std::pair<std::size_t, std::size_t>> row;
+
+                // Whether we've covered any new pairs since the outermost generator was last advanced or kept.
+                bool made_progress = false;
+
+                // If a repetition covered nothing new while some pairs with the current outermost value were still uncovered,
+                //   the next repetition forces the nested generators to one of those pairs, as `{slot_a, value_a, slot_b, value_b}`.
+                // If that doesn't help either (e.g. the generators are conditional), we move on to the next outermost value.
+                std::optional<std::array<std::size_t, 4>> forced_pair;
+
+                // Need this for `std::optional<TestState>` to register the default-constructibility.
+                TestState() {}
+            };
+            std::optional<TestState> test_state;
+
+            CFG_TA_API GeneratorCoverage();
+
+            std::vector<flags::BasicFlag *> GetFlags() noexcept override;
+            void OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept override;
+            bool OnRegisterGeneratorOverride(const data::RunSingleTestProgress &test, const data::BasicGenerator &generator) noexcept override;
+            bool OnOverrideGenerator(const data::RunSingleTestProgress &test, data::BasicGenerator &generator) noexcept override;
+            void OnCheckParallelTest(const data::BasicTest &test, ParallelTestMode &mode) noexcept override;
+
+            // Whether the pairwise mode applies to this test.
+            [[nodiscard]] CFG_TA_API bool IsPairwise(const data::BasicTest &test) const;
+        };
+
         // Responds to various command line flags to configure the output of all printing modules.
         struct PrintingConfigurator : BasicModule
         {
@@ -1857,10 +2288,6 @@ namespace ta_test
             // but because we're providing the context again after an error.
             CFG_TA_API void PrintGeneratorInfo(output::Terminal::StyleGuard &cur_style, const data::RunSingleTestProgress &test, const data::BasicGenerator &generator, bool repeating_info);
 
-            // Returns a string describing the current generators, that's suitable for passing to `--generate` (after `test//`).
-            // Returns an empty string if no generators are active.
-            [[nodiscard]] CFG_TA_API std::string MakeGeneratorSummary(const data::RunSingleTestProgress &test) const;
-
           public:
             CFG_TA_API ProgressPrinter();
 
@@ -1875,6 +2302,192 @@ namespace ta_test
             void OnPreFailTest(const data::RunSingleTestProgress &data) noexcept override;
         };
 
+        // Responds to `--slowest N` to print the slowest tests and generator repetitions after running the tests.
+        struct TimingPrinter : BasicPrintingModule
+        {
+            // How many tests to print. Zero disables this module.
+            std::size_t num_slowest = 0;
+
+            // When describing the slowest repetitions, the generator values longer than this are printed as `#` indices.
+            std::size_t max_generator_summary_value_length = 20;
+
+            flags::IntFlag flag_slowest;
+
+            output::TextStyle style_title = {.color = output::TextColor::light_white, .bold = true};
+            output::TextStyle style_duration = {.color = output::TextColor::light_white};
+            output::TextStyle style_cpu_duration = {.color = output::TextColor::light_black};
+            output::TextStyle style_name = {.color = output::TextColor::light_blue};
+
+            std::string chars_slowest_tests = "SLOWEST TESTS:";
+            std::string chars_slowest_repetitions = "SLOWEST REPETITIONS:";
+            std::string chars_cpu = "cpu ";
+
+            struct Entry
+            {
+                // The test name, possibly followed by `//` and the generator values.
+                std::string name;
+                std::chrono::nanoseconds wall_duration{};
+                std::chrono::nanoseconds cpu_duration{};
+            };
+
+            struct State
+            {
+                // Only the slowest entries are kept, but those lists can temporarily grow up to twice the size.
+                std::vector<Entry> tests;
+                std::vector<Entry> repetitions;
+
+                // Describes the generator values in the current repetition.
+                std::string generator_summary;
+            };
+            State state;
+
+            CFG_TA_API TimingPrinter();
+            std::vector<flags::BasicFlag *> GetFlags() noexcept override;
+            void OnPreRunSingleTest(const data::RunSingleTestInfo &data) noexcept override;
+            void OnPostGenerate(const data::GeneratorCallInfo &data) noexcept override;
+            void OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept override;
+            void OnPostRunTests(const data::RunTestsResults &data) noexcept override;
+
+            // Adds `entry` to `entries`, and occasionally removes all entries except the `num_slowest` slowest ones.
+            CFG_TA_API void AddEntry(std::vector<Entry> &entries, Entry entry) const;
+            // Sorts `entries` from the slowest, and removes all except the `num_slowest` slowest ones.
+            CFG_TA_API void KeepSlowest(std::vector<Entry> &entries) const;
+        };
+
+        // Responds to `--allocations` to print the heap allocations of each test after running the tests.
+        // Needs the library to be built with `CFG_TA_TRACK_ALLOCATIONS=1`.
+        struct AllocationPrinter : BasicPrintingModule
+        {
+            bool enabled = false;
+
+            flags::BoolFlag flag_allocations;
+
+            output::TextStyle style_title = {.color = output::TextColor::light_white, .bold = true};
+            output::TextStyle style_value = {.color = output::TextColor::light_white};
+            output::TextStyle style_label = {.color = output::TextColor::light_black};
+            output::TextStyle style_leak = {.color = output::TextColor::light_red, .bold = true};
+            output::TextStyle style_name = {.color = output::TextColor::light_blue};
+
+            std::string chars_title = "HEAP ALLOCATIONS:";
+
+            struct Entry
+            {
+                std::string name;
+                // Summed over all repetitions, except `peak_live_bytes`, which is the largest one.
+                data::AllocationStats stats;
+                // The sum of positive `live_bytes` over all repetitions.
+                std::size_t leaked_bytes = 0;
+            };
+
+            struct State
+            {
+                std::vector<Entry> tests;
+                // The current test, until its last repetition finishes.
+                Entry current;
+            };
+            State state;
+
+            CFG_TA_API AllocationPrinter();
+            std::vector<flags::BasicFlag *> GetFlags() noexcept override;
+            void OnPreRunTests(const data::RunTestsInfo &data) noexcept override;
+            // We can't see the allocations on worker threads.
+            void OnCheckParallelTest(const data::BasicTest &test, ParallelTestMode &mode) noexcept override;
+            void OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept override;
+            void OnPostRunTests(const data::RunTestsResults &data) noexcept override;
+        };
+
+        // Prints the results of `TA_BENCHMARK(...)`, and responds to the flags that configure the benchmarks.
+        struct BenchmarkPrinter : BasicPrintingModule
+        {
+            // Those are passed to every benchmark.
+            data::BenchmarkSettings settings;
+
+            flags::IntFlag flag_samples;
+            flags::IntFlag flag_sample_time;
+            flags::IntFlag flag_warmup_time;
+            flags::BoolFlag flag_counters;
+
+            output::TextStyle style_label = {.color = output::TextColor::light_black};
+            output::TextStyle style_median = {.color = output::TextColor::light_white, .bold = true};
+            output::TextStyle style_value = {.color = output::TextColor::light_white};
+
+            std::string chars_indentation = "    ";
+            std::string chars_counters_unavailable = "Hardware performance counters are unavailable, check `/proc/sys/kernel/perf_event_paranoid`.";
+
+            // So that we only complain once.
+            bool printed_counters_unavailable = false;
+
+            CFG_TA_API BenchmarkPrinter();
+            std::vector<flags::BasicFlag *> GetFlags() noexcept override;
+            // Benchmarks must run on the main thread, otherwise we can't configure them or see their results.
+            void OnCheckParallelTest(const data::BasicTest &test, ParallelTestMode &mode) noexcept override;
+            void OnPreBenchmark(const data::RunSingleTestInfo &test, data::BenchmarkSettings &settings) noexcept override;
+            void OnPostBenchmark(const data::BenchmarkResults &results) noexcept override;
+
+            // Formats a duration in nanoseconds, choosing a suitable unit.
+            [[nodiscard]] CFG_TA_API static std::string FormatNanoseconds(double ns);
+        };
+
+        // Saves the benchmark results to a baseline file, and compares them against a previously saved baseline.
+        // A benchmark that got significantly slower than the baseline fails its test.
+        struct BenchmarkBaseline : BasicPrintingModule
+        {
+            // The samples of each benchmark loop, in nanoseconds per iteration.
+            // The keys are `<test name>//<generator summary>` (or just the test name if it has no generators), with `:<index>` appended for the second and following loops in one repetition.
+            using Entries = std::map<std::string, std::vector<double>, std::less<>>;
+
+            // Each line is `<number of samples> <samples...> <name>`.
+            // When saving, the benchmarks that didn't run this time keep their old entries.
+            std::string save_path;
+            std::string compare_path;
+
+            // A benchmark is a regression if its median got slower by more than this percentage...
+            double threshold_percent = 5;
+            // ...and if the one-sided Mann-Whitney U test rejects "not slower" at this significance level.
+            double significance_level = 0.05;
+
+            // In the benchmark names, the generator values longer than this are printed as `#` indices.
+            std::size_t max_generator_summary_value_length = 20;
+
+            flags::StringFlag flag_save;
+            flags::StringFlag flag_compare;
+            flags::StringFlag flag_threshold;
+
+            output::TextStyle style_regression = {.color = output::TextColor::light_red, .bold = true};
+            output::TextStyle style_name = {.color = output::TextColor::light_white};
+            output::TextStyle style_details = {.color = output::TextColor::none};
+
+            std::string chars_regression = "Benchmark regression: ";
+
+            // The results to save, loaded from `save_path` in `OnPreRunTests()`.
+            Entries saved_entries;
+            // The baseline, loaded from `compare_path` in `OnPreRunTests()`.
+            Entries baseline_entries;
+
+            // How many benchmark loops ran in the current repetition so far.
+            std::size_t num_loops_in_repetition = 0;
+
+            CFG_TA_API BenchmarkBaseline();
+            std::vector<flags::BasicFlag *> GetFlags() noexcept override;
+            void OnPreRunTests(const data::RunTestsInfo &data) noexcept override;
+            void OnCheckParallelTest(const data::BasicTest &test, ParallelTestMode &mode) noexcept override;
+            void OnPreRunSingleTest(const data::RunSingleTestInfo &data) noexcept override;
+            void OnPostBenchmark(const data::BenchmarkResults &results) noexcept override;
+            void OnPostRunTests(const data::RunTestsResults &data) noexcept override;
+
+            // Describes a benchmark loop, to identify it between runs.
+            [[nodiscard]] CFG_TA_API std::string MakeName(const data::BenchmarkResults &results, std::size_t loop_index) const;
+
+            // Returns the p-value of the one-sided Mann-Whitney U test, for the hypothesis that `current` tends to be larger than `baseline`.
+            // Uses the normal approximation with the tie correction. Returns 1 if either sample is empty.
+            [[nodiscard]] CFG_TA_API static double MannWhitneyPValue(std::span<const double> current, std::span<const double> baseline);
+
+            // Reads the baseline file. Raises a hard error on failure.
+            [[nodiscard]] CFG_TA_API static Entries LoadFile(const std::string &path);
+            // Writes the baseline file. Raises a hard error on failure.
+            CFG_TA_API static void SaveFile(const std::string &path, const Entries &entries);
+        };
+
         // Prints the results of a run.
         struct ResultsPrinter : BasicPrintingModule
         {
@@ -1957,6 +2570,8 @@ namespace ta_test
             output::TextStyle style_overline = {.color = output::TextColor::light_magenta, .bold = true};
             // This is used to dim the unwanted parts of expressions.
             output::TextStyle style_dim = {.color = output::TextColor::light_black};
+            // This is used for `BasicAssertion::Details()`, e.g. the mismatch description from `TA_CHECK_RANGES_EQUAL(...)`.
+            output::TextStyle style_details = {};
 
             // Labels a subexpression that had a nested assertion failure in it.
             std::u32string chars_in_this_subexpr = U"in here";
@@ -1984,13 +2599,27 @@ namespace ta_test
             // A separator between the source location passed to `TA_CONTEXT` and the callee function name.
             std::string chars_loc_context_callee = "\nIn function: ";
 
-            // The current position in the unscoped log vector, to avoid printing the same stuff twice. We reset this when we start a new test.
+            // The smallest ID of an unscoped log entry that wasn't printed yet, to avoid printing the same stuff twice. We reset this when we start a new test.
+            // We use the IDs rather than the positions, because `--log-capacity` can discard the old entries.
             // We intentionally re-print the scoped logs every time they're needed.
-            std::size_t unscoped_log_pos = 0;
+            std::size_t unscoped_log_next_id = 0;
+
+            // How many unscoped log entries were added to the log when we last printed it, including the omitted ones. We reset this when we start a new test.
+            // This lets us count the omitted entries that weren't reported yet.
+            std::size_t unscoped_log_prev_size = 0;
 
+            // How many unscoped log entries to keep.
+            context::LogCapacity log_capacity;
+
+            flags::StringFlag flag_log_capacity;
+
+            CFG_TA_API LogPrinter();
+
+            std::vector<flags::BasicFlag *> GetFlags() noexcept override;
+            void OnChooseLogCapacity(context::LogCapacity &capacity) noexcept override;
             void OnPreRunSingleTest(const data::RunSingleTestInfo &data) noexcept override;
             void OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept override;
-            bool PrintLogEntries(output::Terminal::StyleGuard &cur_style, std::span<const context::LogEntry> unscoped_log, std::span<const context::LogEntry *const> scoped_log) noexcept override;
+            bool PrintLogEntries(output::Terminal::StyleGuard &cur_style, std::span<const context::LogEntry *const> unscoped_log, std::span<const context::LogEntry *const> scoped_log) noexcept override;
         };
 
         // A generic module to analyze exceptions.
@@ -2036,8 +2665,10 @@ namespace ta_test
         struct ExceptionPrinter : virtual BasicPrintingModule, BasicExceptionContentsPrinter
         {
             std::string chars_error = "Uncaught exception:";
+            std::string chars_process_crashed = "Crashed in a worker process:";
 
             void OnUncaughtException(const data::RunSingleTestInfo &test, const data::BasicAssertion *assertion, const std::exception_ptr &e) noexcept override;
+            void OnTestProcessCrashed(const data::RunSingleTestInfo &test, std::string_view reason) noexcept override;
         };
 
         // Prints things related to `TA_MUST_THROW()`.
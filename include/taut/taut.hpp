@@ -7,10 +7,14 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cctype>
+#include <chrono>
+#include <cmath>
 #include <compare>
 #include <concepts>
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -18,9 +22,11 @@
 #include <filesystem> // To make a `path` formatter.
 #include <functional>
 #include <initializer_list>
+#include <limits>
 #include <map>
 #include <memory>
 #include <optional>
+#include <random>
 #include <ranges>
 #include <regex>
 #include <set>
@@ -243,6 +249,26 @@
 #define CFG_TA_DETECT_TERMINAL 1
 #endif
 
+// Whether `--processes` can fork worker processes, on platforms where we know how to do so.
+// NOTE: Only touch this if including `fork()` and the related code in the binary is somehow problematic.
+#ifndef CFG_TA_ALLOW_FORK
+#define CFG_TA_ALLOW_FORK 1
+#endif
+
+// Whether to replace the global `operator new` and `operator delete` to count the heap allocations made by the tests.
+// This is needed for `--allocations` and `TA_MUST_NOT_ALLOCATE(...)`. Must be set when building the library itself, since the replacements live there.
+// This is off by default, since replacing those operators is a global change that can conflict with your own replacements.
+// With `CFG_TA_SHARED` on Windows, this only sees the allocations made by the library itself, so don't use that combination.
+#ifndef CFG_TA_TRACK_ALLOCATIONS
+#define CFG_TA_TRACK_ALLOCATIONS 0
+#endif
+
+// Whether `--benchmark-counters` can read the hardware performance counters, on platforms where we know how to do so (Linux `perf_event_open()`).
+// NOTE: Only touch this if including the related code in the binary is somehow problematic.
+#ifndef CFG_TA_HARDWARE_COUNTERS
+#define CFG_TA_HARDWARE_COUNTERS 1
+#endif
+
 // Warning pragmas to ignore warnings about unused values.
 // E.g. `TA_MUST_THROW(...)` calls this for its argument.
 #ifndef CFG_TA_IGNORE_UNUSED_VALUE
@@ -299,6 +325,27 @@
 // The name can be followed by flags of type `ta_test::TestFlags`, e.g. `ta_test::disabled` to disable this test by default.
 #define TA_TEST DETAIL_TA_TEST
 
+// Define a benchmark, e.g. `TA_BENCHMARK(name) {body}`.
+// This is a test with the `ta_test::benchmark` flag, so it accepts the same names and flags as `TA_TEST(...)`, and `--include`/`--exclude` apply to it as usual.
+// Put the measured code into a `for (auto _ : ta_test::BenchmarkLoop{})` loop. The code before the loop is the setup, and isn't measured.
+// The loop warms up, calibrates the number of iterations per sample, and then measures several samples.
+// Use `ta_test::DoNotOptimize(...)` and `ta_test::ClobberMemory()` to prevent the measured code from being optimized away.
+// Use `TA_GENERATE(...)` before the loop to benchmark several parameter values.
+// Example:
+//     TA_BENCHMARK(vector/push_back)
+//     {
+//         int n = TA_GENERATE(n, {10, 1000});
+//         for (auto _ : ta_test::BenchmarkLoop{})
+//         {
+//             std::vector<int> v;
+//             for (int i = 0; i < n; i++)
+//                 v.push_back(i);
+//             ta_test::DoNotOptimize(v.data());
+//             ta_test::ClobberMemory();
+//         }
+//     }
+#define TA_BENCHMARK DETAIL_TA_BENCHMARK
+
 // Check condition. If it's false or throws, the test is marked as false, and also `InterruptTestException` is thrown to quickly exit the test.
 // You can wrap any part of the condition in `$[...]` to print it on failure (there can be several, possibly nested).
 // Usage:
@@ -357,12 +404,47 @@
 #define TA_MUST_THROW(...) \
     DETAIL_TA_MUST_THROW("TA_MUST_THROW", #__VA_ARGS__, __VA_ARGS__)
 
+// Checks that the argument doesn't allocate any heap memory on this thread (the argument can contain more than one statement, and may contain semicolons).
+// Needs the library to be built with `CFG_TA_TRACK_ALLOCATIONS=1`, otherwise causes a hard error.
+// Example usage:
+//     std::vector<int> v;
+//     v.reserve(10);
+//     TA_MUST_NOT_ALLOCATE( v.push_back(42) );
+// Like `TA_CHECK(...)`, can be followed by a second parenthesis with optional parameters: a message, flags, or both.
+#define TA_MUST_NOT_ALLOCATE(...) \
+    DETAIL_TA_MUST_NOT_ALLOCATE("TA_MUST_NOT_ALLOCATE", #__VA_ARGS__, __VA_ARGS__)
+
+// Checks that two ranges have the same length and equal elements.
+// Unlike `TA_CHECK( $[a] == $[b] )`, on failure this prints only the first mismatching index and a few elements around it, instead of both ranges.
+// Contiguous ranges of integers or enums are compared bytewise, using SIMD if available. Other ranges must be forward ranges, and are compared with `==`.
+// Example usage:
+//     TA_CHECK_RANGES_EQUAL( pixels, expected_pixels );
+// Like `TA_CHECK(...)`, can be followed by a second parenthesis with optional parameters. Following overloads are available:
+//     TA_CHECK_RANGES_EQUAL(a, b)(message...)
+//     TA_CHECK_RANGES_EQUAL(a, b)(flags)
+//     TA_CHECK_RANGES_EQUAL(a, b)(flags, message...)
+#define TA_CHECK_RANGES_EQUAL(...) \
+    DETAIL_TA_CHECK_RANGES_EQUAL("TA_CHECK_RANGES_EQUAL", #__VA_ARGS__, __VA_ARGS__)
+
+// Checks that two contiguous ranges of `float`s or `double`s have the same length and approximately equal elements.
+// The third argument is a `ta_test::FloatTolerance`: absolute, relative, or in ULPs (units in the last place).
+// NaNs are only equal to NaNs, and infinities are only equal to the same infinities.
+// The comparison is vectorized when possible. On failure, prints the maximum error with its location, and a histogram of the error magnitudes.
+// Example usage:
+//     TA_CHECK_RANGES_APPROX( output, expected, ta_test::FloatTolerance::Absolute(1e-6) );
+//     TA_CHECK_RANGES_APPROX( output, expected, ta_test::FloatTolerance::Relative(1e-4) );
+//     TA_CHECK_RANGES_APPROX( output, expected, ta_test::FloatTolerance::Ulp(4) );
+// Like `TA_CHECK(...)`, can be followed by a second parenthesis with optional parameters: a message, flags, or both.
+#define TA_CHECK_RANGES_APPROX(...) \
+    DETAIL_TA_CHECK_RANGES_APPROX("TA_CHECK_RANGES_APPROX", #__VA_ARGS__, __VA_ARGS__)
+
 // Logs a formatted line. It's only printed on test failure, at most once per test.
 // Example:
 //     TA_LOG("Hello!");
 //     TA_LOG("x = {}", 42);
 // The trailing `\n`, if any, is ignored.
 // Can also accept `std::source_location` (or `ta_test::SourceLoc`) directly.
+// If all arguments are arithmetic or enums, they are copied and formatted only if the log is printed. Same for `TA_CONTEXT`.
 #define TA_LOG DETAIL_TA_LOG
 // Creates a scoped log message. It's printed only if this line is in scope on test failure.
 // Unlike `TA_LOG()`, the message can be printed multiple times, if there are multiple failures in this scope.
@@ -507,9 +589,11 @@
     >{})) {} \
     inline void _ta_test_func(::ta_test::meta::ConstStringTag<#name>)
 
+#define DETAIL_TA_BENCHMARK(name, .../*flags*/) DETAIL_TA_TEST(name, ::ta_test::TestFlags::benchmark __VA_OPT__(|) __VA_ARGS__)
+
 #define DETAIL_TA_CHECK(macro_name_, str_, ...) \
     /* `~` is what actually performs the asesrtion. We need something with a high precedence. */\
-    ~::ta_test::detail::AssertWrapper(macro_name_, {__FILE__, __LINE__}, str_, #__VA_ARGS__,\
+    ~::ta_test::detail::AssertWrapper(macro_name_, {__FILE__, __LINE__}, ::ta_test::meta::ConstStringTag<str_>{}, ::ta_test::meta::ConstStringTag<#__VA_ARGS__>{},\
         [&]([[maybe_unused]]::ta_test::detail::AssertWrapper &_ta_assert){_ta_assert.EvalCond(__VA_ARGS__);},\
         []{CFG_TA_BREAKPOINT();}\
     )\
@@ -531,10 +615,19 @@
     )\
     .DETAIL_TA_ADD_EXTRAS
 
+#define DETAIL_TA_MUST_NOT_ALLOCATE(macro_name_, str_, ...) \
+    DETAIL_TA_CHECK(macro_name_, str_, ::ta_test::detail::CountAllocations([&]{CFG_TA_IGNORE_UNUSED_VALUE(DETAIL_TA_NONEMPTY_IDENTITY(__VA_ARGS__);)}) == 0)
+
+#define DETAIL_TA_CHECK_RANGES_EQUAL(macro_name_, str_, ...) \
+    DETAIL_TA_CHECK(macro_name_, str_, ::ta_test::detail::CheckRangesEqual(_ta_assert, __VA_ARGS__))
+
+#define DETAIL_TA_CHECK_RANGES_APPROX(macro_name_, str_, ...) \
+    DETAIL_TA_CHECK(macro_name_, str_, ::ta_test::detail::CheckRangesApprox(_ta_assert, __VA_ARGS__))
+
 #define DETAIL_TA_LOG(...) \
     ::ta_test::detail::AddLogEntry(__VA_ARGS__)
 #define DETAIL_TA_CONTEXT(...) \
-    ::ta_test::detail::ScopedLogGuard DETAIL_TA_CAT(_ta_context,__COUNTER__)(CFG_TA_THIS_FUNC_NAME, __VA_ARGS__)
+    auto DETAIL_TA_CAT(_ta_context,__COUNTER__) = ::ta_test::detail::MakeScopedLogGuard(CFG_TA_THIS_FUNC_NAME, __VA_ARGS__)
 #define DETAIL_TA_CONTEXT_LAZY(...) \
     ::ta_test::detail::ScopedLogGuardLazy DETAIL_TA_CAT(_ta_context,__COUNTER__)([&]{return CFG_TA_FMT_NAMESPACE::format(__VA_ARGS__);})
 
@@ -672,14 +765,14 @@
 #define DETAIL_TA_FLAG_OPERATORS_IN_CLASS(name_) DETAIL_TA_FLAG_OPERATORS_CUSTOM(friend, name_)
 // Same, but lets you specify a custom decl-specifier-seq.
 #define DETAIL_TA_FLAG_OPERATORS_CUSTOM(prefix_, name_) \
-    [[nodiscard, maybe_unused]] prefix_ name_ operator&(name_ a, name_ b) {return name_(::std::underlying_type_t<name_>(a) & ::std::underlying_type_t<name_>(b));} \
-    [[nodiscard, maybe_unused]] prefix_ name_ operator|(name_ a, name_ b) {return name_(::std::underlying_type_t<name_>(a) | ::std::underlying_type_t<name_>(b));} \
-    [[nodiscard, maybe_unused]] prefix_ name_ operator~(name_ a) {return name_(~::std::underlying_type_t<name_>(a));} \
-    [[maybe_unused]] prefix_ name_ &operator&=(name_ &a, name_ b) {return a = a & b;} \
-    [[maybe_unused]] prefix_ name_ &operator|=(name_ &a, name_ b) {return a = a | b;} \
-    [[nodiscard, maybe_unused]] prefix_ name_ operator*(name_ a, bool b) {return b ? a : name_{};} \
-    [[nodiscard, maybe_unused]] prefix_ name_ operator*(bool a, name_ b) {return a ? b : name_{};} \
-    [[maybe_unused]] prefix_ name_ &operator*=(name_ &a, bool b) {return a = a * b;}
+    [[nodiscard, maybe_unused]] prefix_ constexpr name_ operator&(name_ a, name_ b) {return name_(::std::underlying_type_t<name_>(a) & ::std::underlying_type_t<name_>(b));} \
+    [[nodiscard, maybe_unused]] prefix_ constexpr name_ operator|(name_ a, name_ b) {return name_(::std::underlying_type_t<name_>(a) | ::std::underlying_type_t<name_>(b));} \
+    [[nodiscard, maybe_unused]] prefix_ constexpr name_ operator~(name_ a) {return name_(~::std::underlying_type_t<name_>(a));} \
+    [[maybe_unused]] prefix_ constexpr name_ &operator&=(name_ &a, name_ b) {return a = a & b;} \
+    [[maybe_unused]] prefix_ constexpr name_ &operator|=(name_ &a, name_ b) {return a = a | b;} \
+    [[nodiscard, maybe_unused]] prefix_ constexpr name_ operator*(name_ a, bool b) {return b ? a : name_{};} \
+    [[nodiscard, maybe_unused]] prefix_ constexpr name_ operator*(bool a, name_ b) {return a ? b : name_{};} \
+    [[maybe_unused]] prefix_ constexpr name_ &operator*=(name_ &a, bool b) {return a = a * b;}
 
 
 namespace ta_test
@@ -697,6 +790,7 @@ namespace ta_test
     {
         class GenerateValueHelper;
         struct SpecificGeneratorGenerateGuard;
+        struct ArgSlot;
         template <typename T> struct ModuleWrapper;
     }
 
@@ -731,6 +825,11 @@ namespace ta_test
     {
         // Disables this test. It can only be enabled with `--force-include`.
         disabled = 1 << 0,
+        // This is a benchmark. `TA_BENCHMARK(...)` adds this automatically.
+        benchmark = 1 << 1,
+        // Don't run every combination of the generated values, only enough repetitions for every pair of values
+        //   of any two generators to appear at least once. See `--generate-coverage` for details.
+        pairwise = 1 << 2,
     };
     DETAIL_TA_FLAG_OPERATORS(TestFlags)
     using enum TestFlags;
@@ -1002,6 +1101,160 @@ namespace ta_test
             }
         }
 
+        // Parsing C++ expressions.
+        namespace expr
+        {
+            // The state of the parser state machine.
+            enum class CharKind
+            {
+                normal,
+                string, // A string literal (not raw), not including things outside quotes.
+                character, // A character literal, not including things outside quotes.
+                string_escape_slash, // Escaping slashes in a string literal.
+                character_escape_slash, // Escaping slashes in a character literal.
+                raw_string, // A raw string literal, starting from `(` and until the closing `"` inclusive.
+                raw_string_initial_sep // A raw string literal, from the opening `"` to the `(` exclusive.
+            };
+
+            // `emit_char` is `(const char &ch, CharKind kind) -> void`.
+            // It's called for every character, classifying it. The character address is guaranteed to be in `expr`.
+            // `function_call` is `(bool exiting, std::string_view name, std::string_view args, std::size_t depth) -> void`.
+            // It's called for every pair of parentheses. `args` is the contents of parentheses, possibly with leading and trailing whitespace.
+            // `name` is the identifier preceding the `(`, without whitespace. It can be empty, or otherwise invalid.
+            // `depth` is the parentheses nesting depth, starting at 0.
+            // It's called both when entering parentheses (`exiting` == false, `args` == "") and when exiting them (`exiting` == true).
+            // If `function_call_uses_brackets` is true, `function_call` expects square brackets instead of parentheses.
+            template <typename EmitCharFunc, typename FunctionCallFunc>
+            constexpr void ParseExpr(std::string_view expr, EmitCharFunc &&emit_char, bool function_call_uses_brackets, FunctionCallFunc &&function_call)
+            {
+                CharKind state = CharKind::normal;
+
+                // The previous character.
+                char prev_ch = '\0';
+                // The current identifier. Only makes sense in `state == normal`.
+                std::string_view identifier;
+                // Points at the start of the initial separator of a raw string.
+                const char *raw_string_sep_start = nullptr;
+                // The separator at the end of the raw string.
+                std::string_view raw_string_sep;
+
+                struct Entry
+                {
+                    // The identifier preceding the `(`, such as the function name. if any.
+                    std::string_view ident;
+                    // Points to the beginning of the arguments, right after `(`.
+                    const char *args = nullptr;
+                };
+
+                // A stack of `()` parentheses.
+                std::vector<Entry> parens_stack;
+
+                for (const char &ch : expr)
+                {
+                    const CharKind prev_state = state;
+
+                    switch (state)
+                    {
+                      case CharKind::normal:
+                        if (ch == '"' && prev_ch == 'R')
+                        {
+                            state = CharKind::raw_string_initial_sep;
+                            raw_string_sep_start = &ch + 1;
+                        }
+                        else if (ch == '"')
+                        {
+                            state = CharKind::string;
+                        }
+                        else if (ch == '\'')
+                        {
+                            // This condition handles `'` digit separators.
+                            if (identifier.empty() || &identifier.back() + 1 != &ch || !chars::IsDigit(identifier.front()))
+                                state = CharKind::character;
+                        }
+                        else if (chars::IsIdentifierChar(ch))
+                        {
+                            // We reset `identifier` lazily here, as opposed to immediately,
+                            // to allow function calls with whitespace (and/or `)`, even) between the identifier and `(`.
+                            if (!chars::IsIdentifierChar(prev_ch))
+                                identifier = {};
+
+                            if (identifier.empty())
+                                identifier = {&ch, 1};
+                            else
+                                identifier = {identifier.data(), identifier.size() + 1};
+                        }
+                        else
+                        {
+                            if constexpr (!std::is_null_pointer_v<FunctionCallFunc>)
+                            {
+                                if (ch == "(["[function_call_uses_brackets])
+                                {
+                                    function_call(false, identifier, {}, parens_stack.size());
+
+                                    parens_stack.push_back({
+                                        .ident = identifier,
+                                        .args = &ch + 1,
+                                    });
+                                    identifier = {};
+                                }
+                                else if (ch == ")]"[function_call_uses_brackets] && !parens_stack.empty())
+                                {
+                                    function_call(true, parens_stack.back().ident, std::string_view(parens_stack.back().args, &ch), parens_stack.size() - 1);
+                                    parens_stack.pop_back();
+                                }
+                            }
+                        }
+                        break;
+                      case CharKind::string:
+                        if (ch == '"')
+                            state = CharKind::normal;
+                        else if (ch == '\\')
+                            state = CharKind::string_escape_slash;
+                        break;
+                      case CharKind::character:
+                        if (ch == '\'')
+                            state = CharKind::normal;
+                        else if (ch == '\\')
+                            state = CharKind::character_escape_slash;
+                        break;
+                      case CharKind::string_escape_slash:
+                        state = CharKind::string;
+                        break;
+                      case CharKind::character_escape_slash:
+                        state = CharKind::character;
+                        break;
+                      case CharKind::raw_string_initial_sep:
+                        if (ch == '(')
+                        {
+                            state = CharKind::raw_string;
+                            raw_string_sep = {raw_string_sep_start, &ch};
+                        }
+                        break;
+                      case CharKind::raw_string:
+                        if (ch == '"')
+                        {
+                            std::string_view content(raw_string_sep_start, &ch);
+                            if (content.size() >/*sic*/ raw_string_sep.size() && content[content.size() - raw_string_sep.size() - 1] == ')' && content.ends_with(raw_string_sep))
+                                state = CharKind::normal;
+                        }
+                        break;
+                    }
+
+                    if (prev_state != CharKind::normal && state == CharKind::normal)
+                        identifier = {};
+
+                    CharKind fixed_state = state;
+                    if (prev_state == CharKind::string || prev_state == CharKind::character || prev_state == CharKind::raw_string)
+                        fixed_state = prev_state;
+
+                    if constexpr (!std::is_null_pointer_v<EmitCharFunc>)
+                        emit_char(ch, fixed_state);
+
+                    prev_ch = ch;
+                }
+            }
+        }
+
         // Escaping/unescaping and converting strings between different encodings.
         namespace encoding
         {
@@ -1711,7 +1964,8 @@ namespace ta_test
         struct MaybeLazyToString : DefaultMaybeLazyToString<T> {};
 
         // Whether this types specializes `MaybeLazyToString` to enable some form of lazy to-string conversion.
-        // Note that the type must additionally match the `CFG_TA_ARG_STORAGE_SIZE` and `CFG_TA_ARG_STORAGE_ALIGNMENT` requirements, otherwise this is ignored.
+        // If the object returned by `MaybeLazyToString` doesn't fit into `CFG_TA_ARG_STORAGE_SIZE`, it's stored in the per-thread argument arena.
+        // If it's overaligned for that, it's stored on the heap.
         template <typename T>
         concept SupportsLazyToString = requires(MaybeLazyToString<std::remove_cvref_t<T>> trait, const std::remove_cvref_t<T> &value)
         {
@@ -1758,6 +2012,25 @@ namespace ta_test
             std::basic_string<P...> operator()(const std::basic_string_view<P...> &source) const {return std::basic_string<P...>(source);}
         };
 
+        // -- Copying containers.
+
+        // Copies the containers of the elements that themselves are copied (see `CopyForLazyStringConversion`).
+        // Copying a large container is still much cheaper than formatting it.
+        // Views are excluded, because the elements they point to might not live long enough. Strings are handled above.
+        template <typename T>
+            requires(
+                std::ranges::forward_range<T> &&
+                !std::ranges::view<T> &&
+                std::copy_constructible<T> &&
+                !CopyForLazyStringConversion<T>::value &&
+                !text::encoding::CharType<std::ranges::range_value_t<T>> &&
+                CopyForLazyStringConversion<std::ranges::range_value_t<T>>::value
+            )
+        struct DefaultMaybeLazyToString<T>
+        {
+            T operator()(const T &source) const {return source;}
+        };
+
 
         // --- FROM STRING ---
 
@@ -2350,7 +2623,9 @@ namespace ta_test
             BasicFrame &operator=(const BasicFrame &) = default;
             virtual ~BasicFrame() = default;
         };
-        using Context = std::span<const std::shared_ptr<const BasicFrame>>;
+        // The context stack, from the outermost frame to the innermost one.
+        // The same frame can appear more than once. `output::PrintContext()` skips the repeated ones.
+        using Context = std::span<const BasicFrame *const>;
 
         [[nodiscard]] CFG_TA_API Context CurrentContext();
 
@@ -2360,12 +2635,20 @@ namespace ta_test
         class FrameGuard
         {
             const BasicFrame *frame_ptr = nullptr;
+            // Keeps the frame alive, if the guard owns it.
+            std::shared_ptr<const BasicFrame> frame_owner;
 
           public:
-            // Stores a frame pointer in the stack.
+            // Stores a frame pointer in the stack. This doesn't allocate memory, unless the stack gets deeper than ever before.
             // Can pass a null pointer here, then we do nothing.
-            // The pointer can be non-owning. Then make sure it doesn't dangle!
-            CFG_TA_API explicit FrameGuard(std::shared_ptr<const BasicFrame> frame) noexcept;
+            // The pointer is non-owning, make sure it doesn't dangle!
+            CFG_TA_API explicit FrameGuard(const BasicFrame *frame) noexcept;
+            // Same, but keeps the frame alive while the guard exists.
+            explicit FrameGuard(std::shared_ptr<const BasicFrame> frame) noexcept
+                : FrameGuard(frame.get())
+            {
+                frame_owner = std::move(frame);
+            }
 
             FrameGuard(const FrameGuard &) = delete;
             FrameGuard &operator=(const FrameGuard &) = delete;
@@ -2388,6 +2671,8 @@ namespace ta_test
 
             std::string (*message_refresh_func)(const void *data) = nullptr;
             const void *message_refresh_data = nullptr;
+            // If true, `message_refresh_func` is only called once.
+            bool refresh_once = false;
 
             void FixMessage()
             {
@@ -2416,6 +2701,10 @@ namespace ta_test
                 }),
                 message_refresh_data(&generate_message)
             {}
+            // A deferred message, generated once when first needed. Doesn't own the data.
+            LogMessage(std::string (*generate_message)(const void *data), const void *data)
+                : message_refresh_func(generate_message), message_refresh_data(data), refresh_once(true)
+            {}
 
             // This will be called automatically, you don't need to touch it (and can't, since it's non-const).
             // Regenerates the message using the stored function, if any.
@@ -2425,6 +2714,8 @@ namespace ta_test
                 {
                     message = message_refresh_func(message_refresh_data);
                     FixMessage();
+                    if (refresh_once)
+                        message_refresh_func = nullptr;
                 }
             }
 
@@ -2445,11 +2736,106 @@ namespace ta_test
             std::string_view callee;
         };
 
+        // Replaces the unscoped log entries that didn't fit into `LogCapacity`.
+        struct LogOmitted
+        {
+            // How many entries were discarded.
+            std::size_t count = 0;
+        };
+
         // A single log entry.
         struct LogEntry
         {
             std::size_t incremental_id = 0;
-            std::variant<LogMessage, LogSourceLoc> var;
+            std::variant<LogMessage, LogSourceLoc, LogOmitted> var;
+        };
+
+        // Limits the size of the unscoped log, see `--log-capacity`.
+        struct LogCapacity
+        {
+            // If false, the log is unlimited and the other fields are ignored.
+            bool limited = false;
+            // Keep this many first entries.
+            std::size_t keep_first = 0;
+            // Keep this many last entries.
+            std::size_t keep_last = 0;
+        };
+
+        // The unscoped log of a single test.
+        // Can be limited by `LogCapacity`, then it keeps the first and the last entries, and only counts the ones in between.
+        // In that case, the memory usage stays constant once the log is full, no matter how many entries are added.
+        class UnscopedLog
+        {
+            struct Payload
+            {
+                std::unique_ptr<std::byte[]> bytes;
+                std::size_t size = 0;
+            };
+
+            LogCapacity capacity;
+
+            // All entries if the log is unlimited, otherwise the first `capacity.keep_first` entries.
+            std::vector<LogEntry> head;
+            // The last entries, a circular buffer of size up to `capacity.keep_last`. `tail_start` is the oldest one.
+            std::vector<LogEntry> tail;
+            std::size_t tail_start = 0;
+            // The storage for the deferred messages in `tail`, one per element.
+            std::vector<Payload> tail_payloads;
+            // The storage for the deferred messages that are discarded immediately, when `capacity.keep_last == 0`.
+            Payload discarded_payload;
+
+            // This is reported in place of the discarded entries. Its ID is the ID of the last discarded entry.
+            LogEntry omitted;
+
+            void Discard(std::size_t incremental_id)
+            {
+                auto &marker = std::get<LogOmitted>(omitted.var);
+                marker.count++;
+                omitted.incremental_id = incremental_id;
+            }
+
+            template <typename Self, typename F>
+            static void ForEachLow(Self &self, F &&func)
+            {
+                for (auto &entry : self.head)
+                    func(entry);
+                if (std::get<LogOmitted>(self.omitted.var).count > 0)
+                    func(self.omitted);
+                for (std::size_t i = 0; i < self.tail.size(); i++)
+                    func(self.tail[(self.tail_start + i) % self.tail.size()]);
+            }
+
+          public:
+            UnscopedLog() : omitted{.incremental_id = 0, .var = LogOmitted{}} {}
+            explicit UnscopedLog(LogCapacity capacity) : UnscopedLog() {this->capacity = capacity;}
+
+            [[nodiscard]] const LogCapacity &Capacity() const {return capacity;}
+
+            // Removes all entries, but keeps the capacity and the allocated memory.
+            void Clear()
+            {
+                head.clear();
+                tail.clear();
+                tail_start = 0;
+                omitted = {.incremental_id = 0, .var = LogOmitted{}};
+            }
+
+            // How many entries were discarded because of the capacity limit.
+            [[nodiscard]] std::size_t NumOmitted() const {return std::get<LogOmitted>(omitted.var).count;}
+
+            // Returns the storage for the deferred message data of the next entry (passed to the next `Add()` call).
+            // It stays valid until that entry is discarded. Returns null if the caller should allocate the memory elsewhere,
+            //   which happens for the entries that are never discarded.
+            [[nodiscard]] CFG_TA_API void *AllocatePayloadForNextEntry(std::size_t size, std::size_t alignment);
+
+            CFG_TA_API void Add(LogEntry entry);
+
+            // Calls `func(LogEntry &)` for each entry, from oldest to newest.
+            // If some entries were discarded, passes a single `LogOmitted` entry in their place.
+            template <typename F>
+            void ForEach(F &&func) {ForEachLow(*this, func);}
+            template <typename F>
+            void ForEach(F &&func) const {ForEachLow(*this, func);}
         };
 
         // The current scoped log. The unscoped log sits in the `BasicModule::RunSingleTestResults`.
@@ -2496,6 +2882,64 @@ namespace ta_test
     // Either an index of an exception element in `CaughtException`, or a enum designating one or more elements.
     using ExceptionElemVar = std::variant<ExceptionElem, int>;
 
+    namespace detail
+    {
+        // Maps the generators to their indices in the generator stack, see `RunSingleTestProgress::visited_generator_cache`.
+        // The keys are the addresses of `SpecificGenerator<...>::location`, which identify the `TA_GENERATE(...)` calls.
+        // This is an open-addressing hash table with linear probing. `Clear()` is O(1) and keeps the memory, it just bumps the epoch.
+        class VisitedGeneratorCache
+        {
+            struct Slot
+            {
+                const SourceLocWithCounter *key = nullptr;
+                std::size_t value = 0;
+                // The slot is occupied only if this matches `epoch`.
+                std::size_t epoch = 0;
+            };
+
+            // The size is zero or a power of two.
+            std::vector<Slot> slots;
+            std::size_t num_entries = 0;
+            // Starts at one, so the value-initialized slots are empty.
+            std::size_t epoch = 1;
+
+            [[nodiscard]] std::size_t StartingSlot(const SourceLocWithCounter *key) const
+            {
+                // The low bits of the pointers are mostly zeroes, so mix them first.
+                std::uint64_t hash = std::uint64_t(reinterpret_cast<std::uintptr_t>(key)) * 0x9e3779b97f4a7c15u;
+                return std::size_t(hash ^ (hash >> 32)) & (slots.size() - 1);
+            }
+
+          public:
+            // Returns the index for this generator, or null if none.
+            [[nodiscard]] const std::size_t *Find(const SourceLocWithCounter *key) const
+            {
+                if (slots.empty())
+                    return nullptr;
+                for (std::size_t i = StartingSlot(key);; i = (i + 1) & (slots.size() - 1))
+                {
+                    const Slot &slot = slots[i];
+                    if (slot.epoch != epoch)
+                        return nullptr;
+                    if (slot.key == key)
+                        return &slot.value;
+                }
+            }
+
+            // Overwrites the old value, if any.
+            CFG_TA_API void InsertOrAssign(const SourceLocWithCounter *key, std::size_t value);
+
+            // Removes all elements, but keeps the memory.
+            void Clear() noexcept
+            {
+                epoch++;
+                num_entries = 0;
+            }
+
+            [[nodiscard]] std::size_t Size() const {return num_entries;}
+        };
+    }
+
 
     // --- DATA TYPES ---
 
@@ -2569,18 +3013,22 @@ namespace ta_test
                 // Whether this argument has a complex enough spelling to require drawing a horizontal bracket.
                 // This should be automatically true for all arguments with nested arguments inside of them.
                 bool need_bracket = false;
+
+                // Whether the argument is spelled as a name, possibly qualified or followed by member accesses (`x`, `ns::x`, `a.b->c`).
+                // Such lvalues outlive the assertion, so `$[...]` stores a pointer to them instead of copying them.
+                bool is_named_object = false;
             };
 
             // The exact code passed to the assertion macro, as a string. Before macro expansion.
             std::string_view expr;
 
             // Information about each argument.
-            std::vector<ArgInfo> args_info;
+            std::span<const ArgInfo> args_info;
             // Indices of the arguments (0..N-1), sorted in the preferred draw order. The size of this matches `ArgsInfo().size()`.
-            std::vector<std::size_t> args_in_draw_order;
+            std::span<const std::size_t> args_in_draw_order;
 
           protected:
-            AssertionExprStaticInfo() = default;
+            constexpr AssertionExprStaticInfo() = default;
         };
         // Dynamic runtime information about the expression argument of `TA_CHECK(...)`.
         class AssertionExprDynamicInfo
@@ -2606,13 +3054,12 @@ namespace ta_test
 
           protected:
             // Checks that the argument index is correct. Fails with a hard error if not.
-            // Also validates `arg_buffers_pos` and `arg_metadata_offset`.
+            // Also validates `arg_slots`.
             CFG_TA_API void ValidateArgIndex(std::size_t index) const;
 
-            // An index into `ThreadState().assertion_argument_buffers`.
-            std::size_t arg_buffers_pos = 0;
-            // An offset into `ThreadState().assertion_argument_metadata`.
-            std::size_t arg_metadata_offset = 0;
+            // The argument storage, allocated from `ThreadState().assertion_argument_arena`.
+            // Has `static_info->args_info.size()` elements.
+            detail::ArgSlot *arg_slots = nullptr;
         };
         // Information about a single `TA_CHECK(...)` call, both compile-time and runtime.
         // This is separated from `AssertionExprDynamicInfo` to theoretically allow multi-argument assertions,
@@ -2635,6 +3082,11 @@ namespace ta_test
             // Returns the user message. Until the assertion fails, this is always empty.
             [[nodiscard]] virtual std::optional<std::string_view> UserMessage() const = 0;
 
+            // Extra information about the failure, printed below the assertion. Can contain newlines.
+            // E.g. `TA_CHECK_RANGES_EQUAL(...)` describes the first mismatch here.
+            // Returns nothing by default.
+            [[nodiscard]] virtual std::optional<std::string_view> Details() const {return {};}
+
             // The assertion is printed as a sequence of the elements below:
 
             // A fixed string, such as the assertion macro name itself, or its call parentheses.
@@ -2728,6 +3180,49 @@ namespace ta_test
             // The generator flags.
             [[nodiscard]] virtual GeneratorFlags Flags() const = 0;
 
+            // The total number of values, if the generator knows it in advance. This is the case for `TA_GENERATE(...)` with sized ranges.
+            // To support this in `TA_GENERATE_FUNC(...)`, give your functor a `std::size_t NumValues() const` member.
+            // Returns nothing by default.
+            [[nodiscard]] virtual std::optional<std::size_t> NumValuesIfKnown() const {return {};}
+
+            // Whether `GenerateAt()` can jump to any value in constant time. This is the case for `TA_GENERATE(...)` with random-access sized ranges,
+            //   and for `TA_SELECT(...)`. To support this in `TA_GENERATE_FUNC(...)`, give your functor a `void SkipValues(std::size_t count)` member
+            //   that skips this many values without returning them, in addition to `NumValues()` (see above).
+            // Returns false by default.
+            [[nodiscard]] virtual bool CanGenerateAt() const {return false;}
+            // Mostly for internal use. Generates the value with the 0-based `index`, as if `Generate()` was called until `NumGeneratedValues() == index + 1`.
+            // Only works if `CanGenerateAt()` is true. `index` must be at least `NumGeneratedValues()`, and less than `NumValuesIfKnown()`.
+            virtual void GenerateAt(std::size_t index)
+            {
+                (void)index;
+                HardError("This generator doesn't support `GenerateAt()`.");
+            }
+
+            // Shrinking. `modules::GeneratorShrinker` uses this to find a simpler failing value.
+            // This is supported by `ta_test::RandomValues(...)`, and by any `TA_GENERATE_FUNC(...)` functor with
+            //   `std::size_t NumShrinkCandidates(const T &value) const` and `T ShrinkCandidate(const T &value, std::size_t index) const` members,
+            //   that describe the simpler versions of the value, simplest first. They're computed one at a time, so there's no need to store them all.
+            // Whether this generator supports shrinking. Returns false by default, then the functions below raise hard errors.
+            [[nodiscard]] virtual bool CanShrink() const {return false;}
+            // Remembers the current value as the simplest known failing one, and computes the simpler candidates for it.
+            // Returns the number of candidates.
+            virtual std::size_t MakeShrinkCandidates()
+            {
+                HardError("This generator doesn't support shrinking.");
+            }
+            // Replaces the current value with the candidate number `index` from the last `MakeShrinkCandidates()`.
+            // The replaced values count as custom values.
+            virtual void UseShrinkCandidate(std::size_t index)
+            {
+                (void)index;
+                HardError("This generator doesn't support shrinking.");
+            }
+            // Replaces the current value with the one remembered by the last `MakeShrinkCandidates()`.
+            virtual void RestoreShrinkBase()
+            {
+                HardError("This generator doesn't support shrinking.");
+            }
+
             // Whether the last generated value is the last one for this generator.
             // Note that when the generator is operating under a module override, the system doesn't respect this variable (see below).
             [[nodiscard]] bool IsLastValue() const {return !repeat || callback_threw_exception || bool(Flags() & GeneratorFlags::generate_nothing);}
@@ -2993,6 +3488,20 @@ namespace ta_test
             // This is set to `generator_stack.empty()` when entering the test.
             bool is_first_generator_repetition = false;
         };
+
+        // The heap allocations made by a test. Only collected if the library is built with `CFG_TA_TRACK_ALLOCATIONS=1`.
+        struct AllocationStats
+        {
+            std::size_t num_allocations = 0;
+            std::size_t num_deallocations = 0;
+            std::size_t allocated_bytes = 0;
+            // The allocated bytes minus the freed bytes, so far.
+            // Can be negative if the test frees memory that was allocated elsewhere.
+            std::ptrdiff_t live_bytes = 0;
+            // The largest value of `live_bytes` so far.
+            std::ptrdiff_t peak_live_bytes = 0;
+        };
+
         // Information about a single test that's currently running (possibly one of the generated repetitions).
         struct RunSingleTestProgress : RunSingleTestInfo
         {
@@ -3003,6 +3512,10 @@ namespace ta_test
             // When generators are involved, this refers only to the current repetition.
             bool failed = false;
 
+            // The cached result of `OnPreTryCatch()`, computed before entering the test. The assertions use this instead of calling it every time.
+            // If a module's answer changes mid-test, it should reset this to null, then the next assertion will call `OnPreTryCatch()` again.
+            mutable std::optional<bool> should_catch;
+
             // The generator stack.
             // This starts empty when entering the test for the first time.
             // Reaching `TA_GENERATE` can push or modify the last element of the stack.
@@ -3013,22 +3526,29 @@ namespace ta_test
 
             // This is mostly internall stuff:
 
-            // Unlike `generator_stack`, this doesn't persist between test repetition.
+            // Unlike `generator_stack`, this doesn't persist between test repetition. (The runner reuses its memory, but clears it.)
             // This remembers all visited generators, and maps them to the indices in `generator_stack`.
             // If a generator doesn't specify `new_value_when_revisiting`, it'll try to take a value from this map instead of generating a new one.
             // And if it does take a value from here, it's not added to the stack at all.
-            std::map<SourceLocWithCounter, std::size_t> visited_generator_cache;
+            // The keys are the addresses of `BasicGenerator::SourceLocation()`.
+            detail::VisitedGeneratorCache visited_generator_cache;
 
             // This is used to prevent recursive usage of generators.
             bool currently_in_generator = false;
 
-            // This is guaranteed to not contain any lazy log statements.
-            std::vector<context::LogEntry> unscoped_log;
+            // This can contain deferred messages, which are formatted by `output::PrintLog()`. They are empty until then.
+            // Its capacity comes from `BasicModule::OnChooseLogCapacity()`. The runner reuses its memory between repetitions, but clears it.
+            // This used to be a `std::vector<context::LogEntry>`, use `ForEach()` to iterate over it.
+            context::UnscopedLog unscoped_log;
 
             // Which generator in `RunSingleTestInfo::generator_stack` we expect to hit next, or `generator_stack.size()` if none.
             // This starts at `0` every time the test is entered.
             // When exiting a test normally, this should be at `generator_stack.size()`, otherwise you have a non-deterministic failure in your tests.
             std::size_t generator_index = 0;
+
+            // The heap allocations in the test body in this repetition, see `CFG_TA_TRACK_ALLOCATIONS`.
+            // The allocations made when creating generators aren't counted, since the generators outlive the repetition.
+            AllocationStats allocations;
         };
         // Information about a single finished test (possibly one of the generated repetitions).
         struct RunSingleTestResults : RunSingleTestProgress
@@ -3036,6 +3556,59 @@ namespace ta_test
             // True if we're about to leave the test for the last time.
             // This should be equivalent to `generator_stack.empty()`. This is set right before leaving the test.
             bool is_last_generator_repetition = false;
+
+            // The wall time spent in the test body during this repetition.
+            std::chrono::nanoseconds repetition_duration{};
+            // The total wall time spent in the test body, in this and all previous repetitions.
+            std::chrono::nanoseconds test_duration{};
+            // Same, but the CPU time of the thread running the test. Zero if unknown on this platform.
+            std::chrono::nanoseconds repetition_cpu_duration{};
+            std::chrono::nanoseconds test_cpu_duration{};
+        };
+
+        // Settings for a single `BenchmarkLoop`. The modules can adjust them before the loop starts.
+        struct BenchmarkSettings
+        {
+            // How long to run the body before measuring. This is also used to calibrate the number of iterations per sample.
+            std::chrono::nanoseconds warmup_time = std::chrono::milliseconds(50);
+            // The minimal duration of a single sample. The number of iterations per sample is chosen to reach this.
+            std::chrono::nanoseconds min_sample_time = std::chrono::milliseconds(5);
+            // How many samples to measure.
+            std::size_t num_samples = 20;
+            // Whether to read the hardware performance counters while measuring, see `platform::HardwareCounters`.
+            bool hardware_counters = false;
+        };
+
+        // Hardware performance counters, per iteration of a benchmark loop.
+        // Each is empty if not requested, or unavailable.
+        struct BenchmarkCounters
+        {
+            std::optional<double> cycles;
+            std::optional<double> instructions;
+            std::optional<double> cache_misses;
+            std::optional<double> branch_misses;
+        };
+
+        // The results of a single `BenchmarkLoop`.
+        struct BenchmarkResults
+        {
+            const RunSingleTestProgress *test = nullptr;
+
+            BenchmarkSettings settings;
+
+            // How many times the body ran in each sample.
+            std::size_t iterations_per_sample = 0;
+            // The time per iteration in each sample, in nanoseconds, in the order they were measured.
+            std::vector<double> samples;
+
+            // The statistics of `samples`, in nanoseconds per iteration. `mad` is the median absolute deviation from the median.
+            double median = 0;
+            double mad = 0;
+            double min = 0;
+            double max = 0;
+
+            // Averaged over all samples. Only if `settings.hardware_counters` is set.
+            BenchmarkCounters counters;
         };
 
         // Describes a single `TA_GENERATE(...)` call at runtime.
@@ -3113,6 +3686,124 @@ namespace ta_test
             }
         };
 
+        // Storage for a single assertion argument.
+        struct ArgSlot
+        {
+            ArgBuffer buffer;
+            ArgMetadata metadata;
+        };
+
+        // A stack allocator for the assertion arguments. One per thread.
+        // Every assertion gets a contiguous array of `ArgSlot`s from it, and returns it when finished, in the LIFO order.
+        // The memory is allocated in chunks that are never freed or relocated, so after the first few assertions
+        //   this no longer touches the heap, and `ArgBuffer`s can stay non-movable.
+        class ArgArena
+        {
+          public:
+            // A position in the arena. Save it before `Push()`, and pass to `Pop()` later.
+            struct Mark
+            {
+                std::size_t chunk = 0;
+                std::size_t pos = 0;
+            };
+
+            // The minimal chunk size, in slots.
+            static constexpr std::size_t min_chunk_size = 64;
+
+          private:
+            struct Chunk
+            {
+                std::unique_ptr<ArgSlot[]> slots;
+                std::size_t size = 0;
+            };
+            std::vector<Chunk> chunks;
+            Mark top;
+
+          public:
+            [[nodiscard]] Mark GetMark() const {return top;}
+
+            // Returns true if nothing is allocated.
+            [[nodiscard]] bool IsEmpty() const {return top.chunk == 0 && top.pos == 0;}
+
+            // Allocates `n` contiguous slots, with default-constructed metadata.
+            [[nodiscard]] CFG_TA_API ArgSlot *Push(std::size_t n);
+
+            // Allocates uninitialized storage for an argument that doesn't fit into `ArgBuffer`, aligned to `alignof(ArgSlot)`.
+            // This must happen while the assertion owning the argument is the last allocation.
+            //   The storage is freed by its `Pop()`, so the object must be destroyed by its `ArgMetadata::cleanup_func`.
+            [[nodiscard]] void *PushStorage(std::size_t size)
+            {
+                return Push((size + sizeof(ArgSlot) - 1) / sizeof(ArgSlot));
+            }
+
+            // Destroys the arguments in the `n` slots at `slots`, then rewinds to `mark`.
+            // Those must be the last allocation, not counting the `PushStorage()` calls made after it.
+            CFG_TA_API void Pop(Mark mark, ArgSlot *slots, std::size_t n);
+        };
+
+        // The per-thread allocation counters, see `CFG_TA_TRACK_ALLOCATIONS`.
+        // This is separate from `GlobalThreadState`, because it's accessed from `operator new`, so it must be trivially constructible and destructible.
+        struct AllocationThreadState
+        {
+            // The allocations are attributed to this, if not null. Points to `current_test->allocations` while running the test body.
+            data::AllocationStats *target = nullptr;
+            // All allocations on this thread so far, for `TA_MUST_NOT_ALLOCATE(...)`.
+            std::size_t num_allocations = 0;
+        };
+        [[nodiscard]] CFG_TA_API AllocationThreadState &ThreadAllocationState() noexcept;
+
+        // Whether the library was built with `CFG_TA_TRACK_ALLOCATIONS=1`.
+        [[nodiscard]] CFG_TA_API bool AllocationTrackingEnabled() noexcept;
+
+        // Changes `ThreadAllocationState().target` and restores the old value when destroyed. Pass null to pause the tracking.
+        class AllocationTargetGuard
+        {
+            data::AllocationStats *old_target = nullptr;
+
+          public:
+            explicit AllocationTargetGuard(data::AllocationStats *target) noexcept
+                : old_target(ThreadAllocationState().target)
+            {
+                ThreadAllocationState().target = target;
+            }
+
+            AllocationTargetGuard(const AllocationTargetGuard &) = delete;
+            AllocationTargetGuard &operator=(const AllocationTargetGuard &) = delete;
+
+            ~AllocationTargetGuard()
+            {
+                ThreadAllocationState().target = old_target;
+            }
+        };
+
+        // Stores the arguments of the deferred `TA_LOG` calls. One per thread, emptied before each test.
+        // Allocates memory in chunks, and reuses them in the next tests.
+        class DeferredLogArena
+        {
+            struct Chunk
+            {
+                std::unique_ptr<std::byte[]> bytes;
+                std::size_t size = 0;
+            };
+            std::vector<Chunk> chunks;
+            std::size_t cur_chunk = 0;
+            std::size_t cur_pos = 0;
+
+          public:
+            // The minimal chunk size, in bytes.
+            static constexpr std::size_t min_chunk_size = 4096;
+
+            // Returns uninitialized memory, valid until the next `Clear()`.
+            [[nodiscard]] CFG_TA_API void *Allocate(std::size_t size, std::size_t alignment);
+
+            // Frees all objects, but keeps the memory.
+            void Clear()
+            {
+                cur_chunk = 0;
+                cur_pos = 0;
+            }
+        };
+
         // The global per-thread state.
         struct GlobalThreadState
         {
@@ -3121,28 +3812,20 @@ namespace ta_test
 
             // This is used to print (or just examine) the current context.
             // All currently running assertions go there, and possibly other things.
-            std::vector<std::shared_ptr<const context::BasicFrame>> context_stack;
-            // This is used to deduplicate the `context_stack` elements.
-            std::set<const context::BasicFrame *> context_stack_set;
+            // This isn't deduplicated, because that would cost an allocation per frame. `output::PrintContext()` skips the repeated frames instead.
+            std::vector<const context::BasicFrame *> context_stack;
 
             // Each log statement (scoped or not) receives an incremental thread-specific ID.
             std::size_t log_id_counter = 0;
             // The current scoped log, which is what `context::CurrentScopedLog()` returns.
             // The unscoped log sits in `BasicModule::RunSingleTestResults`.
             std::vector<context::LogEntry *> scoped_log;
+            // The arguments of the deferred log messages of the current test, see `DeferrableLogArg`.
+            DeferredLogArena deferred_log_arena;
 
-            // Assertion argument storage:
+            // Assertion argument storage, shared by all nested assertions.
             // We're putting it here to reuse the heap allocations.
-
-            // Byte arrays for the arguments. Outer vector is for nested assertions, inner vectors are for per-assertion arguments.
-            // We can't use a flat vector, because it can't be extended without moving the existing elements,
-            //   which would mess up non-trivially-relocatable elements (which we can't even check for in current C++).
-            std::vector<std::vector<ArgBuffer>> assertion_argument_buffers;
-            // The metadata is relocatable, so this is a flat vector.
-            std::vector<ArgMetadata> assertion_argument_metadata;
-            // Next index for `assertion_argument_buffers`.
-            // We can't use the vector size for that, because we want to preserve the outer vector size to reuse the elements' buffers.
-            std::size_t assertion_argument_buffers_pos = 0;
+            ArgArena assertion_argument_arena;
 
             // Gracefully fails the current test, if not already failed.
             // Call this first, before printing any messages.
@@ -3159,6 +3842,35 @@ namespace ta_test
 
         // Whether stdout (or stderr, depending on the argument) is attached to a terminal.
         CFG_TA_API bool IsTerminalAttached(bool is_stderr);
+
+        // The CPU time used by the current thread so far, or zero if unknown.
+        CFG_TA_API std::chrono::nanoseconds ThreadCpuTime();
+
+        // Counts the hardware events on the current thread, using `perf_event_open()` on Linux.
+        // If the counters are unsupported or disallowed (e.g. by `/proc/sys/kernel/perf_event_paranoid`), they're silently unavailable.
+        class HardwareCounters
+        {
+            enum Event {cycles, instructions, cache_misses, branch_misses, num_events};
+
+            // The file descriptors of the counters, or -1 for the unavailable ones. The first available one is the group leader.
+            std::array<int, num_events> fds;
+            int leader_fd = -1;
+
+          public:
+            // The counters start disabled.
+            CFG_TA_API HardwareCounters();
+            HardwareCounters(const HardwareCounters &) = delete;
+            HardwareCounters &operator=(const HardwareCounters &) = delete;
+            CFG_TA_API ~HardwareCounters();
+
+            // Whether at least one counter is available.
+            [[nodiscard]] bool IsAvailable() const {return leader_fd != -1;}
+
+            // Resets and enables the counters.
+            CFG_TA_API void Start();
+            // Disables the counters and returns their values since `Start()`, scaled if the kernel had to multiplex them.
+            [[nodiscard]] CFG_TA_API data::BenchmarkCounters Stop();
+        };
     }
 
 
@@ -3174,12 +3886,14 @@ namespace ta_test
             data::BasicAssertion *assertion = nullptr;
             ArgBuffer *target_buffer = nullptr;
             ArgMetadata *target_metadata = nullptr;
+            // See `data::AssertionExprStaticInfo::ArgInfo::is_named_object`.
+            bool capture_by_reference = false;
 
             // Raises a hard error if the assertion owning this argument isn't currently running in this thread.
             CFG_TA_API void EnsureAssertionIsRunning();
 
-            ArgWrapper(data::BasicAssertion &assertion, ArgBuffer &target_buffer, ArgMetadata &target_metadata)
-                : assertion(&assertion), target_buffer(&target_buffer), target_metadata(&target_metadata)
+            ArgWrapper(data::BasicAssertion &assertion, ArgBuffer &target_buffer, ArgMetadata &target_metadata, bool capture_by_reference)
+                : assertion(&assertion), target_buffer(&target_buffer), target_metadata(&target_metadata), capture_by_reference(capture_by_reference)
             {
                 EnsureAssertionIsRunning();
                 target_metadata.state = data::AssertionExprDynamicInfo::ArgState::in_progress;
@@ -3201,24 +3915,90 @@ namespace ta_test
                     return *std::launder(reinterpret_cast<std::string *>(buffer.buffer));
                 };
 
+                // If this is a named lvalue, store a pointer to it instead of copying it.
+                // The small trivially copyable objects are still copied, since that's just as cheap,
+                //   and that way we print the value they had at this point, even if the expression modifies them later.
+                if constexpr (std::is_lvalue_reference_v<T> && !string_conv::CopyForLazyStringConversion<type>::value)
+                {
+                    if (capture_by_reference)
+                    {
+                        target_metadata->StoreValue(*target_buffer, std::addressof(std::as_const(arg)));
+                        target_metadata->to_string_func = [](ArgMetadata &self, ArgBuffer &buffer) -> const std::string &
+                        {
+                            // Convert to a string.
+                            std::string string = string_conv::ToString(**std::launder(reinterpret_cast<const type **>(buffer.buffer)));
+
+                            // Store the string as the new value.
+                            auto &ret = self.StoreValue(buffer, std::move(string));
+                            self.to_string_func = identity_to_string;
+
+                            return ret;
+                        };
+
+                        target_metadata->state = data::AssertionExprDynamicInfo::ArgState::done;
+                        return std::forward<T>(arg);
+                    }
+                }
+
                 // If we can copy the object itself (to then convert to string lazily), do it.
-                if constexpr (FitsIntoArgStorage<type> && string_conv::SupportsLazyToString<type>)
+                if constexpr (string_conv::SupportsLazyToString<type>)
                 {
                     using traits = string_conv::MaybeLazyToString<type>;
+                    using proxy_type = std::remove_cvref_t<decltype(traits{}(std::as_const(arg)))>;
 
-                    target_metadata->StoreValue(*target_buffer, traits{}(std::as_const(arg)));
-                    target_metadata->to_string_func = [](ArgMetadata &self, ArgBuffer &buffer) -> const std::string &
+                    if constexpr (FitsIntoArgStorage<proxy_type>)
                     {
-                        // Convert to a string.
-                        using proxy_type = std::remove_cvref_t<decltype(traits{}(std::as_const(arg)))>;
-                        std::string string = string_conv::ToString(*std::launder(reinterpret_cast<proxy_type *>(buffer.buffer)));
+                        target_metadata->StoreValue(*target_buffer, traits{}(std::as_const(arg)));
+                        target_metadata->to_string_func = [](ArgMetadata &self, ArgBuffer &buffer) -> const std::string &
+                        {
+                            // Convert to a string.
+                            std::string string = string_conv::ToString(*std::launder(reinterpret_cast<proxy_type *>(buffer.buffer)));
 
-                        // Store the string as the new value.
-                        auto &ret = self.StoreValue(buffer, std::move(string));
-                        self.to_string_func = identity_to_string;
+                            // Store the string as the new value.
+                            auto &ret = self.StoreValue(buffer, std::move(string));
+                            self.to_string_func = identity_to_string;
 
-                        return ret;
-                    };
+                            return ret;
+                        };
+                    }
+                    else if constexpr (alignof(proxy_type) <= alignof(ArgSlot))
+                    {
+                        // Too large for the buffer, so store it in the arena, after the slots of this assertion.
+                        // The storage is freed along with them, so this doesn't touch the heap after the first few assertions.
+                        // We can't move from `arg`, since we return it to the enclosing expression.
+                        void *storage = ThreadState().assertion_argument_arena.PushStorage(sizeof(proxy_type));
+                        target_metadata->StoreValue(*target_buffer, ::new(storage) proxy_type(traits{}(std::as_const(arg))));
+                        if constexpr (!std::is_trivially_destructible_v<proxy_type>)
+                            target_metadata->cleanup_func = [](ArgBuffer &buffer) {(*std::launder(reinterpret_cast<proxy_type **>(buffer.buffer)))->~proxy_type();};
+                        target_metadata->to_string_func = [](ArgMetadata &self, ArgBuffer &buffer) -> const std::string &
+                        {
+                            // Convert to a string.
+                            std::string string = string_conv::ToString(**std::launder(reinterpret_cast<proxy_type **>(buffer.buffer)));
+
+                            // Store the string as the new value. This destroys the object, but its storage stays until the assertion ends.
+                            auto &ret = self.StoreValue(buffer, std::move(string));
+                            self.to_string_func = identity_to_string;
+
+                            return ret;
+                        };
+                    }
+                    else
+                    {
+                        // Too large for the buffer and overaligned for the arena, so store it on the heap.
+                        // We can't move from `arg`, since we return it to the enclosing expression.
+                        target_metadata->StoreValue(*target_buffer, std::unique_ptr<proxy_type>(new proxy_type(traits{}(std::as_const(arg)))));
+                        target_metadata->to_string_func = [](ArgMetadata &self, ArgBuffer &buffer) -> const std::string &
+                        {
+                            // Convert to a string.
+                            std::string string = string_conv::ToString(**std::launder(reinterpret_cast<std::unique_ptr<proxy_type> *>(buffer.buffer)));
+
+                            // Store the string as the new value. This frees the heap storage.
+                            auto &ret = self.StoreValue(buffer, std::move(string));
+                            self.to_string_func = identity_to_string;
+
+                            return ret;
+                        };
+                    }
                 }
                 else
                 {
@@ -3231,7 +4011,8 @@ namespace ta_test
             }
         };
 
-        struct AssertionExprStaticInfoImpl final : data::AssertionExprStaticInfo
+        // The non-template part of `AssertionExprStaticInfoStorage`.
+        struct AssertionExprStaticInfoImpl : data::AssertionExprStaticInfo
         {
             struct CounterIndexPair
             {
@@ -3239,18 +4020,286 @@ namespace ta_test
                 std::size_t index = 0;
             };
 
-            std::vector<CounterIndexPair> counter_to_arg_index;
+            // Sorted by counter, to allow binary search.
+            std::span<const CounterIndexPair> counter_to_arg_index;
 
-            CFG_TA_API AssertionExprStaticInfoImpl(std::string_view raw_expr, std::string_view expanded_expr);
-        };
+            // If the expression is malformed, this is the error message. `AssertWrapper` reports it when the assertion runs.
+            const char *error = nullptr;
+            HardErrorKind error_kind = HardErrorKind::internal;
 
-        // An intermediate base class that `AssertWrapper<T>` inherits from.
-        // You can also inherit custom assertion classes from this, if they don't need the expression decomposition provided by `AssertWrapper<T>`.
-        class CFG_TA_API_CLASS AssertWrapper final : public data::BasicAssertion, public data::AssertionExprDynamicInfo
-        {
-            bool condition_value = false;
+          protected:
+            constexpr AssertionExprStaticInfoImpl() = default;
 
-            // User condition was evaluated to completion.
+            // Returns the number of `$[...]` in the expression before macro expansion.
+            [[nodiscard]] static constexpr std::size_t CountArgs(std::string_view raw_expr)
+            {
+                std::size_t num_args = 0;
+                text::expr::ParseExpr(raw_expr, nullptr, true, [&](bool exiting, std::string_view name, std::string_view args, std::size_t depth)
+                {
+                    (void)args;
+                    (void)depth;
+                    if (!exiting && text::chars::IsArgMacroName(name))
+                        num_args++;
+                });
+                return num_args;
+            }
+
+            // Fills the argument information. The spans must have `CountArgs(raw_expr)` elements each.
+            // On failure sets `error` and returns early.
+            constexpr void Parse(
+                std::string_view raw_expr, std::string_view expanded_expr,
+                std::span<ArgInfo> out_args_info, std::span<std::size_t> out_args_in_draw_order, std::span<CounterIndexPair> out_counter_to_arg_index
+            )
+            {
+                auto SetError = [&](const char *message, HardErrorKind kind = HardErrorKind::internal)
+                {
+                    if (!error)
+                    {
+                        error = message;
+                        error_kind = kind;
+                    }
+                };
+
+                // Check that `$[...]` weren't expanded too early by another macro.
+                if (raw_expr.find("_ta_arg_(") != std::string_view::npos)
+                {
+                    SetError(
+                        "Invalid assertion macro usage. When passing `$[...]`, "
+                        "the `TA_CHECK` macro must not be wrapped in another function-like macro. Wrap `DETAIL_TA_CHECK` directly instead.",
+                        HardErrorKind::user
+                    );
+                    return;
+                }
+
+                const std::size_t num_args = out_args_info.size();
+
+                // Below we parse the expression twice. The first parse triggers the callback at the beginning of `$[...]`,
+                // and the second triggers it at the end of `$[...]`. This creates more work for us, but can't be fixed without
+                // wrapping the whole argument of `$[...]` in a macro call (which is incompatible with using `[...]`, which we want because they look better).
+
+                // Parse expanded string.
+                std::size_t pos = 0;
+                text::expr::ParseExpr(expanded_expr, nullptr, false, [&](bool exiting, std::string_view name, std::string_view args, std::size_t depth)
+                {
+                    (void)depth;
+
+                    if (error || !exiting || name != "_ta_arg_")
+                        return;
+
+                    if (pos >= num_args)
+                    {
+                        SetError("`$` not followed by `[...]`.", HardErrorKind::user);
+                        return;
+                    }
+
+                    ArgInfo &new_info = out_args_info[pos];
+
+                    // Note: Can't fill `new_info.depth` here, because the parentheses only container the counter, and not the actual `$[...]` argument.
+                    // We fill the depth during the next pass.
+
+                    for (const char &ch : args)
+                    {
+                        if (text::chars::IsDigit(ch))
+                        {
+                            new_info.counter = new_info.counter * 10 + (ch - '0');
+                        }
+                        else if (ch == ',')
+                        {
+                            break;
+                        }
+                        else
+                        {
+                            SetError("Lexer error: Unexpected character after the counter macro.");
+                            return;
+                        }
+                    }
+
+                    CounterIndexPair &new_pair = out_counter_to_arg_index[pos];
+                    new_pair.index = pos;
+                    new_pair.counter = new_info.counter;
+
+                    pos++;
+                });
+                if (!error && pos != num_args)
+                    SetError("Less `$[...]`s than expected.");
+                if (error)
+                    return;
+
+                // This stack maps bracket depth to the element index, so that the second pass processes things in the same order as the first pass.
+                // This only matters for nested brackets.
+                std::vector<std::size_t> bracket_stack;
+                bracket_stack.reserve(num_args);
+
+                // Parse raw string.
+                pos = 0;
+                text::expr::ParseExpr(raw_expr, nullptr, true, [&](bool exiting, std::string_view name, std::string_view args, std::size_t depth)
+                {
+                    // This `depth` is useless to us, because it also counts the user parentheses.
+                    (void)depth;
+
+                    if (error || !text::chars::IsArgMacroName(name))
+                        return;
+
+                    if (!exiting)
+                    {
+                        if (pos >= num_args)
+                        {
+                            SetError("More `$[...]`s than expected.");
+                            return;
+                        }
+
+                        bracket_stack.push_back(pos++);
+                        return;
+                    }
+
+                    ArgInfo &this_info = out_args_info[bracket_stack.back()];
+                    bracket_stack.pop_back();
+
+                    this_info.depth = bracket_stack.size();
+
+                    this_info.expr_offset = std::size_t(args.data() - raw_expr.data());
+                    this_info.expr_size = args.size();
+
+                    this_info.ident_offset = std::size_t(name.data() - raw_expr.data());
+                    this_info.ident_size = name.size();
+
+                    // Trim side whitespace from `args`.
+                    std::string_view trimmed_args = args;
+                    while (!trimmed_args.empty() && text::chars::IsWhitespace(trimmed_args.front()))
+                        trimmed_args.remove_prefix(1);
+                    while (!trimmed_args.empty() && text::chars::IsWhitespace(trimmed_args.back()))
+                        trimmed_args.remove_suffix(1);
+
+                    // Decide if we should draw a bracket for this argument.
+                    for (char ch : trimmed_args)
+                    {
+                        // Whatever the condition is, it should trigger for all arguments with nested arguments.
+                        if (!text::chars::IsIdentifierChar(ch))
+                        {
+                            this_info.need_bracket = true;
+                            break;
+                        }
+                    }
+
+                    // Decide if this is a named object: identifiers separated by `::`, `.`, or `->`, with optional whitespace around the separators.
+                    // Reject the arguments inside of braces, since those can be locals of a lambda that don't outlive the assertion.
+                    this_info.is_named_object = [&]
+                    {
+                        int brace_depth = 0;
+                        char quote = 0;
+                        for (std::size_t i = 0; i < this_info.expr_offset; i++)
+                        {
+                            char ch = raw_expr[i];
+                            if (quote)
+                            {
+                                if (ch == '\\')
+                                    i++;
+                                else if (ch == quote)
+                                    quote = 0;
+                            }
+                            else if (ch == '"' || (ch == '\'' && !(i > 0 && text::chars::IsDigit(raw_expr[i - 1])))) // Not a digit separator.
+                                quote = ch;
+                            else if (ch == '{')
+                                brace_depth++;
+                            else if (ch == '}')
+                                brace_depth--;
+                        }
+                        if (brace_depth != 0)
+                            return false;
+
+                        std::string_view rest = trimmed_args;
+
+                        auto SkipWhitespace = [&]
+                        {
+                            while (!rest.empty() && text::chars::IsWhitespace(rest.front()))
+                                rest.remove_prefix(1);
+                        };
+                        auto SkipSeparator = [&]
+                        {
+                            for (std::string_view sep : {"::", ".", "->"})
+                            {
+                                if (rest.starts_with(sep))
+                                {
+                                    rest.remove_prefix(sep.size());
+                                    return true;
+                                }
+                            }
+                            return false;
+                        };
+
+                        // A leading `::`.
+                        if (rest.starts_with("::"))
+                            rest.remove_prefix(2);
+
+                        while (true)
+                        {
+                            SkipWhitespace();
+                            if (rest.empty() || !text::chars::IsNonDigitIdentifierCharStrict(rest.front()))
+                                return false;
+                            while (!rest.empty() && text::chars::IsIdentifierCharStrict(rest.front()))
+                                rest.remove_prefix(1);
+                            SkipWhitespace();
+                            if (rest.empty())
+                                return true;
+                            if (!SkipSeparator())
+                                return false;
+                        }
+                    }();
+                });
+                if (!error && pos != num_args)
+                    SetError("Less `$[...]`s than expected.");
+                if (error)
+                    return;
+
+                // Sort `counter_to_arg_index` by counter, to allow binary search.
+                std::sort(out_counter_to_arg_index.begin(), out_counter_to_arg_index.end(),
+                    [](const CounterIndexPair &a, const CounterIndexPair &b){return a.counter < b.counter;}
+                );
+
+                // Fill and sort `args_in_draw_order`.
+                for (std::size_t i = 0; i < num_args; i++)
+                    out_args_in_draw_order[i] = i;
+                std::sort(out_args_in_draw_order.begin(), out_args_in_draw_order.end(), [&](std::size_t a, std::size_t b)
+                {
+                    if (auto d = out_args_info[a].depth <=> out_args_info[b].depth; d != 0)
+                        return d > 0;
+                    if (auto d = out_args_info[a].counter <=> out_args_info[b].counter; d != 0)
+                        return d < 0;
+                    return false;
+                });
+            }
+        };
+
+        // The information about a single assertion expression, parsed at compile-time.
+        // `RawExpr` is the expression before macro expansion, and `ExpandedExpr` is after it.
+        template <meta::ConstString RawExpr, meta::ConstString ExpandedExpr>
+        struct AssertionExprStaticInfoStorage final : AssertionExprStaticInfoImpl
+        {
+            static constexpr std::size_t num_args = CountArgs(RawExpr.view());
+
+            std::array<ArgInfo, num_args> args_info_storage{};
+            std::array<std::size_t, num_args> args_in_draw_order_storage{};
+            std::array<CounterIndexPair, num_args> counter_to_arg_index_storage{};
+
+            constexpr AssertionExprStaticInfoStorage()
+            {
+                expr = RawExpr.view();
+                Parse(RawExpr.view(), ExpandedExpr.view(), args_info_storage, args_in_draw_order_storage, counter_to_arg_index_storage);
+                args_info = args_info_storage;
+                args_in_draw_order = args_in_draw_order_storage;
+                counter_to_arg_index = counter_to_arg_index_storage;
+            }
+        };
+        template <meta::ConstString RawExpr, meta::ConstString ExpandedExpr>
+        inline constexpr AssertionExprStaticInfoStorage<RawExpr, ExpandedExpr> assertion_expr_static_info;
+
+        // An intermediate base class that `AssertWrapper<T>` inherits from.
+        // You can also inherit custom assertion classes from this, if they don't need the expression decomposition provided by `AssertWrapper<T>`.
+        class CFG_TA_API_CLASS AssertWrapper final : public data::BasicAssertion, public data::AssertionExprDynamicInfo
+        {
+            bool condition_value = false;
+
+            // User condition was evaluated to completion.
             bool condition_value_known = false;
 
             // This is called to get the optional user message, flags, etc (null if none of that).
@@ -3258,6 +4307,8 @@ namespace ta_test
             const void *extras_data = nullptr;
             // The user message (if any) is written here on failure or when
             std::optional<std::string> user_message;
+            // See `SetDetails()`.
+            std::optional<std::string> details;
 
             // This is only set on failure.
             AssertFlags flags{};
@@ -3267,6 +4318,8 @@ namespace ta_test
             struct AssertionStackGuard
             {
                 AssertWrapper &self;
+                // The arena position before our arguments were allocated.
+                ArgArena::Mark old_arena_mark;
 
                 CFG_TA_API AssertionStackGuard(AssertWrapper &self);
 
@@ -3307,18 +4360,22 @@ namespace ta_test
 
             CFG_TA_API AssertWrapper(std::string_view name, SourceLoc loc, void (*breakpoint_func)());
 
-            template <typename F>
-            AssertWrapper(std::string_view name, SourceLoc loc, std::string_view raw_expr, std::string_view expanded_expr, const F &func, void (*breakpoint_func)())
+            // `RawExpr` and `ExpandedExpr` are the condition before and after macro expansion. They are parsed at compile-time.
+            template <meta::ConstString RawExpr, meta::ConstString ExpandedExpr, typename F>
+            AssertWrapper(std::string_view name, SourceLoc loc, meta::ConstStringTag<RawExpr>, meta::ConstStringTag<ExpandedExpr>, const F &func, void (*breakpoint_func)())
                 : AssertWrapper(name, loc, breakpoint_func)
             {
+                constexpr const AssertionExprStaticInfoImpl &info = assertion_expr_static_info<RawExpr, ExpandedExpr>;
+                if constexpr (info.error != nullptr)
+                    HardError(info.error, info.error_kind);
+
                 condition_func = [](AssertWrapper &self, const void *data)
                 {
                     return (*static_cast<const F *>(data))(self);
                 };
                 condition_data = &func;
 
-                static const AssertionExprStaticInfoImpl static_info_storage(raw_expr, expanded_expr);
-                static_info = &static_info_storage;
+                static_info = &info;
             }
 
             AssertWrapper(const AssertWrapper &) = delete;
@@ -3367,8 +4424,15 @@ namespace ta_test
                 return DETAIL_TA_ADD_EXTRAS;
             }
 
+            // Sets the string returned by `Details()`. Call this from the condition, right before it evaluates to false.
+            void SetDetails(std::string new_details)
+            {
+                details = std::move(new_details);
+            }
+
             CFG_TA_API const SourceLoc &SourceLocation() const override;
             CFG_TA_API std::optional<std::string_view> UserMessage() const override;
+            CFG_TA_API std::optional<std::string_view> Details() const override;
 
             CFG_TA_API DecoVar GetElement(int index) const override;
             [[nodiscard]] CFG_TA_API ArgWrapper _ta_arg_(int counter);
@@ -3429,8 +4493,16 @@ namespace ta_test
             // The order matches the registration order, with prefixes keeping the first registration order.
             std::map<std::string_view, std::size_t, TestNameLess> name_prefixes_to_order;
 
+            // Sorts test `indices` without splitting the test groups. Two tests are ordered by the first prefix where their names differ
+            //   (for `foo/bar/x` and `foo/baz/y`, that's `foo/bar` and `foo/baz`), and `less` compares those prefixes.
+            CFG_TA_API void SortTestListByPrefixes(std::span<std::size_t> indices, const std::function<bool(std::string_view prefix_a, std::string_view prefix_b)> &less) const;
+
             // Sorts test `indices` in the preferred execution order.
             CFG_TA_API void SortTestListInExecutionOrder(std::span<std::size_t> indices) const;
+
+            // Sorts test `indices` by `priorities` (indexed like `tests`), larger first, without splitting the test groups.
+            // Each group is ordered by the largest priority of its tests. Equal priorities keep the preferred execution order.
+            CFG_TA_API void SortTestListByPriority(std::span<std::size_t> indices, std::span<const double> priorities) const;
         };
         [[nodiscard]] CFG_TA_API GlobalState &State();
 
@@ -3496,12 +4568,56 @@ namespace ta_test
         // Generate the next incremental log message id.
         [[nodiscard]] CFG_TA_API std::size_t GenerateLogId();
 
+        // Whether `TA_LOG` and `TA_CONTEXT` can copy an argument of this type and format it later, only if the log gets printed.
+        // This only allows types that are cheap to copy and can't dangle.
+        template <typename T>
+        concept DeferrableLogArg = std::is_arithmetic_v<T> || std::is_enum_v<T>;
+
+        // The format string and the copied arguments of a deferred log message.
+        template <typename ...P>
+        struct DeferredLogMessage
+        {
+            std::string_view format;
+            std::tuple<P...> args;
+
+            // Formats the message. `data` points to a `DeferredLogMessage`.
+            [[nodiscard]] static std::string Format(const void *data)
+            {
+                const DeferredLogMessage &self = *static_cast<const DeferredLogMessage *>(data);
+                return std::apply([&](const P &... elems)
+                {
+                    return CFG_TA_FMT_NAMESPACE::vformat(self.format, CFG_TA_FMT_NAMESPACE::make_format_args(elems...));
+                }, self.args);
+            }
+        };
+
+        // Converts a format string to a `std::string_view`. Format strings are always constant, so the result never dangles.
+        template <typename ...P>
+        [[nodiscard]] std::string_view FormatStringToView(CFG_TA_FMT_NAMESPACE::format_string<P...> format)
+        {
+            return {format.get().data(), format.get().size()};
+        }
+
         CFG_TA_API void AddLogEntryLow(std::string &&message);
-        // `TA_CONTEXT` expands to this.
+        // Allocates the memory for a `DeferredLogMessage` of the next unscoped log entry.
+        [[nodiscard]] CFG_TA_API void *AllocateDeferredLogMessage(std::size_t size, std::size_t alignment);
+        // Adds a message that will be generated by `generate_message(data)` when it's first printed.
+        CFG_TA_API void AddDeferredLogEntryLow(std::string (*generate_message)(const void *data), const void *data);
+        // `TA_LOG` expands to this.
         template <typename ...P>
         void AddLogEntry(CFG_TA_FMT_NAMESPACE::format_string<P...> format, P &&... args)
         {
-            AddLogEntryLow(CFG_TA_FMT_NAMESPACE::format(format, std::forward<P>(args)...));
+            if constexpr ((DeferrableLogArg<std::remove_cvref_t<P>> && ...))
+            {
+                using Message = DeferredLogMessage<std::remove_cvref_t<P>...>;
+                static_assert(std::is_trivially_destructible_v<Message>, "The arena doesn't run the destructors.");
+                void *ptr = AllocateDeferredLogMessage(sizeof(Message), alignof(Message));
+                AddDeferredLogEntryLow(Message::Format, ::new(ptr) Message{FormatStringToView<P...>(format), {args...}});
+            }
+            else
+            {
+                AddLogEntryLow(CFG_TA_FMT_NAMESPACE::format(format, std::forward<P>(args)...));
+            }
         }
         CFG_TA_API void AddLogEntry(const SourceLoc &loc);
 
@@ -3551,6 +4667,47 @@ namespace ta_test
             {}
         };
 
+        // A `TA_CONTEXT` with arguments that satisfy `DeferrableLogArg`. Copies them, and formats the message only when printing the log.
+        template <typename ...P>
+        class ScopedLogGuardDeferred final : BasicScopedLogGuard
+        {
+            DeferredLogMessage<P...> message;
+
+          public:
+            template <typename ...Q>
+            ScopedLogGuardDeferred(std::string_view format, Q &&... args)
+                // `this->message` isn't initialized here yet, but we don't read it yet, so it doesn't matter.
+                : BasicScopedLogGuard({GenerateLogId(), context::LogMessage{DeferredLogMessage<P...>::Format, &this->message}}),
+                message{format, {std::forward<Q>(args)...}}
+            {}
+        };
+
+        // `TA_CONTEXT` expands to this.
+        // User message.
+        template <typename ...P>
+        [[nodiscard]] auto MakeScopedLogGuard(const char *func_name, CFG_TA_FMT_NAMESPACE::format_string<P...> format, P &&... args)
+        {
+            if constexpr ((DeferrableLogArg<std::remove_cvref_t<P>> && ...))
+            {
+                (void)func_name;
+                return ScopedLogGuardDeferred<std::remove_cvref_t<P>...>(FormatStringToView<P...>(format), std::forward<P>(args)...);
+            }
+            else
+            {
+                return ScopedLogGuard(func_name, format, std::forward<P>(args)...);
+            }
+        }
+        // Source location.
+        [[nodiscard]] inline ScopedLogGuard MakeScopedLogGuard(std::string_view func_name, const SourceLoc &loc)
+        {
+            return ScopedLogGuard(func_name, loc);
+        }
+        // Source location with function name override.
+        [[nodiscard]] inline ScopedLogGuard MakeScopedLogGuard(const char *orig_func_name, const SourceLoc &loc, std::string_view func_name)
+        {
+            return ScopedLogGuard(orig_func_name, loc, func_name);
+        }
+
 
         // --- GENERATORS ---
 
@@ -3582,6 +4739,31 @@ namespace ta_test
 
             UserFuncWrapperType func;
 
+            // Whether the functor can make simpler versions of its values, see `BasicGenerator::CanShrink()`.
+            static constexpr bool can_shrink = std::copyable<std::remove_cvref_t<ReturnType>> &&
+                requires(const std::remove_cvref_t<decltype(std::declval<UserFuncWrapperType &>().func)> &f, const std::remove_cvref_t<ReturnType> &value, std::size_t index)
+                {
+                    {f.NumShrinkCandidates(value)} -> std::convertible_to<std::size_t>;
+                    {f.ShrinkCandidate(value, index)} -> std::same_as<std::remove_cvref_t<ReturnType>>;
+                };
+
+            // Whether the functor can skip values, see `BasicGenerator::CanGenerateAt()`.
+            static constexpr bool can_generate_at =
+                requires(std::remove_cvref_t<decltype(std::declval<UserFuncWrapperType &>().func)> &f, std::size_t count)
+                {
+                    f.SkipValues(count);
+                    {std::as_const(f).NumValues()} -> std::convertible_to<std::size_t>;
+                };
+
+            struct ShrinkState
+            {
+                std::optional<std::remove_cvref_t<ReturnType>> base;
+                std::size_t num_candidates = 0;
+            };
+            struct NoShrinkState {};
+            // Only used if `can_shrink` is true.
+            std::conditional_t<can_shrink, ShrinkState, NoShrinkState> shrink_state;
+
             template <typename G>
             SpecificGenerator(G &&make_func) : func(std::forward<G>(make_func)()) {}
 
@@ -3604,6 +4786,86 @@ namespace ta_test
                 return func.flags;
             }
 
+            [[nodiscard]] std::optional<std::size_t> NumValuesIfKnown() const override
+            {
+                if constexpr (requires{{std::as_const(func.func).NumValues()} -> std::convertible_to<std::size_t>;})
+                    return std::as_const(func.func).NumValues();
+                else
+                    return std::nullopt;
+            }
+
+            [[nodiscard]] bool CanGenerateAt() const override
+            {
+                return can_generate_at;
+            }
+
+            void GenerateAt(std::size_t index) override
+            {
+                if constexpr (can_generate_at)
+                {
+                    if (index < this->num_generated_values)
+                        HardError("Can't move a generator backwards.");
+                    if (index >= NumValuesIfKnown().value())
+                        HardError("The generator value index is out of range.");
+                    func.func.SkipValues(index - this->num_generated_values);
+                    this->num_generated_values = index;
+                    Generate();
+                }
+                else
+                {
+                    (void)index;
+                    HardError("This generator doesn't support random access.");
+                }
+            }
+
+            [[nodiscard]] bool CanShrink() const override
+            {
+                return can_shrink;
+            }
+
+            std::size_t MakeShrinkCandidates() override
+            {
+                if constexpr (can_shrink)
+                {
+                    shrink_state.base = this->GetValue();
+                    shrink_state.num_candidates = std::as_const(func.func).NumShrinkCandidates(*shrink_state.base);
+                    return shrink_state.num_candidates;
+                }
+                else
+                {
+                    HardError("This generator doesn't support shrinking.");
+                }
+            }
+
+            void UseShrinkCandidate(std::size_t index) override
+            {
+                if constexpr (can_shrink)
+                {
+                    if (index >= shrink_state.num_candidates)
+                        HardError("The shrinking candidate index is out of range.");
+                    SetShrunkValue(std::as_const(func.func).ShrinkCandidate(*shrink_state.base, index));
+                }
+                else
+                {
+                    (void)index;
+                    HardError("This generator doesn't support shrinking.");
+                }
+            }
+
+            void RestoreShrinkBase() override
+            {
+                if constexpr (can_shrink)
+                {
+                    if (!shrink_state.base)
+                        HardError("Nothing to restore, the shrinking didn't start.");
+                    SetShrunkValue(*shrink_state.base);
+                }
+                else
+                {
+                    HardError("This generator doesn't support shrinking.");
+                }
+            }
+
             void Generate() override
             {
                 auto generate_value = [&]
@@ -3635,10 +4897,22 @@ namespace ta_test
                 this->this_value_is_custom = false;
                 this->num_generated_values++;
             }
+
+          private:
+            void SetShrunkValue(const std::remove_cvref_t<ReturnType> &value)
+            {
+                this->storage.template emplace<2>(value);
+                this->this_value_is_custom = true;
+                this->num_custom_values++;
+            }
         };
 
         class GenerateValueHelper
         {
+            // The generators outlive the test repetition, so they shouldn't count as the test's allocations.
+            // This is the first member, to be destroyed last.
+            AllocationTargetGuard pause_allocation_tracking{nullptr};
+
             // All those are set internally by `HandleGenerator()`:
 
             bool creating_new_generator = false;
@@ -3648,8 +4922,8 @@ namespace ta_test
             bool generator_stays_in_stack = false;
 
           public:
-            // This must be filled with the source location.
-            SourceLocWithCounter source_loc;
+            // The source location. Points to `SpecificGenerator<...>::location`, its address identifies the generator in `visited_generator_cache`.
+            const SourceLocWithCounter &source_loc;
 
             // The caller places the current generator here.
             data::BasicGenerator *untyped_generator = nullptr;
@@ -3658,7 +4932,7 @@ namespace ta_test
             // Note that `HandleGenerator()` moves from this variable, so it's always null in the destructor.
             std::unique_ptr<data::BasicGenerator> created_untyped_generator;
 
-            CFG_TA_API GenerateValueHelper(SourceLocWithCounter source_loc);
+            CFG_TA_API GenerateValueHelper(const SourceLocWithCounter &source_loc);
 
             GenerateValueHelper(const GenerateValueHelper &) = delete;
             GenerateValueHelper &operator=(const GenerateValueHelper &) = delete;
@@ -3685,7 +4959,7 @@ namespace ta_test
             if (!thread_state.current_test)
                 HardError("Can't use `TA_GENERATE(...)` when no test is running.", HardErrorKind::user);
 
-            GenerateValueHelper guard({{LocFile.view(), LocLine}, LocCounter});
+            GenerateValueHelper guard(GeneratorType::location);
 
             GeneratorType *typed_generator = nullptr;
 
@@ -3708,12 +4982,11 @@ namespace ta_test
                 // Try to reuse a cached value.
                 if (!bool(new_generator->Flags() & GeneratorFlags::new_value_when_revisiting))
                 {
-                    auto iter = thread_state.current_test->visited_generator_cache.find(guard.source_loc);
-                    if (iter != thread_state.current_test->visited_generator_cache.end())
+                    if (const std::size_t *index = thread_state.current_test->visited_generator_cache.Find(&guard.source_loc))
                     {
-                        if (iter->second >= thread_state.current_test->generator_stack.size())
+                        if (*index >= thread_state.current_test->generator_stack.size())
                             HardError("Cached generator index is somehow out of range?");
-                        return dynamic_cast<GeneratorType &>(const_cast<data::BasicGenerator &>(*thread_state.current_test->generator_stack[iter->second])).GetValue();
+                        return dynamic_cast<GeneratorType &>(const_cast<data::BasicGenerator &>(*thread_state.current_test->generator_stack[*index])).GetValue();
                     }
                 }
 
@@ -3895,17 +5168,37 @@ namespace ta_test
                 auto operator()() const
                 {
                     bool is_empty = self.enabled_variants.empty();
-                    return GenerateFuncParam(
-                        self.flags | is_empty * GeneratorFlags::generate_nothing,
-                        [variants = std::move(self.enabled_variants), index = std::size_t(0)](bool &repeat) mutable -> IndexType
-                        {
-                            if (index >= variants.size())
-                                HardError("`TA_VARIANT(...)` index is out of range.");
-                            int ret = variants[index++];
-                            repeat = index < variants.size();
-                            return IndexType{ret};
-                        }
-                    );
+                    return GenerateFuncParam(self.flags | is_empty * GeneratorFlags::generate_nothing, VariantsFunctor{.variants = std::move(self.enabled_variants)});
+                }
+            };
+
+            // The functor for the underlying generator, iterates over the enabled variants.
+            struct VariantsFunctor
+            {
+                std::vector<int> variants;
+                std::size_t index = 0;
+
+                IndexType operator()(bool &repeat)
+                {
+                    if (index >= variants.size())
+                        HardError("`TA_VARIANT(...)` index is out of range.");
+                    int ret = variants[index++];
+                    repeat = index < variants.size();
+                    return IndexType{ret};
+                }
+
+                // See `BasicGenerator::NumValuesIfKnown()`.
+                [[nodiscard]] std::size_t NumValues() const
+                {
+                    return variants.size();
+                }
+
+                // See `BasicGenerator::CanGenerateAt()`.
+                void SkipValues(std::size_t count)
+                {
+                    if (count > variants.size() - index)
+                        HardError("`TA_VARIANT(...)` index is out of range.");
+                    index += count;
                 }
             };
 
@@ -4098,24 +5391,36 @@ namespace ta_test
         }
     };
 
-    // Converts a C++20 range to a functor usable with `TA_GENERATE_FUNC(...)`.
-    // `TA_GENERATE(...)` calls it internally. But you might want to call it manually,
-    // because `TA_GENERATE(...)` prevents you from using any local variables, for safety.
-    template <std::ranges::input_range T>
-    [[nodiscard]] auto RangeToGeneratorFunc(GeneratorFlags flags, T &&range)
+    namespace detail
     {
-        struct Functor
+        // The functor returned by `RangeToGeneratorFunc()`.
+        template <typename T>
+        struct RangeGeneratorFunctor
         {
             std::remove_cvref_t<T> range{};
             std::ranges::iterator_t<std::remove_cvref_t<T>> iter{};
 
-            explicit Functor(T &&range)
+            explicit RangeGeneratorFunctor(T &&range)
                 : range(std::forward<T>(range)), iter(this->range.begin())
             {}
 
             // `iter` might go stale on copy.
-            Functor(const Functor &) = delete;
-            Functor &operator=(const Functor &) = delete;
+            RangeGeneratorFunctor(const RangeGeneratorFunctor &) = delete;
+            RangeGeneratorFunctor &operator=(const RangeGeneratorFunctor &) = delete;
+
+            // See `BasicGenerator::NumValuesIfKnown()`.
+            [[nodiscard]] std::size_t NumValues() const requires std::ranges::sized_range<const std::remove_cvref_t<T>>
+            {
+                return std::size_t(std::ranges::size(range));
+            }
+
+            // See `BasicGenerator::CanGenerateAt()`.
+            void SkipValues(std::size_t count) requires std::ranges::random_access_range<std::remove_cvref_t<T>> && std::ranges::sized_range<std::remove_cvref_t<T>>
+            {
+                if (count > std::size_t(std::ranges::end(range) - iter))
+                    HardError("Overflowed a generator range.");
+                iter += std::ranges::range_difference_t<std::remove_cvref_t<T>>(count);
+            }
 
             decltype(auto) operator()(bool &repeat)
             {
@@ -4131,7 +5436,14 @@ namespace ta_test
                     return ret;
             }
         };
+    }
 
+    // Converts a C++20 range to a functor usable with `TA_GENERATE_FUNC(...)`.
+    // `TA_GENERATE(...)` calls it internally. But you might want to call it manually,
+    // because `TA_GENERATE(...)` prevents you from using any local variables, for safety.
+    template <std::ranges::input_range T>
+    [[nodiscard]] auto RangeToGeneratorFunc(GeneratorFlags flags, T &&range)
+    {
         // Here we check emptiness before moving the range, which seems to be unavoidable here.
         bool is_empty = false;
         if constexpr (requires{range.empty();})
@@ -4142,7 +5454,7 @@ namespace ta_test
             flags |= GeneratorFlags::generate_nothing;
 
         // Must get zero moves on the functor.
-        return GenerateFuncParam(flags, Functor(std::forward<T>(range)));
+        return GenerateFuncParam(flags, detail::RangeGeneratorFunctor<T>(std::forward<T>(range)));
     }
     // Those overload accept `{...}` initializer lists. They also conveniently add support for C arrays.
     // Note the lvalue overload being non-const, this way it can accept both const and non-const arrays, same as `std::to_array`.
@@ -4165,19 +5477,726 @@ namespace ta_test
     [[nodiscard]] auto RangeToGeneratorFunc(T (&&range)[N]) {return (RangeToGeneratorFunc)(GeneratorFlags{}, std::move(range));}
 
 
-    // --- ANALYZING EXCEPTIONS ---
-
-    struct ExceptionElemsCombinedTag {explicit ExceptionElemsCombinedTag() = default;};
-    // The functions checking exception message accept this in addition to `ExceptionElem` to check the whole message.
-    inline constexpr ExceptionElemsCombinedTag combined;
+    // --- RANDOM VALUES ---
 
-    template <>
-    struct string_conv::DefaultToStringTraits<ExceptionElem>
+    // A source of random values for `RandomValues()`, with the ability to shrink them.
+    // `source(random_generator)` makes a random value.
+    // `source.NumShrinkCandidates(value)` returns how many simpler versions of the value there are, or zero if the value is already the simplest one.
+    // `source.ShrinkCandidate(value, index)` returns one of them, with `index` less than `NumShrinkCandidates(value)`, simplest first.
+    //   It shouldn't return the value itself, or the shrinking will never end.
+    template <typename T>
+    concept RandomSource = std::copy_constructible<T> && requires(const T &source, std::mt19937_64 &random_generator, const typename T::value_type &value, std::size_t index)
     {
-        CFG_TA_API std::string operator()(const ExceptionElem &value) const;
+        {source(random_generator)} -> std::same_as<typename T::value_type>;
+        {source.NumShrinkCandidates(value)} -> std::same_as<std::size_t>;
+        {source.ShrinkCandidate(value, index)} -> std::same_as<typename T::value_type>;
     };
-    template <>
-    struct string_conv::DefaultToStringTraits<ExceptionElemVar>
+
+    namespace detail
+    {
+        // Returns a random number in `[0, n)`, or any number if `n` is zero.
+        // Not using the standard distributions, because their results differ between standard libraries, and we want the same values everywhere.
+        [[nodiscard]] inline std::uint64_t RandomBelow(std::mt19937_64 &random_generator, std::uint64_t n)
+        {
+            return n == 0 ? random_generator() : random_generator() % n;
+        }
+
+        // Shrinks a sequence container: first tries removing chunks of elements, larger chunks first, then shrinking the individual elements.
+        // Never goes below `min_size` elements. `element` shrinks the elements, it has the same shrinking members as a `RandomSource`.
+        // The candidates are computed by index, so only one copy of the container exists at a time.
+        template <typename C, typename E>
+        class SequenceShrinker
+        {
+            const C &value;
+            std::size_t min_size = 0;
+            const E &element;
+
+            // Calls `func(chunk, num_chunks)` for each chunk size that we try to remove, larger chunks first.
+            // `func` returns true to stop.
+            template <typename F>
+            void ForEachChunkSize(F &&func) const
+            {
+                if (value.size() <= min_size)
+                    return;
+                for (std::size_t chunk = (value.size() - min_size) / 2; chunk > 0; chunk /= 2)
+                {
+                    if (func(chunk, value.size() / chunk))
+                        return;
+                }
+            }
+
+          public:
+            SequenceShrinker(const C &value, std::size_t min_size, const E &element) : value(value), min_size(min_size), element(element) {}
+
+            [[nodiscard]] std::size_t NumCandidates() const
+            {
+                // The first candidate removes everything above `min_size` at once.
+                std::size_t ret = value.size() > min_size;
+                ForEachChunkSize([&](std::size_t chunk, std::size_t num_chunks)
+                {
+                    (void)chunk;
+                    ret += num_chunks;
+                    return false;
+                });
+                for (const auto &elem : value)
+                    ret += element.NumShrinkCandidates(elem);
+                return ret;
+            }
+
+            [[nodiscard]] C Candidate(std::size_t index) const
+            {
+                C ret;
+
+                if (value.size() > min_size)
+                {
+                    if (index == 0)
+                    {
+                        ret.assign(value.begin(), value.begin() + std::ptrdiff_t(min_size));
+                        return ret;
+                    }
+                    index--;
+                }
+
+                bool found = false;
+                ForEachChunkSize([&](std::size_t chunk, std::size_t num_chunks)
+                {
+                    if (index >= num_chunks)
+                    {
+                        index -= num_chunks;
+                        return false;
+                    }
+
+                    ret = value;
+                    ret.erase(ret.begin() + std::ptrdiff_t(index * chunk), ret.begin() + std::ptrdiff_t(index * chunk + chunk));
+                    found = true;
+                    return true;
+                });
+                if (found)
+                    return ret;
+
+                for (std::size_t i = 0; i < value.size(); i++)
+                {
+                    std::size_t num_elem_candidates = element.NumShrinkCandidates(value[i]);
+                    if (index < num_elem_candidates)
+                    {
+                        ret = value;
+                        ret[i] = element.ShrinkCandidate(value[i], index);
+                        return ret;
+                    }
+                    index -= num_elem_candidates;
+                }
+
+                HardError("The shrinking candidate index is out of range.");
+            }
+        };
+
+        // The functor returned by `RandomValues()`.
+        template <RandomSource S>
+        struct RandomValuesFunctor
+        {
+            S source;
+            std::size_t num_values = 0;
+            std::mt19937_64 random_generator;
+            std::size_t num_generated_values = 0;
+
+            typename S::value_type operator()(bool &repeat)
+            {
+                repeat = ++num_generated_values < num_values;
+                return source(random_generator);
+            }
+
+            // See `BasicGenerator::NumValuesIfKnown()`.
+            [[nodiscard]] std::size_t NumValues() const
+            {
+                return num_values;
+            }
+
+            // See `BasicGenerator::CanShrink()`.
+            [[nodiscard]] std::size_t NumShrinkCandidates(const typename S::value_type &value) const
+            {
+                return source.NumShrinkCandidates(value);
+            }
+            [[nodiscard]] typename S::value_type ShrinkCandidate(const typename S::value_type &value, std::size_t index) const
+            {
+                return source.ShrinkCandidate(value, index);
+            }
+        };
+    }
+
+    // Random integers in `[min, max]`. Shrinks towards zero, or towards the bound closest to it.
+    // One in 8 values is either one of the bounds or zero, since those are the usual suspects.
+    template <std::integral T> requires(!std::is_same_v<T, bool>)
+    struct RandomInt
+    {
+        using value_type = T;
+
+        T min = std::numeric_limits<T>::min();
+        T max = std::numeric_limits<T>::max();
+
+        [[nodiscard]] T Target() const
+        {
+            return std::clamp(T{}, min, max);
+        }
+
+        [[nodiscard]] T operator()(std::mt19937_64 &random_generator) const
+        {
+            if (random_generator() % 8 == 0)
+            {
+                switch (random_generator() % 3)
+                {
+                    case 0: return min;
+                    case 1: return max;
+                    default: return Target();
+                }
+            }
+
+            // The unsigned arithmetic wraps around correctly for any integer type up to 64 bits.
+            std::uint64_t span = std::uint64_t(max) - std::uint64_t(min);
+            return T(std::uint64_t(min) + detail::RandomBelow(random_generator, span + 1));
+        }
+
+        // The target, then the values that halve the distance to it, closest to the target first.
+        // This can't overflow, since the value and the target are on the same side of zero.
+        [[nodiscard]] std::size_t NumShrinkCandidates(const T &value) const
+        {
+            T target = Target();
+            if (value == target)
+                return 0;
+
+            std::size_t ret = 1;
+            for (T step = T((value - target) / 2); step != 0; step = T(step / 2))
+                ret++;
+            return ret;
+        }
+        [[nodiscard]] T ShrinkCandidate(const T &value, std::size_t index) const
+        {
+            T target = Target();
+            if (index == 0)
+                return target;
+
+            T step = T(value - target);
+            for (std::size_t i = 0; i < index; i++)
+                step = T(step / 2);
+            return T(value - step);
+        }
+    };
+
+    // Random floating-point numbers in `[min, max]`. Shrinks towards zero (or towards the bound closest to it), and towards whole numbers.
+    // One in 8 values is either one of the bounds or zero.
+    template <std::floating_point T>
+    struct RandomFloat
+    {
+        using value_type = T;
+
+        T min = -1;
+        T max = 1;
+
+        [[nodiscard]] T Target() const
+        {
+            return std::clamp(T{}, min, max);
+        }
+
+        [[nodiscard]] T operator()(std::mt19937_64 &random_generator) const
+        {
+            if (random_generator() % 8 == 0)
+            {
+                switch (random_generator() % 3)
+                {
+                    case 0: return min;
+                    case 1: return max;
+                    default: return Target();
+                }
+            }
+
+            // 53 random bits, which is enough for a uniform `double` in `[0, 1)`.
+            T fraction = T((random_generator() >> 11) * 0x1p-53);
+            return std::clamp(std::lerp(min, max, fraction), min, max);
+        }
+
+        [[nodiscard]] std::size_t NumShrinkCandidates(const T &value) const
+        {
+            std::array<T, 4> candidates{};
+            return ComputeShrinkCandidates(value, candidates);
+        }
+        [[nodiscard]] T ShrinkCandidate(const T &value, std::size_t index) const
+        {
+            std::array<T, 4> candidates{};
+            if (index >= ComputeShrinkCandidates(value, candidates))
+                HardError("The shrinking candidate index is out of range.");
+            return candidates[index];
+        }
+
+      private:
+        // There are only a few candidates, so we compute all of them every time. Returns how many were written to `candidates`.
+        [[nodiscard]] std::size_t ComputeShrinkCandidates(T value, std::array<T, 4> &candidates) const
+        {
+            std::size_t ret = 0;
+            T target = Target();
+            if (value == target)
+                return ret;
+
+            candidates[ret++] = target;
+            if (!std::isfinite(value))
+                return ret;
+
+            T whole = std::trunc(value);
+            if (whole != value && whole != target && whole >= min && whole <= max)
+                candidates[ret++] = whole;
+
+            T middle = target + (value - target) / 2;
+            if (middle != value && middle != target && middle != whole)
+                candidates[ret++] = middle;
+
+            // For whole numbers, also try one step closer to the target.
+            if (whole == value && std::abs(value - target) > 1)
+            {
+                T closer = value - std::copysign(T(1), value - target);
+                if (closer != middle)
+                    candidates[ret++] = closer;
+            }
+
+            return ret;
+        }
+    };
+
+    // Random strings with the size in `[min_size, max_size]`, made of the characters from `alphabet`.
+    // Shrinks by removing characters, and by replacing them with the first character of the alphabet.
+    struct RandomString
+    {
+        using value_type = std::string;
+
+        std::size_t min_size = 0;
+        std::size_t max_size = 16;
+        std::string alphabet = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ";
+
+        [[nodiscard]] std::string operator()(std::mt19937_64 &random_generator) const
+        {
+            if (alphabet.empty())
+                HardError("`RandomString` needs a non-empty alphabet.", HardErrorKind::user);
+
+            std::string ret(min_size + detail::RandomBelow(random_generator, max_size - min_size + 1), '\0');
+            for (char &ch : ret)
+                ch = alphabet[detail::RandomBelow(random_generator, alphabet.size())];
+            return ret;
+        }
+
+        [[nodiscard]] std::size_t NumShrinkCandidates(const std::string &value) const
+        {
+            return detail::SequenceShrinker(value, min_size, CharShrinker{alphabet}).NumCandidates();
+        }
+        [[nodiscard]] std::string ShrinkCandidate(const std::string &value, std::size_t index) const
+        {
+            return detail::SequenceShrinker(value, min_size, CharShrinker{alphabet}).Candidate(index);
+        }
+
+      private:
+        // Shrinks a character to the first character of the alphabet.
+        struct CharShrinker
+        {
+            std::string_view alphabet;
+
+            [[nodiscard]] std::size_t NumShrinkCandidates(char ch) const
+            {
+                return !alphabet.empty() && ch != alphabet.front();
+            }
+            [[nodiscard]] char ShrinkCandidate(char ch, std::size_t index) const
+            {
+                (void)ch;
+                (void)index;
+                return alphabet.front();
+            }
+        };
+    };
+
+    // Random vectors with the size in `[min_size, max_size]`, with the elements from `element`.
+    // Shrinks by removing elements, and by shrinking the individual elements.
+    template <RandomSource S>
+    struct RandomVector
+    {
+        using value_type = std::vector<typename S::value_type>;
+
+        S element{};
+        std::size_t min_size = 0;
+        std::size_t max_size = 16;
+
+        [[nodiscard]] value_type operator()(std::mt19937_64 &random_generator) const
+        {
+            value_type ret;
+            std::size_t size = min_size + detail::RandomBelow(random_generator, max_size - min_size + 1);
+            ret.reserve(size);
+            for (std::size_t i = 0; i < size; i++)
+                ret.push_back(element(random_generator));
+            return ret;
+        }
+
+        [[nodiscard]] std::size_t NumShrinkCandidates(const value_type &value) const
+        {
+            return detail::SequenceShrinker(value, min_size, element).NumCandidates();
+        }
+        [[nodiscard]] value_type ShrinkCandidate(const value_type &value, std::size_t index) const
+        {
+            return detail::SequenceShrinker(value, min_size, element).Candidate(index);
+        }
+    };
+    template <typename S>
+    RandomVector(S, std::size_t = 0, std::size_t = 16) -> RandomVector<S>;
+
+    // Random tuples, with each element from the respective source. Shrinks one element at a time.
+    template <RandomSource ...S>
+    struct RandomTuple
+    {
+        using value_type = std::tuple<typename S::value_type...>;
+
+        std::tuple<S...> sources;
+
+        RandomTuple(S ...sources) : sources(std::move(sources)...) {}
+
+        [[nodiscard]] value_type operator()(std::mt19937_64 &random_generator) const
+        {
+            return [&]<std::size_t ...I>(std::index_sequence<I...>)
+            {
+                // Braced initialization guarantees the left-to-right order.
+                return value_type{std::get<I>(sources)(random_generator)...};
+            }(std::index_sequence_for<S...>{});
+        }
+
+        [[nodiscard]] std::size_t NumShrinkCandidates(const value_type &value) const
+        {
+            return [&]<std::size_t ...I>(std::index_sequence<I...>)
+            {
+                return (std::size_t(0) + ... + std::get<I>(sources).NumShrinkCandidates(std::get<I>(value)));
+            }(std::index_sequence_for<S...>{});
+        }
+        [[nodiscard]] value_type ShrinkCandidate(const value_type &value, std::size_t index) const
+        {
+            value_type ret = value;
+            bool found = [&]<std::size_t ...I>(std::index_sequence<I...>)
+            {
+                // Stops at the element that contains the candidate.
+                return ([&]{
+                    std::size_t num_candidates = std::get<I>(sources).NumShrinkCandidates(std::get<I>(value));
+                    if (index < num_candidates)
+                    {
+                        std::get<I>(ret) = std::get<I>(sources).ShrinkCandidate(std::get<I>(value), index);
+                        return true;
+                    }
+                    index -= num_candidates;
+                    return false;
+                }() || ...);
+            }(std::index_sequence_for<S...>{});
+            if (!found)
+                HardError("The shrinking candidate index is out of range.");
+            return ret;
+        }
+    };
+
+    // Makes a functor for `TA_GENERATE_FUNC(...)`, which generates `num_values` random values from the `source` (see `RandomSource`).
+    // The values only depend on the `seed`, so they're the same in every run.
+    // When the test fails, `modules::GeneratorShrinker` automatically looks for the simplest failing value.
+    // Example:
+    //     auto v = TA_GENERATE_FUNC(v, ta_test::RandomValues(100, ta_test::RandomVector{ta_test::RandomInt<int>{-10, 10}}));
+    template <RandomSource S>
+    [[nodiscard]] auto RandomValues(GeneratorFlags flags, std::size_t num_values, S source, std::uint64_t seed = 0)
+    {
+        if (num_values == 0)
+            flags |= GeneratorFlags::generate_nothing;
+
+        return GenerateFuncParam(flags, detail::RandomValuesFunctor<S>{.source = std::move(source), .num_values = num_values, .random_generator = std::mt19937_64(seed)});
+    }
+    template <RandomSource S>
+    [[nodiscard]] auto RandomValues(std::size_t num_values, S source, std::uint64_t seed = 0)
+    {
+        return (RandomValues)(GeneratorFlags{}, num_values, std::move(source), seed);
+    }
+
+
+    // --- ALLOCATIONS ---
+
+    namespace detail
+    {
+        // Returns the number of heap allocations made on this thread while running `func`. `TA_MUST_NOT_ALLOCATE(...)` uses this.
+        // Raises a hard error if the library isn't built with `CFG_TA_TRACK_ALLOCATIONS=1`.
+        template <typename F>
+        [[nodiscard]] std::size_t CountAllocations(F &&func)
+        {
+            if (!AllocationTrackingEnabled())
+                HardError("`TA_MUST_NOT_ALLOCATE(...)` needs the library to be built with `CFG_TA_TRACK_ALLOCATIONS=1`.", HardErrorKind::user);
+
+            AllocationThreadState &state = ThreadAllocationState();
+            std::size_t old_count = state.num_allocations;
+            std::forward<F>(func)();
+            return state.num_allocations - old_count;
+        }
+    }
+
+
+    // --- RANGE COMPARISON ---
+
+    namespace detail
+    {
+        // Returns the offset of the first byte that differs between `a` and `b`, or `size` if they are equal.
+        // Uses SSE2 or AVX2 if the library was compiled with them enabled.
+        [[nodiscard]] CFG_TA_API std::size_t FindFirstMismatchingByte(const void *a, const void *b, std::size_t size) noexcept;
+
+        // Whether `TA_CHECK_RANGES_EQUAL(...)` can compare the ranges bytewise, using `FindFirstMismatchingByte()`.
+        // Floating-point numbers are excluded, because of `-0.0 == 0.0` and NaNs.
+        template <typename A, typename B>
+        concept BytewiseComparableRanges =
+            std::ranges::contiguous_range<A> && std::ranges::sized_range<A> &&
+            std::ranges::contiguous_range<B> && std::ranges::sized_range<B> &&
+            std::is_same_v<std::ranges::range_value_t<A>, std::ranges::range_value_t<B>> &&
+            (std::is_integral_v<std::ranges::range_value_t<A>> || std::is_enum_v<std::ranges::range_value_t<A>>) &&
+            std::has_unique_object_representations_v<std::ranges::range_value_t<A>>;
+
+        // How many elements `TA_CHECK_RANGES_EQUAL(...)` prints on each side of the first mismatch.
+        inline constexpr std::size_t range_mismatch_context = 3;
+
+        // One element pair near the mismatch, as printed by `TA_CHECK_RANGES_EQUAL(...)`.
+        struct RangeMismatchRow
+        {
+            std::size_t index = 0;
+            // Null if the range ended before this index.
+            std::optional<std::string> a;
+            std::optional<std::string> b;
+            // Whether the elements compare equal. False if one of them is missing.
+            bool equal = false;
+        };
+
+        // Produces the failure description for `TA_CHECK_RANGES_EQUAL(...)`.
+        [[nodiscard]] CFG_TA_API std::string DescribeRangeMismatch(std::size_t mismatch_index, std::size_t size_a, std::size_t size_b, std::span<const RangeMismatchRow> rows);
+
+        // Stringifies an element for `TA_CHECK_RANGES_EQUAL(...)`.
+        template <typename T>
+        [[nodiscard]] std::string RangeElementToString(const T &elem)
+        {
+            if constexpr (string_conv::SupportsToString<T>)
+                return string_conv::ToString(elem);
+            else
+                return "?";
+        }
+
+        // The implementation of `TA_CHECK_RANGES_EQUAL(...)`. Returns true if the ranges are equal, otherwise describes the mismatch in `assertion`.
+        template <std::ranges::forward_range A, std::ranges::forward_range B>
+        [[nodiscard]] bool CheckRangesEqual(AssertWrapper &assertion, const A &a, const B &b)
+        {
+            std::size_t mismatch = 0;
+
+            if constexpr (BytewiseComparableRanges<const A &, const B &>)
+            {
+                std::size_t size_a = std::ranges::size(a);
+                std::size_t size_b = std::ranges::size(b);
+                std::size_t common_bytes = std::min(size_a, size_b) * sizeof(std::ranges::range_value_t<A>);
+                std::size_t byte = FindFirstMismatchingByte(std::ranges::data(a), std::ranges::data(b), common_bytes);
+                if (byte == common_bytes && size_a == size_b)
+                    return true;
+                mismatch = byte / sizeof(std::ranges::range_value_t<A>);
+            }
+            else
+            {
+                auto it_a = std::ranges::begin(a);
+                auto it_b = std::ranges::begin(b);
+                while (true)
+                {
+                    bool end_a = it_a == std::ranges::end(a);
+                    bool end_b = it_b == std::ranges::end(b);
+                    if (end_a && end_b)
+                        return true;
+                    if (end_a || end_b || !(*it_a == *it_b))
+                        break;
+                    ++it_a;
+                    ++it_b;
+                    mismatch++;
+                }
+            }
+
+            // Collect the elements around the mismatch. This only runs on failure, so it's fine to iterate again.
+            std::size_t first = mismatch > range_mismatch_context ? mismatch - range_mismatch_context : 0;
+            std::vector<RangeMismatchRow> rows;
+            auto it_a = std::ranges::next(std::ranges::begin(a), std::ptrdiff_t(first), std::ranges::end(a));
+            auto it_b = std::ranges::next(std::ranges::begin(b), std::ptrdiff_t(first), std::ranges::end(b));
+            for (std::size_t i = first; i <= mismatch + range_mismatch_context; i++)
+            {
+                bool end_a = it_a == std::ranges::end(a);
+                bool end_b = it_b == std::ranges::end(b);
+                if (end_a && end_b)
+                    break;
+
+                RangeMismatchRow &row = rows.emplace_back();
+                row.index = i;
+                if (!end_a)
+                    row.a = (RangeElementToString)(*it_a);
+                if (!end_b)
+                    row.b = (RangeElementToString)(*it_b);
+                row.equal = !end_a && !end_b && bool(*it_a == *it_b);
+
+                if (!end_a)
+                    ++it_a;
+                if (!end_b)
+                    ++it_b;
+            }
+
+            assertion.SetDetails(DescribeRangeMismatch(mismatch, std::size_t(std::ranges::distance(a)), std::size_t(std::ranges::distance(b)), rows));
+            return false;
+        }
+    }
+
+    // The tolerance for `TA_CHECK_RANGES_APPROX(...)`.
+    // Two elements are equal if they compare equal with `==`, or are both NaN, or are both finite and the error is at most `value`.
+    struct FloatTolerance
+    {
+        enum class Kind
+        {
+            // `|a - b| <= value`.
+            absolute,
+            // `|a - b| <= value * max(|a|, |b|)`.
+            relative,
+            // The number of representable values between `a` and `b` is at most `value`.
+            ulp,
+        };
+        Kind kind = Kind::absolute;
+        double value = 0;
+
+        [[nodiscard]] static constexpr FloatTolerance Absolute(double value) {return {.kind = Kind::absolute, .value = value};}
+        [[nodiscard]] static constexpr FloatTolerance Relative(double value) {return {.kind = Kind::relative, .value = value};}
+        [[nodiscard]] static constexpr FloatTolerance Ulp(std::uint64_t value) {return {.kind = Kind::ulp, .value = double(value)};}
+    };
+
+    namespace detail
+    {
+        // Returns the index of the first pair of elements that aren't equal according to `tolerance`, or `size` if there is none.
+        // Uses SSE2 or AVX2 for the absolute and relative tolerances, if the library was compiled with them enabled.
+        [[nodiscard]] CFG_TA_API std::size_t FindFirstApproxMismatch(const float *a, const float *b, std::size_t size, FloatTolerance tolerance) noexcept;
+        [[nodiscard]] CFG_TA_API std::size_t FindFirstApproxMismatch(const double *a, const double *b, std::size_t size, FloatTolerance tolerance) noexcept;
+
+        // Produces the failure description for `TA_CHECK_RANGES_APPROX(...)`. `first_mismatch` is what `FindFirstApproxMismatch()` returned.
+        [[nodiscard]] CFG_TA_API std::string DescribeApproxMismatch(std::span<const float> a, std::span<const float> b, std::size_t first_mismatch, FloatTolerance tolerance);
+        [[nodiscard]] CFG_TA_API std::string DescribeApproxMismatch(std::span<const double> a, std::span<const double> b, std::size_t first_mismatch, FloatTolerance tolerance);
+
+        // The implementation of `TA_CHECK_RANGES_APPROX(...)`. Returns true if the ranges are approximately equal, otherwise describes the mismatch in `assertion`.
+        template <std::ranges::contiguous_range A, std::ranges::contiguous_range B>
+        requires std::ranges::sized_range<A> && std::ranges::sized_range<B> &&
+            std::is_same_v<std::ranges::range_value_t<A>, std::ranges::range_value_t<B>> &&
+            (std::is_same_v<std::ranges::range_value_t<A>, float> || std::is_same_v<std::ranges::range_value_t<A>, double>)
+        [[nodiscard]] bool CheckRangesApprox(AssertWrapper &assertion, const A &a, const B &b, FloatTolerance tolerance)
+        {
+            using T = std::ranges::range_value_t<A>;
+            std::span<const T> span_a(std::ranges::data(a), std::ranges::size(a));
+            std::span<const T> span_b(std::ranges::data(b), std::ranges::size(b));
+
+            std::size_t mismatch = FindFirstApproxMismatch(span_a.data(), span_b.data(), std::min(span_a.size(), span_b.size()), tolerance);
+            if (mismatch == std::min(span_a.size(), span_b.size()) && span_a.size() == span_b.size())
+                return true;
+
+            assertion.SetDetails(DescribeApproxMismatch(span_a, span_b, mismatch, tolerance));
+            return false;
+        }
+    }
+
+
+    // --- BENCHMARKS ---
+
+    namespace detail
+    {
+        // Stores `ptr` into a volatile variable. This is a fallback for `DoNotOptimize()` on compilers without GCC-style inline assembly.
+        CFG_TA_API void DoNotOptimizeHelper(const volatile void *ptr);
+    }
+
+    // Prevents the compiler from optimizing away the computation of `value`. Use this in `TA_BENCHMARK(...)`.
+    template <typename T>
+    void DoNotOptimize(T &&value)
+    {
+        #if defined(__GNUC__) || defined(__clang__)
+        // The address must be materialized, and the `memory` clobber forces the object to be written there.
+        __asm__ __volatile__("" : : "r"(std::addressof(value)) : "memory");
+        #else
+        detail::DoNotOptimizeHelper(std::addressof(value));
+        #endif
+    }
+
+    // Prevents the compiler from optimizing away the preceding writes to memory. Use this in `TA_BENCHMARK(...)`.
+    inline void ClobberMemory()
+    {
+        #if defined(__GNUC__) || defined(__clang__)
+        __asm__ __volatile__("" : : : "memory");
+        #else
+        std::atomic_signal_fence(std::memory_order_acq_rel);
+        #endif
+    }
+
+    // Runs the body of a `TA_BENCHMARK(...)` many times and measures it. Use it as `for (auto _ : ta_test::BenchmarkLoop{}) {...}`.
+    // Only one loop should run at a time, but a benchmark can have several loops in a row, then each one is reported separately.
+    class BenchmarkLoop
+    {
+        // How many iterations remain in the current batch, not counting the current one.
+        std::size_t remaining = 0;
+        // How many iterations are in the current batch. Zero before the first batch.
+        std::size_t batch_size = 0;
+        // Whether we're still warming up, as opposed to measuring the samples.
+        bool warming_up = true;
+
+        std::chrono::steady_clock::time_point batch_start;
+        std::chrono::nanoseconds warmup_elapsed{};
+
+        data::BenchmarkResults results;
+
+        // Only if `results.settings.hardware_counters` is set.
+        std::optional<platform::HardwareCounters> hardware_counters;
+
+        // Finishes the current batch (if any) and starts the next one. Returns false if there are no more batches.
+        [[nodiscard]] CFG_TA_API bool NextBatch();
+
+      public:
+        // Raises a hard error if no test is running on this thread.
+        CFG_TA_API BenchmarkLoop();
+
+        BenchmarkLoop(const BenchmarkLoop &) = delete;
+        BenchmarkLoop &operator=(const BenchmarkLoop &) = delete;
+
+        struct Sentinel {};
+
+        class Iterator
+        {
+            BenchmarkLoop *loop = nullptr;
+
+          public:
+            // `[[maybe_unused]]` silences the "set but not used" warnings for the loop variable.
+            struct [[maybe_unused]] Value {};
+
+            explicit Iterator(BenchmarkLoop &loop) : loop(&loop) {}
+
+            Value operator*() const {return {};}
+            Iterator &operator++() {return *this;}
+
+            // The iteration counter is advanced here, to keep `operator++` trivial.
+            bool operator!=(Sentinel) const
+            {
+                if (loop->remaining > 0) [[likely]]
+                {
+                    loop->remaining--;
+                    return true;
+                }
+                return loop->NextBatch();
+            }
+        };
+
+        [[nodiscard]] Iterator begin() {return Iterator(*this);}
+        [[nodiscard]] Sentinel end() {return {};}
+    };
+
+
+    // --- ANALYZING EXCEPTIONS ---
+
+    struct ExceptionElemsCombinedTag {explicit ExceptionElemsCombinedTag() = default;};
+    // The functions checking exception message accept this in addition to `ExceptionElem` to check the whole message.
+    inline constexpr ExceptionElemsCombinedTag combined;
+
+    template <>
+    struct string_conv::DefaultToStringTraits<ExceptionElem>
+    {
+        CFG_TA_API std::string operator()(const ExceptionElem &value) const;
+    };
+    template <>
+    struct string_conv::DefaultToStringTraits<ExceptionElemVar>
     {
         CFG_TA_API std::string operator()(const ExceptionElemVar &value) const;
     };
@@ -4701,6 +6720,8 @@ namespace ta_test
         template <std::derived_from<BasicModule> T, typename ...P>
         requires std::constructible_from<detail::ModuleWrapper<T>, P &&...>
         friend ModulePtr MakeModule(P &&... params);
+        template <typename T>
+        friend struct detail::ModuleWrapper;
 
       public:
         CFG_TA_API ModulePtr();
@@ -5,32 +5,65 @@
 #include <taut/taut.hpp>
 #include <taut/internals.hpp>
 
+#include <bit>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
 #include <iterator>
+#include <limits>
+#include <mutex>
+#include <thread>
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #define NOMINMAX 1
+#include <windows.h> // For `GetThreadTimes()`, and optionally `IsDebuggerPresent()` and the console functions.
 #endif
 
 #if CFG_TA_CXXABI_DEMANGLE
 #include <cxxabi.h>
 #endif
 
-#if CFG_TA_DETECT_DEBUGGER
-#if defined(_WIN32)
-#include <windows.h> // For `IsDebuggerPresent()`.
-#elif defined(__linux__)
+#if CFG_TA_DETECT_DEBUGGER && defined(__linux__)
 #include <fstream> // To read `/proc/self/status` to detect the debugger.
 #endif
+
+#if CFG_TA_HARDWARE_COUNTERS && defined(__linux__) && __has_include(<linux/perf_event.h>)
+#define DETAIL_TA_USE_PERF_EVENTS 1
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #endif
 
-#if CFG_TA_DETECT_TERMINAL
-#if defined(_WIN32)
-#include <windows.h>
-#elif defined(__linux__) || defined(__APPLE__)
-#define DETAIL_TA_USE_ISATTY 1
+#if CFG_TA_ALLOW_FORK && (defined(__linux__) || defined(__APPLE__))
+#define DETAIL_TA_USE_FORK 1
+#include <cerrno>
+#include <cstring> // For `strsignal()`.
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #endif
+
+#if defined(__AVX2__)
+#define DETAIL_TA_USE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DETAIL_TA_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <time.h> // For `clock_gettime()`.
+#endif
+
+#if CFG_TA_DETECT_TERMINAL && (defined(__linux__) || defined(__APPLE__))
+#define DETAIL_TA_USE_ISATTY 1
+#include <unistd.h>
 #endif
 
 void ta_test::HardError(std::string_view message, HardErrorKind kind)
@@ -740,20 +773,14 @@ ta_test::context::Context ta_test::context::CurrentContext()
     return thread_state.context_stack;
 }
 
-ta_test::context::FrameGuard::FrameGuard(std::shared_ptr<const BasicFrame> frame) noexcept
+ta_test::context::FrameGuard::FrameGuard(const BasicFrame *frame) noexcept
 {
     if (!frame)
         return;
 
-    auto &thread_state = detail::ThreadState();
-    if (thread_state.context_stack_set.insert(frame.get()).second)
-    {
-        frame_ptr = frame.get();
-        thread_state.context_stack.push_back(std::move(frame));
-    }
-
-    if (thread_state.context_stack_set.size() > thread_state.context_stack.size())
-        HardError("The context stack is corrupted: The set is larger than the stack.");
+    // The vector keeps its capacity, so this stops allocating once the stack reaches its usual depth.
+    detail::ThreadState().context_stack.push_back(frame);
+    frame_ptr = frame;
 }
 
 void ta_test::context::FrameGuard::Reset()
@@ -763,17 +790,12 @@ void ta_test::context::FrameGuard::Reset()
 
     auto &thread_state = detail::ThreadState();
 
-    if (thread_state.context_stack.empty() || thread_state.context_stack.back().get() != frame_ptr)
+    if (thread_state.context_stack.empty() || thread_state.context_stack.back() != frame_ptr)
         HardError("The context stack is corrupted: The element we're removing is not at the end of the stack.");
     thread_state.context_stack.pop_back();
 
-    if (thread_state.context_stack_set.erase(frame_ptr) != 1)
-        HardError("The context stack is corrupted: The element we're removing is in the stack, but not in the set.");
-
-    if (thread_state.context_stack_set.size() > thread_state.context_stack.size())
-        HardError("The context stack is corrupted: The set is larger than the stack.");
-
     frame_ptr = nullptr;
+    frame_owner = nullptr;
 }
 
 ta_test::context::FrameGuard::~FrameGuard()
@@ -781,6 +803,59 @@ ta_test::context::FrameGuard::~FrameGuard()
     Reset();
 }
 
+void *ta_test::context::UnscopedLog::AllocatePayloadForNextEntry(std::size_t size, std::size_t alignment)
+{
+    // This entry will never be discarded.
+    if (!capacity.limited || head.size() < capacity.keep_first)
+        return nullptr;
+
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        HardError("The deferred log argument is overaligned.");
+
+    // Either the next free slot in the circular buffer, or the oldest one, which is about to be replaced.
+    Payload *payload = &discarded_payload;
+    if (capacity.keep_last > 0)
+    {
+        std::size_t index = tail.size() < capacity.keep_last ? tail.size() : tail_start;
+        if (tail_payloads.size() <= index)
+            tail_payloads.resize(index + 1);
+        payload = &tail_payloads[index];
+    }
+
+    if (payload->size < size)
+    {
+        payload->bytes = std::make_unique_for_overwrite<std::byte[]>(size);
+        payload->size = size;
+    }
+    return payload->bytes.get();
+}
+
+void ta_test::context::UnscopedLog::Add(LogEntry entry)
+{
+    if (!capacity.limited || head.size() < capacity.keep_first)
+    {
+        head.push_back(std::move(entry));
+        return;
+    }
+
+    if (capacity.keep_last == 0)
+    {
+        Discard(entry.incremental_id);
+        return;
+    }
+
+    if (tail.size() < capacity.keep_last)
+    {
+        tail.push_back(std::move(entry));
+        return;
+    }
+
+    // Replace the oldest entry.
+    Discard(tail[tail_start].incremental_id);
+    tail[tail_start] = std::move(entry);
+    tail_start = (tail_start + 1) % tail.size();
+}
+
 std::span<const ta_test::context::LogEntry *const> ta_test::context::CurrentScopedLog()
 {
     auto &thread_state = detail::ThreadState();
@@ -789,6 +864,514 @@ std::span<const ta_test::context::LogEntry *const> ta_test::context::CurrentScop
     return thread_state.scoped_log;
 }
 
+std::size_t ta_test::detail::FindFirstMismatchingByte(const void *a, const void *b, std::size_t size) noexcept
+{
+    const unsigned char *bytes_a = static_cast<const unsigned char *>(a);
+    const unsigned char *bytes_b = static_cast<const unsigned char *>(b);
+    std::size_t i = 0;
+
+    #if DETAIL_TA_USE_AVX2
+    for (; i + 32 <= size; i += 32)
+    {
+        __m256i block_a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes_a + i));
+        __m256i block_b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes_b + i));
+        std::uint32_t mask = ~std::uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block_a, block_b)));
+        if (mask)
+            return i + std::size_t(std::countr_zero(mask));
+    }
+    #endif
+
+    #if DETAIL_TA_USE_SSE2
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i block_a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes_a + i));
+        __m128i block_b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes_b + i));
+        std::uint32_t mask = ~std::uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(block_a, block_b))) & 0xffff;
+        if (mask)
+            return i + std::size_t(std::countr_zero(mask));
+    }
+    #endif
+
+    // The scalar fallback, a word at a time. Then the mismatching word (if any) and the remainder are checked bytewise.
+    for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t))
+    {
+        std::uint64_t word_a = 0, word_b = 0;
+        std::memcpy(&word_a, bytes_a + i, sizeof word_a);
+        std::memcpy(&word_b, bytes_b + i, sizeof word_b);
+        if (word_a != word_b)
+            break;
+    }
+    for (; i < size; i++)
+    {
+        if (bytes_a[i] != bytes_b[i])
+            return i;
+    }
+
+    return size;
+}
+
+std::string ta_test::detail::DescribeRangeMismatch(std::size_t mismatch_index, std::size_t size_a, std::size_t size_b, std::span<const RangeMismatchRow> rows)
+{
+    std::string ret;
+    if (mismatch_index == std::min(size_a, size_b))
+        ret = CFG_TA_FMT_NAMESPACE::format("Length mismatch: {} vs {} elements, the first {} are equal.", size_a, size_b, mismatch_index);
+    else if (size_a != size_b)
+        ret = CFG_TA_FMT_NAMESPACE::format("First mismatch at index {}, and also a length mismatch: {} vs {} elements.", mismatch_index, size_a, size_b);
+    else
+        ret = CFG_TA_FMT_NAMESPACE::format("First mismatch at index {} of {}.", mismatch_index, size_a);
+
+    auto Width = [](std::string_view str)
+    {
+        std::u32string decoded;
+        text::encoding::ReencodeRelaxed(str, decoded);
+        return decoded.size();
+    };
+
+    // Align the columns.
+    std::size_t index_width = 0;
+    std::size_t value_width = 0;
+    for (const RangeMismatchRow &row : rows)
+    {
+        index_width = std::max(index_width, CFG_TA_FMT_NAMESPACE::formatted_size("[{}]", row.index));
+        value_width = std::max(value_width, Width(row.a ? *row.a : "<end>"));
+    }
+
+    for (const RangeMismatchRow &row : rows)
+    {
+        std::string index = CFG_TA_FMT_NAMESPACE::format("[{}]", row.index);
+        std::string_view value_a = row.a ? *row.a : "<end>";
+
+        ret += '\n';
+        ret += row.index == mismatch_index ? "  > " : "    ";
+        ret += index;
+        ret.append(index_width - index.size() + 1, ' ');
+        ret += value_a;
+        ret.append(value_width - Width(value_a) + 1, ' ');
+        ret += row.equal ? "==" : "!=";
+        ret += ' ';
+        ret += row.b ? *row.b : "<end>";
+    }
+
+    return ret;
+}
+
+namespace
+{
+    // The number of representable values between `a` and `b`, for the ULP tolerance. Both must be non-NaN.
+    template <typename T>
+    [[nodiscard]] std::uint64_t UlpDistance(T a, T b)
+    {
+        using U = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+        constexpr U sign_bit = U(1) << (sizeof(U) * 8 - 1);
+
+        // Map the sign-magnitude representation to unsigned integers that are ordered the same way as the values.
+        auto Ordered = [](T x)
+        {
+            U bits = std::bit_cast<U>(x);
+            return bits & sign_bit ? ~bits : bits | sign_bit;
+        };
+        U x = Ordered(a);
+        U y = Ordered(b);
+        return x > y ? x - y : y - x;
+    }
+
+    // Whether two elements are equal for `TA_CHECK_RANGES_APPROX(...)`. The SIMD code below must agree with this.
+    template <typename T>
+    [[nodiscard]] bool ApproxEqual(T a, T b, ta_test::FloatTolerance tolerance)
+    {
+        if (a == b)
+            return true;
+
+        bool nan_a = std::isnan(a);
+        bool nan_b = std::isnan(b);
+        if (nan_a || nan_b)
+            return nan_a && nan_b;
+        if (std::isinf(a) || std::isinf(b))
+            return false;
+
+        switch (tolerance.kind)
+        {
+          case ta_test::FloatTolerance::Kind::absolute:
+            return std::abs(a - b) <= T(tolerance.value);
+          case ta_test::FloatTolerance::Kind::relative:
+            return std::abs(a - b) <= T(tolerance.value) * std::max(std::abs(a), std::abs(b));
+          case ta_test::FloatTolerance::Kind::ulp:
+            // Avoid overflowing the conversion.
+            return tolerance.value >= 0x1p64 || UlpDistance(a, b) <= std::uint64_t(tolerance.value);
+        }
+        return false;
+    }
+
+    // The error between two elements, in the units of the tolerance. Infinite if one of them is NaN or infinite and they aren't equal.
+    template <typename T>
+    [[nodiscard]] double ApproxError(T a, T b, ta_test::FloatTolerance::Kind kind)
+    {
+        if (a == b)
+            return 0;
+
+        bool nan_a = std::isnan(a);
+        bool nan_b = std::isnan(b);
+        if (nan_a && nan_b)
+            return 0;
+        if (nan_a || nan_b || std::isinf(a) || std::isinf(b))
+            return std::numeric_limits<double>::infinity();
+
+        switch (kind)
+        {
+          case ta_test::FloatTolerance::Kind::absolute:
+            return double(std::abs(a - b));
+          case ta_test::FloatTolerance::Kind::relative:
+            return double(std::abs(a - b)) / double(std::max(std::abs(a), std::abs(b)));
+          case ta_test::FloatTolerance::Kind::ulp:
+            return double(UlpDistance(a, b));
+        }
+        return 0;
+    }
+
+    // The SIMD primitives for `SkipApproxEqualBlocks()`.
+    #if DETAIL_TA_USE_SSE2
+    struct SimdSse2Float
+    {
+        using Value = float;
+        using Vec = __m128;
+        static constexpr std::size_t width = 4;
+        static Vec Load(const float *ptr) {return _mm_loadu_ps(ptr);}
+        static Vec Set(float value) {return _mm_set1_ps(value);}
+        static Vec Abs(Vec x) {return _mm_andnot_ps(_mm_set1_ps(-0.f), x);}
+        static Vec Sub(Vec a, Vec b) {return _mm_sub_ps(a, b);}
+        static Vec Mul(Vec a, Vec b) {return _mm_mul_ps(a, b);}
+        static Vec Max(Vec a, Vec b) {return _mm_max_ps(a, b);}
+        static Vec And(Vec a, Vec b) {return _mm_and_ps(a, b);}
+        static Vec Or(Vec a, Vec b) {return _mm_or_ps(a, b);}
+        static Vec Equal(Vec a, Vec b) {return _mm_cmpeq_ps(a, b);}
+        static Vec LessEqual(Vec a, Vec b) {return _mm_cmple_ps(a, b);}
+        static Vec IsNan(Vec x) {return _mm_cmpunord_ps(x, x);}
+        static bool All(Vec mask) {return _mm_movemask_ps(mask) == 0xf;}
+    };
+    struct SimdSse2Double
+    {
+        using Value = double;
+        using Vec = __m128d;
+        static constexpr std::size_t width = 2;
+        static Vec Load(const double *ptr) {return _mm_loadu_pd(ptr);}
+        static Vec Set(double value) {return _mm_set1_pd(value);}
+        static Vec Abs(Vec x) {return _mm_andnot_pd(_mm_set1_pd(-0.), x);}
+        static Vec Sub(Vec a, Vec b) {return _mm_sub_pd(a, b);}
+        static Vec Mul(Vec a, Vec b) {return _mm_mul_pd(a, b);}
+        static Vec Max(Vec a, Vec b) {return _mm_max_pd(a, b);}
+        static Vec And(Vec a, Vec b) {return _mm_and_pd(a, b);}
+        static Vec Or(Vec a, Vec b) {return _mm_or_pd(a, b);}
+        static Vec Equal(Vec a, Vec b) {return _mm_cmpeq_pd(a, b);}
+        static Vec LessEqual(Vec a, Vec b) {return _mm_cmple_pd(a, b);}
+        static Vec IsNan(Vec x) {return _mm_cmpunord_pd(x, x);}
+        static bool All(Vec mask) {return _mm_movemask_pd(mask) == 0x3;}
+    };
+    #endif
+    #if DETAIL_TA_USE_AVX2
+    struct SimdAvxFloat
+    {
+        using Value = float;
+        using Vec = __m256;
+        static constexpr std::size_t width = 8;
+        static Vec Load(const float *ptr) {return _mm256_loadu_ps(ptr);}
+        static Vec Set(float value) {return _mm256_set1_ps(value);}
+        static Vec Abs(Vec x) {return _mm256_andnot_ps(_mm256_set1_ps(-0.f), x);}
+        static Vec Sub(Vec a, Vec b) {return _mm256_sub_ps(a, b);}
+        static Vec Mul(Vec a, Vec b) {return _mm256_mul_ps(a, b);}
+        static Vec Max(Vec a, Vec b) {return _mm256_max_ps(a, b);}
+        static Vec And(Vec a, Vec b) {return _mm256_and_ps(a, b);}
+        static Vec Or(Vec a, Vec b) {return _mm256_or_ps(a, b);}
+        static Vec Equal(Vec a, Vec b) {return _mm256_cmp_ps(a, b, _CMP_EQ_OQ);}
+        static Vec LessEqual(Vec a, Vec b) {return _mm256_cmp_ps(a, b, _CMP_LE_OQ);}
+        static Vec IsNan(Vec x) {return _mm256_cmp_ps(x, x, _CMP_UNORD_Q);}
+        static bool All(Vec mask) {return _mm256_movemask_ps(mask) == 0xff;}
+    };
+    struct SimdAvxDouble
+    {
+        using Value = double;
+        using Vec = __m256d;
+        static constexpr std::size_t width = 4;
+        static Vec Load(const double *ptr) {return _mm256_loadu_pd(ptr);}
+        static Vec Set(double value) {return _mm256_set1_pd(value);}
+        static Vec Abs(Vec x) {return _mm256_andnot_pd(_mm256_set1_pd(-0.), x);}
+        static Vec Sub(Vec a, Vec b) {return _mm256_sub_pd(a, b);}
+        static Vec Mul(Vec a, Vec b) {return _mm256_mul_pd(a, b);}
+        static Vec Max(Vec a, Vec b) {return _mm256_max_pd(a, b);}
+        static Vec And(Vec a, Vec b) {return _mm256_and_pd(a, b);}
+        static Vec Or(Vec a, Vec b) {return _mm256_or_pd(a, b);}
+        static Vec Equal(Vec a, Vec b) {return _mm256_cmp_pd(a, b, _CMP_EQ_OQ);}
+        static Vec LessEqual(Vec a, Vec b) {return _mm256_cmp_pd(a, b, _CMP_LE_OQ);}
+        static Vec IsNan(Vec x) {return _mm256_cmp_pd(x, x, _CMP_UNORD_Q);}
+        static bool All(Vec mask) {return _mm256_movemask_pd(mask) == 0xf;}
+    };
+    #endif
+
+    // Advances `i` over the blocks of elements that are all equal according to an absolute or relative tolerance.
+    // Stops at the first block containing a mismatch, or when less than a full block remains. The caller checks the rest with `ApproxEqual()`.
+    template <typename S>
+    void SkipApproxEqualBlocks(const typename S::Value *a, const typename S::Value *b, std::size_t size, ta_test::FloatTolerance tolerance, std::size_t &i)
+    {
+        using T = typename S::Value;
+
+        const bool relative = tolerance.kind == ta_test::FloatTolerance::Kind::relative;
+        const typename S::Vec vec_tolerance = S::Set(T(tolerance.value));
+        const typename S::Vec vec_max_finite = S::Set(std::numeric_limits<T>::max());
+
+        for (; i + S::width <= size; i += S::width)
+        {
+            typename S::Vec va = S::Load(a + i);
+            typename S::Vec vb = S::Load(b + i);
+            typename S::Vec abs_a = S::Abs(va);
+            typename S::Vec abs_b = S::Abs(vb);
+
+            typename S::Vec bound = relative ? S::Mul(vec_tolerance, S::Max(abs_a, abs_b)) : vec_tolerance;
+            typename S::Vec both_finite = S::And(S::LessEqual(abs_a, vec_max_finite), S::LessEqual(abs_b, vec_max_finite));
+
+            typename S::Vec ok = S::Or(
+                S::Or(S::Equal(va, vb), S::And(S::IsNan(va), S::IsNan(vb))),
+                S::And(both_finite, S::LessEqual(S::Abs(S::Sub(va, vb)), bound))
+            );
+            if (!S::All(ok))
+                return;
+        }
+    }
+
+    template <typename T>
+    [[nodiscard]] std::size_t FindFirstApproxMismatchLow(const T *a, const T *b, std::size_t size, ta_test::FloatTolerance tolerance)
+    {
+        std::size_t i = 0;
+
+        if (tolerance.kind != ta_test::FloatTolerance::Kind::ulp)
+        {
+            #if DETAIL_TA_USE_AVX2
+            SkipApproxEqualBlocks<std::conditional_t<std::is_same_v<T, float>, SimdAvxFloat, SimdAvxDouble>>(a, b, size, tolerance, i);
+            #endif
+            #if DETAIL_TA_USE_SSE2
+            SkipApproxEqualBlocks<std::conditional_t<std::is_same_v<T, float>, SimdSse2Float, SimdSse2Double>>(a, b, size, tolerance, i);
+            #endif
+        }
+
+        for (; i < size; i++)
+        {
+            if (!ApproxEqual(a[i], b[i], tolerance))
+                return i;
+        }
+        return size;
+    }
+
+    template <typename T>
+    [[nodiscard]] std::string DescribeApproxMismatchLow(std::span<const T> a, std::span<const T> b, std::size_t first_mismatch, ta_test::FloatTolerance tolerance)
+    {
+        std::size_t size = std::min(a.size(), b.size());
+
+        std::string ret;
+        if (a.size() != b.size())
+            ret += CFG_TA_FMT_NAMESPACE::format("Length mismatch: {} vs {} elements.\n", a.size(), b.size());
+
+        std::size_t num_failed = 0;
+        double max_error = -1;
+        std::size_t max_error_index = 0;
+
+        // The histogram of errors. Zero and infinite errors are counted separately, the rest by powers of ten.
+        std::size_t num_exact = 0;
+        std::size_t num_infinite = 0;
+        std::map<int, std::size_t> num_per_decade;
+
+        for (std::size_t i = 0; i < size; i++)
+        {
+            // The elements before the first mismatch are known to be equal.
+            if (i >= first_mismatch && !ApproxEqual(a[i], b[i], tolerance))
+                num_failed++;
+
+            double error = ApproxError(a[i], b[i], tolerance.kind);
+            if (error > max_error)
+            {
+                max_error = error;
+                max_error_index = i;
+            }
+
+            if (error == 0)
+                num_exact++;
+            else if (std::isinf(error))
+                num_infinite++;
+            else
+                num_per_decade[int(std::floor(std::log10(error)))]++;
+        }
+
+        if (num_failed == 0)
+        {
+            ret += CFG_TA_FMT_NAMESPACE::format("The first {} elements are equal.", size);
+            return ret;
+        }
+
+        const char *tolerance_name = "";
+        switch (tolerance.kind)
+        {
+            case ta_test::FloatTolerance::Kind::absolute: tolerance_name = "absolute"; break;
+            case ta_test::FloatTolerance::Kind::relative: tolerance_name = "relative"; break;
+            case ta_test::FloatTolerance::Kind::ulp:      tolerance_name = "ULP"; break;
+        }
+
+        ret += CFG_TA_FMT_NAMESPACE::format("{} of {} elements exceed the {} tolerance {}.\n", num_failed, size, tolerance_name, tolerance.value);
+        ret += CFG_TA_FMT_NAMESPACE::format("Max error: {} at index {}: {} vs {}\n", max_error, max_error_index, a[max_error_index], b[max_error_index]);
+        ret += CFG_TA_FMT_NAMESPACE::format("First mismatch at index {}: {} vs {}\n", first_mismatch, a[first_mismatch], b[first_mismatch]);
+        ret += "Error histogram:";
+
+        std::vector<std::pair<std::string, std::size_t>> rows;
+        if (num_exact > 0)
+            rows.emplace_back("0", num_exact);
+        for (const auto &[decade, count] : num_per_decade)
+            rows.emplace_back(CFG_TA_FMT_NAMESPACE::format("[1e{}, 1e{})", decade, decade + 1), count);
+        if (num_infinite > 0)
+            rows.emplace_back("inf", num_infinite);
+
+        std::size_t label_width = 0;
+        std::size_t count_width = 0;
+        for (const auto &[label, count] : rows)
+        {
+            label_width = std::max(label_width, label.size());
+            count_width = std::max(count_width, CFG_TA_FMT_NAMESPACE::formatted_size("{}", count));
+        }
+        for (const auto &[label, count] : rows)
+            ret += CFG_TA_FMT_NAMESPACE::format("\n    {:<{}} │ {:>{}}", label, label_width, count, count_width);
+
+        return ret;
+    }
+}
+
+std::size_t ta_test::detail::FindFirstApproxMismatch(const float *a, const float *b, std::size_t size, FloatTolerance tolerance) noexcept
+{
+    return FindFirstApproxMismatchLow(a, b, size, tolerance);
+}
+
+std::size_t ta_test::detail::FindFirstApproxMismatch(const double *a, const double *b, std::size_t size, FloatTolerance tolerance) noexcept
+{
+    return FindFirstApproxMismatchLow(a, b, size, tolerance);
+}
+
+std::string ta_test::detail::DescribeApproxMismatch(std::span<const float> a, std::span<const float> b, std::size_t first_mismatch, FloatTolerance tolerance)
+{
+    return DescribeApproxMismatchLow(a, b, first_mismatch, tolerance);
+}
+
+std::string ta_test::detail::DescribeApproxMismatch(std::span<const double> a, std::span<const double> b, std::size_t first_mismatch, FloatTolerance tolerance)
+{
+    return DescribeApproxMismatchLow(a, b, first_mismatch, tolerance);
+}
+
+void ta_test::detail::DoNotOptimizeHelper(const volatile void *ptr)
+{
+    static const volatile void *volatile sink = nullptr;
+    sink = ptr;
+}
+
+ta_test::BenchmarkLoop::BenchmarkLoop()
+{
+    auto &thread_state = detail::ThreadState();
+    if (!thread_state.current_test)
+        HardError("Can't use `BenchmarkLoop` when no test is running.", HardErrorKind::user);
+
+    results.test = thread_state.current_test;
+    thread_state.current_test->all_tests->modules->Call<&BasicModule::OnPreBenchmark>(*thread_state.current_test, results.settings);
+
+    if (results.settings.num_samples == 0)
+        HardError("`BenchmarkSettings::num_samples` must be positive.", HardErrorKind::user);
+
+    results.samples.reserve(results.settings.num_samples);
+
+    if (results.settings.hardware_counters)
+        hardware_counters.emplace();
+}
+
+bool ta_test::BenchmarkLoop::NextBatch()
+{
+    auto now = std::chrono::steady_clock::now();
+
+    if (batch_size == 0)
+    {
+        // The first batch is a single iteration.
+        batch_size = 1;
+        remaining = 0;
+        batch_start = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - batch_start);
+
+    if (warming_up)
+    {
+        warmup_elapsed += elapsed;
+
+        if (warmup_elapsed >= results.settings.warmup_time && elapsed >= results.settings.min_sample_time)
+        {
+            // Use the last batch size for the samples.
+            warming_up = false;
+            results.iterations_per_sample = batch_size;
+
+            if (hardware_counters)
+                hardware_counters->Start();
+        }
+        else
+        {
+            // Grow the batch until it takes at least `min_sample_time`.
+            if (elapsed < results.settings.min_sample_time)
+            {
+                std::size_t new_size = batch_size * 2;
+                // If the batch isn't too short to be measured, jump directly to the estimated size, plus some margin.
+                if (elapsed.count() > 0 && elapsed * 10 >= results.settings.min_sample_time)
+                    new_size = std::max(new_size, std::size_t(double(batch_size) * 1.2 * double(results.settings.min_sample_time.count()) / double(elapsed.count())));
+                batch_size = new_size;
+            }
+        }
+    }
+    else
+    {
+        results.samples.push_back(double(elapsed.count()) / double(batch_size));
+
+        if (results.samples.size() >= results.settings.num_samples)
+        {
+            if (hardware_counters)
+            {
+                results.counters = hardware_counters->Stop();
+
+                double num_iterations = double(results.samples.size() * results.iterations_per_sample);
+                for (std::optional<double> *counter : {&results.counters.cycles, &results.counters.instructions, &results.counters.cache_misses, &results.counters.branch_misses})
+                {
+                    if (*counter)
+                        **counter /= num_iterations;
+                }
+            }
+
+            // Compute the statistics.
+            std::vector<double> sorted = results.samples;
+            std::sort(sorted.begin(), sorted.end());
+
+            auto Median = [](const std::vector<double> &vec)
+            {
+                std::size_t n = vec.size();
+                return n % 2 ? vec[n / 2] : (vec[n / 2 - 1] + vec[n / 2]) / 2;
+            };
+
+            results.min = sorted.front();
+            results.max = sorted.back();
+            results.median = Median(sorted);
+
+            for (double &x : sorted)
+                x = std::abs(x - results.median);
+            std::sort(sorted.begin(), sorted.end());
+            results.mad = Median(sorted);
+
+            detail::ThreadState().current_test->all_tests->modules->Call<&BasicModule::OnPostBenchmark>(results);
+            return false;
+        }
+    }
+
+    // The current iteration counts towards the batch, hence `- 1`.
+    remaining = batch_size - 1;
+    batch_start = std::chrono::steady_clock::now();
+    return true;
+}
+
 std::string ta_test::SingleException::GetTypeName() const
 {
     if (IsTypeKnown())
@@ -838,47 +1421,26 @@ void ta_test::AnalyzeException(const std::exception_ptr &e, const std::function<
 ta_test::data::AssertionExprDynamicInfo::ArgState ta_test::data::AssertionExprDynamicInfo::CurrentArgState(std::size_t index) const
 {
     ValidateArgIndex(index);
-    auto &thread_state = detail::ThreadState();
-    return thread_state.assertion_argument_metadata[arg_metadata_offset + index].state;
+    return arg_slots[index].metadata.state;
 }
 
 const std::string &ta_test::data::AssertionExprDynamicInfo::CurrentArgValue(std::size_t index) const
 {
     ValidateArgIndex(index);
 
-    auto &thread_state = detail::ThreadState();
-
-    auto &metadata = thread_state.assertion_argument_metadata[arg_metadata_offset + index];
-    auto &buffer = thread_state.assertion_argument_buffers[arg_buffers_pos][index];
-
-    return metadata.to_string_func(metadata, buffer);
+    auto &slot = arg_slots[index];
+    return slot.metadata.to_string_func(slot.metadata, slot.buffer);
 }
 
 void ta_test::data::AssertionExprDynamicInfo::ValidateArgIndex(std::size_t index) const
 {
-    auto &thread_state = detail::ThreadState();
-
-    // Metadata index:
-
-    // Make sure the argument storage is as large as we expect it to be.
-    if (arg_metadata_offset + static_info->args_info.size() >/*sic*/ thread_state.assertion_argument_metadata.size())
-        HardError("Something is wrong with the global assertion argument storage, the metadata offset is out of range.");
+    // Make sure the argument storage was allocated.
+    if (!arg_slots)
+        HardError("Something is wrong with the global assertion argument storage, the argument slots weren't allocated.");
 
     // Make sure `index` is in range.
     if (index >= static_info->args_info.size())
         HardError("Assretion argument index is out of range.");
-
-    // Buffer index:
-
-    // Check the outer buffer list size.
-    if (arg_buffers_pos >= thread_state.assertion_argument_buffers.size())
-        HardError("Something is wrong with the global assertion argument storage, the buffers offset is out of range.");
-
-    // Check the inner buffer list size.
-    // Note `<`. I'd like `!=` instead, but since the elements are non-movable, it's way easier to keep the size equal to the capacity,
-    //   so the vector will have some unused elements just to keep the memory allocated.
-    if (thread_state.assertion_argument_buffers[arg_buffers_pos].size() < static_info->args_info.size())
-        HardError("Something is wrong with the global assertion argument storage, the inner buffer list has the wrong size.");
 }
 
 ta_test::data::BasicGenerator::OverrideStatus ta_test::data::BasicGenerator::RunGeneratorOverride()
@@ -899,7 +1461,7 @@ ta_test::data::BasicGenerator::OverrideStatus ta_test::data::BasicGenerator::Run
 ta_test::data::CaughtExceptionContext::CaughtExceptionContext(
     std::shared_ptr<const CaughtExceptionInfo> state, ExceptionElemVar active_elem, AssertFlags flags, SourceLoc source_loc
 )
-    : FrameGuard([&]() -> std::shared_ptr<const CaughtExceptionContext>
+    : FrameGuard([&]() -> const CaughtExceptionContext *
     {
         // A null instance.
         if (!state)
@@ -916,7 +1478,7 @@ ta_test::data::CaughtExceptionContext::CaughtExceptionContext(
                 return nullptr;
         }
 
-        return std::shared_ptr<const CaughtExceptionContext>(std::shared_ptr<void>{}, this);
+        return this;
     }()),
     state(std::move(state)),
     // We don't care about the validity of this when the lambda above returns null.
@@ -941,21 +1503,101 @@ ta_test::data::CaughtExceptionContext::CaughtExceptionContext(
     }, active_elem) : -1)
 {}
 
-// Gracefully fails the current test, if not already failed.
-// Call this first, before printing any messages.
-void ta_test::detail::GlobalThreadState::FailCurrentTest()
+ta_test::detail::ArgSlot *ta_test::detail::ArgArena::Push(std::size_t n)
 {
-    if (!current_test)
-        HardError("Trying to fail the current test, but no test is currently running.");
+    if (chunks.empty() || top.pos + n > chunks[top.chunk].size)
+    {
+        // Switch to the next chunk. Nothing lives in it or after it, so we're free to replace it if it's too small.
+        std::size_t next = chunks.empty() ? 0 : top.chunk + 1;
+        if (next == chunks.size())
+            chunks.emplace_back();
 
-    if (current_test->failed)
-        return; // Already failed.
+        Chunk &chunk = chunks[next];
+        if (chunk.size < n)
+        {
+            std::size_t new_size = std::max({n, min_chunk_size, next > 0 ? chunks[next - 1].size * 2 : 0});
+            chunk.slots = std::make_unique<ArgSlot[]>(new_size);
+            chunk.size = new_size;
+        }
 
-    current_test->failed = true;
-    current_test->all_tests->modules->Call<&BasicModule::OnPreFailTest>(*current_test);
+        top = {.chunk = next, .pos = 0};
+    }
+
+    ArgSlot *ret = chunks[top.chunk].slots.get() + top.pos;
+    top.pos += n;
+
+    // Reset the metadata left over from the previous assertions. The buffers don't need it.
+    for (std::size_t i = 0; i < n; i++)
+        ret[i].metadata = {};
+
+    return ret;
 }
 
-ta_test::detail::GlobalThreadState &ta_test::detail::ThreadState()
+void ta_test::detail::ArgArena::Pop(Mark mark, ArgSlot *slots, std::size_t n)
+{
+    // `Push()` puts the slots either at `mark`, or at the beginning of the next chunk if they didn't fit.
+    // There can be `PushStorage()` allocations after them.
+    bool slots_are_valid = false;
+    for (std::size_t i = mark.chunk; i < chunks.size() && i <= mark.chunk + 1 && i <= top.chunk; i++)
+    {
+        if (slots == chunks[i].slots.get() + (i == mark.chunk ? mark.pos : 0))
+        {
+            slots_are_valid = i < top.chunk || slots + n <= chunks[i].slots.get() + top.pos;
+            break;
+        }
+    }
+    if (!slots_are_valid)
+        HardError("Assertion argument arena mismatch, the arguments are not freed in the LIFO order.");
+
+    // Destroy arguments.
+    for (std::size_t i = n; i-- > 0;)
+        slots[i].metadata.Destroy(slots[i].buffer); // This is noexcept.
+
+    top = mark;
+}
+
+void *ta_test::detail::DeferredLogArena::Allocate(std::size_t size, std::size_t alignment)
+{
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        HardError("The deferred log argument is overaligned.");
+
+    while (true)
+    {
+        if (cur_chunk == chunks.size())
+        {
+            std::size_t new_size = std::max(size, min_chunk_size);
+            chunks.push_back({.bytes = std::make_unique_for_overwrite<std::byte[]>(new_size), .size = new_size});
+        }
+
+        Chunk &chunk = chunks[cur_chunk];
+        std::size_t offset = (cur_pos + alignment - 1) / alignment * alignment;
+        if (offset + size <= chunk.size)
+        {
+            cur_pos = offset + size;
+            return chunk.bytes.get() + offset;
+        }
+
+        // Doesn't fit, try the next chunk.
+        cur_chunk++;
+        cur_pos = 0;
+    }
+}
+
+// Gracefully fails the current test, if not already failed.
+// Call this first, before printing any messages.
+void ta_test::detail::GlobalThreadState::FailCurrentTest()
+{
+    if (!current_test)
+        HardError("Trying to fail the current test, but no test is currently running.");
+
+    if (current_test->failed)
+        return; // Already failed.
+
+    current_test->failed = true;
+    current_test->all_tests->modules->Call<&BasicModule::OnPreFailTest>(*current_test);
+}
+
+ta_test::detail::GlobalThreadState &ta_test::detail::ThreadState()
 {
     thread_local GlobalThreadState ret;
     return ret;
@@ -1014,6 +1656,236 @@ bool ta_test::platform::IsTerminalAttached(bool is_stderr)
     #endif
 }
 
+std::chrono::nanoseconds ta_test::platform::ThreadCpuTime()
+{
+    #if defined(_WIN32)
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time))
+        return {};
+    auto ToUint64 = [](const FILETIME &time){return std::uint64_t(time.dwLowDateTime) | std::uint64_t(time.dwHighDateTime) << 32;};
+    // `FILETIME` uses 100ns units.
+    return std::chrono::nanoseconds(std::int64_t(ToUint64(kernel_time) + ToUint64(user_time)) * 100);
+    #elif defined(__linux__) || defined(__APPLE__)
+    timespec time{};
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0)
+        return {};
+    return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+    #else
+    return {};
+    #endif
+}
+
+ta_test::platform::HardwareCounters::HardwareCounters()
+{
+    fds.fill(-1);
+
+    #if DETAIL_TA_USE_PERF_EVENTS
+    static constexpr std::array<std::uint64_t, num_events> configs = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+
+    for (std::size_t i = 0; i < num_events; i++)
+    {
+        perf_event_attr attr{};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = configs[i];
+        // Only the leader is disabled, the rest follow it.
+        attr.disabled = leader_fd == -1;
+        // Counting only the user space lets this work with `perf_event_paranoid` up to 2.
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        int fd = int(syscall(SYS_perf_event_open, &attr, 0/*this thread*/, -1/*any cpu*/, leader_fd, PERF_FLAG_FD_CLOEXEC));
+        if (fd == -1)
+            continue; // This counter is unavailable.
+
+        fds[i] = fd;
+        if (leader_fd == -1)
+            leader_fd = fd;
+    }
+    #endif
+}
+
+ta_test::platform::HardwareCounters::~HardwareCounters()
+{
+    #if DETAIL_TA_USE_PERF_EVENTS
+    for (int fd : fds)
+    {
+        if (fd != -1)
+            close(fd);
+    }
+    #endif
+}
+
+void ta_test::platform::HardwareCounters::Start()
+{
+    #if DETAIL_TA_USE_PERF_EVENTS
+    if (leader_fd == -1)
+        return;
+    ioctl(leader_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    #endif
+}
+
+ta_test::data::BenchmarkCounters ta_test::platform::HardwareCounters::Stop()
+{
+    data::BenchmarkCounters ret;
+
+    #if DETAIL_TA_USE_PERF_EVENTS
+    if (leader_fd == -1)
+        return ret;
+    ioctl(leader_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    auto Read = [&](Event event) -> std::optional<double>
+    {
+        if (fds[event] == -1)
+            return {};
+
+        // Matches `read_format`.
+        struct {std::uint64_t value, time_enabled, time_running;} data{};
+        if (read(fds[event], &data, sizeof(data)) != sizeof(data) || data.time_running == 0)
+            return {};
+
+        // If the kernel multiplexed the counters, extrapolate.
+        return double(data.value) * double(data.time_enabled) / double(data.time_running);
+    };
+
+    ret.cycles = Read(cycles);
+    ret.instructions = Read(instructions);
+    ret.cache_misses = Read(cache_misses);
+    ret.branch_misses = Read(branch_misses);
+    #endif
+
+    return ret;
+}
+
+namespace
+{
+    // `constinit` makes sure this is trivially constructible, and `AllocationThreadState` is trivially destructible,
+    //   so it's usable from `operator new` at any point of the thread's lifetime.
+    constinit thread_local ta_test::detail::AllocationThreadState allocation_thread_state;
+}
+
+ta_test::detail::AllocationThreadState &ta_test::detail::ThreadAllocationState() noexcept
+{
+    return allocation_thread_state;
+}
+
+bool ta_test::detail::AllocationTrackingEnabled() noexcept
+{
+    return CFG_TA_TRACK_ALLOCATIONS;
+}
+
+#if CFG_TA_TRACK_ALLOCATIONS
+namespace
+{
+    // Stored right before every allocation, to know its size when freeing it.
+    struct AllocationHeader
+    {
+        std::size_t size = 0;
+        // The distance from the start of the underlying allocation to the pointer we return.
+        std::size_t offset = 0;
+    };
+
+    [[nodiscard]] void *TrackedAllocate(std::size_t size, std::size_t alignment) noexcept
+    {
+        // Both are powers of two, so this is a multiple of both.
+        std::size_t offset = std::max(alignment, sizeof(AllocationHeader));
+        if (size > std::size_t(-1) - offset - alignment)
+            return nullptr;
+
+        #ifdef _WIN32
+        void *base = _aligned_malloc(size + offset, alignment);
+        #else
+        void *base = alignment <= alignof(std::max_align_t)
+            ? std::malloc(size + offset)
+            // `aligned_alloc()` wants the size to be a multiple of the alignment.
+            : std::aligned_alloc(alignment, (size + offset + alignment - 1) / alignment * alignment);
+        #endif
+        if (!base)
+            return nullptr;
+
+        char *ret = static_cast<char *>(base) + offset;
+        ::new((void *)(ret - sizeof(AllocationHeader))) AllocationHeader{.size = size, .offset = offset};
+
+        allocation_thread_state.num_allocations++;
+        if (ta_test::data::AllocationStats *target = allocation_thread_state.target)
+        {
+            target->num_allocations++;
+            target->allocated_bytes += size;
+            target->live_bytes += std::ptrdiff_t(size);
+            if (target->live_bytes > target->peak_live_bytes)
+                target->peak_live_bytes = target->live_bytes;
+        }
+
+        return ret;
+    }
+
+    [[nodiscard]] void *TrackedAllocateOrThrow(std::size_t size, std::size_t alignment)
+    {
+        while (true)
+        {
+            if (void *ret = TrackedAllocate(size, alignment))
+                return ret;
+
+            std::new_handler handler = std::get_new_handler();
+            if (!handler)
+                throw std::bad_alloc{};
+            handler();
+        }
+    }
+
+    void TrackedFree(void *ptr) noexcept
+    {
+        if (!ptr)
+            return;
+
+        char *p = static_cast<char *>(ptr);
+        const AllocationHeader &header = *reinterpret_cast<const AllocationHeader *>(p - sizeof(AllocationHeader));
+
+        if (ta_test::data::AllocationStats *target = allocation_thread_state.target)
+        {
+            target->num_deallocations++;
+            target->live_bytes -= std::ptrdiff_t(header.size);
+        }
+
+        void *base = p - header.offset;
+        #ifdef _WIN32
+        _aligned_free(base);
+        #else
+        std::free(base);
+        #endif
+    }
+}
+
+void *operator new(std::size_t size) {return TrackedAllocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);}
+void *operator new[](std::size_t size) {return TrackedAllocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);}
+void *operator new(std::size_t size, std::align_val_t alignment) {return TrackedAllocateOrThrow(size, std::size_t(alignment));}
+void *operator new[](std::size_t size, std::align_val_t alignment) {return TrackedAllocateOrThrow(size, std::size_t(alignment));}
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {return TrackedAllocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {return TrackedAllocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);}
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {return TrackedAllocate(size, std::size_t(alignment));}
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {return TrackedAllocate(size, std::size_t(alignment));}
+
+void operator delete(void *ptr) noexcept {TrackedFree(ptr);}
+void operator delete[](void *ptr) noexcept {TrackedFree(ptr);}
+void operator delete(void *ptr, std::size_t) noexcept {TrackedFree(ptr);}
+void operator delete[](void *ptr, std::size_t) noexcept {TrackedFree(ptr);}
+void operator delete(void *ptr, std::align_val_t) noexcept {TrackedFree(ptr);}
+void operator delete[](void *ptr, std::align_val_t) noexcept {TrackedFree(ptr);}
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept {TrackedFree(ptr);}
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept {TrackedFree(ptr);}
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {TrackedFree(ptr);}
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {TrackedFree(ptr);}
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t &) noexcept {TrackedFree(ptr);}
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t &) noexcept {TrackedFree(ptr);}
+#endif
+
 ta_test::output::Terminal::Terminal(FILE *stream)
 {
     bool is_terminal =
@@ -1058,7 +1930,7 @@ ta_test::output::Terminal::Terminal(FILE *stream)
 
 void ta_test::output::Terminal::PrintLow(std::string_view fmt, CFG_TA_FMT_NAMESPACE::format_args args) const
 {
-    if (output_func)
+    if (output_func && !muted)
         output_func(fmt, args);
 }
 
@@ -1634,7 +2506,12 @@ void ta_test::output::PrintContext(Terminal::StyleGuard &cur_style, const contex
     for (auto it = con.end(); it != con.begin();)
     {
         --it;
-        if (first && skip_last_frame && skip_last_frame == it->get())
+
+        // Only print the outermost occurence of each frame. The stack is usually short, so a linear search is fine.
+        if (std::find(con.begin(), it, *it) != it)
+            continue;
+
+        if (first && skip_last_frame && skip_last_frame == *it)
             continue;
 
         first = false;
@@ -1661,16 +2538,23 @@ void ta_test::output::PrintLog(Terminal::StyleGuard &cur_style)
     if (!thread_state.current_test)
         HardError("No test is currently running, can't print log.", HardErrorKind::user);
 
-    // Refresh the messages. Only the scoped log, since the unscoped one should never be lazy.
+    // Refresh the messages. The unscoped log can only contain deferred messages, which are formatted only once.
     for (auto *entry : thread_state.scoped_log)
     {
         if (auto message = std::get_if<context::LogMessage>(&entry->var))
             message->RefreshMessage();
     }
+    std::vector<const context::LogEntry *> unscoped_log;
+    thread_state.current_test->unscoped_log.ForEach([&](context::LogEntry &entry)
+    {
+        if (auto message = std::get_if<context::LogMessage>(&entry.var))
+            message->RefreshMessage();
+        unscoped_log.push_back(&entry);
+    });
 
     for (const auto &m : thread_state.current_test->all_tests->modules->GetModulesImplementing<&BasicPrintingModule::PrintLogEntries>())
     {
-        if (m->PrintLogEntries(cur_style, thread_state.current_test->unscoped_log, context::CurrentScopedLog()))
+        if (m->PrintLogEntries(cur_style, unscoped_log, context::CurrentScopedLog()))
             break;
     }
 }
@@ -1713,148 +2597,6 @@ void ta_test::detail::ArgWrapper::EnsureAssertionIsRunning()
     HardError("`$[...]` was evaluated when an assertion owning it already finished executing, or in a wrong thread.", HardErrorKind::user);
 }
 
-ta_test::detail::AssertionExprStaticInfoImpl::AssertionExprStaticInfoImpl(std::string_view raw_expr, std::string_view expanded_expr)
-{
-    expr = raw_expr;
-
-    // Check that `$[...]` weren't expanded too early by another macro.
-    if (raw_expr.find("_ta_arg_(") != std::string_view::npos)
-    {
-        HardError(
-            "Invalid assertion macro usage. When passing `$[...]`, "
-            "the `TA_CHECK` macro must not be wrapped in another function-like macro. Wrap `DETAIL_TA_CHECK` directly instead.",
-            HardErrorKind::user
-        );
-    }
-
-    std::size_t num_args = 0;
-    text::expr::ParseExpr(raw_expr, nullptr, true, [&](bool exiting, std::string_view name, std::string_view args, std::size_t depth)
-    {
-        (void)args;
-        (void)depth;
-        if (!exiting && text::chars::IsArgMacroName(name))
-            num_args++;
-
-    });
-
-    args_info.resize(num_args);
-    counter_to_arg_index.resize(num_args);
-
-    // Below we parse the expression twice. The first parse triggers the callback at the beginning of `$[...]`,
-    // and the second triggers it at the end of `$[...]`. This creates more work for us, but can't be fixed without
-    // wrapping the whole argument of `$[...]` in a macro call (which is incompatible with using `[...]`, which we want because they look better).
-
-    // Parse expanded string.
-    std::size_t pos = 0;
-    text::expr::ParseExpr(expanded_expr, nullptr, false, [&](bool exiting, std::string_view name, std::string_view args, std::size_t depth)
-    {
-        (void)depth;
-
-        if (!exiting || name != "_ta_arg_")
-            return;
-
-        if (pos >= num_args)
-            HardError("`$` not followed by `[...]`.", HardErrorKind::user);
-
-        ArgInfo &new_info = args_info[pos];
-
-        // Note: Can't fill `new_info.depth` here, because the parentheses only container the counter, and not the actual `$[...]` argument.
-        // We fill the depth during the next pass.
-
-        for (const char &ch : args)
-        {
-            if (text::chars::IsDigit(ch))
-                new_info.counter = new_info.counter * 10 + (ch - '0');
-            else if (ch == ',')
-                break;
-            else
-                HardError("Lexer error: Unexpected character after the counter macro.");
-        }
-
-        CounterIndexPair &new_pair = counter_to_arg_index[pos];
-        new_pair.index = pos;
-        new_pair.counter = new_info.counter;
-
-        pos++;
-    });
-    if (pos != num_args)
-        HardError("Less `$[...]`s than expected.");
-
-    // This stack maps bracket depth to the element index, so that the second pass processes things in the same order as the first pass.
-    // This only matters for nested brackets.
-    std::vector<std::size_t> bracket_stack;
-    bracket_stack.reserve(num_args);
-
-    // Parse raw string.
-    pos = 0;
-    text::expr::ParseExpr(raw_expr, nullptr, true, [&](bool exiting, std::string_view name, std::string_view args, std::size_t depth)
-    {
-        // This `depth` is useless to us, because it also counts the user parentheses.
-        (void)depth;
-
-        if (!text::chars::IsArgMacroName(name))
-            return;
-
-        if (!exiting)
-        {
-            if (pos >= num_args)
-                HardError("More `$[...]`s than expected.");
-
-            bracket_stack.push_back(pos++);
-            return;
-        }
-
-        ArgInfo &this_info = args_info[bracket_stack.back()];
-        bracket_stack.pop_back();
-
-        this_info.depth = bracket_stack.size();
-
-        this_info.expr_offset = std::size_t(args.data() - raw_expr.data());
-        this_info.expr_size = args.size();
-
-        this_info.ident_offset = std::size_t(name.data() - raw_expr.data());
-        this_info.ident_size = name.size();
-
-        // Trim side whitespace from `args`.
-        std::string_view trimmed_args = args;
-        while (!trimmed_args.empty() && text::chars::IsWhitespace(trimmed_args.front()))
-            trimmed_args.remove_prefix(1);
-        while (!trimmed_args.empty() && text::chars::IsWhitespace(trimmed_args.back()))
-            trimmed_args.remove_suffix(1);
-
-        // Decide if we should draw a bracket for this argument.
-        for (char ch : trimmed_args)
-        {
-            // Whatever the condition is, it should trigger for all arguments with nested arguments.
-            if (!text::chars::IsIdentifierChar(ch))
-            {
-                this_info.need_bracket = true;
-                break;
-            }
-        }
-    });
-    if (pos != num_args)
-        HardError("Less `$[...]`s than expected.");
-
-    // Sort `counter_to_arg_index` by counter, to allow binary search.
-    std::sort(counter_to_arg_index.begin(), counter_to_arg_index.end(),
-        [](const CounterIndexPair &a, const CounterIndexPair &b){return a.counter < b.counter;}
-    );
-
-    // Fill and sort `args_in_draw_order`.
-    args_in_draw_order.resize(num_args);
-    for (std::size_t i = 0; i < num_args; i++)
-        args_in_draw_order[i] = i;
-    std::sort(args_in_draw_order.begin(), args_in_draw_order.end(), [&](std::size_t a, std::size_t b)
-    {
-        if (auto d = args_info[a].depth <=> args_info[b].depth; d != 0)
-            return d > 0;
-        if (auto d = args_info[a].counter <=> args_info[b].counter; d != 0)
-            return d < 0;
-        return false;
-    });
-}
-
 ta_test::detail::AssertWrapper::AssertionStackGuard::AssertionStackGuard(AssertWrapper &self)
     : self(self)
 {
@@ -1866,22 +2608,9 @@ ta_test::detail::AssertWrapper::AssertionStackGuard::AssertionStackGuard(AssertW
     self.enclosing_assertion = cur;
     cur = &self;
 
-    { // Set up the argument storage.
-        self.arg_buffers_pos = thread_state.assertion_argument_buffers_pos++;
-        if (thread_state.assertion_argument_buffers.size() < thread_state.assertion_argument_buffers_pos)
-            thread_state.assertion_argument_buffers.resize(thread_state.assertion_argument_buffers_pos);
-
-        auto &arg_buffers = thread_state.assertion_argument_buffers[self.arg_buffers_pos];
-        if (!arg_buffers.empty())
-            HardError("Expected the argument buffers to be empty, but there's junk there.");
-
-        // A jank manual resize, since `ArgBuffer` is non-movable.
-        if (arg_buffers.size() < self.static_info->args_info.size())
-            arg_buffers = std::vector<ArgBuffer>(std::max(arg_buffers.size() * 2, self.static_info->args_info.size()));
-
-        self.arg_metadata_offset = thread_state.assertion_argument_metadata.size();
-        thread_state.assertion_argument_metadata.resize(self.arg_metadata_offset + self.static_info->args_info.size());
-    }
+    // Set up the argument storage.
+    old_arena_mark = thread_state.assertion_argument_arena.GetMark();
+    self.arg_slots = thread_state.assertion_argument_arena.Push(self.static_info->args_info.size());
 }
 
 ta_test::detail::AssertWrapper::AssertionStackGuard::~AssertionStackGuard()
@@ -1894,34 +2623,15 @@ ta_test::detail::AssertWrapper::AssertionStackGuard::~AssertionStackGuard()
 
     thread_state.current_assertion = const_cast<data::BasicAssertion *>(self.enclosing_assertion);
 
-    { // Dismantle argument storage.
-        // Decrement depth counter.
-        thread_state.assertion_argument_buffers_pos--;
-        if (self.arg_buffers_pos != thread_state.assertion_argument_buffers_pos)
-            HardError("Assertion depth counter mismatch.");
-
-        // Destroy arguments.
-        for (std::size_t i = self.static_info->args_info.size(); i-- > 0;)
-        {
-            ArgBuffer &buffer = thread_state.assertion_argument_buffers[self.arg_buffers_pos][i];
-            ArgMetadata &metadata = thread_state.assertion_argument_metadata[self.arg_metadata_offset + i];
-            metadata.Destroy(buffer); // This is noexcept.
-        }
-
-        // Intentionally preserve this memory for future reuse.
-        thread_state.assertion_argument_buffers[self.arg_buffers_pos].clear();
-
-        if (self.arg_metadata_offset + self.static_info->args_info.size() != thread_state.assertion_argument_metadata.size())
-            HardError("Invalid argument metadata array size.");
-
-        thread_state.assertion_argument_metadata.resize(self.arg_metadata_offset);
-    }
+    // Dismantle argument storage. This keeps the memory for future reuse.
+    thread_state.assertion_argument_arena.Pop(old_arena_mark, self.arg_slots, self.static_info->args_info.size());
+    self.arg_slots = nullptr;
 }
 
 bool ta_test::detail::AssertWrapper::Evaluator::operator~()
 {
     AssertionStackGuard stack_guard(self);
-    context::FrameGuard context_guard({std::shared_ptr<void>{}, &self});
+    context::FrameGuard context_guard(&self);
 
     GlobalThreadState &thread_state = ThreadState();
     if (!thread_state.current_test)
@@ -1932,12 +2642,18 @@ bool ta_test::detail::AssertWrapper::Evaluator::operator~()
     // Increment total checks counter.
     const_cast<data::RunTestsProgress *>(thread_state.current_test->all_tests)->num_checks_total++;
 
-    bool should_catch = true;
-    thread_state.current_test->all_tests->modules->Call<&BasicModule::OnPreTryCatch>(should_catch);
+    // Use the cached policy, unless a module invalidated it.
+    auto &cached_should_catch = thread_state.current_test->should_catch;
+    if (!cached_should_catch)
+    {
+        bool should_catch = true;
+        thread_state.current_test->all_tests->modules->Call<&BasicModule::OnPreTryCatch>(should_catch);
+        cached_should_catch = should_catch;
+    }
 
     std::exception_ptr uncaught_exception;
 
-    if (should_catch)
+    if (*cached_should_catch)
     {
         try
         {
@@ -2036,6 +2752,14 @@ std::optional<std::string_view> ta_test::detail::AssertWrapper::UserMessage() co
         return {};
 }
 
+std::optional<std::string_view> ta_test::detail::AssertWrapper::Details() const
+{
+    if (details)
+        return *details;
+    else
+        return {};
+}
+
 ta_test::data::BasicAssertion::DecoVar ta_test::detail::AssertWrapper::GetElement(int index) const
 {
     if (static_info->expr.empty())
@@ -2085,10 +2809,15 @@ ta_test::data::BasicAssertion::DecoVar ta_test::detail::AssertWrapper::GetElemen
 
     ValidateArgIndex(it->index);
 
-    return {*this, thread_state.assertion_argument_buffers[arg_buffers_pos][it->index],thread_state.assertion_argument_metadata[arg_metadata_offset + it->index]};
+    return {
+        *this,
+        arg_slots[it->index].buffer,
+        arg_slots[it->index].metadata,
+        static_info->args_info[it->index].is_named_object,
+    };
 }
 
-void ta_test::detail::GlobalState::SortTestListInExecutionOrder(std::span<std::size_t> indices) const
+void ta_test::detail::GlobalState::SortTestListByPrefixes(std::span<std::size_t> indices, const std::function<bool(std::string_view prefix_a, std::string_view prefix_b)> &less) const
 {
     std::sort(indices.begin(), indices.end(), [&](std::size_t a, std::size_t b)
     {
@@ -2115,9 +2844,45 @@ void ta_test::detail::GlobalState::SortTestListInExecutionOrder(std::span<std::s
                 continue;
             }
 
-            return name_prefixes_to_order.at(std::string_view(name_a.begin(), new_it_a)) <
-                name_prefixes_to_order.at(std::string_view(name_b.begin(), new_it_b));
+            return less(std::string_view(name_a.begin(), new_it_a), std::string_view(name_b.begin(), new_it_b));
+        }
+    });
+}
+
+void ta_test::detail::GlobalState::SortTestListInExecutionOrder(std::span<std::size_t> indices) const
+{
+    SortTestListByPrefixes(indices, [&](std::string_view prefix_a, std::string_view prefix_b)
+    {
+        return name_prefixes_to_order.at(prefix_a) < name_prefixes_to_order.at(prefix_b);
+    });
+}
+
+void ta_test::detail::GlobalState::SortTestListByPriority(std::span<std::size_t> indices, std::span<const double> priorities) const
+{
+    // The priority of each test and each prefix, which is the largest priority of the tests in it.
+    std::map<std::string_view, double, TestNameLess> prefix_priorities;
+    for (std::size_t index : indices)
+    {
+        std::string_view name = tests[index]->Name();
+        for (auto it = name.begin();; it++)
+        {
+            it = std::find(it, name.end(), '/');
+            auto [iter, is_new] = prefix_priorities.try_emplace(std::string_view(name.begin(), it), priorities[index]);
+            if (!is_new)
+                iter->second = std::max(iter->second, priorities[index]);
+            if (it == name.end())
+                break;
         }
+    }
+
+    SortTestListByPrefixes(indices, [&](std::string_view prefix_a, std::string_view prefix_b)
+    {
+        double priority_a = prefix_priorities.at(prefix_a);
+        double priority_b = prefix_priorities.at(prefix_b);
+        if (priority_a != priority_b)
+            return priority_a > priority_b;
+
+        return name_prefixes_to_order.at(prefix_a) < name_prefixes_to_order.at(prefix_b);
     });
 }
 
@@ -2196,7 +2961,27 @@ void ta_test::detail::AddLogEntryLow(std::string &&message)
     auto &thread_state = ThreadState();
     if (!thread_state.current_test)
         HardError("Can't log when no test is running.", HardErrorKind::user);
-    thread_state.current_test->unscoped_log.push_back(context::LogEntry{GenerateLogId(), context::LogMessage{std::move(message)}});
+    thread_state.current_test->unscoped_log.Add(context::LogEntry{GenerateLogId(), context::LogMessage{std::move(message)}});
+}
+
+void *ta_test::detail::AllocateDeferredLogMessage(std::size_t size, std::size_t alignment)
+{
+    auto &thread_state = ThreadState();
+    if (!thread_state.current_test)
+        HardError("Can't log when no test is running.", HardErrorKind::user);
+
+    // If the entry can be discarded by `--log-capacity`, the log itself provides the memory, which gets reused.
+    if (void *ret = thread_state.current_test->unscoped_log.AllocatePayloadForNextEntry(size, alignment))
+        return ret;
+    return thread_state.deferred_log_arena.Allocate(size, alignment);
+}
+
+void ta_test::detail::AddDeferredLogEntryLow(std::string (*generate_message)(const void *data), const void *data)
+{
+    auto &thread_state = ThreadState();
+    if (!thread_state.current_test)
+        HardError("Can't log when no test is running.", HardErrorKind::user);
+    thread_state.current_test->unscoped_log.Add(context::LogEntry{GenerateLogId(), context::LogMessage{generate_message, data}});
 }
 
 void ta_test::detail::AddLogEntry(const SourceLoc &loc)
@@ -2206,7 +2991,7 @@ void ta_test::detail::AddLogEntry(const SourceLoc &loc)
     auto &thread_state = ThreadState();
     if (!thread_state.current_test)
         HardError("Can't log when no test is running.", HardErrorKind::user);
-    thread_state.current_test->unscoped_log.push_back(context::LogEntry{GenerateLogId(), context::LogSourceLoc{.loc = loc, .callee = {}}});
+    thread_state.current_test->unscoped_log.Add(context::LogEntry{GenerateLogId(), context::LogSourceLoc{.loc = loc, .callee = {}}});
 }
 
 ta_test::detail::BasicScopedLogGuard::BasicScopedLogGuard(context::LogEntry new_entry)
@@ -2253,21 +3038,53 @@ ta_test::detail::SpecificGeneratorGenerateGuard::~SpecificGeneratorGenerateGuard
     }
 }
 
-ta_test::detail::GenerateValueHelper::GenerateValueHelper(SourceLocWithCounter source_loc)
-    : source_loc(source_loc)
+void ta_test::detail::VisitedGeneratorCache::InsertOrAssign(const SourceLocWithCounter *key, std::size_t value)
 {
-    if (ThreadState().current_test->currently_in_generator)
+    // Keep the load factor at most 1/2.
+    if ((num_entries + 1) * 2 > slots.size())
     {
-        HardError(
-            CFG_TA_FMT_NAMESPACE::format("Using a generator inside of another generator callback is not allowed, at `" DETAIL_TA_INTERNAL_ERROR_LOCATION_FORMAT "`.",
-                source_loc.file, source_loc.line
-            ),
-            HardErrorKind::user
-        );
+        std::vector<Slot> old_slots = std::exchange(slots, std::vector<Slot>(std::max(std::size_t(16), slots.size() * 2)));
+        std::size_t old_epoch = std::exchange(epoch, 1);
+        num_entries = 0;
+        for (const Slot &slot : old_slots)
+        {
+            if (slot.epoch == old_epoch)
+                InsertOrAssign(slot.key, slot.value);
+        }
     }
 
-    ThreadState().current_test->currently_in_generator = true;
-}
+    for (std::size_t i = StartingSlot(key);; i = (i + 1) & (slots.size() - 1))
+    {
+        Slot &slot = slots[i];
+        if (slot.epoch != epoch)
+        {
+            slot = {.key = key, .value = value, .epoch = epoch};
+            num_entries++;
+            return;
+        }
+        if (slot.key == key)
+        {
+            slot.value = value;
+            return;
+        }
+    }
+}
+
+ta_test::detail::GenerateValueHelper::GenerateValueHelper(const SourceLocWithCounter &source_loc)
+    : source_loc(source_loc)
+{
+    if (ThreadState().current_test->currently_in_generator)
+    {
+        HardError(
+            CFG_TA_FMT_NAMESPACE::format("Using a generator inside of another generator callback is not allowed, at `" DETAIL_TA_INTERNAL_ERROR_LOCATION_FORMAT "`.",
+                source_loc.file, source_loc.line
+            ),
+            HardErrorKind::user
+        );
+    }
+
+    ThreadState().current_test->currently_in_generator = true;
+}
 
 ta_test::detail::GenerateValueHelper::~GenerateValueHelper()
 {
@@ -2304,7 +3121,7 @@ ta_test::detail::GenerateValueHelper::~GenerateValueHelper()
                 // This also happens regardless of whether we just created the generator, or are revisiting it.
                 [&]() noexcept {
                     // Intentionally overwriting the old value, if any.
-                    thread_state.current_test->visited_generator_cache.insert_or_assign(source_loc, thread_state.current_test->generator_index);
+                    thread_state.current_test->visited_generator_cache.InsertOrAssign(&source_loc, thread_state.current_test->generator_index);
                 }();
 
                 thread_state.current_test->generator_index++;
@@ -2520,7 +3337,7 @@ ta_test::CaughtException ta_test::detail::MustThrowWrapper::Evaluator::operator~
 
     try
     {
-        context::FrameGuard guard({self.info, &self.info->info}); // A wonky owning pointer that points to a subobject.
+        context::FrameGuard guard(&self.info->info); // `self.info` outlives this.
         self.body_func(self.body_data);
     }
     catch (...)
@@ -2567,10 +3384,20 @@ void ta_test::Runner::SetDefaultModules()
     // Those are ordered in a certain way to print the `--help` page in the nice order: [
     modules.push_back(MakeModule<modules::HelpPrinter>());
     modules.push_back(MakeModule<modules::TestSelector>());
+    modules.push_back(MakeModule<modules::TestSharder>());
+    modules.push_back(MakeModule<modules::TimingDatabase>());
     modules.push_back(MakeModule<modules::GeneratorOverrider>());
+    modules.push_back(MakeModule<modules::ParallelTestRunner>());
+    modules.push_back(MakeModule<modules::GeneratorShrinker>());
+    modules.push_back(MakeModule<modules::GeneratorSampler>());
+    modules.push_back(MakeModule<modules::GeneratorCoverage>());
     modules.push_back(MakeModule<modules::PrintingConfigurator>());
     // ]
     modules.push_back(MakeModule<modules::ProgressPrinter>());
+    modules.push_back(MakeModule<modules::TimingPrinter>());
+    modules.push_back(MakeModule<modules::AllocationPrinter>());
+    modules.push_back(MakeModule<modules::BenchmarkPrinter>());
+    modules.push_back(MakeModule<modules::BenchmarkBaseline>());
     modules.push_back(MakeModule<modules::ResultsPrinter>());
     modules.push_back(MakeModule<modules::AssertionPrinter>());
     modules.push_back(MakeModule<modules::LogPrinter>());
@@ -2712,22 +3539,76 @@ int ta_test::Runner::Run()
             if (filter_state == BasicModule::TestFilterState::enabled)
                 ordered_tests.push_back(i);
         }
+
+        // Let the modules filter the whole list.
+        std::vector<const data::BasicTest *> enabled_tests;
+        enabled_tests.reserve(ordered_tests.size());
+        for (std::size_t i : ordered_tests)
+            enabled_tests.push_back(state.tests[i]);
+        module_lists.Call<&BasicModule::OnFilterTestList>(enabled_tests);
+        if (enabled_tests.size() != ordered_tests.size())
+        {
+            ordered_tests.clear();
+            for (const data::BasicTest *test : enabled_tests)
+                ordered_tests.push_back(state.name_to_test_index.at(test->Name()));
+        }
         state.SortTestListInExecutionOrder(ordered_tests);
     }
 
+    // Sets the current test for this thread.
+    struct StateGuard
+    {
+        data::RunSingleTestResults state;
+        StateGuard() {detail::ThreadState().current_test = &state;}
+        StateGuard(const StateGuard &) = delete;
+        StateGuard &operator=(const StateGuard &) = delete;
+        ~StateGuard() {detail::ThreadState().current_test = nullptr;}
+    };
+
     data::RunTestsResults results;
     results.modules = &module_lists;
     results.num_tests = ordered_tests.size();
     results.num_tests_with_skipped = state.tests.size();
     module_lists.Call<&BasicModule::OnPreRunTests>(results);
 
-    // For every non-skipped test...
-    for (std::size_t test_index : ordered_tests)
+    { // Let the modules reorder the tests.
+        std::vector<double> priorities(state.tests.size());
+        bool any_priorities = false;
+        for (std::size_t i : ordered_tests)
+        {
+            module_lists.Call<&BasicModule::OnScheduleTest>(*state.tests[i], priorities[i]);
+            if (priorities[i] != 0)
+                any_priorities = true;
+        }
+        if (any_priorities)
+            state.SortTestListByPriority(ordered_tests, priorities);
+    }
+
+    // The time spent in the test body.
+    struct TestDuration
+    {
+        std::chrono::nanoseconds wall{};
+        std::chrono::nanoseconds cpu{};
+    };
+
+    // The unscoped log capacity, e.g. from `--log-capacity`.
+    // We choose it once, since the workers call only the copies of the modules.
+    context::LogCapacity log_capacity;
+    module_lists.Call<&BasicModule::OnChooseLogCapacity>(log_capacity);
+
+    // Runs all repetitions of a single test on the current thread. Returns true if any of them failed.
+    // Worker threads and processes pass their own `results` and `module_lists` here, see `WorkerModules` below.
+    // The time spent in the test body is added to `duration`.
+    auto RunTest = [&log_capacity](const detail::BasicTestImpl *test, data::RunTestsResults &results, const ModuleLists &module_lists, TestDuration &duration) -> bool
     {
-        const detail::BasicTestImpl *test = state.tests[test_index];
+        auto &thread_state = detail::ThreadState();
 
         // This stores the generator stack between iterations.
         std::vector<std::unique_ptr<const data::BasicGenerator>> next_generator_stack;
+        // This is cleared on every iteration, we only keep it to reuse the memory.
+        detail::VisitedGeneratorCache next_visited_generator_cache;
+        // Same.
+        context::UnscopedLog next_unscoped_log(log_capacity);
 
         // Whether any of the repetitions have failed.
         bool any_repetition_failed = false;
@@ -2735,40 +3616,44 @@ int ta_test::Runner::Run()
         // Repeat to exhaust all generators...
         do
         {
-            struct StateGuard
-            {
-                data::RunSingleTestResults state;
-                StateGuard() {detail::ThreadState().current_test = &state;}
-                StateGuard(const StateGuard &) = delete;
-                StateGuard &operator=(const StateGuard &) = delete;
-                ~StateGuard() {detail::ThreadState().current_test = nullptr;}
-            };
             StateGuard guard;
             guard.state.all_tests = &results;
             guard.state.test = test;
             guard.state.generator_stack = std::move(next_generator_stack);
             guard.state.is_first_generator_repetition = guard.state.generator_stack.empty();
+            guard.state.visited_generator_cache = std::move(next_visited_generator_cache);
+            guard.state.visited_generator_cache.Clear();
+            guard.state.unscoped_log = std::move(next_unscoped_log);
+            guard.state.unscoped_log.Clear();
 
             module_lists.Call<&BasicModule::OnPreRunSingleTest>(guard.state);
 
             bool should_catch = true;
             module_lists.Call<&BasicModule::OnPreTryCatch>(should_catch);
+            // The assertions in this test reuse this.
+            guard.state.should_catch = should_catch;
+
+            // The previous test's log is gone by now, so its deferred arguments are no longer needed.
+            thread_state.deferred_log_arena.Clear();
 
             // This lambda runs before and after running each test, to make sure the global state is set correctly.
             auto PreAndPostCheck = [&]
             {
-                if (thread_state.assertion_argument_buffers_pos != 0)
-                    HardError("The assertion depth counter should be zero when not running a test.");
-                if (!thread_state.assertion_argument_metadata.empty())
-                    HardError("The assertion argument metadata vector should be empty when not running a test.");
+                if (!thread_state.assertion_argument_arena.IsEmpty())
+                    HardError("The assertion argument arena should be empty when not running a test.");
             };
             PreAndPostCheck();
 
             auto lambda = [&]
             {
+                // Attribute the heap allocations to this repetition, if `CFG_TA_TRACK_ALLOCATIONS` is enabled.
+                detail::AllocationTargetGuard allocation_guard(&guard.state.allocations);
                 test->Run();
             };
 
+            auto start_time = std::chrono::steady_clock::now();
+            auto start_cpu_time = platform::ThreadCpuTime();
+
             if (should_catch)
             {
                 try
@@ -2788,6 +3673,13 @@ int ta_test::Runner::Run()
                 lambda();
             }
 
+            guard.state.repetition_duration = std::chrono::steady_clock::now() - start_time;
+            guard.state.repetition_cpu_duration = platform::ThreadCpuTime() - start_cpu_time;
+            duration.wall += guard.state.repetition_duration;
+            duration.cpu += guard.state.repetition_cpu_duration;
+            guard.state.test_duration = duration.wall;
+            guard.state.test_cpu_duration = duration.cpu;
+
             PreAndPostCheck();
 
             // Check for non-deterministic use of generators.
@@ -2901,1984 +3793,4733 @@ int ta_test::Runner::Run()
                 test->Breakpoint();
 
             next_generator_stack = std::move(guard.state.generator_stack);
+            next_visited_generator_cache = std::move(guard.state.visited_generator_cache);
+            next_unscoped_log = std::move(guard.state.unscoped_log);
         }
         while (!next_generator_stack.empty());
 
-        if (any_repetition_failed)
-            results.failed_tests.push_back(test);
-    }
-
-    module_lists.Call<&BasicModule::OnPostRunTests>(results);
-
-    return results.failed_tests.size() > 0 ? int(ExitCode::test_failed) : results.num_tests == 0 ? int(ExitCode::no_tests_to_run) : 0;
-}
+        return any_repetition_failed;
+    };
 
-void ta_test::Runner::SetOutputStream(FILE *stream) const
-{
-    SetTerminalSettings([&](output::Terminal &terminal)
-    {
-        terminal = output::Terminal(stream);
-    });
-}
+    std::size_t num_jobs = 1;
+    module_lists.Call<&BasicModule::OnChooseNumJobs>(num_jobs);
+    if (num_jobs == 0)
+        num_jobs = std::max(1u, std::thread::hardware_concurrency());
 
-void ta_test::Runner::SetEnableColor(bool enable) const
-{
-    SetTerminalSettings([&](output::Terminal &terminal)
-    {
-        terminal.enable_color = enable;
-    });
-}
+    std::size_t num_processes = 1;
+    module_lists.Call<&BasicModule::OnChooseNumProcesses>(num_processes);
+    if (num_processes == 0)
+        num_processes = std::max(1u, std::thread::hardware_concurrency());
 
-void ta_test::Runner::SetEnableUnicode(bool enable) const
-{
-    for (const auto &m : modules)
-    {
-        if (auto base = dynamic_cast<BasicPrintingModule *>(m.get()))
-            base->EnableUnicode(enable);
-    }
-}
+    #if !DETAIL_TA_USE_FORK
+    if (num_processes > 1)
+        HardError("Running tests in worker processes isn't supported on this platform.", HardErrorKind::user);
+    #endif
 
-void ta_test::Runner::SetTerminalSettings(std::function<void(output::Terminal &terminal)> func) const
-{
-    for (const auto &m : modules)
+    if (num_jobs > 1 || num_processes > 1)
     {
-        if (auto base = dynamic_cast<BasicPrintingModule *>(m.get()))
-            func(base->terminal);
+        // Workers can't break into the debugger or run tests outside of try/catch, so stay on this thread if that's requested.
+        bool should_catch = true;
+        module_lists.Call<&BasicModule::OnPreTryCatch>(should_catch);
+        if (!should_catch)
+        {
+            num_jobs = 1;
+            num_processes = 1;
+        }
     }
-}
 
-// --- modules::BasicExceptionContentsPrinter ---
+    // Worker processes run their tests on a single thread.
+    if (num_processes > 1)
+        num_jobs = 1;
 
-void ta_test::modules::BasicExceptionContentsPrinter::EnableUnicode(bool enable)
-{
-    BasicPrintingModule::EnableUnicode(enable);
+    using ParallelTestRunner = modules::ParallelTestRunner;
 
-    if (enable)
+    // Tests that run on the worker threads or processes.
+    struct ParallelTest
     {
-        // This symbol has a tendency to be rendered with a half-character offset to the right, so we put it slightly to the left.
-        chars_indent_type_active = " \xE2\x96\xB6  "; // U+25B6 BLACK RIGHT-POINTING TRIANGLE
-    }
-    else
+        const detail::BasicTestImpl *test = nullptr;
+        bool split_generators = false;
+
+        // The rest is protected by `mutex`:
+
+        // The events recorded by a single job of this test, see `GeneratorSplitter::part_index`.
+        struct Part
+        {
+            // The main thread takes those as they arrive.
+            std::vector<ParallelTestRunner::WorkerEvent> events;
+            bool finished = false;
+        };
+        // The parts after the first one are added when the first one splits.
+        std::vector<Part> parts = std::vector<Part>(1);
+        // If not empty, the worker process running this test has crashed, and this is the reason.
+        std::string crash_reason;
+    };
+    // Only the outermost generator values can be split between jobs.
+    struct ParallelJob
     {
-        chars_indent_type_active = "  > ";
-    }
-    chars_indent_message_active = chars_indent_type_active + "    ";
-}
+        ParallelTest *test = nullptr;
+        // Which part of the outermost generator values this job runs, see `GeneratorSplitter::part_index`.
+        std::size_t part_index = 0;
+    };
+    // This isn't resized after the worker threads start.
+    std::vector<ParallelTest> parallel_tests;
+    // Whether the test at the same index in `ordered_tests` runs on worker threads.
+    std::vector<bool> is_parallel_test(ordered_tests.size());
 
-ta_test::modules::BasicExceptionContentsPrinter::BasicExceptionContentsPrinter()
-{
-    EnableUnicode(true);
-}
+    std::mutex mutex;
+    // Notified when a job is added to the queue or finishes.
+    std::condition_variable queue_changed;
+    // Notified when the workers add events to a test, or finish a part of it.
+    std::condition_variable test_changed;
+    // The jobs split from a running test are pushed to the front, to finish that test sooner. Protected by `mutex`.
+    std::deque<ParallelJob> job_queue;
+    // How many jobs are currently running. Protected by `mutex`.
+    std::size_t num_running_jobs = 0;
 
-void ta_test::modules::BasicExceptionContentsPrinter::PrintException(
-    const output::Terminal &terminal,
-    output::Terminal::StyleGuard &cur_style,
-    const std::exception_ptr &e,
-    int active_elem,
-    bool only_one_element
-) const
-{
-    int i = 0;
-    AnalyzeException(e, [&](const SingleException &elem)
+    std::vector<std::thread> workers;
+
+    if (num_jobs > 1 || num_processes > 1)
     {
-        bool active = i++ == active_elem && !only_one_element;
-        bool draw_arrows = active;
+        parallel_tests.reserve(ordered_tests.size());
 
-        if (elem.IsTypeKnown())
-        {
-            terminal.Print(cur_style, "{}{}{}{}{}\n{}{}{}{}\n",
-                style_exception_active_marker,
-                draw_arrows ? chars_indent_type_active : chars_indent_type,
-                active ? style_exception_type_active : style_exception_type,
-                elem.GetTypeName(),
-                chars_type_suffix,
-                style_exception_active_marker,
-                draw_arrows ? chars_indent_message_active : chars_indent_message,
-                active ? style_exception_message_active : style_exception_message,
-                string_conv::ToString(elem.message)
-            );
-        }
-        else
+        for (std::size_t i = 0; i < ordered_tests.size(); i++)
         {
-            terminal.Print(cur_style, "{}{}{}{}\n",
-                style_exception_active_marker,
-                draw_arrows ? chars_indent_type_active : chars_indent_type,
-                active ? style_exception_type_active : style_exception_type,
-                chars_unknown_exception
-            );
+            const detail::BasicTestImpl *test = state.tests[ordered_tests[i]];
+            BasicModule::ParallelTestMode mode = BasicModule::ParallelTestMode::worker;
+            module_lists.Call<&BasicModule::OnCheckParallelTest>(*test, mode);
+            if (mode != BasicModule::ParallelTestMode::main_thread)
+            {
+                is_parallel_test[i] = true;
+                ParallelTest &parallel_test = parallel_tests.emplace_back();
+                parallel_test.test = test;
+                // Worker processes don't split generators.
+                parallel_test.split_generators = num_jobs > 1 && mode == BasicModule::ParallelTestMode::worker_split_generators;
+            }
         }
-    });
-}
+    }
 
-// --- modules::HelpPrinter ---
+    // The copies of the modules for a single worker thread or process, see `BasicModule::OnCheckParallelTest()`.
+    // This can't be moved after `InitWorkerModules()`, since it points to itself.
+    struct WorkerModules
+    {
+        std::vector<ModulePtr> modules;
+        ModuleLists module_lists;
+        // The copies of the printing modules print into this.
+        ParallelTestRunner::EventRecorder *recorder = nullptr;
+        // This does nothing unless configured for a specific job.
+        ParallelTestRunner::GeneratorSplitter *splitter = nullptr;
+        // The counters of this worker. The recorder sends the changes in them to the main thread.
+        data::RunTestsResults results;
+    };
 
-ta_test::modules::HelpPrinter::HelpPrinter()
-    : expected_flag_width(17),
-    flag_help("help", 0, "Show usage.", [](const Runner &runner, BasicModule &this_module)
+    // Copies the modules for a worker. The modules that aren't copyable are left out.
+    auto InitWorkerModules = [&](WorkerModules &target)
     {
-        std::vector<flags::BasicFlag *> flags;
-        for (const auto &m : runner.modules) // Can't use `ModuleLists` here yet.
+        ModulePtr recorder = MakeModule<ParallelTestRunner::EventRecorder>();
+        target.recorder = &dynamic_cast<ParallelTestRunner::EventRecorder &>(*recorder);
+
+        // This must be first, to send the text printed before each callback that gets replayed.
+        target.modules.push_back(MakeModule<ParallelTestRunner::EventRecorder::Flusher>());
+        dynamic_cast<ParallelTestRunner::EventRecorder::Flusher &>(*target.modules.back()).recorder = target.recorder;
+
+        for (std::size_t i = 0; i < modules.size(); i++)
         {
-            auto more_flags = m->GetFlags();
-            flags.insert(flags.end(), more_flags.begin(), more_flags.end());
+            ModulePtr copy = modules[i]->Detail_Clone();
+            if (!copy)
+                continue;
+
+            if (auto printing = dynamic_cast<BasicPrintingModule *>(copy.get()))
+            {
+                // We could be in the middle of a muted replay on the main thread.
+                printing->terminal.muted = false;
+                printing->terminal.output_func = [recorder = target.recorder, i](std::string_view fmt, CFG_TA_FMT_NAMESPACE::format_args args)
+                {
+                    recorder->AppendOutput(i, CFG_TA_FMT_NAMESPACE::vformat(fmt, args));
+                };
+            }
+
+            target.modules.push_back(std::move(copy));
         }
 
-        // The case should never fail.
-        HelpPrinter &self = dynamic_cast<HelpPrinter &>(this_module);
+        // After the copies, so that their generator overrides take priority (e.g. from `GeneratorShrinker`).
+        target.modules.push_back(MakeModule<ParallelTestRunner::GeneratorSplitter>());
+        target.splitter = &dynamic_cast<ParallelTestRunner::GeneratorSplitter &>(*target.modules.back());
 
-        self.terminal.Print("This is a test runner using Taut unit test framework.\nAvailable options:\n");
-        for (flags::BasicFlag *flag : flags)
-            self.terminal.Print("  {:<{}} - {}\n", flag->HelpFlagSpelling(), self.expected_flag_width, flag->help_desc);
+        // This must be last, to see the changes made by the other modules in each callback.
+        target.modules.push_back(std::move(recorder));
 
-        std::exit(int(ExitCode::ok));
-    })
-{}
+        target.module_lists = ModuleLists(target.modules);
+        target.results.modules = &target.module_lists;
+        target.results.num_tests = results.num_tests;
+        target.results.num_tests_with_skipped = results.num_tests_with_skipped;
+    };
 
-std::vector<ta_test::flags::BasicFlag *> ta_test::modules::HelpPrinter::GetFlags() noexcept
-{
-    return {&flag_help};
-}
+    // One per worker thread.
+    std::vector<WorkerModules> worker_modules;
 
-void ta_test::modules::HelpPrinter::OnUnknownFlag(std::string_view flag, bool &abort) noexcept
-{
-    (void)abort;
-    terminal.Print("Unknown flag `{}`, run with `{}` for usage.\n", flag, flag_help.HelpFlagSpelling());
-    // Don't exit, rely on `abort`.
-}
+    if (num_jobs > 1)
+    {
+        for (ParallelTest &parallel_test : parallel_tests)
+            job_queue.push_back({.test = &parallel_test, .part_index = 0});
 
-void ta_test::modules::HelpPrinter::OnMissingFlagArgument(std::string_view flag, const flags::BasicFlag &flag_obj, bool &abort) noexcept
-{
-    (void)flag_obj;
-    (void)abort;
-    terminal.Print("Flag `{}` wasn't given enough arguments, run with `{}` for usage.\n", flag, flag_help.HelpFlagSpelling());
-    // Don't exit, rely on `abort`.
-}
+        // A single test can be split into up to `num_jobs` jobs, so then we need all threads even if there are few tests.
+        bool any_split = std::any_of(parallel_tests.begin(), parallel_tests.end(), [](const ParallelTest &test){return test.split_generators;});
 
-// --- modules::TestSelector ---
+        // The modules are copied here, since the main thread will be using the originals.
+        worker_modules = std::vector<WorkerModules>(any_split ? num_jobs : std::min(num_jobs, parallel_tests.size()));
+        for (WorkerModules &this_worker : worker_modules)
+            InitWorkerModules(this_worker);
 
-ta_test::modules::TestSelector::TestSelector()
-    : flag_include("include", 'i',
-        "Enable tests matching a pattern. The pattern must either match the whole test name, or its prefix up to and possibly including a slash. "
-        "The pattern can be a regex. This flag can be repeated multiple times, and the order with respect to `--exclude` matters. "
-        "If the first time this flag appears is before `--exclude`, all tests start disabled by default. "
-        "If the pattern contains `//`, then `--include A//B` acts as a shorthand for `--include A --generate A//B`.",
-        GetFlagCallback(false, false)
-    ),
-    flag_exclude("exclude", 'e',
-        "Disable tests matching a pattern. Uses the same pattern format as `--include`.",
-        GetFlagCallback(true, false)
-    ),
-    flag_force_include("force-include", 'I',
-        "Like `--include`, but can enable tests that were disabled in the source with `disabled` flag.",
-        GetFlagCallback(false, true)
-    )
-{}
+        for (WorkerModules &this_worker : worker_modules)
+        {
+            workers.emplace_back([&, &this_worker = this_worker]
+            {
+                // The events of the current repetition. They're handed to the main thread together, to lock less often.
+                std::vector<ParallelTestRunner::WorkerEvent> pending_events;
 
-std::vector<ta_test::flags::BasicFlag *> ta_test::modules::TestSelector::GetFlags() noexcept
-{
-    return {&flag_include, &flag_exclude, &flag_force_include};
-}
+                while (true)
+                {
+                    ParallelJob job;
 
-void ta_test::modules::TestSelector::OnFilterTest(const data::BasicTest &test, TestFilterState &state) noexcept
-{
-    if (patterns.empty())
-        return;
+                    {
+                        std::unique_lock lock(mutex);
+                        // A running job can split and add more jobs, so we wait for it.
+                        queue_changed.wait(lock, [&]{return !job_queue.empty() || num_running_jobs == 0;});
+                        if (job_queue.empty())
+                            break;
+                        job = job_queue.front();
+                        job_queue.pop_front();
+                        num_running_jobs++;
+                    }
 
-    // Disable by default is the first pattern is `--include`.
-    if (state == TestFilterState::enabled && !patterns.front().exclude)
-        state = TestFilterState::disabled;
+                    ParallelTest &parallel_test = *job.test;
 
-    for (Pattern &pattern : patterns)
-    {
-        if (pattern.exclude == (state != TestFilterState::enabled))
-            continue; // Already enabled or disabled.
+                    auto SendPendingEvents = [&](bool job_finished)
+                    {
+                        {
+                            std::lock_guard lock(mutex);
 
-        if (!pattern.exclude && state == TestFilterState::disabled_in_source && !pattern.force)
-            continue; // Non-force include can't enable tests that were disabled with the `disabled` flag.
+                            ParallelTest::Part &part = parallel_test.parts[job.part_index];
+                            part.events.insert(part.events.end(), std::make_move_iterator(pending_events.begin()), std::make_move_iterator(pending_events.end()));
+                            if (job_finished)
+                            {
+                                part.finished = true;
+                                num_running_jobs--;
+                            }
+                        }
+                        pending_events.clear();
 
-        if (ta_test::text::regex::TestNameMatchesRegex(test.Name(), pattern.regex))
-        {
-            pattern.was_used = true;
-            state = pattern.exclude ? TestFilterState::disabled : TestFilterState::enabled;
+                        if (job_finished)
+                            queue_changed.notify_all();
+                        test_changed.notify_all();
+                    };
+
+                    this_worker.splitter->num_parts = parallel_test.split_generators ? num_jobs : 1;
+                    this_worker.splitter->part_index = job.part_index;
+                    this_worker.splitter->spawn_job = [&](std::size_t part_index)
+                    {
+                        {
+                            std::lock_guard lock(mutex);
+                            if (parallel_test.parts.size() <= part_index)
+                                parallel_test.parts.resize(part_index + 1);
+                            job_queue.push_front({.test = &parallel_test, .part_index = part_index});
+                        }
+                        queue_changed.notify_one();
+                    };
+                    this_worker.recorder->on_event = [&](ParallelTestRunner::WorkerEvent &&event)
+                    {
+                        bool repetition_finished = event.kind == ParallelTestRunner::WorkerEvent::Kind::post_run_single_test;
+                        pending_events.push_back(std::move(event));
+                        if (repetition_finished)
+                            SendPendingEvents(false);
+                    };
+
+                    TestDuration duration;
+                    (void)RunTest(parallel_test.test, this_worker.results, this_worker.module_lists, duration);
+                    this_worker.recorder->FlushOutput();
+
+                    SendPendingEvents(true);
+                }
+            });
         }
     }
-}
 
-void ta_test::modules::TestSelector::OnPreRunTests(const data::RunTestsInfo &data) noexcept
-{
-    (void)data;
+    // If set, we're running tests in worker processes. This receives their events, and gives them the remaining tests.
+    // If `wait` is true, waits until at least something arrives.
+    std::function<void(bool wait)> pump_processes;
 
-    // Make sure all patterns were used.
-    bool fail = false;
-    for (const Pattern &pattern : patterns)
+    #if DETAIL_TA_USE_FORK
+    // Those retry on `EINTR` and on partial reads/writes. They return false on EOF or on failure.
+    auto ReadAll = [](int fd, void *target, std::size_t size) -> bool
     {
-        if (!pattern.was_used)
+        char *ptr = static_cast<char *>(target);
+        while (size > 0)
         {
-            std::fprintf(stderr, "Flag `--%s %s` didn't match any tests.\n", pattern.exclude ? "exclude" : (pattern.force ? "force-include" : "include"), pattern.regex_string.c_str());
-            fail = true;
+            ssize_t n = read(fd, ptr, size);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            ptr += n;
+            size -= std::size_t(n);
         }
-    }
-    if (fail)
-        std::exit(int(ExitCode::no_test_name_match));
-}
+        return true;
+    };
+    auto SendAll = [](int fd, const void *source, std::size_t size) -> bool
+    {
+        const char *ptr = static_cast<const char *>(source);
+        while (size > 0)
+        {
+            // If the other side is dead, we don't want this to kill us with `SIGPIPE`.
+            // Where `MSG_NOSIGNAL` is missing, the sockets have `SO_NOSIGPIPE` instead, see `StartWorker()`.
+            #ifdef MSG_NOSIGNAL
+            ssize_t n = send(fd, ptr, size, MSG_NOSIGNAL);
+            #else
+            ssize_t n = send(fd, ptr, size, 0);
+            #endif
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            ptr += n;
+            size -= std::size_t(n);
+        }
+        return true;
+    };
 
-ta_test::flags::StringFlag::Callback ta_test::modules::TestSelector::GetFlagCallback(bool exclude, bool force)
-{
-    return [exclude, force](const Runner &runner, BasicModule &this_module, std::string_view pattern)
+    // Describes how a process that didn't report back has ended, from its `waitpid()` status.
+    auto DescribeProcessCrash = [](int status) -> std::string
     {
-        TestSelector &self = dynamic_cast<TestSelector &>(this_module); // This cast should never fail.
+        if (WIFSIGNALED(status))
+            return CFG_TA_FMT_NAMESPACE::format("The worker process was killed by signal {} ({}).", WTERMSIG(status), strsignal(WTERMSIG(status)));
+        else if (WIFEXITED(status))
+            return CFG_TA_FMT_NAMESPACE::format("The worker process exited with code {}.", WEXITSTATUS(status));
+        else
+            return "The worker process stopped unexpectedly.";
+    };
 
-        // Check for `//` in the pattern.
-        if (auto sep = pattern.find("//"); sep != std::string::npos)
+    struct WorkerProcess
+    {
+        pid_t pid = -1;
+        // We send test indices (into `parallel_tests`) here, and receive the events back, see `StartWorker()`.
+        int socket = -1;
+        // The test this worker is currently running, if any.
+        ParallelTest *test = nullptr;
+        // The received bytes that don't form a complete message yet.
+        std::string buffer;
+    };
+    std::vector<WorkerProcess> worker_processes;
+
+    auto StartWorker = [&](WorkerProcess &worker)
+    {
+        int sockets[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+            HardError("Unable to create a socket for a worker process.");
+        #ifdef SO_NOSIGPIPE
+        for (int fd : sockets)
         {
-            if (exclude)
-                HardError("Separator `//` can appear only in `--include`, not in `--exclude`.");
+            int enable = 1;
+            (void)setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+        }
+        #endif
 
-            bool found = runner.FindModule<GeneratorOverrider>([&](GeneratorOverrider &overrider)
+        // Otherwise the buffered output would be printed twice.
+        std::fflush(nullptr);
+
+        pid_t pid = fork();
+        if (pid < 0)
+            HardError("Unable to start a worker process.");
+
+        if (pid == 0)
+        {
+            // This is the worker process.
+
+            close(sockets[0]);
+            for (const WorkerProcess &other : worker_processes)
             {
-                overrider.flag_override.callback(runner, overrider, pattern);
-                pattern = pattern.substr(0, sep);
-                return true;
-            });
-            if (!found)
-                HardError("There's no `GeneratorOverrider` module, can't process `//` in `--include`.");
-        }
+                if (other.pid != -1)
+                    close(other.socket);
+            }
 
-        Pattern new_pattern{
-            .exclude = exclude,
-            .force = force,
-            .regex_string = std::string(pattern),
-            .regex = std::regex(new_pattern.regex_string, std::regex_constants::ECMAScript/*the default syntax*/ | std::regex_constants::optimize),
-        };
-        self.patterns.push_back(std::move(new_pattern));
-    };
-}
+            WorkerModules process_modules;
+            InitWorkerModules(process_modules);
+            process_modules.splitter->num_parts = 1;
 
-// --- modules::GeneratorOverrider ---
+            // Each message is a `std::size_t` size, followed by a serialized `WorkerEvent`. The size 0 means that the test has finished.
+            // The events of a repetition are sent together.
+            std::string messages;
+            bool ok = true;
+            auto SendMessages = [&]
+            {
+                // The output of the test itself goes straight to the terminal, so print it before the parent prints what follows it.
+                std::fflush(nullptr);
+                ok = ok && SendAll(sockets[1], messages.data(), messages.size());
+                messages.clear();
+            };
+            process_modules.recorder->on_event = [&](ParallelTestRunner::WorkerEvent &&event)
+            {
+                std::size_t size_offset = messages.size();
+                messages.append(sizeof(std::size_t), '\0');
+                event.Serialize(messages);
+                std::size_t size = messages.size() - size_offset - sizeof(std::size_t);
+                std::memcpy(messages.data() + size_offset, &size, sizeof(size));
+
+                if (event.kind == ParallelTestRunner::WorkerEvent::Kind::post_run_single_test)
+                    SendMessages();
+            };
 
-std::string_view ta_test::modules::GeneratorOverrider::Entry::OriginalArgument() const
-{
-    if (original_argument_storage.empty())
-        return {};
-    else
-        return {original_argument_storage.data(), original_argument_storage.size() - 1};
-}
+            std::size_t test_index = 0;
+            while (ok && ReadAll(sockets[1], &test_index, sizeof(test_index)))
+            {
+                TestDuration duration;
+                (void)RunTest(parallel_tests[test_index].test, process_modules.results, process_modules.module_lists, duration);
+                process_modules.recorder->FlushOutput();
 
-ta_test::modules::GeneratorOverrider::GeneratorOverrider()
-    : flag_override("generate", 'g',
-        "Changes the behavior of `TA_GENERATE(...)`. The argument is a test name regex (as in `--include`), "
-        "followed by `//`, then a comma-separated list of generator overrides, such as `name=value`. See `--help-generate` for a detailed explanation.",
-        [](const Runner &runner, BasicModule &this_module, std::string_view input)
-        {
-            (void)runner;
+                messages.append(sizeof(std::size_t), '\0');
+                SendMessages();
+            }
 
-            auto &self = dynamic_cast<GeneratorOverrider &>(this_module);
+            // Skip the static destructors, they belong to the parent process.
+            std::_Exit(0);
+        }
 
-            Entry &new_entry = self.entries.emplace_back();
+        close(sockets[1]);
+        worker.pid = pid;
+        worker.socket = sockets[0];
+        worker.test = nullptr;
+        worker.buffer.clear();
+    };
 
-            // Copy the input string into a vector, which gives it a persistent address.
-            // The parsed `GeneratorOverrideSeq` will point into it.
-            new_entry.original_argument_storage.reserve(input.size() + 1);
-            new_entry.original_argument_storage.assign(input.data(), input.data() + input.size());
-            new_entry.original_argument_storage.push_back('\0');
+    auto StopWorker = [&](WorkerProcess &worker) -> int
+    {
+        close(worker.socket);
+        int status = 0;
+        while (waitpid(worker.pid, &status, 0) < 0 && errno == EINTR) {}
+        worker.pid = -1;
+        worker.test = nullptr;
+        return status;
+    };
 
-            static constexpr std::string_view separator = "//";
+    std::size_t next_process_test_index = 0;
 
-            auto sep_pos = input.find(separator);
-            if (sep_pos == std::string_view::npos)
+    auto GiveNextTest = [&](WorkerProcess &worker)
+    {
+        if (next_process_test_index >= parallel_tests.size())
+            return;
+        worker.test = &parallel_tests[next_process_test_index];
+        // If this fails, the worker is dead, and we'll see the EOF when reading from it.
+        (void)SendAll(worker.socket, &next_process_test_index, sizeof(next_process_test_index));
+        next_process_test_index++;
+    };
+
+    // Moves the complete messages from `worker.buffer` to its test.
+    auto ReceiveMessages = [&](WorkerProcess &worker)
+    {
+        std::size_t pos = 0;
+        while (worker.test && worker.buffer.size() - pos >= sizeof(std::size_t))
+        {
+            std::size_t size = 0;
+            std::memcpy(&size, worker.buffer.data() + pos, sizeof(size));
+
+            if (size == 0)
             {
-                self.HardErrorInFlag(
-                    "Expected `//` after the test name regex.",
-                    new_entry, new_entry.original_argument_storage.data() + input.size(),
-                    HardErrorKind::user
-                );
+                pos += sizeof(size);
+                worker.test->parts.front().finished = true;
+                worker.test = nullptr;
+                GiveNextTest(worker);
+                continue;
             }
 
-            new_entry.test_regex = std::regex(input.begin(), input.begin() + sep_pos, std::regex_constants::ECMAScript/*the default syntax*/ | std::regex_constants::optimize);
+            if (worker.buffer.size() - pos - sizeof(size) < size)
+                break;
 
+            ParallelTestRunner::WorkerEvent event;
+            if (!event.Deserialize(std::string_view(worker.buffer).substr(pos + sizeof(size), size)))
+                HardError("Received a malformed message from a worker process.");
+            worker.test->parts.front().events.push_back(std::move(event));
+            pos += sizeof(size) + size;
+        }
+        worker.buffer.erase(0, pos);
+    };
 
-            const char *string = new_entry.original_argument_storage.data() + sep_pos + separator.size();
+    std::vector<pollfd> poll_fds;
+    std::vector<char> read_buffer;
 
-            text::chars::SkipWhitespace(string);
+    if (num_processes > 1 && !parallel_tests.empty())
+    {
+        worker_processes.resize(std::min(num_processes, parallel_tests.size()));
+        read_buffer.resize(1 << 16);
 
-            std::string error = self.ParseGeneratorOverrideSeq(new_entry.seq, string, false);
-            if (!error.empty())
-                self.HardErrorInFlag(error, new_entry, string, HardErrorKind::user);
-        }
-    ),
-    flag_local_help("help-generate", 0, CFG_TA_FMT_NAMESPACE::format("Show detailed help about `--{}`.", flag_override.flag),
-        [](const Runner &runner, BasicModule &this_module)
+        for (WorkerProcess &worker : worker_processes)
         {
-            (void)runner;
-            (void)this_module;
-            dynamic_cast<GeneratorOverrider &>(this_module).terminal.Print("{}", &R"(
-The argument of `--generate` is a name regex (as in `--include`), followed by `//`, then a comma-separated list of generator overrides.
-Some examples: (here `x`,`y` are generator names as passed to `TA_GENERATE(name, ...)`)
-* -g 'foo/bar//x=42'         - generate only this value.
-* -g 'foo/bar//x=42,y=43'    - override several generators (the order matters; you can omit some of the generators).
-* -g 'foo/bar//x{=10,=20}'   - several values per generator.
-* -g 'foo/bar//x-=10         - skip specific value.
-* -g 'foo/bar//x#10'         - only generate the value at the specified index (1-based).
-* -g 'foo/bar//x#10..12'     - same, but with a range of indices (inclusive). One of the numbers can be omitted: `..10`, `10..`.
-* -g 'foo/bar//x-#10'        - skip the value at the specific index. This also accepts ranges.
-Multiple operators can be combined:
-* -g 'foo/bar//x{#..10,=42}' - generate only 10 first values, and a custom value `42`.
-Operators are applied left to right. If the first operator is `=` or `#`, all values are disabled by default. But you can reenable them manually:
-* -g 'foo/bar//x{#1..,=42}'  - generate all values, and a custom one.
-Operators `=` and `#` can be followed by a parenthesized list of generator overrides, which are used in place of the remaining string for those values:
-* -g 'foo/bar//x{#1..,#5(y=20)},y=10' - override `y=20` for 5th value of `x`, and `y=10` for all other values of `x`.
-If multiple operators match the same value, parentheses from the last match are used.
-Parentheses apply only to the single preceding operator by default. To apply them to multiple operators, separate the operators with `&` instead of `,`:
-* -g 'foo/bar//x{#1..,#5&=42(y=20)},y=10' - override `y=20` for 5th value of `x` and for a custom value `x=42`, for all other values of `x` use `y=10`.
-More examples:
-* -g 'foo/bar//x{#1..,#5()},y=10' - override `y=10` for all values of `x` except the 5-th one.
-* -g 'foo/bar//x{#1..(y=10),#5}' - same effect as above.
-More than one `--generate` flag can be active in a given test at a time. They run in parallel rather than sequentially, in the sense that each flag maintains
-  its own "instruction pointer". If multiple flags offer the same generator, the latest flag gets preference, and preceding flags skip that generator.
-Some notes:
-* This flag changes the generator semantics slightly, making subsequent calls to the generator lambda happen between the test repetitions, as opposed to
-    when the control flow reaches the `TA_GENERATE(...)` call, to avoid entering the test when all future values are disabled.
-    This shouldn't affect you much, unless you're doing something unusual in the generator callback, or unless you're throwing from it
-    (then the repetition counters will can be slightly off, and trying to catch the resulting `InterruptTestException` stops being possible).
-* Not all types can be deserialized from strings, but index-based operators will always work.
-    We support scalars, strings (with standard escape sequences), containers (as printed by `std::format()`: {...} sets, {a:b, c:d} maps, [...] other containers, and (...) tuples).
-    Custom type support can be added by specializing `ta_test::string_conv::FromStringTraits`.
-* `-=` requires overloaded `==` to work.
-* Values added with `=` have no index, so `#` and `-#` don't affect them.
-)"[1]);
-            std::exit(int(ExitCode::ok));
+            StartWorker(worker);
+            GiveNextTest(worker);
         }
-    )
-{}
 
-std::vector<ta_test::flags::BasicFlag *> ta_test::modules::GeneratorOverrider::GetFlags() noexcept
-{
-    return {&flag_override, &flag_local_help};
-}
+        pump_processes = [&](bool wait)
+        {
+            poll_fds.clear();
+            bool any_running = false;
+            for (const WorkerProcess &worker : worker_processes)
+            {
+                poll_fds.push_back({.fd = worker.test ? worker.socket : -1, .events = POLLIN, .revents = 0});
+                any_running = any_running || worker.test;
+            }
+            if (!any_running)
+                return;
 
-void ta_test::modules::GeneratorOverrider::OnPreRunTests(const data::RunTestsInfo &data) noexcept
-{
-    (void)data;
-    test_state = {};
-}
+            if (poll(poll_fds.data(), nfds_t(poll_fds.size()), wait ? -1 : 0) < 0)
+            {
+                if (errno == EINTR)
+                    return;
+                HardError("Unable to wait for the worker processes.");
+            }
 
-void ta_test::modules::GeneratorOverrider::OnPostRunTests(const data::RunTestsResults &data) noexcept
-{
-    (void)data;
+            for (std::size_t i = 0; i < worker_processes.size(); i++)
+            {
+                if (poll_fds[i].fd == -1 || poll_fds[i].revents == 0)
+                    continue;
 
-    for (const Entry &entry : entries)
+                WorkerProcess &worker = worker_processes[i];
+
+                ssize_t n = read(worker.socket, read_buffer.data(), read_buffer.size());
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n > 0)
+                {
+                    worker.buffer.append(read_buffer.data(), std::size_t(n));
+                    ReceiveMessages(worker);
+                    continue;
+                }
+
+                // The worker died while running the test.
+                ParallelTest &parallel_test = *worker.test;
+                parallel_test.crash_reason = DescribeProcessCrash(StopWorker(worker));
+                parallel_test.parts.front().finished = true;
+
+                if (next_process_test_index < parallel_tests.size())
+                {
+                    StartWorker(worker);
+                    GiveNextTest(worker);
+                }
+            }
+        };
+    }
+    #endif
+
+    // Replays the events that the workers recorded for a test, to the modules on this thread. Returns true if the test failed.
+    // The repetitions are replayed as they arrive, in the same order as if the test ran on this thread,
+    //   except that the split values of the outermost generator are grouped by the job that ran them.
+    auto ReplayParallelTest = [&](ParallelTest &parallel_test) -> bool
     {
-        // Whole flag is unused?
-        if (!entry.was_used)
-            HardErrorInFlag("This regex didn't match any tests.", entry, FlagErrorDetails{}, HardErrorKind::user);
+        using WorkerEvent = ParallelTestRunner::WorkerEvent;
 
-        // Individual generators or rules are unused?
-        FlagErrorDetails errors_unused;
+        bool any_repetition_failed = false;
+        TestDuration duration;
 
-        // Those are index ranges with upper bounds being too high.
-        FlagErrorDetails errors_high_upper_bounds;
-        // The first range in `errors_high_upper_bounds` should only go up to this number.
-        // We only show this for the first range, for simplicity.
-        std::size_t first_upper_bound = 0;
+        // The current repetition, if any.
+        std::optional<StateGuard> guard;
+        // Whether we had any repetitions so far.
+        bool any_repetitions = false;
 
-        auto lambda = [&](auto &lambda, const GeneratorOverrideSeq &seq) -> void
+        // Whether we've muted our terminals, following the copies of the modules.
+        bool muted = false;
+        auto SetMuted = [&](bool mute)
         {
-            for (const GeneratorOverrideSeq::Entry &override_entry : seq.entries)
+            if (muted == mute)
+                return;
+            muted = mute;
+            SetTerminalSettings([&](output::Terminal &terminal){terminal.muted = mute;});
+        };
+
+        std::vector<WorkerEvent> events;
+        std::size_t num_parts = 1;
+        std::string crash_reason;
+
+        for (std::size_t part_index = 0; part_index < num_parts; part_index++)
+        {
+            bool part_finished = false;
+            while (!part_finished)
             {
-                if (!override_entry.was_used)
+                events.clear();
+
                 {
-                    // Whole entry is unused.
-                    errors_unused.elems.push_back({.marker = std::string(override_entry.total_num_characters, '~'), .location = override_entry.generator_name.data()});
+                    std::unique_lock lock(mutex);
+                    while (parallel_test.parts[part_index].events.empty() && !parallel_test.parts[part_index].finished)
+                    {
+                        if (pump_processes)
+                        {
+                            lock.unlock();
+                            pump_processes(true);
+                            lock.lock();
+                        }
+                        else
+                        {
+                            test_changed.wait(lock);
+                        }
+                    }
+
+                    std::swap(events, parallel_test.parts[part_index].events);
+                    part_finished = parallel_test.parts[part_index].finished;
+                    // All parts are added before the first one finishes.
+                    num_parts = parallel_test.parts.size();
+                    crash_reason = parallel_test.crash_reason;
                 }
-                else
+
+                for (WorkerEvent &event : events)
                 {
-                    { // Custom values.
-                        const GeneratorOverrideSeq *last_seq = nullptr;
+                    SetMuted(event.muted);
 
-                        for (const GeneratorOverrideSeq::Entry::CustomValue &value : override_entry.custom_values)
-                        {
-                            if (!value.was_used)
-                            {
-                                errors_unused.elems.push_back({
-                                    .marker = std::string(std::size_t(value.value.data() + value.value.size() - value.operator_character), '~'),
-                                    .location = value.operator_character,
-                                });
-                            }
+                    if (event.kind == WorkerEvent::Kind::output)
+                    {
+                        // The original of the module copy that printed this.
+                        if (auto printing = dynamic_cast<BasicPrintingModule *>(modules[event.module_index].get()))
+                            printing->terminal.Print("{}", event.text);
+                        continue;
+                    }
 
-                            if (value.custom_generator_seq && value.custom_generator_seq.get() != last_seq)
-                            {
-                                lambda(lambda, *value.custom_generator_seq);
-                                last_seq = value.custom_generator_seq.get();
-                            }
-                        }
+                    results.num_checks_total += event.num_checks_total;
+                    results.num_checks_failed += event.num_checks_failed;
+                    results.num_tests_with_repetitions_total += event.num_tests_with_repetitions_total;
+                    results.num_tests_with_repetitions_failed += event.num_tests_with_repetitions_failed;
+
+                    if (event.kind == WorkerEvent::Kind::pre_run_single_test)
+                    {
+                        guard.emplace();
+                        guard->state.all_tests = &results;
+                        guard->state.test = parallel_test.test;
+                        // The other parts continue from the later values of the outermost generator.
+                        guard->state.is_first_generator_repetition = event.is_first_generator_repetition && part_index == 0;
+                        any_repetitions = true;
+                    }
+                    else if (!guard)
+                    {
+                        HardError("A worker has reported an event outside of a test repetition.");
                     }
 
-                    { // Other rules.
-                        const GeneratorOverrideSeq *last_seq = nullptr;
+                    // Update the generator stack, reusing the generators that didn't change.
+                    auto &stack = guard->state.generator_stack;
+                    stack.resize(std::min(stack.size(), event.generator_stack.size()));
+                    for (std::size_t j = 0; j < event.generator_stack.size(); j++)
+                    {
+                        if (j < stack.size() && static_cast<const ParallelTestRunner::RecordedGenerator &>(*stack[j]).snapshot == event.generator_stack[j])
+                            continue;
+                        auto generator = std::make_unique<const ParallelTestRunner::RecordedGenerator>(event.generator_stack[j]);
+                        if (j < stack.size())
+                            stack[j] = std::move(generator);
+                        else
+                            stack.push_back(std::move(generator));
+                    }
+                    guard->state.generator_index = event.generator_index;
 
-                        for (const GeneratorOverrideSeq::Entry::Rule &basic_rule : override_entry.rules)
+                    switch (event.kind)
+                    {
+                      case WorkerEvent::Kind::output:
+                        // Handled above.
+                        break;
+                      case WorkerEvent::Kind::pre_run_single_test:
+                        module_lists.Call<&BasicModule::OnPreRunSingleTest>(guard->state);
+                        break;
+                      case WorkerEvent::Kind::post_generate:
                         {
-                            if (!basic_rule.was_used)
-                            {
-                                std::size_t num_chars = 0;
-
-                                std::visit(meta::Overload{
-                                    [&](const GeneratorOverrideSeq::Entry::RuleRemoveValue &rule)
-                                    {
-                                        num_chars = std::size_t(rule.value.data() + rule.value.size() - basic_rule.operator_character);
-                                    },
-                                    [&](const GeneratorOverrideSeq::Entry::RuleIndex &rule)
-                                    {
-                                        num_chars = rule.total_num_characters;
-                                    },
-                                }, basic_rule.var);
-
-                                errors_unused.elems.push_back({
-                                    .marker = std::string(num_chars, '~'),
-                                    .location = basic_rule.operator_character,
-                                });
-                            }
-                            else
-                            {
-                                // Check the range in the index rules.
-                                if (auto *rule_index = std::get_if<GeneratorOverrideSeq::Entry::RuleIndex>(&basic_rule.var))
-                                {
-                                    if (rule_index->end != std::size_t(-1) && rule_index->max_used_end < rule_index->end)
-                                    {
-                                        if (errors_high_upper_bounds.elems.empty())
-                                            first_upper_bound = rule_index->max_used_end;
-                                        errors_high_upper_bounds.elems.push_back({.marker = "^", .location = rule_index->end_string_location});
-                                    }
-                                }
-                            }
-
-                            if (basic_rule.custom_generator_seq && basic_rule.custom_generator_seq.get() != last_seq)
-                            {
-                                lambda(lambda, *basic_rule.custom_generator_seq);
-                                last_seq = basic_rule.custom_generator_seq.get();
-                            }
+                            data::GeneratorCallInfo callback_data{
+                                .test = &guard->state,
+                                .generator = stack.at(event.generator_index).get(),
+                                .generating_new_value = event.generating_new_value,
+                            };
+                            module_lists.Call<&BasicModule::OnPostGenerate>(callback_data);
                         }
+                        break;
+                      case WorkerEvent::Kind::pre_prune_generator:
+                        module_lists.Call<&BasicModule::OnPrePruneGenerator>(guard->state);
+                        break;
+                      case WorkerEvent::Kind::pre_fail_test:
+                        thread_state.FailCurrentTest();
+                        break;
+                      case WorkerEvent::Kind::post_run_single_test:
+                        duration.wall += event.repetition_duration;
+                        duration.cpu += event.repetition_cpu_duration;
+                        guard->state.failed = event.failed;
+                        guard->state.repetition_duration = event.repetition_duration;
+                        guard->state.repetition_cpu_duration = event.repetition_cpu_duration;
+                        guard->state.test_duration = duration.wall;
+                        guard->state.test_cpu_duration = duration.cpu;
+                        guard->state.allocations = event.allocations;
+                        guard->state.is_last_generator_repetition = event.is_last_generator_repetition && part_index + 1 == num_parts;
+                        if (event.failed)
+                            any_repetition_failed = true;
+                        module_lists.Call<&BasicModule::OnPostRunSingleTest>(guard->state);
+                        guard.reset();
+                        break;
                     }
                 }
             }
-        };
-        lambda(lambda, entry.seq);
+        }
 
-        if (!errors_unused.elems.empty())
-            HardErrorInFlag("Those parts are unused.", entry, errors_unused, HardErrorKind::user);
+        SetMuted(false);
 
-        if (!errors_high_upper_bounds.elems.empty())
+        // The worker process has crashed. Fail the unfinished repetition, or report the crash as a separate one if there's none.
+        if (!crash_reason.empty())
         {
-            HardErrorInFlag(
-                errors_high_upper_bounds.elems.size() == 1
-                ? CFG_TA_FMT_NAMESPACE::format("This upper bound is too large, the max index was {}.", first_upper_bound)
-                : CFG_TA_FMT_NAMESPACE::format("Those upper bounds are too large, e.g. max index for the first one was {}.", first_upper_bound)
-                ,
-                entry, errors_high_upper_bounds, HardErrorKind::user);
+            if (!guard)
+            {
+                guard.emplace();
+                guard->state.all_tests = &results;
+                guard->state.test = parallel_test.test;
+                guard->state.is_first_generator_repetition = !any_repetitions;
+                module_lists.Call<&BasicModule::OnPreRunSingleTest>(guard->state);
+            }
+
+            results.num_tests_with_repetitions_total++;
+            results.num_tests_with_repetitions_failed++;
+
+            thread_state.FailCurrentTest();
+            module_lists.Call<&BasicModule::OnTestProcessCrashed>(guard->state, crash_reason);
+            guard->state.is_last_generator_repetition = true;
+            module_lists.Call<&BasicModule::OnPostRunSingleTest>(guard->state);
+            guard.reset();
+            any_repetition_failed = true;
+        }
+
+        return any_repetition_failed;
+    };
+
+    // For every non-skipped test...
+    for (std::size_t i = 0, parallel_test_index = 0; i < ordered_tests.size(); i++)
+    {
+        const detail::BasicTestImpl *test = state.tests[ordered_tests[i]];
+
+        bool failed = false;
+
+        if (is_parallel_test[i])
+        {
+            failed = ReplayParallelTest(parallel_tests[parallel_test_index++]);
         }
+        else
+        {
+            // Give more tests to the idle worker processes, if any.
+            if (pump_processes)
+                pump_processes(false);
+
+            TestDuration duration;
+            failed = RunTest(test, results, module_lists, duration);
+        }
+
+        if (failed)
+            results.failed_tests.push_back(test);
+    }
+
+    for (std::thread &worker : workers)
+        worker.join();
+
+    #if DETAIL_TA_USE_FORK
+    // Closing the sockets tells the worker processes to exit.
+    for (WorkerProcess &worker : worker_processes)
+    {
+        if (worker.pid != -1)
+            (void)StopWorker(worker);
     }
+    #endif
+
+    module_lists.Call<&BasicModule::OnPostRunTests>(results);
+
+    return results.failed_tests.size() > 0 ? int(ExitCode::test_failed) : results.num_tests == 0 ? int(ExitCode::no_tests_to_run) : 0;
 }
 
-void ta_test::modules::GeneratorOverrider::OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept
+void ta_test::Runner::SetOutputStream(FILE *stream) const
 {
-    if (data.is_last_generator_repetition && test_state)
+    SetTerminalSettings([&](output::Terminal &terminal)
     {
-        test_state = {};
-    }
+        terminal = output::Terminal(stream);
+    });
 }
 
-bool ta_test::modules::GeneratorOverrider::OnRegisterGeneratorOverride(const data::RunSingleTestProgress &test, const data::BasicGenerator &generator) noexcept
+void ta_test::Runner::SetEnableColor(bool enable) const
 {
-    // If we don't have an active `--generate` flag, try to find one.
-    if (!test_state)
+    SetTerminalSettings([&](output::Terminal &terminal)
     {
-        test_state.emplace();
+        terminal.enable_color = enable;
+    });
+}
 
-        for (auto it = entries.rbegin(); it != entries.rend(); ++it)
-        {
-            const Entry &entry = *it;
+void ta_test::Runner::SetEnableUnicode(bool enable) const
+{
+    for (const auto &m : modules)
+    {
+        if (auto base = dynamic_cast<BasicPrintingModule *>(m.get()))
+            base->EnableUnicode(enable);
+    }
+}
 
-            if (text::regex::TestNameMatchesRegex(test.test->Name(), entry.test_regex))
-            {
-                entry.was_used = true;
-                test_state->active_flags.push_back({
-                    .entry = &entry,
-                    .remaining_program = entry.seq.entries,
-                    .elems = {},
-                });
-            }
-        }
+void ta_test::Runner::SetTerminalSettings(std::function<void(output::Terminal &terminal)> func) const
+{
+    for (const auto &m : modules)
+    {
+        if (auto base = dynamic_cast<BasicPrintingModule *>(m.get()))
+            func(base->terminal);
     }
+}
 
-    // If we do have an active `--generate` flag, use it.
-    if (test_state)
+std::optional<std::string> ta_test::output::MakeGeneratorSummary(const data::RunSingleTestProgress &test, std::size_t num_generators, std::size_t max_value_length)
+{
+    std::string ret;
+
+    for (std::size_t i = 0; i < num_generators; i++)
     {
-        bool found = false;
+        const data::BasicGenerator &gen = *test.generator_stack[i];
 
-        for (ActiveFlag &flag : test_state->active_flags)
+        // Print the value as a string.
+        if (gen.ValueConvertibleToString() && gen.ValueConvertibleFromString())
         {
-            if (flag.remaining_program.empty())
-                continue;
-
-            const GeneratorOverrideSeq::Entry &override_entry = flag.remaining_program.front();
+            std::string value = gen.ValueToString();
 
-            if (override_entry.generator_name == generator.Name())
+            if (value.size() <= max_value_length)
             {
-                if (!found)
-                    override_entry.was_used = true; // Only the first flag is marked as used.
+                // Check roundtrip string conversion.
+                value += ','; // Add a separator to make sure `TryFindUnprotectedSeparator` stops right before it.
+                bool roundtrip_ok = false;
+                {
+                    const char *string = value.c_str();
+                    text::chars::TryFindUnprotectedSeparator(string, text::chars::generator_override_separators);
+                    if (string == &value.back())
+                    {
+                        value.pop_back(); // Remove the dummy separator.
+                        string = value.c_str();
+                        std::string error = gen.ValueEqualsToString(string, roundtrip_ok);
+                        if (!error.empty() || string != value.data() + value.size())
+                            roundtrip_ok = false;
+                    }
+                }
 
-                found = true;
-                flag.elems.push_back({.generator_index = test.generator_index, .remaining_program = flag.remaining_program});
+                if (roundtrip_ok)
+                {
+                    if (!ret.empty())
+                        ret += ',';
+
+                    ret += gen.Name();
+                    ret += '=';
+                    ret += value;
+                    continue;
+                }
             }
         }
-        if (found)
-            return true;
+
+        // Print the value index.
+        if (!gen.IsCustomValue())
+        {
+            if (!ret.empty())
+                ret += ',';
+
+            ret += gen.Name();
+            ret += '#';
+            ret += std::to_string(gen.NumGeneratedValues());
+            continue;
+        }
+
+        // Can't print this custom value.
+        return {};
     }
 
-    return false;
+    return ret;
 }
 
-bool ta_test::modules::GeneratorOverrider::OnOverrideGenerator(const data::RunSingleTestProgress &test, data::BasicGenerator &generator) noexcept
+// --- modules::BasicExceptionContentsPrinter ---
+
+void ta_test::modules::BasicExceptionContentsPrinter::EnableUnicode(bool enable)
 {
-    if (!test_state)
-        HardError("A generator override is requested, but we don't have an active state.");
+    BasicPrintingModule::EnableUnicode(enable);
 
-    ActiveFlag *this_flag = nullptr;
-    ActiveFlag::Elem *this_elem = nullptr;
-    for (ActiveFlag &active_flag : test_state->active_flags)
+    if (enable)
     {
-        auto iter = std::partition_point(active_flag.elems.begin(), active_flag.elems.end(), [&](const ActiveFlag::Elem &elem){return elem.generator_index < test.generator_index;});
-        if (iter != active_flag.elems.end() && iter->generator_index == test.generator_index)
-        {
-            if (!this_elem)
-            {
-                // The first match.
-                this_elem = std::to_address(iter);
-                this_flag = &active_flag;
-            }
-            else
-            {
-                // In the remaining matches, we just advance the program counter.
-                if (!active_flag.remaining_program.empty())
-                    active_flag.remaining_program = active_flag.remaining_program.subspan(1);
-            }
-        }
+        // This symbol has a tendency to be rendered with a half-character offset to the right, so we put it slightly to the left.
+        chars_indent_type_active = " \xE2\x96\xB6  "; // U+25B6 BLACK RIGHT-POINTING TRIANGLE
     }
-    if (!this_elem)
-        HardError("A generator override is requested, but the state doesn't contain information about this generator.");
-
-
-    const GeneratorOverrideSeq::Entry &command = this_elem->remaining_program.front();
+    else
+    {
+        chars_indent_type_active = "  > ";
+    }
+    chars_indent_message_active = chars_indent_type_active + "    ";
+}
 
-    const auto default_remaining_program = this_elem->remaining_program.subspan(1);
+ta_test::modules::BasicExceptionContentsPrinter::BasicExceptionContentsPrinter()
+{
+    EnableUnicode(true);
+}
 
-    // Generate the values until one passes the conditions...
-    while (true)
+void ta_test::modules::BasicExceptionContentsPrinter::PrintException(
+    const output::Terminal &terminal,
+    output::Terminal::StyleGuard &cur_style,
+    const std::exception_ptr &e,
+    int active_elem,
+    bool only_one_element
+) const
+{
+    int i = 0;
+    AnalyzeException(e, [&](const SingleException &elem)
     {
-        // A helper to check the result of `ReplaceValueFromString()` or `ValueEqualsToString()`. Raises a hard error on any failure.
-        // `error` is the parsing error, if any, returned from the function being checked.
-        // `string` is string pointer after parsing.
-        // `expected_end` is where we expected the string pointer to be.
-        auto CheckValueParsingResult = [&](std::string_view error, const char *string, const char *expected_end)
-        {
-            if (string > expected_end)
-            {
-                HardErrorInFlag(
-                    "Parsing the value consumed more characters than expected. "
-                    "Expected the parsing to end at (1), but it ended at (2).",
-                    *this_flag->entry, {{
-                        FlagErrorDetails::Elem{.marker = "1^", .location = expected_end - 2},
-                        FlagErrorDetails::Elem{.marker = "^2", .location = string - 1},
-                    }}, HardErrorKind::user
-                );
-            }
-            if (!error.empty())
-                HardErrorInFlag(error, *this_flag->entry, string, HardErrorKind::user);
-            if (string < expected_end)
-            {
-                HardErrorInFlag(
-                    "Junk characters after the value. The values ends at (1), junk ends at (2).",
-                    *this_flag->entry, {{
-                        FlagErrorDetails::Elem{.marker = "1^", .location = string - 2},
-                        FlagErrorDetails::Elem{.marker = "^2", .location = expected_end - 1},
-                    }}, HardErrorKind::user
-                );
-            }
-        };
+        bool active = i++ == active_elem && !only_one_element;
+        bool draw_arrows = active;
 
-        // Reset the remaining program first.
-        this_flag->remaining_program = default_remaining_program;
+        if (elem.IsTypeKnown())
+        {
+            terminal.Print(cur_style, "{}{}{}{}{}\n{}{}{}{}\n",
+                style_exception_active_marker,
+                draw_arrows ? chars_indent_type_active : chars_indent_type,
+                active ? style_exception_type_active : style_exception_type,
+                elem.GetTypeName(),
+                chars_type_suffix,
+                style_exception_active_marker,
+                draw_arrows ? chars_indent_message_active : chars_indent_message,
+                active ? style_exception_message_active : style_exception_message,
+                string_conv::ToString(elem.message)
+            );
+        }
+        else
+        {
+            terminal.Print(cur_style, "{}{}{}{}\n",
+                style_exception_active_marker,
+                draw_arrows ? chars_indent_type_active : chars_indent_type,
+                active ? style_exception_type_active : style_exception_type,
+                chars_unknown_exception
+            );
+        }
+    });
+}
 
-        // Insert the next custom value, if any.
+// --- modules::HelpPrinter ---
 
-        std::size_t rule_index = 0;
-        bool using_custom_value = false;
-        if (this_elem->num_used_custom_values < command.custom_values.size())
+ta_test::modules::HelpPrinter::HelpPrinter()
+    : expected_flag_width(17),
+    flag_help("help", 0, "Show usage.", [](const Runner &runner, BasicModule &this_module)
+    {
+        std::vector<flags::BasicFlag *> flags;
+        for (const auto &m : runner.modules) // Can't use `ModuleLists` here yet.
         {
-            const auto &this_value = command.custom_values[this_elem->num_used_custom_values];
+            auto more_flags = m->GetFlags();
+            flags.insert(flags.end(), more_flags.begin(), more_flags.end());
+        }
 
-            this_value.was_used = true;
+        // The case should never fail.
+        HelpPrinter &self = dynamic_cast<HelpPrinter &>(this_module);
 
-            if (!generator.ValueConvertibleFromString())
-            {
-                HardErrorInFlag(
-                    CFG_TA_FMT_NAMESPACE::format(
-                        "The generated type `{}` can't be deserialized from a string, so `=` can't be used with it. "
-                        "But you can filter certain generated values by their indices using `#`, see `--help-generate` for details.",
-                        generator.TypeName()
-                    ),
-                    *this_flag->entry, this_value.value.data(), HardErrorKind::user
-                );
-            }
+        self.terminal.Print("This is a test runner using Taut unit test framework.\nAvailable options:\n");
+        for (flags::BasicFlag *flag : flags)
+            self.terminal.Print("  {:<{}} - {}\n", flag->HelpFlagSpelling(), self.expected_flag_width, flag->help_desc);
 
-            const char *string = this_value.value.data();
-            std::string error = generator.ReplaceValueFromString(string);
-            CheckValueParsingResult(error, string, this_value.value.data() + this_value.value.size());
+        std::exit(int(ExitCode::ok));
+    })
+{}
 
-            this_elem->num_used_custom_values++;
+std::vector<ta_test::flags::BasicFlag *> ta_test::modules::HelpPrinter::GetFlags() noexcept
+{
+    return {&flag_help};
+}
 
-            using_custom_value = true;
-            rule_index = this_value.next_rule;
+void ta_test::modules::HelpPrinter::OnUnknownFlag(std::string_view flag, bool &abort) noexcept
+{
+    (void)abort;
+    terminal.Print("Unknown flag `{}`, run with `{}` for usage.\n", flag, flag_help.HelpFlagSpelling());
+    // Don't exit, rely on `abort`.
+}
 
-            // Replace the remaining program.
-            if (this_value.custom_generator_seq)
-                this_flag->remaining_program = this_value.custom_generator_seq->entries;
-            else
-                this_flag->remaining_program = default_remaining_program;
-        }
+void ta_test::modules::HelpPrinter::OnMissingFlagArgument(std::string_view flag, const flags::BasicFlag &flag_obj, bool &abort) noexcept
+{
+    (void)flag_obj;
+    (void)abort;
+    terminal.Print("Flag `{}` wasn't given enough arguments, run with `{}` for usage.\n", flag, flag_help.HelpFlagSpelling());
+    // Don't exit, rely on `abort`.
+}
 
-        // Generate the next natural value, if any.
+// --- modules::TestSelector ---
 
-        if (!using_custom_value)
+ta_test::modules::TestSelector::TestSelector()
+    : flag_include("include", 'i',
+        "Enable tests matching a pattern. The pattern must either match the whole test name, or its prefix up to and possibly including a slash. "
+        "The pattern can be a regex. This flag can be repeated multiple times, and the order with respect to `--exclude` matters. "
+        "If the first time this flag appears is before `--exclude`, all tests start disabled by default. "
+        "If the pattern contains `//`, then `--include A//B` acts as a shorthand for `--include A --generate A//B`.",
+        GetFlagCallback(false, false)
+    ),
+    flag_exclude("exclude", 'e',
+        "Disable tests matching a pattern. Uses the same pattern format as `--include`.",
+        GetFlagCallback(true, false)
+    ),
+    flag_force_include("force-include", 'I',
+        "Like `--include`, but can enable tests that were disabled in the source with `disabled` flag.",
+        GetFlagCallback(false, true)
+    )
+{}
+
+std::vector<ta_test::flags::BasicFlag *> ta_test::modules::TestSelector::GetFlags() noexcept
+{
+    return {&flag_include, &flag_exclude, &flag_force_include};
+}
+
+void ta_test::modules::TestSelector::OnFilterTest(const data::BasicTest &test, TestFilterState &state) noexcept
+{
+    if (patterns.empty())
+        return;
+
+    // Disable by default is the first pattern is `--include`.
+    if (state == TestFilterState::enabled && !patterns.front().exclude)
+        state = TestFilterState::disabled;
+
+    for (Pattern &pattern : patterns)
+    {
+        if (pattern.exclude == (state != TestFilterState::enabled))
+            continue; // Already enabled or disabled.
+
+        if (!pattern.exclude && state == TestFilterState::disabled_in_source && !pattern.force)
+            continue; // Non-force include can't enable tests that were disabled with the `disabled` flag.
+
+        if (ta_test::text::regex::TestNameMatchesRegex(test.Name(), pattern.regex))
         {
-            if (generator.IsLastValue())
-                return true; // No more values.
+            pattern.was_used = true;
+            state = pattern.exclude ? TestFilterState::disabled : TestFilterState::enabled;
+        }
+    }
+}
 
-            try
-            {
-                generator.Generate();
-            }
-            catch (InterruptTestException)
-            {
-                return true; // No more values.
-            }
+void ta_test::modules::TestSelector::OnPreRunTests(const data::RunTestsInfo &data) noexcept
+{
+    (void)data;
+
+    // Make sure all patterns were used.
+    bool fail = false;
+    for (const Pattern &pattern : patterns)
+    {
+        if (!pattern.was_used)
+        {
+            std::fprintf(stderr, "Flag `--%s %s` didn't match any tests.\n", pattern.exclude ? "exclude" : (pattern.force ? "force-include" : "include"), pattern.regex_string.c_str());
+            fail = true;
         }
+    }
+    if (fail)
+        std::exit(int(ExitCode::no_test_name_match));
+}
 
-        // Outright reject natural values if they overlap with `=`.
-        // But if the type isn't equality-comparable, just don't do anything.
+ta_test::flags::StringFlag::Callback ta_test::modules::TestSelector::GetFlagCallback(bool exclude, bool force)
+{
+    return [exclude, force](const Runner &runner, BasicModule &this_module, std::string_view pattern)
+    {
+        TestSelector &self = dynamic_cast<TestSelector &>(this_module); // This cast should never fail.
 
-        if (!using_custom_value && generator.ValueEqualityComparableToString())
+        // Check for `//` in the pattern.
+        if (auto sep = pattern.find("//"); sep != std::string::npos)
         {
-            bool skip = false;
-            for (const auto &custom_value : command.custom_values)
+            if (exclude)
+                HardError("Separator `//` can appear only in `--include`, not in `--exclude`.");
+
+            bool found = runner.FindModule<GeneratorOverrider>([&](GeneratorOverrider &overrider)
             {
-                const char *string = custom_value.value.data();
-                bool equal = false;
-                std::string error = generator.ValueEqualsToString(string, equal);
-                CheckValueParsingResult(error, string, custom_value.value.data() + custom_value.value.size());
-                if (equal)
-                {
-                    skip = true;
-                    break;
-                }
-            }
-            if (skip)
-                continue; // Generate the next value.
+                overrider.flag_override.callback(runner, overrider, pattern);
+                pattern = pattern.substr(0, sep);
+                return true;
+            });
+            if (!found)
+                HardError("There's no `GeneratorOverrider` module, can't process `//` in `--include`.");
         }
 
-        // Process the rules.
+        Pattern new_pattern{
+            .exclude = exclude,
+            .force = force,
+            .regex_string = std::string(pattern),
+            .regex = std::regex(new_pattern.regex_string, std::regex_constants::ECMAScript/*the default syntax*/ | std::regex_constants::optimize),
+        };
+        self.patterns.push_back(std::move(new_pattern));
+    };
+}
 
-        bool value_passes = using_custom_value || command.enable_values_by_default;
+// --- modules::TestSharder ---
 
-        for (; rule_index < command.rules.size(); rule_index++)
+ta_test::modules::TestSharder::TestSharder()
+    : flag_shard("shard", '\0',
+        "Run only a part of the tests, to split them between several machines. The argument is `i/n`, where `n` is the number of shards "
+        "and `i` is the 1-based index of this shard. Tests are assigned to shards by hashing their names, so the assignment is stable between runs. "
+        "This only applies to the tests enabled by `--include` and `--exclude`.",
+        [](const Runner &runner, BasicModule &this_module, std::string_view value)
         {
-            const GeneratorOverrideSeq::Entry::Rule &basic_rule = command.rules[rule_index];
+            (void)runner;
+            TestSharder &self = dynamic_cast<TestSharder &>(this_module); // This cast should never fail.
 
-            std::visit(meta::Overload{
-                [&](const GeneratorOverrideSeq::Entry::RuleIndex &rule)
-                {
-                    if (using_custom_value)
-                        return;
+            // Copy to get a null terminator.
+            std::string str(value);
+            const char *cur = str.c_str();
+            std::size_t index = 0;
+            std::size_t count = 0;
 
-                    if (generator.NumGeneratedValues() >= rule.begin + 1 && generator.NumGeneratedValues() - 1 < rule.end)
-                    {
-                        if (value_passes != rule.add)
-                        {
-                            value_passes = rule.add;
+            bool ok = !str.empty() && std::isdigit((unsigned char)*cur);
+            if (ok)
+            {
+                index = string_conv::strto<std::size_t>(cur, &cur, 10);
+                ok = *cur++ == '/' && std::isdigit((unsigned char)*cur);
+            }
+            if (ok)
+            {
+                count = string_conv::strto<std::size_t>(cur, &cur, 10);
+                ok = *cur == '\0' && index >= 1 && index <= count;
+            }
+            if (!ok)
+                HardError(CFG_TA_FMT_NAMESPACE::format("Expected `i/n` after `--shard`, where `1 <= i <= n`, but got `{}`.", value), HardErrorKind::user);
 
-                            basic_rule.was_used = true;
-
-                            // Note, must use `max()` here. Even though the indices are monotonous in each test, the flag can be shared by multiple tests.
-                            rule.max_used_end = std::max(rule.max_used_end, generator.NumGeneratedValues());
-                        }
-
-                        // Replace the remaining program.
-                        if (rule.add)
-                        {
-                            if (basic_rule.custom_generator_seq)
-                            {
-                                if (this_flag->remaining_program.data() != basic_rule.custom_generator_seq->entries.data() ||
-                                    this_flag->remaining_program.size() != basic_rule.custom_generator_seq->entries.size()
-                                )
-                                {
-                                    basic_rule.was_used = true;
-                                    this_flag->remaining_program = basic_rule.custom_generator_seq->entries;
-                                }
-                            }
-                            else
-                            {
-                                if (this_flag->remaining_program.data() != default_remaining_program.data() ||
-                                    this_flag->remaining_program.size() != default_remaining_program.size()
-                                )
-                                {
-                                    basic_rule.was_used = true;
-                                    this_flag->remaining_program = default_remaining_program;
-                                }
-                            }
-                        }
-                    }
-                },
-                [&](const GeneratorOverrideSeq::Entry::RuleRemoveValue &rule)
-                {
-                    if (!generator.ValueConvertibleFromString())
-                    {
-                        HardErrorInFlag(
-                            CFG_TA_FMT_NAMESPACE::format(
-                                "The generated type `{}` can't be deserialized from a string, so `-=` can't be used with it. "
-                                "But you can filter certain generated values by their indices using `-#`, see `--help-generate` for details.",
-                                generator.TypeName()
-                            ),
-                            *this_flag->entry, rule.value.data(), HardErrorKind::user
-                        );
-                    }
-                    if (!generator.ValueEqualityComparableToString())
-                    {
-                        HardErrorInFlag(
-                            CFG_TA_FMT_NAMESPACE::format(
-                                "The generated type `{}` doesn't overload equality comparison, so `-=` can't be used with it. "
-                                "But you can filter certain generated values by their indices using `-#`, see `--help-generate` for details.",
-                                generator.TypeName()
-                            ),
-                            *this_flag->entry, rule.value.data(), HardErrorKind::user
-                        );
-                    }
+            self.shard_index = index - 1;
+            self.num_shards = count;
+        }
+    ),
+    flag_shard_weights("shard-weights", '\0',
+        "A file written by `--timing-db`, to balance `--shard` by time rather than by the number of tests. "
+        "The tests missing from the file are assigned by their name hashes.",
+        [](const Runner &runner, BasicModule &this_module, std::string_view value)
+        {
+            (void)runner;
+            TestSharder &self = dynamic_cast<TestSharder &>(this_module); // This cast should never fail.
+            self.weights_file = value;
+        }
+    )
+{}
 
-                    const char *string = rule.value.data();
-                    bool equal = false;
-                    std::string error = generator.ValueEqualsToString(string, equal);
-                    CheckValueParsingResult(error, string, rule.value.data() + rule.value.size());
+std::vector<ta_test::flags::BasicFlag *> ta_test::modules::TestSharder::GetFlags() noexcept
+{
+    return {&flag_shard, &flag_shard_weights};
+}
 
-                    if (equal && value_passes)
-                    {
-                        basic_rule.was_used = true;
-                        value_passes = false;
-                    }
-                },
-            }, basic_rule.var);
-        }
+void ta_test::modules::TestSharder::OnFilterTestList(std::vector<const data::BasicTest *> &tests) noexcept
+{
+    if (num_shards <= 1)
+        return;
 
-        if (value_passes)
-            return false; // Generate the value.
+    std::map<std::string_view, std::size_t, std::less<>> weighted_shards;
+    if (!weights_file.empty())
+        weighted_shards = LoadWeightedShards(tests);
 
-        // Otherwise try generating the next value.
-    }
+    std::erase_if(tests, [&](const data::BasicTest *test)
+    {
+        std::size_t test_shard = HashTestName(test->Name()) % num_shards;
+        if (auto iter = weighted_shards.find(test->Name()); iter != weighted_shards.end())
+            test_shard = iter->second;
+        return test_shard != shard_index;
+    });
 }
 
-void ta_test::modules::GeneratorOverrider::OnPrePruneGenerator(const data::RunSingleTestProgress &test) noexcept
+std::uint64_t ta_test::modules::TestSharder::HashTestName(std::string_view name)
 {
-    if (test.generator_stack.back()->OverridingModule() == this)
+    // FNV-1a.
+    std::uint64_t ret = 0xcbf29ce484222325;
+    for (char ch : name)
     {
-        if (!test_state)
-            HardError("We're pruning our overridden generator, but have no state for some reason.");
+        ret ^= (unsigned char)ch;
+        ret *= 0x100000001b3;
+    }
+    return ret;
+}
 
-        bool found = false;
-        for (ActiveFlag &active_flag : test_state->active_flags)
-        {
-            if (active_flag.elems.empty() || active_flag.elems.back().generator_index != test.generator_stack.size() - 1)
-                continue;
-            found = true;
+std::map<std::string_view, std::size_t, std::less<>> ta_test::modules::TestSharder::LoadWeightedShards(std::span<const data::BasicTest *const> enabled_tests)
+{
+    TimingDatabase::Entries entries = TimingDatabase::LoadFile(weights_file);
 
-            active_flag.remaining_program = active_flag.elems.back().remaining_program;
-            active_flag.elems.pop_back();
+    std::vector<std::pair<std::string_view, double>> tests;
+    for (const data::BasicTest *test : enabled_tests)
+    {
+        if (auto iter = entries.find(test->Name()); iter != entries.end())
+            tests.emplace_back(test->Name(), iter->second.seconds);
+    }
 
-        }
-        if (!found)
-            HardError("We're pruning our overridden generator, but its index doesn't match what we have.");
+    // Longest first, then by name to make this deterministic.
+    std::sort(tests.begin(), tests.end(), [](const auto &a, const auto &b)
+    {
+        if (a.second != b.second)
+            return a.second > b.second;
+        return a.first < b.first;
+    });
 
+    // Greedily put each test into the least loaded shard.
+    std::vector<double> shard_loads(num_shards);
+    std::map<std::string_view, std::size_t, std::less<>> ret;
+    for (const auto &[name, seconds] : tests)
+    {
+        std::size_t shard = std::size_t(std::min_element(shard_loads.begin(), shard_loads.end()) - shard_loads.begin());
+        shard_loads[shard] += seconds;
+        ret.try_emplace(name, shard);
     }
+    return ret;
 }
 
-std::string ta_test::modules::GeneratorOverrider::ParseGeneratorOverrideSeq(GeneratorOverrideSeq &target, const char *&string, bool is_nested)
-{
-    bool first_generator = true;
+// --- modules::TimingDatabase ---
 
-    // For each generator.
-    while (true)
-    {
-        if (first_generator)
+ta_test::modules::TimingDatabase::TimingDatabase()
+    : flag_timing_db("timing-db", '\0',
+        "A file to remember the test durations and failures between runs. It's read before running the tests and written after. "
+        "This is needed for `--schedule`, and can be passed to `--shard-weights`.",
+        [](const Runner &runner, BasicModule &this_module, std::string_view value)
         {
-            first_generator = false;
+            (void)runner;
+            // The cast should never fail.
+            dynamic_cast<TimingDatabase &>(this_module).file_path = value;
         }
-        else
+    ),
+    flag_schedule("schedule", '\0',
+        "Reorder the tests using the information from `--timing-db`. "
+        "`longest-first` runs the slowest tests first, which reduces the total time with `--jobs` or `--processes`. "
+        "`failed-first` runs the tests that failed last time first. `default` keeps the default order.",
+        [](const Runner &runner, BasicModule &this_module, std::string_view value)
         {
-            if (*string == '\0' || (is_nested && *string == ')'))
-                break;
-
-            text::chars::SkipWhitespace(string);
+            (void)runner;
+            TimingDatabase &self = dynamic_cast<TimingDatabase &>(this_module); // This cast should never fail.
+            if (value == "default")
+                self.schedule = Schedule::none;
+            else if (value == "longest-first")
+                self.schedule = Schedule::longest_first;
+            else if (value == "failed-first")
+                self.schedule = Schedule::failed_first;
+            else
+                HardError(CFG_TA_FMT_NAMESPACE::format("Expected `default`, `longest-first`, or `failed-first` after `--schedule`, but got `{}`.", value), HardErrorKind::user);
+        }
+    )
+{}
 
-            if (*string != ',')
-                return "Expected `,`.";
-            string++;
+std::vector<ta_test::flags::BasicFlag *> ta_test::modules::TimingDatabase::GetFlags() noexcept
+{
+    return {&flag_timing_db, &flag_schedule};
+}
 
-            text::chars::SkipWhitespace(string);
-        }
+void ta_test::modules::TimingDatabase::OnPreRunTests(const data::RunTestsInfo &data) noexcept
+{
+    (void)data;
 
-        GeneratorOverrideSeq::Entry new_entry;
+    if (schedule != Schedule::none && file_path.empty())
+        HardError("`--schedule` needs `--timing-db`.", HardErrorKind::user);
 
-        { // Parse the name.
-            if (!text::chars::IsNonDigitIdentifierCharStrict(*string))
-                return "Expected a generator name.";
+    // It's not an error for the file to not exist yet.
+    if (!file_path.empty() && std::filesystem::exists(file_path))
+        entries = LoadFile(file_path);
+}
 
-            const char *name_begin = string;
+void ta_test::modules::TimingDatabase::OnScheduleTest(const data::BasicTest &test, double &priority) noexcept
+{
+    auto iter = entries.find(test.Name());
+    if (iter == entries.end())
+        return;
 
-            do
-            {
-                string++;
-            }
-            while (text::chars::IsIdentifierCharStrict(*string));
+    switch (schedule)
+    {
+      case Schedule::none:
+        break;
+      case Schedule::longest_first:
+        priority = iter->second.seconds;
+        break;
+      case Schedule::failed_first:
+        priority = double(iter->second.fail_streak);
+        break;
+    }
+}
 
-            new_entry.generator_name = {name_begin, string};
-        }
+void ta_test::modules::TimingDatabase::OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept
+{
+    if (file_path.empty())
+        return;
 
-        bool is_first_rule = true;
-        bool last_rule_is_positive = false;
+    Entry &entry = entries[std::string(data.test->Name())];
+    if (data.is_first_generator_repetition)
+    {
+        entry.num_repetitions = 0;
+        current_test_failed = false;
+    }
 
-        std::shared_ptr<GeneratorOverrideSeq> sub_override;
+    entry.seconds = std::chrono::duration<double>(data.test_duration).count();
+    entry.num_repetitions++;
+    if (data.failed)
+        current_test_failed = true;
 
-        auto ParseRule = [&] CFG_TA_NODISCARD_LAMBDA () -> std::string
-        {
-            auto TrimValue = [](std::string_view value) -> std::string_view
-            {
-                // We only trim the leading whitespace, because `TryFindUnprotectedSeparator()`
-                // automatically rejects trailing whitespace.
-                while (!value.empty() && text::chars::IsWhitespace(value.front()))
-                    value.remove_prefix(1);
-                return value;
-            };
+    if (data.is_last_generator_repetition)
+        entry.fail_streak = current_test_failed ? entry.fail_streak + 1 : 0;
+}
 
-            auto BeginPositiveRule = [&]
-            {
-                if (is_first_rule)
-                    new_entry.enable_values_by_default = false;
-            };
+void ta_test::modules::TimingDatabase::OnPostRunTests(const data::RunTestsResults &data) noexcept
+{
+    (void)data;
 
-            auto BeginNegativeRule = [&] CFG_TA_NODISCARD_LAMBDA () -> std::string
-            {
-                if (is_first_rule)
-                    new_entry.enable_values_by_default = true;
+    if (!file_path.empty())
+        SaveFile(file_path, entries);
+}
 
-                if (sub_override)
-                    return "`&` can't appear before a negative rule, since those can't be followed by `(...)`.";
+ta_test::modules::TimingDatabase::Entries ta_test::modules::TimingDatabase::LoadFile(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+        HardError(CFG_TA_FMT_NAMESPACE::format("Unable to open the timing database `{}`.", path), HardErrorKind::user);
 
-                return "";
-            };
+    Entries ret;
 
-            auto FinishPositiveRule = [&] CFG_TA_NODISCARD_LAMBDA (std::shared_ptr<GeneratorOverrideSeq> &ptr) -> std::string
-            {
-                text::chars::SkipWhitespace(string);
+    std::string line;
+    std::size_t line_number = 0;
+    while (std::getline(file, line))
+    {
+        line_number++;
+        if (line.empty())
+            continue;
 
-                bool is_and = *string == '&';
-                bool is_open = *string == '(';
+        auto Fail = [&]
+        {
+            HardError(CFG_TA_FMT_NAMESPACE::format("In the timing database `{}`, line {}: expected `<seconds> <repetitions> <fail streak> <test name>`.", path, line_number), HardErrorKind::user);
+        };
 
-                if (is_and || is_open)
-                {
-                    if (!sub_override)
-                        sub_override = std::make_shared<GeneratorOverrideSeq>();
-                    ptr = sub_override;
-                }
-                else
-                {
-                    if (sub_override)
-                        return "Expected `&` or `(` after a list of `&`-separated rules.";
-                }
+        Entry entry;
+        const char *cur = line.c_str();
+        const char *end = cur;
 
-                if (is_open)
-                {
-                    string++;
-                    text::chars::SkipWhitespace(string);
+        entry.seconds = string_conv::strto<double>(cur, &end);
+        if (end == cur || *end != ' ' || !(entry.seconds >= 0))
+            Fail();
+        cur = end + 1;
 
-                    if (*string == ')')
-                    {
-                        // Nothing. We allow empty `()`.
-                    }
-                    else
-                    {
-                        std::string error = ParseGeneratorOverrideSeq(*sub_override, string, true);
-                        if (!error.empty())
-                            return error;
-                    }
+        entry.num_repetitions = string_conv::strto<std::size_t>(cur, &end, 10);
+        if (end == cur || *end != ' ')
+            Fail();
+        cur = end + 1;
 
-                    sub_override = nullptr;
+        entry.fail_streak = string_conv::strto<std::size_t>(cur, &end, 10);
+        if (end == cur || *end != ' ')
+            Fail();
+        cur = end + 1;
 
-                    // No need to skip whitespace here, `ParseGeneratorOverrideSeq()` should do it for us.
+        ret.insert_or_assign(std::string(cur), entry);
+    }
 
-                    if (*string != ')')
-                        return "Expected closing `)`.";
-                    string++;
+    return ret;
+}
 
-                    text::chars::SkipWhitespace(string);
-                }
+void ta_test::modules::TimingDatabase::SaveFile(const std::string &path, const Entries &entries)
+{
+    std::ofstream file(path);
+    if (!file)
+        HardError(CFG_TA_FMT_NAMESPACE::format("Unable to write the timing database `{}`.", path), HardErrorKind::user);
 
-                last_rule_is_positive = true;
+    for (const auto &[name, entry] : entries)
+        file << CFG_TA_FMT_NAMESPACE::format("{:.6f} {} {} {}\n", entry.seconds, entry.num_repetitions, entry.fail_streak, name);
 
-                return "";
-            };
+    if (!file)
+        HardError(CFG_TA_FMT_NAMESPACE::format("Unable to write the timing database `{}`.", path), HardErrorKind::user);
+}
 
-            auto FinishNegativeRule = [&] CFG_TA_NODISCARD_LAMBDA () -> std::string
-            {
-                text::chars::SkipWhitespace(string);
+// --- modules::GeneratorOverrider ---
 
-                if (*string == '(')
-                    return "`(...)` can't appear after negative rules.";
-                if (*string == '&')
-                    return "`&` can't appear after a negative rule, since those can't be followed by `(...)`.";;
-
-                last_rule_is_positive = false;
+std::string_view ta_test::modules::GeneratorOverrider::Entry::OriginalArgument() const
+{
+    if (original_argument_storage.empty())
+        return {};
+    else
+        return {original_argument_storage.data(), original_argument_storage.size() - 1};
+}
 
-                return "";
-            };
+ta_test::modules::GeneratorOverrider::GeneratorOverrider()
+    : flag_override("generate", 'g',
+        "Changes the behavior of `TA_GENERATE(...)`. The argument is a test name regex (as in `--include`), "
+        "followed by `//`, then a comma-separated list of generator overrides, such as `name=value`. See `--help-generate` for a detailed explanation.",
+        [](const Runner &runner, BasicModule &this_module, std::string_view input)
+        {
+            (void)runner;
 
-            if (*string == '=')
-            {
-                BeginPositiveRule();
+            auto &self = dynamic_cast<GeneratorOverrider &>(this_module);
 
-                GeneratorOverrideSeq::Entry::CustomValue new_value;
-                new_value.operator_character = string;
-                new_value.next_rule = new_entry.rules.size();
+            Entry &new_entry = self.entries.emplace_back();
 
-                string++;
+            // Copy the input string into a vector, which gives it a persistent address.
+            // The parsed `GeneratorOverrideSeq` will point into it.
+            new_entry.original_argument_storage.reserve(input.size() + 1);
+            new_entry.original_argument_storage.assign(input.data(), input.data() + input.size());
+            new_entry.original_argument_storage.push_back('\0');
 
-                const char *value_begin = string;
-                text::chars::TryFindUnprotectedSeparator(string, text::chars::generator_override_separators);
-                new_value.value = TrimValue({value_begin, string});
-                if (new_value.value.empty())
-                    return "Expected a value.";
+            static constexpr std::string_view separator = "//";
 
-                std::string error = FinishPositiveRule(new_value.custom_generator_seq);
-                if (!error.empty())
-                    return error;
-                new_entry.custom_values.push_back(std::move(new_value));
-            }
-            else if (*string == '-' && string[1] == '=')
+            auto sep_pos = input.find(separator);
+            if (sep_pos == std::string_view::npos)
             {
-                std::string error = BeginNegativeRule();
-                if (!error.empty())
-                    return error;
-
-                GeneratorOverrideSeq::Entry::Rule new_rule;
-                new_rule.operator_character = string;
-
-                string += 2;
-
-                const char *value_begin = string;
-                text::chars::TryFindUnprotectedSeparator(string, text::chars::generator_override_separators);
-
-                auto &value = new_rule.var.emplace<GeneratorOverrideSeq::Entry::RuleRemoveValue>().value;
-                value = TrimValue({value_begin, string});
-                if (value.empty())
-                    return "Expected a value.";
+                self.HardErrorInFlag(
+                    "Expected `//` after the test name regex.",
+                    new_entry, new_entry.original_argument_storage.data() + input.size(),
+                    HardErrorKind::user
+                );
+            }
 
-                new_entry.rules.push_back(std::move(new_rule));
+            new_entry.test_regex = std::regex(input.begin(), input.begin() + sep_pos, std::regex_constants::ECMAScript/*the default syntax*/ | std::regex_constants::optimize);
 
-                error = FinishNegativeRule();
-                if (!error.empty())
-                    return error;
-            }
-            else if (*string == '#' || (*string == '-' && string[1] == '#'))
-            {
-                GeneratorOverrideSeq::Entry::Rule new_rule;
-                GeneratorOverrideSeq::Entry::RuleIndex &new_rule_index = new_rule.var.emplace<GeneratorOverrideSeq::Entry::RuleIndex>();
 
-                new_rule.operator_character = string;
+            const char *string = new_entry.original_argument_storage.data() + sep_pos + separator.size();
 
-                new_rule_index.add = *string == '#';
+            text::chars::SkipWhitespace(string);
 
-                if (new_rule_index.add)
-                {
-                    BeginPositiveRule();
-                    string++;
-                }
-                else
-                {
-                    std::string error = BeginNegativeRule();
-                    if (!error.empty())
-                        return error;
+            std::string error = self.ParseGeneratorOverrideSeq(new_entry.seq, string, false);
+            if (!error.empty())
+                self.HardErrorInFlag(error, new_entry, string, HardErrorKind::user);
+        }
+    ),
+    flag_local_help("help-generate", 0, CFG_TA_FMT_NAMESPACE::format("Show detailed help about `--{}`.", flag_override.flag),
+        [](const Runner &runner, BasicModule &this_module)
+        {
+            (void)runner;
+            (void)this_module;
+            dynamic_cast<GeneratorOverrider &>(this_module).terminal.Print("{}", &R"(
+The argument of `--generate` is a name regex (as in `--include`), followed by `//`, then a comma-separated list of generator overrides.
+Some examples: (here `x`,`y` are generator names as passed to `TA_GENERATE(name, ...)`)
+* -g 'foo/bar//x=42'         - generate only this value.
+* -g 'foo/bar//x=42,y=43'    - override several generators (the order matters; you can omit some of the generators).
+* -g 'foo/bar//x{=10,=20}'   - several values per generator.
+* -g 'foo/bar//x-=10         - skip specific value.
+* -g 'foo/bar//x#10'         - only generate the value at the specified index (1-based).
+* -g 'foo/bar//x#10..12'     - same, but with a range of indices (inclusive). One of the numbers can be omitted: `..10`, `10..`.
+* -g 'foo/bar//x-#10'        - skip the value at the specific index. This also accepts ranges.
+Multiple operators can be combined:
+* -g 'foo/bar//x{#..10,=42}' - generate only 10 first values, and a custom value `42`.
+Operators are applied left to right. If the first operator is `=` or `#`, all values are disabled by default. But you can reenable them manually:
+* -g 'foo/bar//x{#1..,=42}'  - generate all values, and a custom one.
+Operators `=` and `#` can be followed by a parenthesized list of generator overrides, which are used in place of the remaining string for those values:
+* -g 'foo/bar//x{#1..,#5(y=20)},y=10' - override `y=20` for 5th value of `x`, and `y=10` for all other values of `x`.
+If multiple operators match the same value, parentheses from the last match are used.
+Parentheses apply only to the single preceding operator by default. To apply them to multiple operators, separate the operators with `&` instead of `,`:
+* -g 'foo/bar//x{#1..,#5&=42(y=20)},y=10' - override `y=20` for 5th value of `x` and for a custom value `x=42`, for all other values of `x` use `y=10`.
+More examples:
+* -g 'foo/bar//x{#1..,#5()},y=10' - override `y=10` for all values of `x` except the 5-th one.
+* -g 'foo/bar//x{#1..(y=10),#5}' - same effect as above.
+More than one `--generate` flag can be active in a given test at a time. They run in parallel rather than sequentially, in the sense that each flag maintains
+  its own "instruction pointer". If multiple flags offer the same generator, the latest flag gets preference, and preceding flags skip that generator.
+Some notes:
+* This flag changes the generator semantics slightly, making subsequent calls to the generator lambda happen between the test repetitions, as opposed to
+    when the control flow reaches the `TA_GENERATE(...)` call, to avoid entering the test when all future values are disabled.
+    This shouldn't affect you much, unless you're doing something unusual in the generator callback, or unless you're throwing from it
+    (then the repetition counters will can be slightly off, and trying to catch the resulting `InterruptTestException` stops being possible).
+* Not all types can be deserialized from strings, but index-based operators will always work.
+    We support scalars, strings (with standard escape sequences), containers (as printed by `std::format()`: {...} sets, {a:b, c:d} maps, [...] other containers, and (...) tuples).
+    Custom type support can be added by specializing `ta_test::string_conv::FromStringTraits`.
+* `-=` requires overloaded `==` to work.
+* Values added with `=` have no index, so `#` and `-#` don't affect them.
+)"[1]);
+            std::exit(int(ExitCode::ok));
+        }
+    )
+{}
 
-                    string += 2;
-                }
+std::vector<ta_test::flags::BasicFlag *> ta_test::modules::GeneratorOverrider::GetFlags() noexcept
+{
+    return {&flag_override, &flag_local_help};
+}
 
-                text::chars::SkipWhitespace(string);
+void ta_test::modules::GeneratorOverrider::OnPreRunTests(const data::RunTestsInfo &data) noexcept
+{
+    (void)data;
+    test_state = {};
+}
 
-                if (*string != '.' && !text::chars::IsDigit(*string))
-                    return "Expected an integer or `..`.";
+void ta_test::modules::GeneratorOverrider::OnPostRunTests(const data::RunTestsResults &data) noexcept
+{
+    (void)data;
 
-                bool have_first_number = *string != '.';
+    for (const Entry &entry : entries)
+    {
+        // Whole flag is unused?
+        if (!entry.was_used)
+            HardErrorInFlag("This regex didn't match any tests.", entry, FlagErrorDetails{}, HardErrorKind::user);
 
-                auto CheckNumberLimits = [] CFG_TA_NODISCARD_LAMBDA (std::size_t n) -> std::string
-                {
-                    if (n < 1)
-                        return "The index must be 1 or greater.";
-                    if (n == std::size_t(-1))
-                        return "The index must be less than the max value of `size_t`.";
-                    return "";
-                };
+        // Individual generators or rules are unused?
+        FlagErrorDetails errors_unused;
 
-                // Parse the first number, if any.
-                if (have_first_number)
-                {
-                    std::string error = string_conv::FromStringTraits<decltype(new_rule_index.begin)>{}(new_rule_index.begin, string);
-                    if (!error.empty())
-                        return error;
-                    error = CheckNumberLimits(new_rule_index.begin);
-                    if (!error.empty())
-                        return error;
-                    new_rule_index.begin--;
-                }
+        // Those are index ranges with upper bounds being too high.
+        FlagErrorDetails errors_high_upper_bounds;
+        // The first range in `errors_high_upper_bounds` should only go up to this number.
+        // We only show this for the first range, for simplicity.
+        std::size_t first_upper_bound = 0;
 
-                // Check for `..`.
-                if (*string != '.' || string[1] != '.')
+        auto lambda = [&](auto &lambda, const GeneratorOverrideSeq &seq) -> void
+        {
+            for (const GeneratorOverrideSeq::Entry &override_entry : seq.entries)
+            {
+                if (!override_entry.was_used)
                 {
-                    // If we didn't have the first number, we must have `..`.
-                    if (have_first_number)
-                        new_rule_index.end = new_rule_index.begin + 1;
-                    else
-                        return "Expected `..`.";
+                    // Whole entry is unused.
+                    errors_unused.elems.push_back({.marker = std::string(override_entry.total_num_characters, '~'), .location = override_entry.generator_name.data()});
                 }
                 else
                 {
-                    // Skip `..`.
-                    string += 2;
+                    { // Custom values.
+                        const GeneratorOverrideSeq *last_seq = nullptr;
 
-                    // Parse the second number (optional if there was no first number).
-                    if (!have_first_number || text::chars::IsDigit(*string))
-                    {
-                        new_rule_index.end_string_location = string;
+                        for (const GeneratorOverrideSeq::Entry::CustomValue &value : override_entry.custom_values)
+                        {
+                            if (!value.was_used)
+                            {
+                                errors_unused.elems.push_back({
+                                    .marker = std::string(std::size_t(value.value.data() + value.value.size() - value.operator_character), '~'),
+                                    .location = value.operator_character,
+                                });
+                            }
 
-                        std::string error = string_conv::FromStringTraits<decltype(new_rule_index.end)>{}(new_rule_index.end, string);
-                        if (!error.empty())
-                            return error;
-                        error = CheckNumberLimits(new_rule_index.end);
-                        if (!error.empty())
-                            return error;
-                        if (new_rule_index.end < new_rule_index.begin + 1)
-                            return "The second index must be greater or equal to the first one.";
+                            if (value.custom_generator_seq && value.custom_generator_seq.get() != last_seq)
+                            {
+                                lambda(lambda, *value.custom_generator_seq);
+                                last_seq = value.custom_generator_seq.get();
+                            }
+                        }
                     }
-                }
 
-                new_rule_index.total_num_characters = std::size_t(string - new_rule.operator_character);
+                    { // Other rules.
+                        const GeneratorOverrideSeq *last_seq = nullptr;
 
-                std::string error;
-                if (new_rule_index.add)
-                    error = FinishPositiveRule(new_rule.custom_generator_seq);
-                else
-                    error = FinishNegativeRule();
-                if (!error.empty())
-                    return error;
+                        for (const GeneratorOverrideSeq::Entry::Rule &basic_rule : override_entry.rules)
+                        {
+                            if (!basic_rule.was_used)
+                            {
+                                std::size_t num_chars = 0;
 
-                new_entry.rules.push_back(std::move(new_rule));
-            }
-            else
-            {
-                return "Expected one of: `=`, `-=`, `#`, `-#`.";
-            }
+                                std::visit(meta::Overload{
+                                    [&](const GeneratorOverrideSeq::Entry::RuleRemoveValue &rule)
+                                    {
+                                        num_chars = std::size_t(rule.value.data() + rule.value.size() - basic_rule.operator_character);
+                                    },
+                                    [&](const GeneratorOverrideSeq::Entry::RuleIndex &rule)
+                                    {
+                                        num_chars = rule.total_num_characters;
+                                    },
+                                }, basic_rule.var);
 
-            is_first_rule = false;
+                                errors_unused.elems.push_back({
+                                    .marker = std::string(num_chars, '~'),
+                                    .location = basic_rule.operator_character,
+                                });
+                            }
+                            else
+                            {
+                                // Check the range in the index rules.
+                                if (auto *rule_index = std::get_if<GeneratorOverrideSeq::Entry::RuleIndex>(&basic_rule.var))
+                                {
+                                    if (rule_index->end != std::size_t(-1) && rule_index->max_used_end < rule_index->end)
+                                    {
+                                        if (errors_high_upper_bounds.elems.empty())
+                                            first_upper_bound = rule_index->max_used_end;
+                                        errors_high_upper_bounds.elems.push_back({.marker = "^", .location = rule_index->end_string_location});
+                                    }
+                                }
+                            }
 
-            return "";
+                            if (basic_rule.custom_generator_seq && basic_rule.custom_generator_seq.get() != last_seq)
+                            {
+                                lambda(lambda, *basic_rule.custom_generator_seq);
+                                last_seq = basic_rule.custom_generator_seq.get();
+                            }
+                        }
+                    }
+                }
+            }
         };
+        lambda(lambda, entry.seq);
 
-        text::chars::SkipWhitespace(string);
+        if (!errors_unused.elems.empty())
+            HardErrorInFlag("Those parts are unused.", entry, errors_unused, HardErrorKind::user);
 
-        // Parse the rules.
+        if (!errors_high_upper_bounds.elems.empty())
+        {
+            HardErrorInFlag(
+                errors_high_upper_bounds.elems.size() == 1
+                ? CFG_TA_FMT_NAMESPACE::format("This upper bound is too large, the max index was {}.", first_upper_bound)
+                : CFG_TA_FMT_NAMESPACE::format("Those upper bounds are too large, e.g. max index for the first one was {}.", first_upper_bound)
+                ,
+                entry, errors_high_upper_bounds, HardErrorKind::user);
+        }
+    }
+}
 
-        if (*string == '{')
+void ta_test::modules::GeneratorOverrider::OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept
+{
+    if (data.is_last_generator_repetition && test_state)
+    {
+        test_state = {};
+    }
+}
+
+bool ta_test::modules::GeneratorOverrider::OnRegisterGeneratorOverride(const data::RunSingleTestProgress &test, const data::BasicGenerator &generator) noexcept
+{
+    // If we don't have an active `--generate` flag, try to find one.
+    if (!test_state)
+    {
+        test_state.emplace();
+
+        for (auto it = entries.rbegin(); it != entries.rend(); ++it)
         {
-            string++;
+            const Entry &entry = *it;
 
-            text::chars::SkipWhitespace(string);
+            if (text::regex::TestNameMatchesRegex(test.test->Name(), entry.test_regex))
+            {
+                entry.was_used = true;
+                test_state->active_flags.push_back({
+                    .entry = &entry,
+                    .remaining_program = entry.seq.entries,
+                    .elems = {},
+                });
+            }
+        }
+    }
 
-            while (true)
+    // If we do have an active `--generate` flag, use it.
+    if (test_state)
+    {
+        bool found = false;
+
+        for (ActiveFlag &flag : test_state->active_flags)
+        {
+            if (flag.remaining_program.empty())
+                continue;
+
+            const GeneratorOverrideSeq::Entry &override_entry = flag.remaining_program.front();
+
+            if (override_entry.generator_name == generator.Name())
             {
-                if (!is_first_rule)
-                {
-                    if (*string == '}')
-                    {
-                        string++;
-                        break;
-                    }
+                if (!found)
+                    override_entry.was_used = true; // Only the first flag is marked as used.
 
-                    if (last_rule_is_positive)
-                    {
-                        if (*string != ',' && *string != '&' && *string != '&')
-                            return "Expected `,` or `&` or `(`.";
-                    }
-                    else
-                    {
-                        if (*string != ',')
-                            return "Expected `,`.";
-                    }
-                    string++;
+                found = true;
+                flag.elems.push_back({.generator_index = test.generator_index, .remaining_program = flag.remaining_program});
+            }
+        }
+        if (found)
+            return true;
+    }
 
-                    text::chars::SkipWhitespace(string);
-                }
+    return false;
+}
 
-                // This skips the trailing whitespace.
-                std::string error = ParseRule();
-                if (!error.empty())
-                    return error;
+bool ta_test::modules::GeneratorOverrider::OnOverrideGenerator(const data::RunSingleTestProgress &test, data::BasicGenerator &generator) noexcept
+{
+    if (!test_state)
+        HardError("A generator override is requested, but we don't have an active state.");
+
+    ActiveFlag *this_flag = nullptr;
+    ActiveFlag::Elem *this_elem = nullptr;
+    for (ActiveFlag &active_flag : test_state->active_flags)
+    {
+        auto iter = std::partition_point(active_flag.elems.begin(), active_flag.elems.end(), [&](const ActiveFlag::Elem &elem){return elem.generator_index < test.generator_index;});
+        if (iter != active_flag.elems.end() && iter->generator_index == test.generator_index)
+        {
+            if (!this_elem)
+            {
+                // The first match.
+                this_elem = std::to_address(iter);
+                this_flag = &active_flag;
+            }
+            else
+            {
+                // In the remaining matches, we just advance the program counter.
+                if (!active_flag.remaining_program.empty())
+                    active_flag.remaining_program = active_flag.remaining_program.subspan(1);
             }
         }
-        else
+    }
+    if (!this_elem)
+        HardError("A generator override is requested, but the state doesn't contain information about this generator.");
+
+
+    const GeneratorOverrideSeq::Entry &command = this_elem->remaining_program.front();
+
+    const auto default_remaining_program = this_elem->remaining_program.subspan(1);
+
+    // Generate the values until one passes the conditions...
+    while (true)
+    {
+        // A helper to check the result of `ReplaceValueFromString()` or `ValueEqualsToString()`. Raises a hard error on any failure.
+        // `error` is the parsing error, if any, returned from the function being checked.
+        // `string` is string pointer after parsing.
+        // `expected_end` is where we expected the string pointer to be.
+        auto CheckValueParsingResult = [&](std::string_view error, const char *string, const char *expected_end)
         {
-            std::string error = ParseRule();
+            if (string > expected_end)
+            {
+                HardErrorInFlag(
+                    "Parsing the value consumed more characters than expected. "
+                    "Expected the parsing to end at (1), but it ended at (2).",
+                    *this_flag->entry, {{
+                        FlagErrorDetails::Elem{.marker = "1^", .location = expected_end - 2},
+                        FlagErrorDetails::Elem{.marker = "^2", .location = string - 1},
+                    }}, HardErrorKind::user
+                );
+            }
             if (!error.empty())
-                return error;
+                HardErrorInFlag(error, *this_flag->entry, string, HardErrorKind::user);
+            if (string < expected_end)
+            {
+                HardErrorInFlag(
+                    "Junk characters after the value. The values ends at (1), junk ends at (2).",
+                    *this_flag->entry, {{
+                        FlagErrorDetails::Elem{.marker = "1^", .location = string - 2},
+                        FlagErrorDetails::Elem{.marker = "^2", .location = expected_end - 1},
+                    }}, HardErrorKind::user
+                );
+            }
+        };
+
+        // Reset the remaining program first.
+        this_flag->remaining_program = default_remaining_program;
+
+        // Insert the next custom value, if any.
+
+        std::size_t rule_index = 0;
+        bool using_custom_value = false;
+        if (this_elem->num_used_custom_values < command.custom_values.size())
+        {
+            const auto &this_value = command.custom_values[this_elem->num_used_custom_values];
+
+            this_value.was_used = true;
+
+            if (!generator.ValueConvertibleFromString())
+            {
+                HardErrorInFlag(
+                    CFG_TA_FMT_NAMESPACE::format(
+                        "The generated type `{}` can't be deserialized from a string, so `=` can't be used with it. "
+                        "But you can filter certain generated values by their indices using `#`, see `--help-generate` for details.",
+                        generator.TypeName()
+                    ),
+                    *this_flag->entry, this_value.value.data(), HardErrorKind::user
+                );
+            }
+
+            const char *string = this_value.value.data();
+            std::string error = generator.ReplaceValueFromString(string);
+            CheckValueParsingResult(error, string, this_value.value.data() + this_value.value.size());
+
+            this_elem->num_used_custom_values++;
+
+            using_custom_value = true;
+            rule_index = this_value.next_rule;
+
+            // Replace the remaining program.
+            if (this_value.custom_generator_seq)
+                this_flag->remaining_program = this_value.custom_generator_seq->entries;
+            else
+                this_flag->remaining_program = default_remaining_program;
         }
 
-        // Figure out the total generator length in characters.
-        new_entry.total_num_characters = std::size_t(string - new_entry.generator_name.data());
-        while (new_entry.total_num_characters > 0 && text::chars::IsWhitespace(new_entry.generator_name.data()[new_entry.total_num_characters-1]))
-            new_entry.total_num_characters--;
+        // Generate the next natural value, if any.
+
+        if (!using_custom_value)
+        {
+            if (generator.IsLastValue())
+                return true; // No more values.
+
+            // If the generator supports random access, jump straight to the next index that can be enabled by a rule.
+            // We only do this when nothing is enabled by default and all rules are index rules, then the skipped values
+            //   don't match any positive rules, and wouldn't affect any of the bookkeeping below.
+            std::optional<std::size_t> jump_to_index;
+            if (generator.CanGenerateAt() && !command.enable_values_by_default &&
+                std::all_of(command.rules.begin(), command.rules.end(), [](const GeneratorOverrideSeq::Entry::Rule &rule){return std::holds_alternative<GeneratorOverrideSeq::Entry::RuleIndex>(rule.var);})
+            )
+            {
+                const std::size_t next_index = generator.NumGeneratedValues();
+                std::size_t target = std::size_t(-1);
+                for (const GeneratorOverrideSeq::Entry::Rule &basic_rule : command.rules)
+                {
+                    const auto &rule = std::get<GeneratorOverrideSeq::Entry::RuleIndex>(basic_rule.var);
+                    if (rule.add && rule.end > next_index)
+                        target = std::min(target, std::max(rule.begin, next_index));
+                }
+
+                if (target >= generator.NumValuesIfKnown().value())
+                    return true; // No more values.
+                jump_to_index = target;
+            }
+
+            try
+            {
+                if (jump_to_index)
+                    generator.GenerateAt(*jump_to_index);
+                else
+                    generator.Generate();
+            }
+            catch (InterruptTestException)
+            {
+                return true; // No more values.
+            }
+        }
+
+        // Outright reject natural values if they overlap with `=`.
+        // But if the type isn't equality-comparable, just don't do anything.
+
+        if (!using_custom_value && generator.ValueEqualityComparableToString())
+        {
+            bool skip = false;
+            for (const auto &custom_value : command.custom_values)
+            {
+                const char *string = custom_value.value.data();
+                bool equal = false;
+                std::string error = generator.ValueEqualsToString(string, equal);
+                CheckValueParsingResult(error, string, custom_value.value.data() + custom_value.value.size());
+                if (equal)
+                {
+                    skip = true;
+                    break;
+                }
+            }
+            if (skip)
+                continue; // Generate the next value.
+        }
+
+        // Process the rules.
+
+        bool value_passes = using_custom_value || command.enable_values_by_default;
+
+        for (; rule_index < command.rules.size(); rule_index++)
+        {
+            const GeneratorOverrideSeq::Entry::Rule &basic_rule = command.rules[rule_index];
+
+            std::visit(meta::Overload{
+                [&](const GeneratorOverrideSeq::Entry::RuleIndex &rule)
+                {
+                    if (using_custom_value)
+                        return;
+
+                    if (generator.NumGeneratedValues() >= rule.begin + 1 && generator.NumGeneratedValues() - 1 < rule.end)
+                    {
+                        if (value_passes != rule.add)
+                        {
+                            value_passes = rule.add;
+
+                            basic_rule.was_used = true;
+
+                            // Note, must use `max()` here. Even though the indices are monotonous in each test, the flag can be shared by multiple tests.
+                            rule.max_used_end = std::max(rule.max_used_end, generator.NumGeneratedValues());
+                        }
+
+                        // Replace the remaining program.
+                        if (rule.add)
+                        {
+                            if (basic_rule.custom_generator_seq)
+                            {
+                                if (this_flag->remaining_program.data() != basic_rule.custom_generator_seq->entries.data() ||
+                                    this_flag->remaining_program.size() != basic_rule.custom_generator_seq->entries.size()
+                                )
+                                {
+                                    basic_rule.was_used = true;
+                                    this_flag->remaining_program = basic_rule.custom_generator_seq->entries;
+                                }
+                            }
+                            else
+                            {
+                                if (this_flag->remaining_program.data() != default_remaining_program.data() ||
+                                    this_flag->remaining_program.size() != default_remaining_program.size()
+                                )
+                                {
+                                    basic_rule.was_used = true;
+                                    this_flag->remaining_program = default_remaining_program;
+                                }
+                            }
+                        }
+                    }
+                },
+                [&](const GeneratorOverrideSeq::Entry::RuleRemoveValue &rule)
+                {
+                    if (!generator.ValueConvertibleFromString())
+                    {
+                        HardErrorInFlag(
+                            CFG_TA_FMT_NAMESPACE::format(
+                                "The generated type `{}` can't be deserialized from a string, so `-=` can't be used with it. "
+                                "But you can filter certain generated values by their indices using `-#`, see `--help-generate` for details.",
+                                generator.TypeName()
+                            ),
+                            *this_flag->entry, rule.value.data(), HardErrorKind::user
+                        );
+                    }
+                    if (!generator.ValueEqualityComparableToString())
+                    {
+                        HardErrorInFlag(
+                            CFG_TA_FMT_NAMESPACE::format(
+                                "The generated type `{}` doesn't overload equality comparison, so `-=` can't be used with it. "
+                                "But you can filter certain generated values by their indices using `-#`, see `--help-generate` for details.",
+                                generator.TypeName()
+                            ),
+                            *this_flag->entry, rule.value.data(), HardErrorKind::user
+                        );
+                    }
+
+                    const char *string = rule.value.data();
+                    bool equal = false;
+                    std::string error = generator.ValueEqualsToString(string, equal);
+                    CheckValueParsingResult(error, string, rule.value.data() + rule.value.size());
+
+                    if (equal && value_passes)
+                    {
+                        basic_rule.was_used = true;
+                        value_passes = false;
+                    }
+                },
+            }, basic_rule.var);
+        }
+
+        if (value_passes)
+            return false; // Generate the value.
+
+        // Otherwise try generating the next value.
+    }
+}
+
+void ta_test::modules::GeneratorOverrider::OnPrePruneGenerator(const data::RunSingleTestProgress &test) noexcept
+{
+    if (test.generator_stack.back()->OverridingModule() == this)
+    {
+        if (!test_state)
+            HardError("We're pruning our overridden generator, but have no state for some reason.");
+
+        bool found = false;
+        for (ActiveFlag &active_flag : test_state->active_flags)
+        {
+            if (active_flag.elems.empty() || active_flag.elems.back().generator_index != test.generator_stack.size() - 1)
+                continue;
+            found = true;
+
+            active_flag.remaining_program = active_flag.elems.back().remaining_program;
+            active_flag.elems.pop_back();
+
+        }
+        if (!found)
+            HardError("We're pruning our overridden generator, but its index doesn't match what we have.");
+
+    }
+}
+
+void ta_test::modules::GeneratorOverrider::OnCheckParallelTest(const data::BasicTest &test, ParallelTestMode &mode) noexcept
+{
+    // We need to see the generators as they're created, so the tests we're overriding must run on the main thread.
+    for (const Entry &entry : entries)
+    {
+        if (text::regex::TestNameMatchesRegex(test.Name(), entry.test_regex))
+        {
+            mode = ParallelTestMode::main_thread;
+            return;
+        }
+    }
+}
+
+std::string ta_test::modules::GeneratorOverrider::ParseGeneratorOverrideSeq(GeneratorOverrideSeq &target, const char *&string, bool is_nested)
+{
+    bool first_generator = true;
+
+    // For each generator.
+    while (true)
+    {
+        if (first_generator)
+        {
+            first_generator = false;
+        }
+        else
+        {
+            if (*string == '\0' || (is_nested && *string == ')'))
+                break;
+
+            text::chars::SkipWhitespace(string);
+
+            if (*string != ',')
+                return "Expected `,`.";
+            string++;
+
+            text::chars::SkipWhitespace(string);
+        }
+
+        GeneratorOverrideSeq::Entry new_entry;
+
+        { // Parse the name.
+            if (!text::chars::IsNonDigitIdentifierCharStrict(*string))
+                return "Expected a generator name.";
+
+            const char *name_begin = string;
+
+            do
+            {
+                string++;
+            }
+            while (text::chars::IsIdentifierCharStrict(*string));
+
+            new_entry.generator_name = {name_begin, string};
+        }
+
+        bool is_first_rule = true;
+        bool last_rule_is_positive = false;
+
+        std::shared_ptr<GeneratorOverrideSeq> sub_override;
+
+        auto ParseRule = [&] CFG_TA_NODISCARD_LAMBDA () -> std::string
+        {
+            auto TrimValue = [](std::string_view value) -> std::string_view
+            {
+                // We only trim the leading whitespace, because `TryFindUnprotectedSeparator()`
+                // automatically rejects trailing whitespace.
+                while (!value.empty() && text::chars::IsWhitespace(value.front()))
+                    value.remove_prefix(1);
+                return value;
+            };
+
+            auto BeginPositiveRule = [&]
+            {
+                if (is_first_rule)
+                    new_entry.enable_values_by_default = false;
+            };
+
+            auto BeginNegativeRule = [&] CFG_TA_NODISCARD_LAMBDA () -> std::string
+            {
+                if (is_first_rule)
+                    new_entry.enable_values_by_default = true;
+
+                if (sub_override)
+                    return "`&` can't appear before a negative rule, since those can't be followed by `(...)`.";
+
+                return "";
+            };
+
+            auto FinishPositiveRule = [&] CFG_TA_NODISCARD_LAMBDA (std::shared_ptr<GeneratorOverrideSeq> &ptr) -> std::string
+            {
+                text::chars::SkipWhitespace(string);
+
+                bool is_and = *string == '&';
+                bool is_open = *string == '(';
+
+                if (is_and || is_open)
+                {
+                    if (!sub_override)
+                        sub_override = std::make_shared<GeneratorOverrideSeq>();
+                    ptr = sub_override;
+                }
+                else
+                {
+                    if (sub_override)
+                        return "Expected `&` or `(` after a list of `&`-separated rules.";
+                }
+
+                if (is_open)
+                {
+                    string++;
+                    text::chars::SkipWhitespace(string);
+
+                    if (*string == ')')
+                    {
+                        // Nothing. We allow empty `()`.
+                    }
+                    else
+                    {
+                        std::string error = ParseGeneratorOverrideSeq(*sub_override, string, true);
+                        if (!error.empty())
+                            return error;
+                    }
+
+                    sub_override = nullptr;
+
+                    // No need to skip whitespace here, `ParseGeneratorOverrideSeq()` should do it for us.
+
+                    if (*string != ')')
+                        return "Expected closing `)`.";
+                    string++;
+
+                    text::chars::SkipWhitespace(string);
+                }
+
+                last_rule_is_positive = true;
+
+                return "";
+            };
+
+            auto FinishNegativeRule = [&] CFG_TA_NODISCARD_LAMBDA () -> std::string
+            {
+                text::chars::SkipWhitespace(string);
+
+                if (*string == '(')
+                    return "`(...)` can't appear after negative rules.";
+                if (*string == '&')
+                    return "`&` can't appear after a negative rule, since those can't be followed by `(...)`.";;
+
+                last_rule_is_positive = false;
+
+                return "";
+            };
+
+            if (*string == '=')
+            {
+                BeginPositiveRule();
+
+                GeneratorOverrideSeq::Entry::CustomValue new_value;
+                new_value.operator_character = string;
+                new_value.next_rule = new_entry.rules.size();
+
+                string++;
+
+                const char *value_begin = string;
+                text::chars::TryFindUnprotectedSeparator(string, text::chars::generator_override_separators);
+                new_value.value = TrimValue({value_begin, string});
+                if (new_value.value.empty())
+                    return "Expected a value.";
+
+                std::string error = FinishPositiveRule(new_value.custom_generator_seq);
+                if (!error.empty())
+                    return error;
+                new_entry.custom_values.push_back(std::move(new_value));
+            }
+            else if (*string == '-' && string[1] == '=')
+            {
+                std::string error = BeginNegativeRule();
+                if (!error.empty())
+                    return error;
+
+                GeneratorOverrideSeq::Entry::Rule new_rule;
+                new_rule.operator_character = string;
+
+                string += 2;
+
+                const char *value_begin = string;
+                text::chars::TryFindUnprotectedSeparator(string, text::chars::generator_override_separators);
+
+                auto &value = new_rule.var.emplace<GeneratorOverrideSeq::Entry::RuleRemoveValue>().value;
+                value = TrimValue({value_begin, string});
+                if (value.empty())
+                    return "Expected a value.";
+
+                new_entry.rules.push_back(std::move(new_rule));
+
+                error = FinishNegativeRule();
+                if (!error.empty())
+                    return error;
+            }
+            else if (*string == '#' || (*string == '-' && string[1] == '#'))
+            {
+                GeneratorOverrideSeq::Entry::Rule new_rule;
+                GeneratorOverrideSeq::Entry::RuleIndex &new_rule_index = new_rule.var.emplace<GeneratorOverrideSeq::Entry::RuleIndex>();
+
+                new_rule.operator_character = string;
+
+                new_rule_index.add = *string == '#';
+
+                if (new_rule_index.add)
+                {
+                    BeginPositiveRule();
+                    string++;
+                }
+                else
+                {
+                    std::string error = BeginNegativeRule();
+                    if (!error.empty())
+                        return error;
+
+                    string += 2;
+                }
+
+                text::chars::SkipWhitespace(string);
+
+                if (*string != '.' && !text::chars::IsDigit(*string))
+                    return "Expected an integer or `..`.";
+
+                bool have_first_number = *string != '.';
+
+                auto CheckNumberLimits = [] CFG_TA_NODISCARD_LAMBDA (std::size_t n) -> std::string
+                {
+                    if (n < 1)
+                        return "The index must be 1 or greater.";
+                    if (n == std::size_t(-1))
+                        return "The index must be less than the max value of `size_t`.";
+                    return "";
+                };
+
+                // Parse the first number, if any.
+                if (have_first_number)
+                {
+                    std::string error = string_conv::FromStringTraits<decltype(new_rule_index.begin)>{}(new_rule_index.begin, string);
+                    if (!error.empty())
+                        return error;
+                    error = CheckNumberLimits(new_rule_index.begin);
+                    if (!error.empty())
+                        return error;
+                    new_rule_index.begin--;
+                }
+
+                // Check for `..`.
+                if (*string != '.' || string[1] != '.')
+                {
+                    // If we didn't have the first number, we must have `..`.
+                    if (have_first_number)
+                        new_rule_index.end = new_rule_index.begin + 1;
+                    else
+                        return "Expected `..`.";
+                }
+                else
+                {
+                    // Skip `..`.
+                    string += 2;
+
+                    // Parse the second number (optional if there was no first number).
+                    if (!have_first_number || text::chars::IsDigit(*string))
+                    {
+                        new_rule_index.end_string_location = string;
+
+                        std::string error = string_conv::FromStringTraits<decltype(new_rule_index.end)>{}(new_rule_index.end, string);
+                        if (!error.empty())
+                            return error;
+                        error = CheckNumberLimits(new_rule_index.end);
+                        if (!error.empty())
+                            return error;
+                        if (new_rule_index.end < new_rule_index.begin + 1)
+                            return "The second index must be greater or equal to the first one.";
+                    }
+                }
+
+                new_rule_index.total_num_characters = std::size_t(string - new_rule.operator_character);
+
+                std::string error;
+                if (new_rule_index.add)
+                    error = FinishPositiveRule(new_rule.custom_generator_seq);
+                else
+                    error = FinishNegativeRule();
+                if (!error.empty())
+                    return error;
+
+                new_entry.rules.push_back(std::move(new_rule));
+            }
+            else
+            {
+                return "Expected one of: `=`, `-=`, `#`, `-#`.";
+            }
+
+            is_first_rule = false;
+
+            return "";
+        };
+
+        text::chars::SkipWhitespace(string);
+
+        // Parse the rules.
+
+        if (*string == '{')
+        {
+            string++;
+
+            text::chars::SkipWhitespace(string);
+
+            while (true)
+            {
+                if (!is_first_rule)
+                {
+                    if (*string == '}')
+                    {
+                        string++;
+                        break;
+                    }
+
+                    if (last_rule_is_positive)
+                    {
+                        if (*string != ',' && *string != '&' && *string != '&')
+                            return "Expected `,` or `&` or `(`.";
+                    }
+                    else
+                    {
+                        if (*string != ',')
+                            return "Expected `,`.";
+                    }
+                    string++;
+
+                    text::chars::SkipWhitespace(string);
+                }
+
+                // This skips the trailing whitespace.
+                std::string error = ParseRule();
+                if (!error.empty())
+                    return error;
+            }
+        }
+        else
+        {
+            std::string error = ParseRule();
+            if (!error.empty())
+                return error;
+        }
+
+        // Figure out the total generator length in characters.
+        new_entry.total_num_characters = std::size_t(string - new_entry.generator_name.data());
+        while (new_entry.total_num_characters > 0 && text::chars::IsWhitespace(new_entry.generator_name.data()[new_entry.total_num_characters-1]))
+            new_entry.total_num_characters--;
+
+        target.entries.push_back(std::move(new_entry));
+    }
+
+    return "";
+}
+
+void ta_test::modules::GeneratorOverrider::HardErrorInFlag(std::string_view message, const Entry &entry, FlagErrorDetails details, HardErrorKind kind)
+{
+    std::string markers;
+    for (const FlagErrorDetails::Elem &elem : details.elems)
+    {
+        std::size_t offset = 2 + flag_override.flag.size() + 1 + std::size_t(elem.location - entry.original_argument_storage.data());
+        std::size_t needed_size = offset + elem.marker.size();
+        if (markers.size() < needed_size)
+            markers.resize(needed_size, ' ');
+
+        std::copy(elem.marker.begin(), elem.marker.end(), markers.begin() + std::ptrdiff_t(offset));
+    }
+    if (!details.elems.empty())
+        markers += '\n';
+
+    HardError(CFG_TA_FMT_NAMESPACE::format("In flag:\n--{} {}\n{}{}\n", flag_override.flag, entry.OriginalArgument(), markers, message), kind);
+}
+
+// --- modules::ParallelTestRunner ---
+
+ta_test::modules::ParallelTestRunner::ParallelTestRunner()
+    : flag_jobs("jobs", 'j',
+        "Run tests on this many worker threads, or on one thread per CPU core if 0. "
+        "The results are printed in the usual order, as if the tests ran on one thread. "
+        "Tests affected by `--generate` always run on the main thread.",
+        [](const Runner &runner, BasicModule &this_module, std::size_t value)
+        {
+            (void)runner;
+            // The cast should never fail.
+            dynamic_cast<ParallelTestRunner &>(this_module).num_jobs = value;
+        }
+    ),
+    flag_split_generators("split-generators",
+        "When running on worker threads, split the values of the outermost generator of each test between them, "
+        "instead of running all repetitions of a test on one thread.",
+        [](const Runner &runner, BasicModule &this_module, bool enable)
+        {
+            (void)runner;
+            // The cast should never fail.
+            dynamic_cast<ParallelTestRunner &>(this_module).split_generators = enable;
+        }
+    ),
+    flag_processes("processes", 'p',
+        "Run tests in this many forked worker processes, or in one process per CPU core if 0. "
+        "A test that crashes its process is reported as failed, and the process is restarted. "
+        "This overrides `--jobs`.",
+        [](const Runner &runner, BasicModule &this_module, std::size_t value)
+        {
+            (void)runner;
+            // The cast should never fail.
+            dynamic_cast<ParallelTestRunner &>(this_module).num_processes = value;
+        }
+    )
+{}
+
+std::vector<ta_test::flags::BasicFlag *> ta_test::modules::ParallelTestRunner::GetFlags() noexcept
+{
+    return {&flag_jobs, &flag_split_generators, &flag_processes};
+}
+
+void ta_test::modules::ParallelTestRunner::OnChooseNumJobs(std::size_t &num_jobs) noexcept
+{
+    num_jobs = this->num_jobs;
+}
+
+void ta_test::modules::ParallelTestRunner::OnChooseNumProcesses(std::size_t &num_processes) noexcept
+{
+    num_processes = this->num_processes;
+}
+
+void ta_test::modules::ParallelTestRunner::OnCheckParallelTest(const data::BasicTest &test, ParallelTestMode &mode) noexcept
+{
+    (void)test;
+    if (split_generators && mode == ParallelTestMode::worker)
+        mode = ParallelTestMode::worker_split_generators;
+}
+
+bool ta_test::modules::ParallelTestRunner::GeneratorSplitter::OnRegisterGeneratorOverride(const data::RunSingleTestProgress &test, const data::BasicGenerator &generator) noexcept
+{
+    (void)generator;
+    // Only the outermost generator is split. The nested ones run in full in every job.
+    return num_parts > 1 && test.generator_index == 0;
+}
+
+bool ta_test::modules::ParallelTestRunner::GeneratorSplitter::OnOverrideGenerator(const data::RunSingleTestProgress &test, data::BasicGenerator &generator) noexcept
+{
+    (void)test;
+
+    // If the generator supports random access, jump straight to the next value of this part.
+    if (generator.CanGenerateAt())
+    {
+        std::size_t num_values = generator.NumValuesIfKnown().value();
+
+        // Start the other parts, but only those that have at least one value.
+        if (part_index == 0 && generator.NumGeneratedValues() == 0)
+        {
+            for (std::size_t i = 1; i < std::min(num_parts, num_values); i++)
+                spawn_job(i);
+        }
+
+        if (generator.NumGeneratedValues() > 0 && generator.IsLastValue())
+            return true; // No more values.
+
+        // The smallest index of this part that wasn't generated yet.
+        std::size_t value_index = (generator.NumGeneratedValues() + num_parts - 1 - part_index) / num_parts * num_parts + part_index;
+        if (value_index >= num_values)
+            return true; // No more values.
+
+        try
+        {
+            generator.GenerateAt(value_index);
+        }
+        catch (InterruptTestException)
+        {
+            return true; // The test is already marked as failed at this point.
+        }
+        return false; // Use this value.
+    }
+
+    // Generate the values until we find one that belongs to this job.
+    while (true)
+    {
+        if (generator.IsLastValue())
+            return true; // No more values.
+
+        try
+        {
+            generator.Generate();
+        }
+        catch (InterruptTestException)
+        {
+            return true; // No more values. The test is already marked as failed at this point.
+        }
+
+        std::size_t value_index = generator.NumGeneratedValues() - 1;
+
+        // Start each other part when we reach its first value.
+        if (part_index == 0 && value_index > 0 && value_index < num_parts)
+            spawn_job(value_index);
+
+        if (value_index % num_parts == part_index)
+            return false; // Use this value.
+    }
+}
+
+ta_test::modules::ParallelTestRunner::GeneratorSnapshot ta_test::modules::ParallelTestRunner::GeneratorSnapshot::Make(const data::BasicGenerator &generator)
+{
+    GeneratorSnapshot ret;
+    ret.location = &generator.SourceLocation();
+    ret.name = generator.Name();
+    ret.type = generator.Type();
+    ret.type_name = generator.TypeName();
+    ret.flags = generator.Flags();
+    ret.num_values = generator.NumValuesIfKnown();
+
+    ret.has_value = generator.HasValue();
+    ret.is_last_value = generator.IsLastValue();
+    ret.callback_threw_exception = generator.CallbackThrewException();
+    ret.is_custom_value = generator.IsCustomValue();
+    ret.num_generated_values = generator.NumGeneratedValues();
+    ret.num_custom_values = generator.NumCustomValues();
+
+    ret.value_convertible_to_string = generator.ValueConvertibleToString();
+    ret.value_convertible_from_string = generator.ValueConvertibleFromString();
+    ret.value_equality_comparable_to_string = generator.ValueEqualityComparableToString();
+
+    if (ret.has_value)
+    {
+        ret.value = generator.ValueToString();
+
+        // We can't parse the values on the main thread, but we can remember whether this one survives the roundtrip.
+        if (ret.value_convertible_to_string && ret.value_equality_comparable_to_string)
+        {
+            const char *string = ret.value.c_str();
+            bool equal = false;
+            std::string error = generator.ValueEqualsToString(string, equal);
+            ret.value_roundtrips = error.empty() && equal && string == ret.value.data() + ret.value.size();
+        }
+    }
+
+    return ret;
+}
+
+ta_test::modules::ParallelTestRunner::RecordedGenerator::RecordedGenerator(std::shared_ptr<const GeneratorSnapshot> snapshot)
+    : snapshot(std::move(snapshot))
+{
+    repeat = !this->snapshot->is_last_value;
+    callback_threw_exception = this->snapshot->callback_threw_exception;
+    this_value_is_custom = this->snapshot->is_custom_value;
+    num_generated_values = this->snapshot->num_generated_values;
+    num_custom_values = this->snapshot->num_custom_values;
+}
+
+void ta_test::modules::ParallelTestRunner::RecordedGenerator::Generate()
+{
+    HardError("A generator replayed from a worker can't generate new values.");
+}
+
+std::string ta_test::modules::ParallelTestRunner::RecordedGenerator::ReplaceValueFromString(const char *&string) noexcept
+{
+    (void)string;
+    return "A generator replayed from a worker can't parse values.";
+}
+
+std::string ta_test::modules::ParallelTestRunner::RecordedGenerator::ValueEqualsToString(const char *&string, bool &equal) const noexcept
+{
+    equal = false;
+    // The worker checked that the value equals its own string representation, and that's the only thing we can compare with.
+    if (!snapshot->value_roundtrips || !std::string_view(string).starts_with(snapshot->value))
+        return "A generator replayed from a worker can only compare its value with its own string representation.";
+    equal = true;
+    string += snapshot->value.size();
+    return "";
+}
+
+void ta_test::modules::ParallelTestRunner::WorkerEvent::Serialize(std::string &target) const
+{
+    auto Write = [&](const auto &value)
+    {
+        static_assert(std::is_trivially_copyable_v<std::remove_cvref_t<decltype(value)>>);
+        target.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    };
+    auto WriteString = [&](std::string_view value)
+    {
+        Write(value.size());
+        target += value;
+    };
+
+    Write(kind);
+    Write(muted);
+    Write(num_checks_total);
+    Write(num_checks_failed);
+    Write(num_tests_with_repetitions_total);
+    Write(num_tests_with_repetitions_failed);
+
+    Write(generator_stack.size());
+    for (const auto &snapshot : generator_stack)
+    {
+        Write(snapshot->location);
+        WriteString(snapshot->name);
+        Write(snapshot->type);
+        WriteString(snapshot->type_name);
+        Write(snapshot->flags);
+        Write(snapshot->num_values.has_value());
+        Write(snapshot->num_values.value_or(0));
+        Write(snapshot->has_value);
+        Write(snapshot->is_last_value);
+        Write(snapshot->callback_threw_exception);
+        Write(snapshot->is_custom_value);
+        Write(snapshot->num_generated_values);
+        Write(snapshot->num_custom_values);
+        Write(snapshot->value_convertible_to_string);
+        Write(snapshot->value_convertible_from_string);
+        Write(snapshot->value_equality_comparable_to_string);
+        Write(snapshot->value_roundtrips);
+        WriteString(snapshot->value);
+    }
+
+    Write(generator_index);
+    Write(failed);
+    Write(is_first_generator_repetition);
+    Write(is_last_generator_repetition);
+    Write(repetition_duration.count());
+    Write(repetition_cpu_duration.count());
+    Write(allocations);
+    Write(generating_new_value);
+    Write(module_index);
+    WriteString(text);
+}
+
+bool ta_test::modules::ParallelTestRunner::WorkerEvent::Deserialize(std::string_view source)
+{
+    bool ok = true;
+    auto Read = [&](auto &value)
+    {
+        static_assert(std::is_trivially_copyable_v<std::remove_cvref_t<decltype(value)>>);
+        if (source.size() < sizeof(value))
+        {
+            ok = false;
+            return;
+        }
+        std::memcpy(&value, source.data(), sizeof(value));
+        source.remove_prefix(sizeof(value));
+    };
+    auto ReadString = [&](std::string &value)
+    {
+        std::size_t size = 0;
+        Read(size);
+        if (!ok || source.size() < size)
+        {
+            ok = false;
+            return;
+        }
+        value = source.substr(0, size);
+        source.remove_prefix(size);
+    };
+
+    Read(kind);
+    Read(muted);
+    Read(num_checks_total);
+    Read(num_checks_failed);
+    Read(num_tests_with_repetitions_total);
+    Read(num_tests_with_repetitions_failed);
+
+    std::size_t stack_size = 0;
+    Read(stack_size);
+    generator_stack.clear();
+    for (std::size_t i = 0; ok && i < stack_size; i++)
+    {
+        auto snapshot = std::make_shared<GeneratorSnapshot>();
+        Read(snapshot->location);
+        ReadString(snapshot->name);
+        Read(snapshot->type);
+        ReadString(snapshot->type_name);
+        Read(snapshot->flags);
+        bool has_num_values = false;
+        std::size_t num_values = 0;
+        Read(has_num_values);
+        Read(num_values);
+        if (has_num_values)
+            snapshot->num_values = num_values;
+        Read(snapshot->has_value);
+        Read(snapshot->is_last_value);
+        Read(snapshot->callback_threw_exception);
+        Read(snapshot->is_custom_value);
+        Read(snapshot->num_generated_values);
+        Read(snapshot->num_custom_values);
+        Read(snapshot->value_convertible_to_string);
+        Read(snapshot->value_convertible_from_string);
+        Read(snapshot->value_equality_comparable_to_string);
+        Read(snapshot->value_roundtrips);
+        ReadString(snapshot->value);
+        generator_stack.push_back(std::move(snapshot));
+    }
+
+    Read(generator_index);
+    Read(failed);
+    Read(is_first_generator_repetition);
+    Read(is_last_generator_repetition);
+    std::chrono::nanoseconds::rep duration = 0;
+    Read(duration);
+    repetition_duration = std::chrono::nanoseconds(duration);
+    Read(duration);
+    repetition_cpu_duration = std::chrono::nanoseconds(duration);
+    Read(allocations);
+    Read(generating_new_value);
+    Read(module_index);
+    ReadString(text);
+
+    return ok && source.empty();
+}
+
+void ta_test::modules::ParallelTestRunner::EventRecorder::AppendOutput(std::size_t module_index, std::string_view text)
+{
+    if (!output.empty() && module_index != output_module_index)
+        FlushOutput();
+    output_module_index = module_index;
+    output += text;
+}
+
+void ta_test::modules::ParallelTestRunner::EventRecorder::FlushOutput()
+{
+    if (output.empty())
+        return;
+
+    WorkerEvent event;
+    event.kind = WorkerEvent::Kind::output;
+    event.muted = terminal.muted;
+    event.module_index = output_module_index;
+    event.text = std::move(output);
+    output.clear();
+    on_event(std::move(event));
+}
+
+void ta_test::modules::ParallelTestRunner::EventRecorder::Flusher::OnPreRunSingleTest(const data::RunSingleTestInfo &data) noexcept
+{
+    (void)data;
+    recorder->FlushOutput();
+}
+
+void ta_test::modules::ParallelTestRunner::EventRecorder::Flusher::OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept
+{
+    (void)data;
+    recorder->FlushOutput();
+}
+
+void ta_test::modules::ParallelTestRunner::EventRecorder::Flusher::OnPostGenerate(const data::GeneratorCallInfo &data) noexcept
+{
+    (void)data;
+    recorder->FlushOutput();
+}
+
+void ta_test::modules::ParallelTestRunner::EventRecorder::Flusher::OnPrePruneGenerator(const data::RunSingleTestProgress &test) noexcept
+{
+    (void)test;
+    recorder->FlushOutput();
+}
+
+void ta_test::modules::ParallelTestRunner::EventRecorder::Flusher::OnPreFailTest(const data::RunSingleTestProgress &data) noexcept
+{
+    (void)data;
+    recorder->FlushOutput();
+}
+
+void ta_test::modules::ParallelTestRunner::EventRecorder::OnPreRunSingleTest(const data::RunSingleTestInfo &data) noexcept
+{
+    (void)data;
+    // The values could've changed since the last repetition, e.g. by a generator override.
+    generator_snapshots.clear();
+    // The original modules print this again when replaying. Same in the other callbacks below.
+    output.clear();
+    on_event(MakeEvent(WorkerEvent::Kind::pre_run_single_test));
+}
+
+void ta_test::modules::ParallelTestRunner::EventRecorder::OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept
+{
+    output.clear();
+    WorkerEvent event = MakeEvent(WorkerEvent::Kind::post_run_single_test);
+    event.is_last_generator_repetition = data.is_last_generator_repetition;
+    event.repetition_duration = data.repetition_duration;
+    event.repetition_cpu_duration = data.repetition_cpu_duration;
+    event.allocations = data.allocations;
+    on_event(std::move(event));
+}
+
+void ta_test::modules::ParallelTestRunner::EventRecorder::OnPostGenerate(const data::GeneratorCallInfo &data) noexcept
+{
+    // This generator is at `generator_index`, and it could have a new value.
+    if (generator_snapshots.size() > data.test->generator_index)
+        generator_snapshots.resize(data.test->generator_index);
+
+    output.clear();
+    WorkerEvent event = MakeEvent(WorkerEvent::Kind::post_generate);
+    event.generating_new_value = data.generating_new_value;
+    on_event(std::move(event));
+}
+
+void ta_test::modules::ParallelTestRunner::EventRecorder::OnPrePruneGenerator(const data::RunSingleTestProgress &test) noexcept
+{
+    (void)test;
+    output.clear();
+    on_event(MakeEvent(WorkerEvent::Kind::pre_prune_generator));
+}
+
+void ta_test::modules::ParallelTestRunner::EventRecorder::OnPreFailTest(const data::RunSingleTestProgress &data) noexcept
+{
+    (void)data;
+    output.clear();
+    on_event(MakeEvent(WorkerEvent::Kind::pre_fail_test));
+}
+
+ta_test::modules::ParallelTestRunner::WorkerEvent ta_test::modules::ParallelTestRunner::EventRecorder::MakeEvent(WorkerEvent::Kind kind)
+{
+    const data::RunSingleTestResults &test = *detail::ThreadState().current_test;
+
+    WorkerEvent event;
+    event.kind = kind;
+    event.muted = terminal.muted;
+
+    // The number of checks can decrease, but the unsigned arithmetic wraps around correctly on the main thread.
+    const data::RunTestsProgress &counters = *test.all_tests;
+    event.num_checks_total = counters.num_checks_total - prev_counters.num_checks_total;
+    event.num_checks_failed = counters.num_checks_failed - prev_counters.num_checks_failed;
+    event.num_tests_with_repetitions_total = counters.num_tests_with_repetitions_total - prev_counters.num_tests_with_repetitions_total;
+    event.num_tests_with_repetitions_failed = counters.num_tests_with_repetitions_failed - prev_counters.num_tests_with_repetitions_failed;
+    prev_counters.num_checks_total = counters.num_checks_total;
+    prev_counters.num_checks_failed = counters.num_checks_failed;
+    prev_counters.num_tests_with_repetitions_total = counters.num_tests_with_repetitions_total;
+    prev_counters.num_tests_with_repetitions_failed = counters.num_tests_with_repetitions_failed;
+
+    generator_snapshots.resize(test.generator_stack.size());
+    for (std::size_t i = 0; i < generator_snapshots.size(); i++)
+    {
+        if (!generator_snapshots[i])
+            generator_snapshots[i] = std::make_shared<const GeneratorSnapshot>(GeneratorSnapshot::Make(*test.generator_stack[i]));
+    }
+    event.generator_stack = generator_snapshots;
+
+    event.generator_index = test.generator_index;
+    event.failed = test.failed;
+    event.is_first_generator_repetition = test.is_first_generator_repetition;
+    return event;
+}
+
+// --- modules::GeneratorShrinker ---
+
+ta_test::modules::GeneratorShrinker::GeneratorShrinker()
+    : flag_shrink("shrink",
+        "When a test fails, rerun it with simpler values from the generators that support it (such as `ta_test::RandomValues(...)`), "
+        "and print the simplest failing value. Enabled by default.",
+        [](const Runner &runner, BasicModule &this_module, bool enable)
+        {
+            (void)runner;
+            // The cast should never fail.
+            dynamic_cast<GeneratorShrinker &>(this_module).enabled = enable;
+        }
+    )
+{}
+
+void ta_test::modules::GeneratorShrinker::SetOutputMuted(const data::RunTestsProgress &all_tests, bool mute)
+{
+    if (output_muted == mute)
+        return;
+    output_muted = mute;
+
+    for (const auto &m : all_tests.modules->AllModules())
+    {
+        if (auto base = dynamic_cast<BasicPrintingModule *>(m.get()))
+            base->terminal.muted = mute;
+    }
+}
+
+std::vector<ta_test::flags::BasicFlag *> ta_test::modules::GeneratorShrinker::GetFlags() noexcept
+{
+    return {&flag_shrink};
+}
+
+void ta_test::modules::GeneratorShrinker::OnPreRunSingleTest(const data::RunSingleTestInfo &data) noexcept
+{
+    // The candidates are tried quietly. This runs before the printing modules see the repetition, since they're after us in the list.
+    bool trying_candidate = std::any_of(elems.begin(), elems.end(), [](const Elem &elem){return elem.next_repetition_is_candidate;});
+    SetOutputMuted(*data.all_tests, trying_candidate);
+}
+
+void ta_test::modules::GeneratorShrinker::OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept
+{
+    if (data.is_last_generator_repetition)
+    {
+        elems.clear();
+        // This shouldn't normally be necessary, since the final repetition is never muted.
+        SetOutputMuted(*data.all_tests, false);
+    }
+}
+
+void ta_test::modules::GeneratorShrinker::OnPreFailTest(const data::RunSingleTestProgress &data) noexcept
+{
+    // Only the generators we've reached in this repetition are responsible for the failure.
+    for (Elem &elem : elems)
+    {
+        if (elem.generator_index < data.generator_index)
+            elem.failed = true;
+    }
+}
+
+bool ta_test::modules::GeneratorShrinker::OnRegisterGeneratorOverride(const data::RunSingleTestProgress &test, const data::BasicGenerator &generator) noexcept
+{
+    if (!enabled || !generator.CanShrink())
+        return false;
+
+    // Prune the stale elements.
+    while (!elems.empty() && elems.back().generator_index >= test.generator_index)
+        elems.pop_back();
+
+    elems.push_back({.generator_index = test.generator_index});
+    return true;
+}
+
+bool ta_test::modules::GeneratorShrinker::OnOverrideGenerator(const data::RunSingleTestProgress &test, data::BasicGenerator &generator) noexcept
+{
+    auto iter = std::find_if(elems.begin(), elems.end(), [&](const Elem &elem){return elem.generator_index == test.generator_index;});
+    if (iter == elems.end())
+        HardError("A generator override is requested, but we don't know this generator.");
+    Elem &elem = *iter;
+
+    // Generates the next value normally. Returns true if there are no more values.
+    auto GenerateNext = [&]
+    {
+        if (generator.IsLastValue())
+            return true;
+
+        try
+        {
+            generator.Generate();
+        }
+        catch (InterruptTestException)
+        {
+            return true; // The test is already marked as failed at this point.
+        }
+        return false;
+    };
+
+    auto PrintResult = [&]
+    {
+        if (elem.num_repetitions == 0)
+            return; // Nothing to report, the value was already as simple as it gets.
+
+        auto cur_style = terminal.MakeStyleGuard();
+        std::string message = CFG_TA_FMT_NAMESPACE::format("Shrunk `{}` in {} step{} ({} repetition{})", generator.Name(), elem.num_steps, elem.num_steps == 1 ? "" : "s", elem.num_repetitions, elem.num_repetitions == 1 ? "" : "s");
+        if (generator.ValueConvertibleToString())
+            message += CFG_TA_FMT_NAMESPACE::format(", the simplest failing value is `{}`.", generator.ValueToString());
+        else
+            message += '.';
+        PrintNote(cur_style, message);
+    };
+
+    if (!generator.HasValue())
+        return GenerateNext(); // A new generator.
+
+    // The repetition has ended.
+
+    elem.next_repetition_is_candidate = false;
+
+    if (elem.final_repetition)
+    {
+        PrintResult();
+        return true;
+    }
+
+    if (!elem.shrinking)
+    {
+        if (!elem.failed)
+            return GenerateNext();
+
+        // If an enclosing generator is shrinking, it only needs to know whether its current candidate fails, which we've just learned.
+        // Don't shrink this one and don't try the remaining values, so the enclosing generator can move on.
+        for (const Elem &other : elems)
+        {
+            if (other.generator_index < elem.generator_index && other.shrinking)
+                return true;
+        }
+
+        elem.shrinking = true;
+    }
+
+    if (elem.failed)
+    {
+        // The current value fails, so it becomes the new base for shrinking.
+        if (!elem.value_is_base && elem.num_repetitions > 0)
+            elem.num_steps++;
+        elem.num_candidates = generator.MakeShrinkCandidates();
+        elem.next_candidate = 0;
+        elem.value_is_base = true;
+        elem.failed = false;
+    }
+
+    if (elem.next_candidate < elem.num_candidates && elem.num_repetitions < max_shrink_repetitions)
+    {
+        generator.UseShrinkCandidate(elem.next_candidate++);
+        elem.num_repetitions++;
+        elem.value_is_base = false;
+        elem.next_repetition_is_candidate = true;
+        return false;
+    }
+
+    // No simpler failing values.
+
+    if (elem.num_repetitions == 0)
+        return true; // The original failure was already printed, and there's nothing to report.
+
+    // Rerun the test with the simplest failing value, so that its failure is printed. The candidates were tried quietly.
+    generator.RestoreShrinkBase();
+    elem.value_is_base = true;
+    elem.final_repetition = true;
+    return false;
+}
+
+void ta_test::modules::GeneratorShrinker::OnPrePruneGenerator(const data::RunSingleTestProgress &test) noexcept
+{
+    if (test.generator_stack.back()->OverridingModule() == this && !elems.empty())
+        elems.pop_back();
+}
+
+// --- modules::GeneratorSampler ---
+
+ta_test::modules::GeneratorSampler::GeneratorSampler()
+    : flag_generate_sample("generate-sample", '\0',
+        "Instead of running every combination of the generated values, run this many random repetitions of each test. "
+        "Each repetition gets a different value of the outermost generator, so there are at most as many repetitions as it has values. "
+        "If the outermost generator doesn't know its size, its first values are used in order, while the nested generators are still random. "
+        "On failure, prints a `--generate` flag to reproduce the failed repetition. "
+        "All tests then run on the main thread, ignoring `--jobs` and `--processes`.",
+        [](const Runner &runner, BasicModule &this_module, std::size_t value)
+        {
+            (void)runner;
+            // The cast should never fail.
+            dynamic_cast<GeneratorSampler &>(this_module).num_samples = value;
+        }
+    ),
+    flag_seed("seed", '\0',
+        "The random seed for `--generate-sample`. If not specified, a random one is used and printed.",
+        [](const Runner &runner, BasicModule &this_module, std::size_t value)
+        {
+            (void)runner;
+            // The cast should never fail.
+            dynamic_cast<GeneratorSampler &>(this_module).seed = value;
+        }
+    )
+{}
+
+std::vector<ta_test::flags::BasicFlag *> ta_test::modules::GeneratorSampler::GetFlags() noexcept
+{
+    return {&flag_generate_sample, &flag_seed};
+}
+
+void ta_test::modules::GeneratorSampler::OnPreRunTests(const data::RunTestsInfo &data) noexcept
+{
+    (void)data;
+
+    if (num_samples == 0)
+        return;
+
+    if (!seed)
+    {
+        std::random_device device;
+        seed = std::uint64_t(device()) << 32 | device();
+    }
+
+    auto cur_style = terminal.MakeStyleGuard();
+    PrintNote(cur_style, CFG_TA_FMT_NAMESPACE::format("Will run {} random repetition{} of each test, with `--seed {}`.", num_samples, num_samples == 1 ? "" : "s", *seed));
+}
+
+void ta_test::modules::GeneratorSampler::OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept
+{
+    if (!test_state)
+        return;
+
+    if (!test_state->failed_repetition_flag.empty())
+    {
+        auto cur_style = terminal.MakeStyleGuard();
+        PrintNote(cur_style, CFG_TA_FMT_NAMESPACE::format("Reproduce this repetition with `{}`.", test_state->failed_repetition_flag));
+        test_state->failed_repetition_flag.clear();
+    }
+
+    if (data.is_last_generator_repetition)
+        test_state = {};
+}
+
+bool ta_test::modules::GeneratorSampler::OnRegisterGeneratorOverride(const data::RunSingleTestProgress &test, const data::BasicGenerator &generator) noexcept
+{
+    if (num_samples == 0)
+        return false;
+
+    // Let the empty generators fail as usual.
+    if (bool(generator.Flags() & GeneratorFlags::generate_nothing))
+        return false;
+
+    // The `--generate` flag we print on failure must cover all enclosing generators.
+    for (std::size_t i = 0; i < test.generator_index; i++)
+    {
+        if (test.generator_stack[i]->OverridingModule() != this)
+            return false;
+    }
+
+    if (!test_state)
+    {
+        test_state.emplace();
+        test_state->random_generator.seed(*seed ^ TestSharder::HashTestName(test.test->Name()));
+    }
+    return true;
+}
+
+bool ta_test::modules::GeneratorSampler::OnOverrideGenerator(const data::RunSingleTestProgress &test, data::BasicGenerator &generator) noexcept
+{
+    if (!test_state)
+        HardError("A generator override is requested, but we don't have an active state.");
+
+    TestState &state = *test_state;
+    const std::size_t depth = test.generator_index;
+
+    std::size_t slot_index = std::size_t(std::find_if(state.slots.begin(), state.slots.end(), [&](const TestState::Slot &slot){return slot.location == &generator.SourceLocation();}) - state.slots.begin());
+    if (slot_index == state.slots.size())
+        state.slots.push_back({.location = &generator.SourceLocation()});
+
+    // Returns a random number in `[0, n)`. Not using `std::uniform_int_distribution`, because its results differ between standard libraries,
+    //   and we want the same `--seed` to produce the same values everywhere. The bias is negligible for any sane `n`.
+    auto Random = [&](std::size_t n)
+    {
+        return std::size_t(state.random_generator() % n);
+    };
+
+    // Generates values until the 0-based `index`, or until the last one if the index is too large.
+    // Updates what we know about the size of this generator. Returns false if we ran out of values or the generator threw.
+    auto SkipTo = [&](std::size_t index)
+    {
+        while (generator.NumGeneratedValues() <= index)
+        {
+            if (generator.IsLastValue())
+                return generator.HasValue() && !generator.CallbackThrewException();
+
+            try
+            {
+                // Jump straight to the index if the generator supports random access.
+                std::optional<std::size_t> num_values = generator.NumValuesIfKnown();
+                if (generator.CanGenerateAt() && index < num_values.value_or(0))
+                    generator.GenerateAt(index);
+                else
+                    generator.Generate();
+            }
+            catch (InterruptTestException)
+            {
+                return false; // The test is already marked as failed at this point.
+            }
+
+            TestState::Slot &slot = state.slots[slot_index];
+            slot.num_known_values = std::max(slot.num_known_values, generator.NumGeneratedValues());
+            if (generator.IsLastValue())
+                slot.size_is_known = true;
+        }
+        return true;
+    };
+
+    if (!generator.HasValue())
+    {
+        // A new generator.
+
+        const std::optional<std::size_t> num_values = generator.NumValuesIfKnown();
+
+        if (depth == 0)
+        {
+            state.num_samples_left = num_samples;
+            if (num_values && *num_values > 0)
+            {
+                // Pick distinct indices, there's no point in repeating the outermost values.
+                state.num_samples_left = std::min(num_samples, *num_values);
+
+                // Floyd's algorithm, to avoid allocating all `*num_values` indices.
+                std::set<std::size_t> indices;
+                for (std::size_t i = *num_values - state.num_samples_left; i < *num_values; i++)
+                {
+                    if (!indices.insert(Random(i + 1)).second)
+                        indices.insert(i);
+                }
+                state.outermost_values.assign(indices.rbegin(), indices.rend());
+
+                std::size_t index = state.outermost_values.back();
+                state.outermost_values.pop_back();
+                return !SkipTo(index);
+            }
+            else
+            {
+                return !SkipTo(0);
+            }
+        }
+
+        const TestState::Slot &slot = state.slots[slot_index];
+        if (num_values)
+            return !SkipTo(Random(*num_values));
+        else if (slot.size_is_known)
+            return !SkipTo(Random(slot.num_known_values));
+        else
+            return !SkipTo(Random(std::max(std::size_t(1), slot.num_known_values * 2))); // This can overshoot, then we get the last value and learn the size.
+    }
+
+    // The repetition has ended.
+
+    // This is the first call at the end of the repetition, the innermost generator. Remember how to reproduce this repetition if it failed.
+    if (test.failed && depth + 1 == test.generator_stack.size())
+    {
+        if (auto summary = output::MakeGeneratorSummary(test, test.generator_stack.size(), max_generator_summary_value_length))
+            state.failed_repetition_flag = CFG_TA_FMT_NAMESPACE::format("--generate '{}//{}'", test.test->Name(), *summary);
+    }
+
+    // Recreate the nested generators in the next repetition, to pick new values for them.
+    if (depth > 0)
+        return true;
+
+    if (--state.num_samples_left == 0)
+        return true; // No more repetitions.
+
+    if (generator.NumValuesIfKnown())
+    {
+        std::size_t index = state.outermost_values.back();
+        state.outermost_values.pop_back();
+        return !SkipTo(index);
+    }
+    else
+    {
+        if (generator.IsLastValue())
+            return true; // No more values.
+        return !SkipTo(generator.NumGeneratedValues());
+    }
+}
+
+void ta_test::modules::GeneratorSampler::OnCheckParallelTest(const data::BasicTest &test, ParallelTestMode &mode) noexcept
+{
+    (void)test;
+    // We need to see the generators as they're created, so the tests must run on the main thread.
+    if (num_samples > 0)
+        mode = ParallelTestMode::main_thread;
+}
+
+// --- modules::GeneratorCoverage ---
+
+ta_test::modules::GeneratorCoverage::GeneratorCoverage()
+    : flag_generate_coverage("generate-coverage", '\0',
+        "How to combine the values of nested generators. "
+        "`pairwise` runs only enough repetitions for every pair of values of any two generators to appear at least once. "
+        "`exhaustive` runs every combination. `default` uses `pairwise` only for the tests with the `ta_test::pairwise` flag.",
+        [](const Runner &runner, BasicModule &this_module, std::string_view value)
+        {
+            (void)runner;
+            GeneratorCoverage &self = dynamic_cast<GeneratorCoverage &>(this_module); // This cast should never fail.
+            if (value == "default")
+                self.mode = Mode::per_test;
+            else if (value == "pairwise")
+                self.mode = Mode::pairwise;
+            else if (value == "exhaustive")
+                self.mode = Mode::exhaustive;
+            else
+                HardError(CFG_TA_FMT_NAMESPACE::format("Expected `default`, `pairwise`, or `exhaustive` after `--generate-coverage`, but got `{}`.", value), HardErrorKind::user);
+        }
+    )
+{}
+
+std::vector<ta_test::flags::BasicFlag *> ta_test::modules::GeneratorCoverage::GetFlags() noexcept
+{
+    return {&flag_generate_coverage};
+}
+
+void ta_test::modules::GeneratorCoverage::OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept
+{
+    if (data.is_last_generator_repetition && test_state)
+    {
+        test_state = {};
+    }
+}
+
+bool ta_test::modules::GeneratorCoverage::OnRegisterGeneratorOverride(const data::RunSingleTestProgress &test, const data::BasicGenerator &generator) noexcept
+{
+    if (!IsPairwise(*test.test))
+        return false;
+
+    // Let the empty generators fail as usual.
+    if (bool(generator.Flags() & GeneratorFlags::generate_nothing))
+        return false;
+
+    // We must know the values of all enclosing generators to track the pairs.
+    for (std::size_t i = 0; i < test.generator_index; i++)
+    {
+        if (test.generator_stack[i]->OverridingModule() != this)
+            return false;
+    }
+
+    if (!test_state)
+        test_state.emplace();
+    return true;
+}
+
+bool ta_test::modules::GeneratorCoverage::OnOverrideGenerator(const data::RunSingleTestProgress &test, data::BasicGenerator &generator) noexcept
+{
+    if (!test_state)
+        HardError("A generator override is requested, but we don't have an active state.");
+
+    TestState &state = *test_state;
+    const std::size_t depth = test.generator_index;
+
+    std::size_t slot_index = std::size_t(std::find_if(state.slots.begin(), state.slots.end(), [&](const TestState::Slot &slot){return slot.location == &generator.SourceLocation();}) - state.slots.begin());
+    if (slot_index == state.slots.size())
+        state.slots.push_back({.location = &generator.SourceLocation()});
+
+    auto PairKey = [](std::size_t slot_a, std::size_t value_a, std::size_t slot_b, std::size_t value_b)
+    {
+        if (slot_a > slot_b)
+        {
+            std::swap(slot_a, slot_b);
+            std::swap(value_a, value_b);
+        }
+        return std::array<std::size_t, 4>{slot_a, value_a, slot_b, value_b};
+    };
+    auto IsCovered = [&](std::size_t slot_a, std::size_t value_a, std::size_t slot_b, std::size_t value_b)
+    {
+        return state.covered_pairs.contains(PairKey(slot_a, value_a, slot_b, value_b));
+    };
+
+    // Generates the next value, and updates what we know about the size of this generator.
+    // Returns false if there are no more values.
+    auto GenerateNext = [&]
+    {
+        if (generator.IsLastValue())
+            return false;
+
+        try
+        {
+            generator.Generate();
+        }
+        catch (InterruptTestException)
+        {
+            return false; // The test is already marked as failed at this point.
+        }
+
+        TestState::Slot &slot = state.slots[slot_index];
+        slot.num_known_values = std::max(slot.num_known_values, generator.NumGeneratedValues());
+        if (generator.IsLastValue())
+            slot.size_is_known = true;
+        return true;
+    };
+
+    // Adds the current value to the row, and marks its pairs with the enclosing generators as covered.
+    auto AddToRow = [&]
+    {
+        std::size_t value = generator.NumGeneratedValues() - 1;
+        state.row.resize(depth);
+        for (const auto &[other_slot, other_value] : state.row)
+        {
+            if (other_slot != slot_index && state.covered_pairs.insert(PairKey(other_slot, other_value, slot_index, value)).second)
+                state.made_progress = true;
+        }
+        state.row.emplace_back(slot_index, value);
+    };
+
+    if (!generator.HasValue())
+    {
+        // A new generator. Pick the value that covers the most new pairs with the enclosing generators.
+        // Break ties by how many uncovered pairs the value has in total, then by the smaller index.
+        // A value we haven't seen yet is always new, so we consider one if we don't know the size yet.
+
+        const TestState::Slot &slot = state.slots[slot_index];
+        state.row.resize(depth);
+
+        std::size_t best_value = 0;
+        std::pair<std::size_t, std::size_t> best_score{};
+
+        // If a pair is being forced, use its value instead.
+        std::optional<std::size_t> forced_value;
+        if (state.forced_pair)
+        {
+            const auto &[slot_a, value_a, slot_b, value_b] = *state.forced_pair;
+            if (slot_a == slot_index)
+                forced_value = value_a;
+            else if (slot_b == slot_index)
+                forced_value = value_b;
+        }
+        if (forced_value)
+            best_value = *forced_value;
+
+        for (std::size_t value = 0; !forced_value && value < slot.num_known_values + !slot.size_is_known; value++)
+        {
+            const bool is_unseen = value == slot.num_known_values;
+
+            std::pair<std::size_t, std::size_t> score{};
+
+            for (const auto &[other_slot, other_value] : state.row)
+            {
+                if (other_slot != slot_index && (is_unseen || !IsCovered(other_slot, other_value, slot_index, value)))
+                    score.first++;
+            }
+
+            if (is_unseen)
+            {
+                score.second = std::size_t(-1);
+            }
+            else
+            {
+                for (std::size_t other_slot = 0; other_slot < state.slots.size(); other_slot++)
+                {
+                    if (other_slot == slot_index)
+                        continue;
+                    for (std::size_t other_value = 0; other_value < state.slots[other_slot].num_known_values; other_value++)
+                    {
+                        if (!IsCovered(other_slot, other_value, slot_index, value))
+                            score.second++;
+                    }
+                }
+            }
+
+            if (value == 0 || score > best_score)
+            {
+                best_value = value;
+                best_score = score;
+            }
+        }
+
+        // Skip to the chosen value.
+        while (generator.NumGeneratedValues() <= best_value)
+        {
+            if (!GenerateNext())
+                break;
+        }
+
+        if (!generator.HasValue() || generator.CallbackThrewException())
+            return true; // No more values.
+
+        AddToRow();
+        return false;
+    }
+
+    // The repetition has ended.
+
+    // Recreate the nested generators in the next repetition, to pick new values for them.
+    if (depth > 0)
+        return true;
+
+    // Keep the outermost value while there's still something to cover with it.
+    // The pairs between the nested generators can be covered with any outermost value, so we only insist on them at the last one.
+    // If an uncovered pair is found, it's written to `uncovered_pair`.
+    auto AnythingLeftToCover = [&](std::optional<std::array<std::size_t, 4>> &uncovered_pair)
+    {
+        const std::size_t this_value = generator.NumGeneratedValues() - 1;
+        const bool is_last_value = generator.IsLastValue();
+
+        for (std::size_t slot_a = 0; slot_a < state.slots.size(); slot_a++)
+        {
+            if (slot_a != slot_index && !state.slots[slot_a].size_is_known)
+                return true;
+
+            for (std::size_t slot_b = slot_a + 1; slot_b < state.slots.size(); slot_b++)
+            {
+                if (slot_a != slot_index && slot_b != slot_index && !is_last_value)
+                    continue;
+
+                auto ValueRange = [&](std::size_t slot)
+                {
+                    return slot == slot_index ? std::pair(this_value, this_value + 1) : std::pair(std::size_t(0), state.slots[slot].num_known_values);
+                };
+                const auto [begin_a, end_a] = ValueRange(slot_a);
+                const auto [begin_b, end_b] = ValueRange(slot_b);
+
+                for (std::size_t value_a = begin_a; value_a < end_a; value_a++)
+                {
+                    for (std::size_t value_b = begin_b; value_b < end_b; value_b++)
+                    {
+                        if (!IsCovered(slot_a, value_a, slot_b, value_b))
+                        {
+                            uncovered_pair = {slot_a, value_a, slot_b, value_b};
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+
+        return false;
+    };
+
+    const bool made_progress = std::exchange(state.made_progress, false);
+    const bool was_forced = state.forced_pair.has_value();
+    state.forced_pair.reset();
+
+    // If the forced repetition didn't help, give up on this value.
+    std::optional<std::array<std::size_t, 4>> uncovered_pair;
+    if ((made_progress || !was_forced) && AnythingLeftToCover(uncovered_pair))
+    {
+        if (made_progress)
+            return false; // Keep the current value.
+
+        // The greedy choice got stuck, force the next repetition to an uncovered pair.
+        if (uncovered_pair)
+        {
+            state.forced_pair = uncovered_pair;
+            return false; // Keep the current value.
+        }
+    }
+
+    if (!GenerateNext())
+        return true; // No more values.
+
+    AddToRow();
+    return false;
+}
+
+void ta_test::modules::GeneratorCoverage::OnCheckParallelTest(const data::BasicTest &test, ParallelTestMode &mode) noexcept
+{
+    // We need to see the generators as they're created, so the pairwise tests must run on the main thread.
+    if (IsPairwise(test))
+        mode = ParallelTestMode::main_thread;
+}
+
+bool ta_test::modules::GeneratorCoverage::IsPairwise(const data::BasicTest &test) const
+{
+    switch (mode)
+    {
+      case Mode::per_test:
+        return bool(test.Flags() & TestFlags::pairwise);
+      case Mode::pairwise:
+        return true;
+      case Mode::exhaustive:
+        return false;
+    }
+    return false;
+}
+
+// --- modules::PrintingConfigurator ---
+
+ta_test::modules::PrintingConfigurator::PrintingConfigurator()
+    : flag_color("color", "Color output using ANSI escape sequences (by default enabled when printing to terminal).",
+        [](const Runner &runner, BasicModule &this_module, bool enable)
+        {
+            (void)this_module;
+            runner.SetEnableColor(enable);
+        }
+    ), flag_unicode("unicode", "Use Unicode characters for pseudographics (enabled by default).",
+        [](const Runner &runner, BasicModule &this_module, bool enable)
+        {
+            (void)this_module;
+            runner.SetEnableUnicode(enable);
+        }
+    )
+{}
+
+std::vector<ta_test::flags::BasicFlag *> ta_test::modules::PrintingConfigurator::GetFlags() noexcept
+{
+    return {&flag_color, &flag_unicode};
+}
+
+// --- modules::ProgressPrinter ---
+
+ta_test::modules::ProgressPrinter::GeneratorValueShortener::GeneratorValueShortener(
+    std::string_view value, std::string_view ellipsis, std::size_t max_prefix, std::size_t max_suffix
+)
+{
+    // The number of unicode characters in `ellipsis`. This is initialized lazily.
+    std::size_t ellipsis_size = 0;
+
+    // Where the prefix ends, if the string is longer than `max_prefix`.
+    const char *prefix_end = nullptr;
+
+    // `prefix_end` plus the size of the `ellipsis`, if the string is longer than that.
+    const char *imaginary_ellipsis_end = nullptr;
+
+    // See if we're at least longer than `max_prefix` plus the size of the ellipsis.
+    std::size_t index = 0;
+    for (const char &ch : value)
+    {
+        if (text::chars::IsFirstUtf8Byte(ch))
+        {
+            if (index == max_prefix)
+            {
+                ellipsis_size = text::chars::NumUtf8Chars(ellipsis);
+                prefix_end = &ch;
+            }
+            else if (index == max_prefix + ellipsis_size)
+            {
+                imaginary_ellipsis_end = &ch;
+                break;
+            }
+
+            index++;
+        }
+    }
+
+    // Maybe we're long, iterate backwards to find the suffix start and whether we even have enough characters for a suffix.
+    if (imaginary_ellipsis_end)
+    {
+        const char *cur = value.data() + value.size();
+
+        index = 0;
+        while (cur != imaginary_ellipsis_end)
+        {
+            cur--;
+            index++;
+            if (index == max_suffix)
+            {
+                is_short = false;
+                long_prefix = {value.data(), prefix_end};
+                long_suffix = {cur, value.data() + value.size()};
+                return;
+            }
+        }
+    }
+
+    is_short = true;
+}
+
+void ta_test::modules::ProgressPrinter::PrintContextLinePrefix(
+    output::Terminal::StyleGuard &cur_style,
+    const data::RunTestsProgress &all_tests,
+    TestCounterStyle test_counter_style
+) const
+{
+    // Test index, if necessary.
+    if (test_counter_style != TestCounterStyle::none)
+    {
+        terminal.Print(cur_style, "{}{:{}}{}/{}",
+            test_counter_style == TestCounterStyle::repeated ? style_index_repeated : style_index,
+            state.test_counter + 1, state.num_tests_width,
+            style_total_count,
+            all_tests.num_tests
+        );
+
+        // Failed test count.
+        if (all_tests.failed_tests.size() > 0)
+        {
+            terminal.Print(cur_style, "{}{}{}{}{}{}",
+                style_failed_count_decorations,
+                chars_failed_test_count_prefix,
+                style_failed_count,
+                all_tests.failed_tests.size(),
+                style_failed_count_decorations,
+                chars_failed_test_count_suffix
+            );
+        }
+    }
+    else
+    {
+        // No test index, just a gap.
+
+        std::size_t gap_width = state.num_tests_width * 2 + 1;
+
+        if (all_tests.failed_tests.size() > 0)
+            gap_width += CFG_TA_FMT_NAMESPACE::formatted_size("{}", all_tests.failed_tests.size()) + 3;
+
+        terminal.Print("{:{}}", "", gap_width);
+    }
+
+    // The gutter border.
+    terminal.Print(cur_style, "{}{}",
+        style_gutter_border,
+        chars_test_counter_separator
+    );
+}
+
+void ta_test::modules::ProgressPrinter::PrintContextLineIndentation(output::Terminal::StyleGuard &cur_style, std::size_t depth, std::size_t skip_characters) const
+{
+    // Indentation prefix.
+    terminal.Print(cur_style, "{}{}",
+        style_indentation_guide,
+        chars_pre_indentation
+    );
+
+    std::size_t single_indentation_width = text::chars::NumUtf8Chars(chars_indentation);
+
+    if (skip_characters > single_indentation_width * depth)
+        return; // Everything is skipped.
+
+    depth -= (skip_characters + single_indentation_width - 1) / single_indentation_width;
+
+    // Print the first incomplete indentation guide, if partially skipped.
+    if (std::size_t skipped_part = skip_characters % single_indentation_width; skipped_part > 0)
+    {
+        std::size_t i = 0;
+        for (const char &ch : chars_indentation)
+        {
+            if (text::chars::IsFirstUtf8Byte(ch))
+                i++;
+
+            if (i > skipped_part)
+            {
+                terminal.Print("{}", &ch);
+                break;
+            }
+        }
+    }
+
+    // The indentation.
+    for (std::size_t i = 0; i < depth; i++)
+        terminal.Print("{}", chars_indentation);
+}
+
+void ta_test::modules::ProgressPrinter::PrintGeneratorInfo(
+    output::Terminal::StyleGuard &cur_style, const data::RunSingleTestProgress &test, const data::BasicGenerator &generator, bool repeating_info
+)
+{
+    PrintContextLinePrefix(cur_style, *test.all_tests, state.per_test.per_repetition.printed_counter ? TestCounterStyle::none : TestCounterStyle::repeated);
+
+    std::size_t repetition_counters_width = CFG_TA_FMT_NAMESPACE::formatted_size("{}", state.per_test.repetition_counter + 1);
+    if (state.per_test.failed_generator_stacks.size() > 0)
+    {
+        repetition_counters_width += text::chars::NumUtf8Chars(chars_failed_repetition_count_prefix);
+        repetition_counters_width += CFG_TA_FMT_NAMESPACE::formatted_size("{}", state.per_test.failed_generator_stacks.size());
+        repetition_counters_width += text::chars::NumUtf8Chars(chars_failed_repetition_count_suffix);
+    }
+
+    // Print the repetition counter, or nothing if already printed during this repetition.
+    if (!state.per_test.per_repetition.printed_counter)
+    {
+        // The actual repetition count.
+
+        state.per_test.per_repetition.printed_counter = true;
+
+        terminal.Print(cur_style, "{}{}",
+            style_repetition_total_count,
+            state.per_test.repetition_counter + 1
+        );
+
+        // Failed repetition count, if any.
+        if (!state.per_test.failed_generator_stacks.empty())
+        {
+            terminal.Print(cur_style, "{}{}{}{}{}{}",
+                style_repetition_failed_count_decorations,
+                chars_failed_repetition_count_prefix,
+                style_repetition_failed_count,
+                state.per_test.failed_generator_stacks.size(),
+                style_repetition_failed_count_decorations,
+                chars_failed_repetition_count_suffix
+            );
+        }
+    }
+    else
+    {
+        // Empty spacing.
+        terminal.Print("{:{}}", "", repetition_counters_width);
+    }
+
+    // The ending border after the repetition counter.
+    const std::string &repetition_border_string =
+        repetition_counters_width <= state.per_test.last_repetition_counters_width
+        ? chars_repetition_counter_separator
+        : chars_repetition_counter_separator_diagonal;
+    terminal.Print(cur_style, "{}{}",
+        style_repetition_border,
+        repetition_border_string
+    );
+    state.per_test.last_repetition_counters_width = repetition_counters_width;
+
+    // Indentation.
+    std::size_t num_chars_removed_from_indentation = std::min(std::size_t(repetition_counters_width) + text::chars::NumUtf8Chars(repetition_border_string), text::chars::NumUtf8Chars(chars_indentation) * state.stack.size());
+    PrintContextLineIndentation(cur_style, state.stack.size() + test.generator_index, num_chars_removed_from_indentation);
+
+    const auto &st_gen = repeating_info ? style_generator_repeated : style_generator;
+
+    // The generator name and the value index.
+    terminal.Print(cur_style, "{}{}{}{}{}{}{}{}{}{}{}",
+        // The bullet point.
+        st_gen.prefix,
+        repeating_info ? chars_test_prefix_continuing : chars_test_prefix,
+        // Generator name.
+        st_gen.name,
+        generator.Name(),
+        // Opening bracket.
+        st_gen.index_brackets,
+        chars_generator_index_prefix,
+        // Index:
+        //   Index style.
+        generator.IsCustomValue() ? st_gen.index_custom : st_gen.index,
+        //   Prefix for custom values, if any.
+        generator.IsCustomValue() ? chars_generator_custom_index_prefix : "",
+        //   The index itself.
+        generator.IsCustomValue() ? generator.NumCustomValues() : generator.NumGeneratedValues(),
+        // Closing bracket.
+        st_gen.index_brackets,
+        chars_generator_index_suffix
+    );
+
+    // The value as a string.
+    if (generator.ValueConvertibleToString())
+    {
+        std::string value = generator.ValueToString();
 
-        target.entries.push_back(std::move(new_entry));
-    }
+        if (!value.empty())
+        {
+            // The equals sign.
+            terminal.Print(cur_style, "{}{}{}",
+                st_gen.value_separator,
+                chars_generator_value_separator,
+                st_gen.value
+            );
 
-    return "";
-}
+            // The value itself.
 
-void ta_test::modules::GeneratorOverrider::HardErrorInFlag(std::string_view message, const Entry &entry, FlagErrorDetails details, HardErrorKind kind)
-{
-    std::string markers;
-    for (const FlagErrorDetails::Elem &elem : details.elems)
-    {
-        std::size_t offset = 2 + flag_override.flag.size() + 1 + std::size_t(elem.location - entry.original_argument_storage.data());
-        std::size_t needed_size = offset + elem.marker.size();
-        if (markers.size() < needed_size)
-            markers.resize(needed_size, ' ');
+            GeneratorValueShortener shortener(value, chars_generator_value_ellipsis, max_generator_value_prefix_length, max_generator_value_suffix_length);
 
-        std::copy(elem.marker.begin(), elem.marker.end(), markers.begin() + std::ptrdiff_t(offset));
+            if (shortener.is_short)
+            {
+                // The value is short enough to be printed completely.
+                terminal.Print("{}", value);
+            }
+            else
+            {
+                // The value is too long.
+                terminal.Print(cur_style, "{}{}{}{}{}",
+                    shortener.long_prefix,
+                    st_gen.value_ellipsis,
+                    chars_generator_value_ellipsis,
+                    st_gen.value,
+                    shortener.long_suffix
+                );
+            }
+        }
     }
-    if (!details.elems.empty())
-        markers += '\n';
 
-    HardError(CFG_TA_FMT_NAMESPACE::format("In flag:\n--{} {}\n{}{}\n", flag_override.flag, entry.OriginalArgument(), markers, message), kind);
+    terminal.Print("\n");
 }
 
-// --- modules::PrintingConfigurator ---
-
-ta_test::modules::PrintingConfigurator::PrintingConfigurator()
-    : flag_color("color", "Color output using ANSI escape sequences (by default enabled when printing to terminal).",
-        [](const Runner &runner, BasicModule &this_module, bool enable)
-        {
-            (void)this_module;
-            runner.SetEnableColor(enable);
-        }
-    ), flag_unicode("unicode", "Use Unicode characters for pseudographics (enabled by default).",
+ta_test::modules::ProgressPrinter::ProgressPrinter()
+    : flag_progress("progress", "Print test names before running them (enabled by default).",
         [](const Runner &runner, BasicModule &this_module, bool enable)
         {
-            (void)this_module;
-            runner.SetEnableUnicode(enable);
+            (void)runner;
+
+            // The cast should never fail.
+            auto &self = dynamic_cast<ProgressPrinter &>(this_module);
+            self.show_progress = enable;
         }
     )
-{}
+{
+    EnableUnicode(true);
+}
 
-std::vector<ta_test::flags::BasicFlag *> ta_test::modules::PrintingConfigurator::GetFlags() noexcept
+std::vector<ta_test::flags::BasicFlag *> ta_test::modules::ProgressPrinter::GetFlags() noexcept
 {
-    return {&flag_color, &flag_unicode};
+    return {&flag_progress};
 }
 
-// --- modules::ProgressPrinter ---
+void ta_test::modules::ProgressPrinter::EnableUnicode(bool enable)
+{
+    BasicPrintingModule::EnableUnicode(enable);
 
-ta_test::modules::ProgressPrinter::GeneratorValueShortener::GeneratorValueShortener(
-    std::string_view value, std::string_view ellipsis, std::size_t max_prefix, std::size_t max_suffix
-)
+    if (enable)
+    {
+        chars_test_prefix = "\xE2\x97\x8F "; // BLACK CIRCLE, then a space.
+        chars_test_prefix_continuing = "\xE2\x97\x8B "; // WHITE CIRCLE, then a space.
+        chars_indentation = "\xC2\xB7   "; // MIDDLE DOT, then a space.
+        chars_test_counter_separator = " \xE2\x94\x82 "; // BOX DRAWINGS LIGHT VERTICAL, with spaces around it.
+        chars_repetition_counter_separator = " \xE2\x94\x82"; // BOX DRAWINGS LIGHT VERTICAL, with a space to the left.
+        chars_repetition_counter_separator_diagonal = "\xE2\x95\xB0\xE2\x95\xAE"; // BOX DRAWINGS LIGHT ARC UP AND RIGHT, then BOX DRAWINGS LIGHT ARC DOWN AND LEFT
+        chars_test_failed_separator = "\xE2\x94\x81"; // BOX DRAWINGS HEAVY HORIZONTAL
+        chars_test_failed_ending_separator = "\xE2\x94\x80"; // BOX DRAWINGS LIGHT HORIZONTAL
+        chars_summary_path_separator = "      \xE2\x94\x82 "; // BOX DRAWINGS LIGHT VERTICAL, with some spaces around it.
+    }
+    else
+    {
+        chars_test_prefix = "* ";
+        chars_test_prefix_continuing = "+ ";
+        chars_indentation = "    ";
+        chars_test_counter_separator = " | ";
+        chars_repetition_counter_separator = " |";
+        chars_repetition_counter_separator_diagonal = " \\";
+        chars_test_failed_separator = "#";
+        chars_test_failed_ending_separator = "-";
+        chars_summary_path_separator = "      | ";
+    }
+}
+
+void ta_test::modules::ProgressPrinter::OnPreRunTests(const data::RunTestsInfo &data) noexcept
 {
-    // The number of unicode characters in `ellipsis`. This is initialized lazily.
-    std::size_t ellipsis_size = 0;
+    state = {};
 
-    // Where the prefix ends, if the string is longer than `max_prefix`.
-    const char *prefix_end = nullptr;
+    state.num_tests_width = CFG_TA_FMT_NAMESPACE::formatted_size("{}", data.num_tests);
 
-    // `prefix_end` plus the size of the `ellipsis`, if the string is longer than that.
-    const char *imaginary_ellipsis_end = nullptr;
+    // Print a message when some tests are skipped.
+    if (data.num_tests < data.num_tests_with_skipped)
+    {
+        std::size_t num_skipped = data.num_tests_with_skipped - data.num_tests;
 
-    // See if we're at least longer than `max_prefix` plus the size of the ellipsis.
-    std::size_t index = 0;
-    for (const char &ch : value)
+        auto cur_style = terminal.MakeStyleGuard();
+
+        PrintNote(cur_style, CFG_TA_FMT_NAMESPACE::format("Skipping {} test{}, will run {}/{} test{}.",
+            num_skipped,
+            num_skipped != 1 ? "s" : "",
+            data.num_tests,
+            data.num_tests_with_skipped,
+            data.num_tests_with_skipped != 1 ? "s" : ""
+        ));
+    }
+}
+
+void ta_test::modules::ProgressPrinter::OnPostRunTests(const data::RunTestsResults &data) noexcept
+{
+    if (!data.failed_tests.empty())
     {
-        if (text::chars::IsFirstUtf8Byte(ch))
+        auto cur_style = terminal.MakeStyleGuard();
+        terminal.Print(cur_style, "\n{}{}\n\n",
+            common_data.style_error,
+            chars_summary_tests_failed
+        );
+
+        std::size_t max_test_name_width = 0;
+        std::size_t indentation_width = text::chars::NumUtf8Chars(chars_indentation);
+        std::size_t prefix_width = text::chars::NumUtf8Chars(chars_test_prefix);
+
+        // Trim trailing whitespace from `chars_summary_path_separator`.
+        std::string_view summary_path_separator_trimmed = chars_summary_path_separator;
+        if (auto pos = summary_path_separator_trimmed.find_last_not_of(' '); pos != std::string_view::npos)
+            summary_path_separator_trimmed = summary_path_separator_trimmed.substr(0, pos + 1);
+
+        // Determine how much space to leave for the test name tree.
+        for (const data::BasicTest *test : data.failed_tests)
         {
-            if (index == max_prefix)
-            {
-                ellipsis_size = text::chars::NumUtf8Chars(ellipsis);
-                prefix_end = &ch;
-            }
-            else if (index == max_prefix + ellipsis_size)
+            std::string_view test_name = test->Name();
+
+            std::size_t cur_prefix_width = prefix_width;
+
+            text::chars::Split(test_name, '/', [&](std::string_view segment, bool is_last_segment)
             {
-                imaginary_ellipsis_end = &ch;
-                break;
-            }
+                std::size_t this_width = cur_prefix_width + (is_last_segment ? 0 : 1/*for the slash*/) + segment.size();
+                if (this_width > max_test_name_width)
+                    max_test_name_width = this_width;
 
-            index++;
-        }
-    }
+                cur_prefix_width += indentation_width;
 
-    // Maybe we're long, iterate backwards to find the suffix start and whether we even have enough characters for a suffix.
-    if (imaginary_ellipsis_end)
-    {
-        const char *cur = value.data() + value.size();
+                return false;
+            });
+        }
 
-        index = 0;
-        while (cur != imaginary_ellipsis_end)
+        std::vector<std::string_view> stack;
+        for (const data::BasicTest *test : data.failed_tests)
         {
-            cur--;
-            index++;
-            if (index == max_suffix)
+            ProduceTree(stack, test->Name(), [&](std::size_t segment_index, std::string_view segment, bool is_last_segment)
             {
-                is_short = false;
-                long_prefix = {value.data(), prefix_end};
-                long_suffix = {cur, value.data() + value.size()};
-                return;
-            }
+                (void)segment_index;
+
+                // The indentation.
+                if (!stack.empty())
+                {
+                    // Switch to the indentation guide color.
+                    terminal.Print("{}", terminal.AnsiDeltaString(cur_style, style_indentation_guide).data());
+                    // Print the required number of guides.
+                    for (std::size_t repeat = 0; repeat < stack.size(); repeat++)
+                        terminal.Print("{}", chars_indentation);
+                }
+
+                std::size_t gap_to_separator = max_test_name_width - (stack.size() * indentation_width + prefix_width + (is_last_segment ? 0 : 1/*for the slash*/) + segment.size());
+
+                // Print the test name.
+                terminal.Print(cur_style, "{}{}{}{}{:{}}{}{}",
+                    is_last_segment ? style_summary_failed_name : style_summary_failed_group_name,
+                    chars_test_prefix,
+                    segment,
+                    is_last_segment ? "" : "/",
+                    "", int(gap_to_separator),
+                    style_summary_path_separator,
+                    is_last_segment
+                        ? chars_summary_path_separator
+                        // Strip trailing whitespace if we're not going to print a path after this.
+                        // We avoid trailing whitespace in general to make editing the testcases easier.
+                        : summary_path_separator_trimmed
+                );
+
+                // Print the file path for the last segment.
+                if (is_last_segment)
+                {
+                    terminal.Print(cur_style, "{}{}",
+                        style_summary_path,
+                        common_data.LocationToString(test->SourceLocation())
+                    );
+                }
+
+                terminal.Print("\n");
+            });
         }
     }
 
-    is_short = true;
+    state = {};
 }
 
-void ta_test::modules::ProgressPrinter::PrintContextLinePrefix(
-    output::Terminal::StyleGuard &cur_style,
-    const data::RunTestsProgress &all_tests,
-    TestCounterStyle test_counter_style
-) const
+void ta_test::modules::ProgressPrinter::OnPreRunSingleTest(const data::RunSingleTestInfo &data) noexcept
 {
-    // Test index, if necessary.
-    if (test_counter_style != TestCounterStyle::none)
+    // Reset the state.
+    if (data.is_first_generator_repetition)
     {
-        terminal.Print(cur_style, "{}{:{}}{}/{}",
-            test_counter_style == TestCounterStyle::repeated ? style_index_repeated : style_index,
-            state.test_counter + 1, state.num_tests_width,
-            style_total_count,
-            all_tests.num_tests
-        );
-
-        // Failed test count.
-        if (all_tests.failed_tests.size() > 0)
-        {
-            terminal.Print(cur_style, "{}{}{}{}{}{}",
-                style_failed_count_decorations,
-                chars_failed_test_count_prefix,
-                style_failed_count,
-                all_tests.failed_tests.size(),
-                style_failed_count_decorations,
-                chars_failed_test_count_suffix
-            );
-        }
+        bool prev_test_failed = state.per_test.prev_failed;
+        state.per_test = {};
+        state.per_test.prev_failed = prev_test_failed;
     }
     else
     {
-        // No test index, just a gap.
-
-        std::size_t gap_width = state.num_tests_width * 2 + 1;
-
-        if (all_tests.failed_tests.size() > 0)
-            gap_width += CFG_TA_FMT_NAMESPACE::formatted_size("{}", all_tests.failed_tests.size()) + 3;
-
-        terminal.Print("{:{}}", "", gap_width);
+        state.per_test.per_repetition = {};
     }
 
-    // The gutter border.
-    terminal.Print(cur_style, "{}{}",
-        style_gutter_border,
-        chars_test_counter_separator
-    );
-}
-
-void ta_test::modules::ProgressPrinter::PrintContextLineIndentation(output::Terminal::StyleGuard &cur_style, std::size_t depth, std::size_t skip_characters) const
-{
-    // Indentation prefix.
-    terminal.Print(cur_style, "{}{}",
-        style_indentation_guide,
-        chars_pre_indentation
-    );
-
-    std::size_t single_indentation_width = text::chars::NumUtf8Chars(chars_indentation);
-
-    if (skip_characters > single_indentation_width * depth)
-        return; // Everything is skipped.
-
-    depth -= (skip_characters + single_indentation_width - 1) / single_indentation_width;
+    state.per_test.per_repetition.prev_rep_failed = !state.failed_test_stack.empty();
 
-    // Print the first incomplete indentation guide, if partially skipped.
-    if (std::size_t skipped_part = skip_characters % single_indentation_width; skipped_part > 0)
+    if (show_progress)
     {
-        std::size_t i = 0;
-        for (const char &ch : chars_indentation)
-        {
-            if (text::chars::IsFirstUtf8Byte(ch))
-                i++;
+        auto cur_style = terminal.MakeStyleGuard();
 
-            if (i > skipped_part)
+        { // Print the message when first starting tests, or when resuming from a failure.
+            bool is_first_test_first_repetition = state.test_counter == 0 && state.per_test.repetition_counter == 0;
+
+            if (is_first_test_first_repetition || state.per_test.prev_failed || state.per_test.per_repetition.prev_rep_failed)
             {
-                terminal.Print("{}", &ch);
-                break;
+                terminal.Print(cur_style, "\n{}{}\n",
+                    is_first_test_first_repetition ? style_starting_tests : style_continuing_tests,
+                    is_first_test_first_repetition ? chars_starting_tests : chars_continuing_tests
+                );
             }
         }
-    }
 
-    // The indentation.
-    for (std::size_t i = 0; i < depth; i++)
-        terminal.Print("{}", chars_indentation);
-}
+        // Print the current test name (and groups, if any).
+        ProduceTree(state.stack, data.test->Name(), [&](std::size_t segment_index, std::string_view segment, bool is_last_segment)
+        {
 
-void ta_test::modules::ProgressPrinter::PrintGeneratorInfo(
-    output::Terminal::StyleGuard &cur_style, const data::RunSingleTestProgress &test, const data::BasicGenerator &generator, bool repeating_info
-)
-{
-    PrintContextLinePrefix(cur_style, *test.all_tests, state.per_test.per_repetition.printed_counter ? TestCounterStyle::none : TestCounterStyle::repeated);
+            // Whether we're reentering this group after a failed test.
+            bool is_continued = segment_index < state.failed_test_stack.size() && state.failed_test_stack[segment_index] == segment;
 
-    std::size_t repetition_counters_width = CFG_TA_FMT_NAMESPACE::formatted_size("{}", state.per_test.repetition_counter + 1);
-    if (state.per_test.failed_generator_stacks.size() > 0)
-    {
-        repetition_counters_width += text::chars::NumUtf8Chars(chars_failed_repetition_count_prefix);
-        repetition_counters_width += CFG_TA_FMT_NAMESPACE::formatted_size("{}", state.per_test.failed_generator_stacks.size());
-        repetition_counters_width += text::chars::NumUtf8Chars(chars_failed_repetition_count_suffix);
+            PrintContextLinePrefix(cur_style, *data.all_tests,
+                !is_last_segment ? TestCounterStyle::none :
+                is_continued     ? TestCounterStyle::repeated :
+                                   TestCounterStyle::normal
+            );
+            PrintContextLineIndentation(cur_style, state.stack.size(), 0);
+
+            // Print the test name.
+            terminal.Print(cur_style, "{}{}{}{}{}\n",
+                is_continued ? style_prefix_continuing : style_prefix,
+                is_continued ? chars_test_prefix_continuing : chars_test_prefix,
+                is_continued ? style_continuing_group : is_last_segment ? style_name : style_group_name,
+                segment,
+                is_last_segment ? "" : "/"
+            );
+        });
     }
+}
 
-    // Print the repetition counter, or nothing if already printed during this repetition.
-    if (!state.per_test.per_repetition.printed_counter)
-    {
-        // The actual repetition count.
+void ta_test::modules::ProgressPrinter::OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept
+{
+    auto cur_style = terminal.MakeStyleGuard();
 
-        state.per_test.per_repetition.printed_counter = true;
+    // Print the ending separator.
+    if (data.failed)
+    {
+        std::size_t separator_segment_width = text::chars::NumUtf8Chars(chars_test_failed_ending_separator);
+        std::string separator;
+        for (std::size_t i = 0; i + separator_segment_width - 1 < separator_line_width; i += separator_segment_width)
+            separator += chars_test_failed_ending_separator;
 
-        terminal.Print(cur_style, "{}{}",
-            style_repetition_total_count,
-            state.per_test.repetition_counter + 1
+        // The test failure message, and a separator after that.
+        terminal.Print(cur_style, "{}{}\n",
+            style_test_failed_ending_separator,
+            separator
         );
+    }
 
-        // Failed repetition count, if any.
-        if (!state.per_test.failed_generator_stacks.empty())
-        {
-            terminal.Print(cur_style, "{}{}{}{}{}{}",
-                style_repetition_failed_count_decorations,
-                chars_failed_repetition_count_prefix,
-                style_repetition_failed_count,
-                state.per_test.failed_generator_stacks.size(),
-                style_repetition_failed_count_decorations,
-                chars_failed_repetition_count_suffix
-            );
-        }
+    // Adjust the group name stack to show the group names again after a failed test.
+    if (data.failed)
+    {
+        state.failed_test_stack = std::move(state.stack);
+        state.stack.clear();
     }
     else
     {
-        // Empty spacing.
-        terminal.Print("{:{}}", "", repetition_counters_width);
+        state.failed_test_stack.clear();
     }
 
-    // The ending border after the repetition counter.
-    const std::string &repetition_border_string =
-        repetition_counters_width <= state.per_test.last_repetition_counters_width
-        ? chars_repetition_counter_separator
-        : chars_repetition_counter_separator_diagonal;
-    terminal.Print(cur_style, "{}{}",
-        style_repetition_border,
-        repetition_border_string
-    );
-    state.per_test.last_repetition_counters_width = repetition_counters_width;
+    state.per_test.repetition_counter++;
 
-    // Indentation.
-    std::size_t num_chars_removed_from_indentation = std::min(std::size_t(repetition_counters_width) + text::chars::NumUtf8Chars(repetition_border_string), text::chars::NumUtf8Chars(chars_indentation) * state.stack.size());
-    PrintContextLineIndentation(cur_style, state.stack.size() + test.generator_index, num_chars_removed_from_indentation);
+    // Print failed repetitions summary.
+    // Note the weird `!<..>.front().empty()` check. This avoid the message when there was only one repetition without any generators visited.
+    if (data.is_last_generator_repetition && !state.per_test.failed_generator_stacks.empty() && !state.per_test.failed_generator_stacks.front().empty())
+    {
+        std::string_view test_group;
+        std::string_view test_name = data.test->Name();
+        auto sep = test_name.find_last_of('/');
+        if (sep != std::string_view::npos)
+        {
+            test_group = test_name.substr(0, sep + 1);
+            test_name = test_name.substr(sep + 1);
+        }
 
-    const auto &st_gen = repeating_info ? style_generator_repeated : style_generator;
+        // Intentionally always using plural "VARIANTS" here, because seeing "1/N VARIANT" is confusing, because it looks kinda like "first variant".
+        terminal.Print(cur_style, "\n{}{}:\n{}IN TEST {}{}{}{}{}, {}{}{}/{}{} VARIANTS FAILED:\n\n",
+            common_data.style_path,
+            common_data.LocationToString(data.test->SourceLocation()),
+            common_data.style_error,
+            style_failed_group_name,
+            test_group,
+            style_failed_name,
+            test_name,
+            common_data.style_error,
+            style_repetitions_summary_failed_count,
+            state.per_test.failed_generator_stacks.size(),
+            style_repetitions_summary_total_count,
+            state.per_test.repetition_counter,
+            common_data.style_error
+        );
 
-    // The generator name and the value index.
-    terminal.Print(cur_style, "{}{}{}{}{}{}{}{}{}{}{}",
-        // The bullet point.
-        st_gen.prefix,
-        repeating_info ? chars_test_prefix_continuing : chars_test_prefix,
-        // Generator name.
-        st_gen.name,
-        generator.Name(),
-        // Opening bracket.
-        st_gen.index_brackets,
-        chars_generator_index_prefix,
-        // Index:
-        //   Index style.
-        generator.IsCustomValue() ? st_gen.index_custom : st_gen.index,
-        //   Prefix for custom values, if any.
-        generator.IsCustomValue() ? chars_generator_custom_index_prefix : "",
-        //   The index itself.
-        generator.IsCustomValue() ? generator.NumCustomValues() : generator.NumGeneratedValues(),
-        // Closing bracket.
-        st_gen.index_brackets,
-        chars_generator_index_suffix
-    );
+        std::vector<const State::PerTest::FailedGenerator *> cur_stack;
 
-    // The value as a string.
-    if (generator.ValueConvertibleToString())
-    {
-        std::string value = generator.ValueToString();
+        for (const auto &failed_stack : state.per_test.failed_generator_stacks)
+        {
+            for (std::size_t i = 0; i < failed_stack.size(); i++)
+            {
+                const auto &elem = failed_stack[i];
+
+                if (i < cur_stack.size() && *cur_stack[i] == elem)
+                    continue;
+                cur_stack.resize(i);
+                cur_stack.push_back(&elem);
+
+                // Indent.
+                for (std::size_t j = 0; j < i; j++)
+                    terminal.Print(cur_style, "{}{}", style_indentation_guide, chars_indentation);
+
+                // Generator name and index.
+                terminal.Print(cur_style, "{}{}{}{}{}{}{}{}{}{}{}",
+                    style_generator_failed.prefix,
+                    chars_test_prefix,
+                    style_generator_failed.name,
+                    elem.name,
+                    style_generator_failed.index_brackets,
+                    chars_generator_index_prefix,
+                    elem.is_custom_value ? style_generator_failed.index_custom : style_generator_failed.index,
+                    elem.is_custom_value ? chars_generator_custom_index_prefix : "",
+                    elem.index,
+                    style_generator_failed.index_brackets,
+                    chars_generator_index_suffix
+                );
 
-        if (!value.empty())
-        {
-            // The equals sign.
-            terminal.Print(cur_style, "{}{}{}",
-                st_gen.value_separator,
-                chars_generator_value_separator,
-                st_gen.value
-            );
+                // Generator value, if any.
+                if (elem.value)
+                {
+                    // Equals sign.
+                    terminal.Print(cur_style, "{}{}{}",
+                        style_generator_failed.value_separator,
+                        chars_generator_value_separator,
+                        style_generator_failed.value
+                    );
 
-            // The value itself.
+                    GeneratorValueShortener shortener(*elem.value, chars_generator_value_ellipsis, max_generator_value_prefix_length, max_generator_value_suffix_length);
 
-            GeneratorValueShortener shortener(value, chars_generator_value_ellipsis, max_generator_value_prefix_length, max_generator_value_suffix_length);
+                    // The value, possibly shortened.
+                    if (shortener.is_short)
+                    {
+                        terminal.Print("{}", *elem.value);
+                    }
+                    else
+                    {
+                        terminal.Print(cur_style, "{}{}{}{}{}",
+                            shortener.long_prefix,
+                            style_generator_failed.value_ellipsis,
+                            chars_generator_value_ellipsis,
+                            style_generator_failed.value,
+                            shortener.long_suffix
+                        );
+                    }
+                }
 
-            if (shortener.is_short)
-            {
-                // The value is short enough to be printed completely.
-                terminal.Print("{}", value);
-            }
-            else
-            {
-                // The value is too long.
-                terminal.Print(cur_style, "{}{}{}{}{}",
-                    shortener.long_prefix,
-                    st_gen.value_ellipsis,
-                    chars_generator_value_ellipsis,
-                    st_gen.value,
-                    shortener.long_suffix
-                );
+                terminal.Print("\n");
             }
         }
     }
 
-    terminal.Print("\n");
+    // Reset per-test state after the last repetition.
+    // We also do this in `OnPreRunSingleTest()`, so this isn't strictly necessary.
+    if (data.is_last_generator_repetition)
+    {
+        state.test_counter++;
+
+        bool prev_test_failed = !state.per_test.failed_generator_stacks.empty();
+        state.per_test = {};
+        state.per_test.prev_failed = prev_test_failed;
+    }
+    else
+    {
+        state.per_test.per_repetition = {};
+    }
 }
 
-std::string ta_test::modules::ProgressPrinter::MakeGeneratorSummary(const data::RunSingleTestProgress &test) const
+void ta_test::modules::ProgressPrinter::OnPostGenerate(const data::GeneratorCallInfo &data) noexcept
 {
-    std::string ret;
+    if (show_progress)
+    {
+        auto cur_style = terminal.MakeStyleGuard();
+        if (data.generating_new_value || state.per_test.per_repetition.prev_rep_failed)
+            PrintGeneratorInfo(cur_style, *data.test, *data.generator, !data.generating_new_value);
+    }
+}
 
-    for (std::size_t i = 0; i < test.generator_index; i++)
+void ta_test::modules::ProgressPrinter::OnPreFailTest(const data::RunSingleTestProgress &data) noexcept
+{
+    // Remember the failed generator stack.
+    std::vector<State::PerTest::FailedGenerator> failed_generator_stack;
+    failed_generator_stack.reserve(data.generator_stack.size());
+    for (const auto &gen : data.generator_stack)
     {
-        const data::BasicGenerator &gen = *test.generator_stack[i];
+        failed_generator_stack.push_back({
+            .name = std::string(gen->Name()),
+            .index = gen->IsCustomValue() ? gen->NumCustomValues() : gen->NumGeneratedValues(),
+            .is_custom_value = gen->IsCustomValue(),
+            .value = gen->ValueConvertibleToString() ? std::optional(gen->ValueToString()) : std::nullopt,
+            .location = gen->SourceLocation(),
+        });
+    }
+    state.per_test.failed_generator_stacks.push_back(std::move(failed_generator_stack));
 
-        // Print the value as a string.
-        if (gen.ValueConvertibleToString() && gen.ValueConvertibleFromString())
-        {
-            std::string value = gen.ValueToString();
 
-            if (value.size() <= max_generator_summary_value_length)
-            {
-                // Check roundtrip string conversion.
-                value += ','; // Add a separator to make sure `TryFindUnprotectedSeparator` stops right before it.
-                bool roundtrip_ok = false;
-                {
-                    const char *string = value.c_str();
-                    text::chars::TryFindUnprotectedSeparator(string, text::chars::generator_override_separators);
-                    if (string == &value.back())
-                    {
-                        value.pop_back(); // Remove the dummy separator.
-                        string = value.c_str();
-                        std::string error = gen.ValueEqualsToString(string, roundtrip_ok);
-                        if (!error.empty() || string != value.data() + value.size())
-                            roundtrip_ok = false;
-                    }
-                }
+    // Avoid printing the diagnoal separator on the next progress line. It's unnecessary after a bulky failure message.
+    state.per_test.last_repetition_counters_width = std::size_t(-1);
 
-                if (roundtrip_ok)
-                {
-                    if (!ret.empty())
-                        ret += ',';
+    // Find group and test name.
+    std::string_view group;
+    std::string_view name = data.test->Name();
+    auto sep = name.find_last_of('/');
+    if (sep != std::string_view::npos)
+    {
+        group = name.substr(0, sep + 1);
+        name = name.substr(sep + 1);
+    }
 
-                    ret += gen.Name();
-                    ret += '=';
-                    ret += value;
-                    continue;
-                }
-            }
-        }
+    std::string generator_summary = output::MakeGeneratorSummary(data, data.generator_index, max_generator_summary_value_length).value_or("...");
 
-        // Print the value index.
-        if (!gen.IsCustomValue())
-        {
-            if (!ret.empty())
-                ret += ',';
+    std::size_t separator_segment_width = text::chars::NumUtf8Chars(chars_test_failed_separator);
+    std::size_t separator_needed_width =
+        separator_line_width
+        - text::chars::NumUtf8Chars(chars_test_failed)
+        - data.test->Name().size()
+        - generator_summary.size() - 2 * !generator_summary.empty()
+        - 1/*space before separator*/;
+    std::string separator;
+    for (std::size_t i = 0; i + separator_segment_width - 1 < separator_needed_width; i += separator_segment_width)
+        separator += chars_test_failed_separator;
 
-            ret += gen.Name();
-            ret += '#';
-            ret += std::to_string(gen.NumGeneratedValues());
-            continue;
-        }
+    auto cur_style = terminal.MakeStyleGuard();
 
-        { // Fall back to a stub.
-            ret = "...";
-            return ret;
-        }
+    // The test failure message, and a separator after that.
+    terminal.Print(cur_style, "\n{}{}:\n{}{}{}{}{}{}{}{}{} {}{}\n",
+        common_data.style_path,
+        common_data.LocationToString(data.test->SourceLocation()),
+        common_data.style_error,
+        chars_test_failed,
+        style_failed_group_name,
+        group,
+        style_failed_name,
+        name,
+        style_failed_generator_summary,
+        !generator_summary.empty() ? "//" : "",
+        generator_summary,
+        style_test_failed_separator,
+        separator
+    );
+
+    // Print the generator determinism warning, if needed.
+    if (data.generator_index < data.generator_stack.size() &&
+        // And if not all remaining generators failed due to exceptions...
+        // We still want to keep the previous condition, even if it looks redundant, in case `data.generator_index` somehow ends up larger than the stack size.
+        !std::all_of(data.generator_stack.begin() + std::ptrdiff_t(data.generator_index), data.generator_stack.end(), [](const auto &g){return g->CallbackThrewException();})
+    )
+    {
+        PrintWarning(cur_style, "Non-deterministic failure. Previous runs didn't fail here with the same generated values. Some generators will be pruned.");
     }
 
-    return ret;
+    terminal.Print("\n");
 }
 
-ta_test::modules::ProgressPrinter::ProgressPrinter()
-    : flag_progress("progress", "Print test names before running them (enabled by default).",
-        [](const Runner &runner, BasicModule &this_module, bool enable)
+// --- modules::TimingPrinter ---
+
+ta_test::modules::TimingPrinter::TimingPrinter()
+    : flag_slowest("slowest", '\0',
+        "After running the tests, print this many slowest tests, and this many slowest generator repetitions.",
+        [](const Runner &runner, BasicModule &this_module, std::size_t value)
         {
             (void)runner;
-
             // The cast should never fail.
-            auto &self = dynamic_cast<ProgressPrinter &>(this_module);
-            self.show_progress = enable;
+            dynamic_cast<TimingPrinter &>(this_module).num_slowest = value;
         }
     )
-{
-    EnableUnicode(true);
-}
+{}
 
-std::vector<ta_test::flags::BasicFlag *> ta_test::modules::ProgressPrinter::GetFlags() noexcept
+std::vector<ta_test::flags::BasicFlag *> ta_test::modules::TimingPrinter::GetFlags() noexcept
 {
-    return {&flag_progress};
+    return {&flag_slowest};
 }
 
-void ta_test::modules::ProgressPrinter::EnableUnicode(bool enable)
+void ta_test::modules::TimingPrinter::OnPreRunSingleTest(const data::RunSingleTestInfo &data) noexcept
 {
-    BasicPrintingModule::EnableUnicode(enable);
-
-    if (enable)
-    {
-        chars_test_prefix = "\xE2\x97\x8F "; // BLACK CIRCLE, then a space.
-        chars_test_prefix_continuing = "\xE2\x97\x8B "; // WHITE CIRCLE, then a space.
-        chars_indentation = "\xC2\xB7   "; // MIDDLE DOT, then a space.
-        chars_test_counter_separator = " \xE2\x94\x82 "; // BOX DRAWINGS LIGHT VERTICAL, with spaces around it.
-        chars_repetition_counter_separator = " \xE2\x94\x82"; // BOX DRAWINGS LIGHT VERTICAL, with a space to the left.
-        chars_repetition_counter_separator_diagonal = "\xE2\x95\xB0\xE2\x95\xAE"; // BOX DRAWINGS LIGHT ARC UP AND RIGHT, then BOX DRAWINGS LIGHT ARC DOWN AND LEFT
-        chars_test_failed_separator = "\xE2\x94\x81"; // BOX DRAWINGS HEAVY HORIZONTAL
-        chars_test_failed_ending_separator = "\xE2\x94\x80"; // BOX DRAWINGS LIGHT HORIZONTAL
-        chars_summary_path_separator = "      \xE2\x94\x82 "; // BOX DRAWINGS LIGHT VERTICAL, with some spaces around it.
-    }
-    else
-    {
-        chars_test_prefix = "* ";
-        chars_test_prefix_continuing = "+ ";
-        chars_indentation = "    ";
-        chars_test_counter_separator = " | ";
-        chars_repetition_counter_separator = " |";
-        chars_repetition_counter_separator_diagonal = " \\";
-        chars_test_failed_separator = "#";
-        chars_test_failed_ending_separator = "-";
-        chars_summary_path_separator = "      | ";
-    }
+    (void)data;
+    state.generator_summary.clear();
 }
 
-void ta_test::modules::ProgressPrinter::OnPreRunTests(const data::RunTestsInfo &data) noexcept
-{
-    state = {};
-
-    state.num_tests_width = CFG_TA_FMT_NAMESPACE::formatted_size("{}", data.num_tests);
-
-    // Print a message when some tests are skipped.
-    if (data.num_tests < data.num_tests_with_skipped)
-    {
-        std::size_t num_skipped = data.num_tests_with_skipped - data.num_tests;
-
-        auto cur_style = terminal.MakeStyleGuard();
-
-        PrintNote(cur_style, CFG_TA_FMT_NAMESPACE::format("Skipping {} test{}, will run {}/{} test{}.",
-            num_skipped,
-            num_skipped != 1 ? "s" : "",
-            data.num_tests,
-            data.num_tests_with_skipped,
-            data.num_tests_with_skipped != 1 ? "s" : ""
-        ));
-    }
+void ta_test::modules::TimingPrinter::OnPostGenerate(const data::GeneratorCallInfo &data) noexcept
+{
+    if (num_slowest == 0)
+        return;
+
+    // Describe the generators up to and including this one.
+    std::size_t num_generators = 0;
+    while (num_generators < data.test->generator_stack.size() && data.test->generator_stack[num_generators++].get() != data.generator) {}
+    state.generator_summary = output::MakeGeneratorSummary(*data.test, num_generators, max_generator_summary_value_length).value_or("...");
 }
 
-void ta_test::modules::ProgressPrinter::OnPostRunTests(const data::RunTestsResults &data) noexcept
+void ta_test::modules::TimingPrinter::OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept
 {
-    if (!data.failed_tests.empty())
+    if (num_slowest == 0)
+        return;
+
+    // Don't list the tests without generators as repetitions, they're already listed as tests.
+    if (!(data.is_first_generator_repetition && data.is_last_generator_repetition))
     {
-        auto cur_style = terminal.MakeStyleGuard();
-        terminal.Print(cur_style, "\n{}{}\n\n",
-            common_data.style_error,
-            chars_summary_tests_failed
-        );
+        AddEntry(state.repetitions, {
+            .name = CFG_TA_FMT_NAMESPACE::format("{}//{}", data.test->Name(), state.generator_summary),
+            .wall_duration = data.repetition_duration,
+            .cpu_duration = data.repetition_cpu_duration,
+        });
+    }
 
-        std::size_t max_test_name_width = 0;
-        std::size_t indentation_width = text::chars::NumUtf8Chars(chars_indentation);
-        std::size_t prefix_width = text::chars::NumUtf8Chars(chars_test_prefix);
+    if (data.is_last_generator_repetition)
+    {
+        AddEntry(state.tests, {
+            .name = std::string(data.test->Name()),
+            .wall_duration = data.test_duration,
+            .cpu_duration = data.test_cpu_duration,
+        });
+    }
+}
 
-        // Trim trailing whitespace from `chars_summary_path_separator`.
-        std::string_view summary_path_separator_trimmed = chars_summary_path_separator;
-        if (auto pos = summary_path_separator_trimmed.find_last_not_of(' '); pos != std::string_view::npos)
-            summary_path_separator_trimmed = summary_path_separator_trimmed.substr(0, pos + 1);
+void ta_test::modules::TimingPrinter::OnPostRunTests(const data::RunTestsResults &data) noexcept
+{
+    (void)data;
 
-        // Determine how much space to leave for the test name tree.
-        for (const data::BasicTest *test : data.failed_tests)
-        {
-            std::string_view test_name = test->Name();
+    if (num_slowest == 0)
+        return;
 
-            std::size_t cur_prefix_width = prefix_width;
+    auto cur_style = terminal.MakeStyleGuard();
 
-            text::chars::Split(test_name, '/', [&](std::string_view segment, bool is_last_segment)
-            {
-                std::size_t this_width = cur_prefix_width + (is_last_segment ? 0 : 1/*for the slash*/) + segment.size();
-                if (this_width > max_test_name_width)
-                    max_test_name_width = this_width;
+    auto PrintList = [&](std::string_view title, std::vector<Entry> &entries)
+    {
+        if (entries.empty())
+            return;
 
-                cur_prefix_width += indentation_width;
+        KeepSlowest(entries);
 
-                return false;
-            });
-        }
+        terminal.Print(cur_style, "\n{}{}\n\n", style_title, title);
 
-        std::vector<std::string_view> stack;
-        for (const data::BasicTest *test : data.failed_tests)
+        for (const Entry &entry : entries)
         {
-            ProduceTree(stack, test->Name(), [&](std::size_t segment_index, std::string_view segment, bool is_last_segment)
-            {
-                (void)segment_index;
+            terminal.Print(cur_style, "{}{:>10.3f}s  {}{}{:.3f}s  {}{}\n",
+                style_duration,
+                std::chrono::duration<double>(entry.wall_duration).count(),
+                style_cpu_duration,
+                chars_cpu,
+                std::chrono::duration<double>(entry.cpu_duration).count(),
+                style_name,
+                entry.name
+            );
+        }
+    };
 
-                // The indentation.
-                if (!stack.empty())
-                {
-                    // Switch to the indentation guide color.
-                    terminal.Print("{}", terminal.AnsiDeltaString(cur_style, style_indentation_guide).data());
-                    // Print the required number of guides.
-                    for (std::size_t repeat = 0; repeat < stack.size(); repeat++)
-                        terminal.Print("{}", chars_indentation);
-                }
+    PrintList(chars_slowest_tests, state.tests);
+    PrintList(chars_slowest_repetitions, state.repetitions);
+}
 
-                std::size_t gap_to_separator = max_test_name_width - (stack.size() * indentation_width + prefix_width + (is_last_segment ? 0 : 1/*for the slash*/) + segment.size());
+void ta_test::modules::TimingPrinter::AddEntry(std::vector<Entry> &entries, Entry entry) const
+{
+    entries.push_back(std::move(entry));
+    if (entries.size() >= num_slowest * 2)
+        KeepSlowest(entries);
+}
 
-                // Print the test name.
-                terminal.Print(cur_style, "{}{}{}{}{:{}}{}{}",
-                    is_last_segment ? style_summary_failed_name : style_summary_failed_group_name,
-                    chars_test_prefix,
-                    segment,
-                    is_last_segment ? "" : "/",
-                    "", int(gap_to_separator),
-                    style_summary_path_separator,
-                    is_last_segment
-                        ? chars_summary_path_separator
-                        // Strip trailing whitespace if we're not going to print a path after this.
-                        // We avoid trailing whitespace in general to make editing the testcases easier.
-                        : summary_path_separator_trimmed
-                );
+void ta_test::modules::TimingPrinter::KeepSlowest(std::vector<Entry> &entries) const
+{
+    auto IsSlower = [](const Entry &a, const Entry &b){return a.wall_duration > b.wall_duration;};
 
-                // Print the file path for the last segment.
-                if (is_last_segment)
-                {
-                    terminal.Print(cur_style, "{}{}",
-                        style_summary_path,
-                        common_data.LocationToString(test->SourceLocation())
-                    );
-                }
+    if (entries.size() > num_slowest)
+    {
+        std::nth_element(entries.begin(), entries.begin() + std::ptrdiff_t(num_slowest), entries.end(), IsSlower);
+        entries.resize(num_slowest);
+    }
+    std::stable_sort(entries.begin(), entries.end(), IsSlower);
+}
 
-                terminal.Print("\n");
-            });
+// --- modules::AllocationPrinter ---
+
+ta_test::modules::AllocationPrinter::AllocationPrinter()
+    : flag_allocations("allocations",
+        "After running the tests, print how many heap allocations each test made, its peak heap usage, and how much memory it didn't free. "
+        "Needs the library to be built with `CFG_TA_TRACK_ALLOCATIONS=1`.",
+        [](const Runner &runner, BasicModule &this_module, bool enable)
+        {
+            (void)runner;
+            // The cast should never fail.
+            dynamic_cast<AllocationPrinter &>(this_module).enabled = enable;
         }
-    }
+    )
+{}
 
-    state = {};
+std::vector<ta_test::flags::BasicFlag *> ta_test::modules::AllocationPrinter::GetFlags() noexcept
+{
+    return {&flag_allocations};
 }
 
-void ta_test::modules::ProgressPrinter::OnPreRunSingleTest(const data::RunSingleTestInfo &data) noexcept
+void ta_test::modules::AllocationPrinter::OnPreRunTests(const data::RunTestsInfo &data) noexcept
 {
-    // Reset the state.
+    (void)data;
+    if (enabled && !detail::AllocationTrackingEnabled())
+        HardError("`--allocations` needs the library to be built with `CFG_TA_TRACK_ALLOCATIONS=1`.", HardErrorKind::user);
+}
+
+void ta_test::modules::AllocationPrinter::OnCheckParallelTest(const data::BasicTest &test, ParallelTestMode &mode) noexcept
+{
+    (void)test;
+    if (enabled)
+        mode = ParallelTestMode::main_thread;
+}
+
+void ta_test::modules::AllocationPrinter::OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept
+{
+    if (!enabled)
+        return;
+
     if (data.is_first_generator_repetition)
     {
-        bool prev_test_failed = state.per_test.prev_failed;
-        state.per_test = {};
-        state.per_test.prev_failed = prev_test_failed;
-    }
-    else
-    {
-        state.per_test.per_repetition = {};
+        state.current = {};
+        state.current.name = data.test->Name();
     }
 
-    state.per_test.per_repetition.prev_rep_failed = !state.failed_test_stack.empty();
+    const data::AllocationStats &stats = data.allocations;
+    state.current.stats.num_allocations += stats.num_allocations;
+    state.current.stats.num_deallocations += stats.num_deallocations;
+    state.current.stats.allocated_bytes += stats.allocated_bytes;
+    state.current.stats.live_bytes += stats.live_bytes;
+    state.current.stats.peak_live_bytes = std::max(state.current.stats.peak_live_bytes, stats.peak_live_bytes);
+    if (stats.live_bytes > 0)
+        state.current.leaked_bytes += std::size_t(stats.live_bytes);
 
-    if (show_progress)
+    if (data.is_last_generator_repetition && state.current.stats.num_allocations > 0)
+        state.tests.push_back(std::move(state.current));
+}
+
+void ta_test::modules::AllocationPrinter::OnPostRunTests(const data::RunTestsResults &data) noexcept
+{
+    (void)data;
+
+    if (!enabled || state.tests.empty())
+        return;
+
+    auto cur_style = terminal.MakeStyleGuard();
+
+    terminal.Print(cur_style, "\n{}{}\n\n", style_title, chars_title);
+
+    for (const Entry &entry : state.tests)
     {
-        auto cur_style = terminal.MakeStyleGuard();
+        terminal.Print(cur_style, "{}{:>8}{} allocs {}{:>12}{} bytes, peak {}{:>12}{}, {}{:>10}{} leaked  {}{}\n",
+            style_value, entry.stats.num_allocations, style_label,
+            style_value, entry.stats.allocated_bytes, style_label,
+            style_value, entry.stats.peak_live_bytes, style_label,
+            entry.leaked_bytes > 0 ? style_leak : style_value, entry.leaked_bytes, style_label,
+            style_name, entry.name
+        );
+    }
+}
 
-        { // Print the message when first starting tests, or when resuming from a failure.
-            bool is_first_test_first_repetition = state.test_counter == 0 && state.per_test.repetition_counter == 0;
+// --- modules::BenchmarkPrinter ---
 
-            if (is_first_test_first_repetition || state.per_test.prev_failed || state.per_test.per_repetition.prev_rep_failed)
-            {
-                terminal.Print(cur_style, "\n{}{}\n",
-                    is_first_test_first_repetition ? style_starting_tests : style_continuing_tests,
-                    is_first_test_first_repetition ? chars_starting_tests : chars_continuing_tests
-                );
-            }
+ta_test::modules::BenchmarkPrinter::BenchmarkPrinter()
+    : flag_samples("benchmark-samples", '\0',
+        "How many samples to measure in each `TA_BENCHMARK(...)` loop.",
+        [](const Runner &runner, BasicModule &this_module, std::size_t value)
+        {
+            (void)runner;
+            // The cast should never fail.
+            dynamic_cast<BenchmarkPrinter &>(this_module).settings.num_samples = std::max(value, std::size_t(1));
         }
-
-        // Print the current test name (and groups, if any).
-        ProduceTree(state.stack, data.test->Name(), [&](std::size_t segment_index, std::string_view segment, bool is_last_segment)
+    ),
+    flag_sample_time("benchmark-sample-ms", '\0',
+        "The minimal duration of a single benchmark sample, in milliseconds. The number of iterations per sample is chosen to reach it.",
+        [](const Runner &runner, BasicModule &this_module, std::size_t value)
+        {
+            (void)runner;
+            // The cast should never fail.
+            dynamic_cast<BenchmarkPrinter &>(this_module).settings.min_sample_time = std::chrono::milliseconds(value);
+        }
+    ),
+    flag_warmup_time("benchmark-warmup-ms", '\0',
+        "How long to run each benchmark before measuring it, in milliseconds.",
+        [](const Runner &runner, BasicModule &this_module, std::size_t value)
+        {
+            (void)runner;
+            // The cast should never fail.
+            dynamic_cast<BenchmarkPrinter &>(this_module).settings.warmup_time = std::chrono::milliseconds(value);
+        }
+    ),
+    flag_counters("benchmark-counters",
+        "Also report the hardware performance counters (cycles, instructions, cache misses, branch misses) per iteration of each benchmark. "
+        "Currently only on Linux. If the counters are disallowed by the kernel, this does nothing.",
+        [](const Runner &runner, BasicModule &this_module, bool enable)
         {
+            (void)runner;
+            // The cast should never fail.
+            dynamic_cast<BenchmarkPrinter &>(this_module).settings.hardware_counters = enable;
+        }
+    )
+{}
 
-            // Whether we're reentering this group after a failed test.
-            bool is_continued = segment_index < state.failed_test_stack.size() && state.failed_test_stack[segment_index] == segment;
+std::vector<ta_test::flags::BasicFlag *> ta_test::modules::BenchmarkPrinter::GetFlags() noexcept
+{
+    return {&flag_samples, &flag_sample_time, &flag_warmup_time, &flag_counters};
+}
 
-            PrintContextLinePrefix(cur_style, *data.all_tests,
-                !is_last_segment ? TestCounterStyle::none :
-                is_continued     ? TestCounterStyle::repeated :
-                                   TestCounterStyle::normal
-            );
-            PrintContextLineIndentation(cur_style, state.stack.size(), 0);
+void ta_test::modules::BenchmarkPrinter::OnCheckParallelTest(const data::BasicTest &test, ParallelTestMode &mode) noexcept
+{
+    if (bool(test.Flags() & TestFlags::benchmark))
+        mode = ParallelTestMode::main_thread;
+}
 
-            // Print the test name.
-            terminal.Print(cur_style, "{}{}{}{}{}\n",
-                is_continued ? style_prefix_continuing : style_prefix,
-                is_continued ? chars_test_prefix_continuing : chars_test_prefix,
-                is_continued ? style_continuing_group : is_last_segment ? style_name : style_group_name,
-                segment,
-                is_last_segment ? "" : "/"
-            );
-        });
-    }
+void ta_test::modules::BenchmarkPrinter::OnPreBenchmark(const data::RunSingleTestInfo &test, data::BenchmarkSettings &settings) noexcept
+{
+    (void)test;
+    settings = this->settings;
 }
 
-void ta_test::modules::ProgressPrinter::OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept
+void ta_test::modules::BenchmarkPrinter::OnPostBenchmark(const data::BenchmarkResults &results) noexcept
 {
     auto cur_style = terminal.MakeStyleGuard();
 
-    // Print the ending separator.
-    if (data.failed)
+    terminal.Print(cur_style, "{}{}median {}{}{}, MAD {}{}{}, min {}{}{}, max {}{}{}, {} samples x {} iterations\n",
+        chars_indentation,
+        style_label,
+        style_median, FormatNanoseconds(results.median), style_label,
+        style_value, FormatNanoseconds(results.mad), style_label,
+        style_value, FormatNanoseconds(results.min), style_label,
+        style_value, FormatNanoseconds(results.max), style_label,
+        results.samples.size(),
+        results.iterations_per_sample
+    );
+
+    if (results.settings.hardware_counters)
     {
-        std::size_t separator_segment_width = text::chars::NumUtf8Chars(chars_test_failed_ending_separator);
-        std::string separator;
-        for (std::size_t i = 0; i + separator_segment_width - 1 < separator_line_width; i += separator_segment_width)
-            separator += chars_test_failed_ending_separator;
+        const data::BenchmarkCounters &c = results.counters;
+        if (!c.cycles && !c.instructions && !c.cache_misses && !c.branch_misses)
+        {
+            if (!printed_counters_unavailable)
+            {
+                printed_counters_unavailable = true;
+                terminal.Print(cur_style, "{}{}{}\n", chars_indentation, common_data.style_warning, chars_counters_unavailable);
+            }
+        }
+        else
+        {
+            auto Format = [](const std::optional<double> &value)
+            {
+                return value ? CFG_TA_FMT_NAMESPACE::format("{:.1f}", *value) : "n/a";
+            };
 
-        // The test failure message, and a separator after that.
-        terminal.Print(cur_style, "{}{}\n",
-            style_test_failed_ending_separator,
-            separator
-        );
+            terminal.Print(cur_style, "{}{}cycles {}{}{}, instructions {}{}{}",
+                chars_indentation,
+                style_label,
+                style_value, Format(c.cycles), style_label,
+                style_value, Format(c.instructions), style_label
+            );
+            if (c.cycles && c.instructions && *c.cycles > 0)
+                terminal.Print(cur_style, " (IPC {}{:.2f}{})", style_value, *c.instructions / *c.cycles, style_label);
+            terminal.Print(cur_style, ", cache misses {}{}{}, branch misses {}{}{} per iteration\n",
+                style_value, Format(c.cache_misses), style_label,
+                style_value, Format(c.branch_misses), style_label
+            );
+        }
     }
+}
 
-    // Adjust the group name stack to show the group names again after a failed test.
-    if (data.failed)
-    {
-        state.failed_test_stack = std::move(state.stack);
-        state.stack.clear();
-    }
+std::string ta_test::modules::BenchmarkPrinter::FormatNanoseconds(double ns)
+{
+    if (ns < 1e3)
+        return CFG_TA_FMT_NAMESPACE::format("{:.2f}ns", ns);
+    else if (ns < 1e6)
+        return CFG_TA_FMT_NAMESPACE::format("{:.2f}us", ns / 1e3);
+    else if (ns < 1e9)
+        return CFG_TA_FMT_NAMESPACE::format("{:.2f}ms", ns / 1e6);
     else
-    {
-        state.failed_test_stack.clear();
-    }
+        return CFG_TA_FMT_NAMESPACE::format("{:.2f}s", ns / 1e9);
+}
 
-    state.per_test.repetition_counter++;
+// --- modules::BenchmarkBaseline ---
 
-    // Print failed repetitions summary.
-    // Note the weird `!<..>.front().empty()` check. This avoid the message when there was only one repetition without any generators visited.
-    if (data.is_last_generator_repetition && !state.per_test.failed_generator_stacks.empty() && !state.per_test.failed_generator_stacks.front().empty())
-    {
-        std::string_view test_group;
-        std::string_view test_name = data.test->Name();
-        auto sep = test_name.find_last_of('/');
-        if (sep != std::string_view::npos)
+ta_test::modules::BenchmarkBaseline::BenchmarkBaseline()
+    : flag_save("benchmark-save", '\0',
+        "Save the benchmark results to this file, to later pass it to `--benchmark-compare`. The benchmarks that didn't run keep their old results in the file.",
+        [](const Runner &runner, BasicModule &this_module, std::string_view value)
         {
-            test_group = test_name.substr(0, sep + 1);
-            test_name = test_name.substr(sep + 1);
+            (void)runner;
+            // The cast should never fail.
+            dynamic_cast<BenchmarkBaseline &>(this_module).save_path = value;
+        }
+    ),
+    flag_compare("benchmark-compare", '\0',
+        "Compare the benchmark results against this file, saved by `--benchmark-save`. "
+        "Benchmarks that got significantly slower fail. Benchmarks missing from the file are not checked.",
+        [](const Runner &runner, BasicModule &this_module, std::string_view value)
+        {
+            (void)runner;
+            // The cast should never fail.
+            dynamic_cast<BenchmarkBaseline &>(this_module).compare_path = value;
+        }
+    ),
+    flag_threshold("benchmark-threshold", '\0',
+        "With `--benchmark-compare`, how many percent slower the median must get to count as a regression. Can be fractional. Defaults to 5.",
+        [](const Runner &runner, BasicModule &this_module, std::string_view value)
+        {
+            (void)runner;
+
+            // Copy to get a null terminator.
+            std::string str(value);
+            const char *end = str.c_str();
+            double percent = string_conv::strto<double>(str.c_str(), &end);
+            if (str.empty() || *end != '\0' || !std::isfinite(percent) || percent < 0)
+                HardError(CFG_TA_FMT_NAMESPACE::format("Expected a non-negative number after `--benchmark-threshold`, but got `{}`.", value), HardErrorKind::user);
+
+            // The cast should never fail.
+            dynamic_cast<BenchmarkBaseline &>(this_module).threshold_percent = percent;
         }
+    )
+{}
 
-        // Intentionally always using plural "VARIANTS" here, because seeing "1/N VARIANT" is confusing, because it looks kinda like "first variant".
-        terminal.Print(cur_style, "\n{}{}:\n{}IN TEST {}{}{}{}{}, {}{}{}/{}{} VARIANTS FAILED:\n\n",
-            common_data.style_path,
-            common_data.LocationToString(data.test->SourceLocation()),
-            common_data.style_error,
-            style_failed_group_name,
-            test_group,
-            style_failed_name,
-            test_name,
-            common_data.style_error,
-            style_repetitions_summary_failed_count,
-            state.per_test.failed_generator_stacks.size(),
-            style_repetitions_summary_total_count,
-            state.per_test.repetition_counter,
-            common_data.style_error
-        );
+std::vector<ta_test::flags::BasicFlag *> ta_test::modules::BenchmarkBaseline::GetFlags() noexcept
+{
+    return {&flag_save, &flag_compare, &flag_threshold};
+}
 
-        std::vector<const State::PerTest::FailedGenerator *> cur_stack;
+void ta_test::modules::BenchmarkBaseline::OnPreRunTests(const data::RunTestsInfo &data) noexcept
+{
+    (void)data;
 
-        for (const auto &failed_stack : state.per_test.failed_generator_stacks)
-        {
-            for (std::size_t i = 0; i < failed_stack.size(); i++)
-            {
-                const auto &elem = failed_stack[i];
+    // Unlike the baseline, the file we're saving to doesn't have to exist yet.
+    if (!save_path.empty() && std::filesystem::exists(save_path))
+        saved_entries = LoadFile(save_path);
+    if (!compare_path.empty())
+        baseline_entries = LoadFile(compare_path);
+}
 
-                if (i < cur_stack.size() && *cur_stack[i] == elem)
-                    continue;
-                cur_stack.resize(i);
-                cur_stack.push_back(&elem);
+void ta_test::modules::BenchmarkBaseline::OnCheckParallelTest(const data::BasicTest &test, ParallelTestMode &mode) noexcept
+{
+    // We can't observe the benchmarks running on worker threads.
+    if ((!save_path.empty() || !compare_path.empty()) && bool(test.Flags() & TestFlags::benchmark))
+        mode = ParallelTestMode::main_thread;
+}
 
-                // Indent.
-                for (std::size_t j = 0; j < i; j++)
-                    terminal.Print(cur_style, "{}{}", style_indentation_guide, chars_indentation);
+void ta_test::modules::BenchmarkBaseline::OnPreRunSingleTest(const data::RunSingleTestInfo &data) noexcept
+{
+    (void)data;
+    num_loops_in_repetition = 0;
+}
 
-                // Generator name and index.
-                terminal.Print(cur_style, "{}{}{}{}{}{}{}{}{}{}{}",
-                    style_generator_failed.prefix,
-                    chars_test_prefix,
-                    style_generator_failed.name,
-                    elem.name,
-                    style_generator_failed.index_brackets,
-                    chars_generator_index_prefix,
-                    elem.is_custom_value ? style_generator_failed.index_custom : style_generator_failed.index,
-                    elem.is_custom_value ? chars_generator_custom_index_prefix : "",
-                    elem.index,
-                    style_generator_failed.index_brackets,
-                    chars_generator_index_suffix
-                );
+void ta_test::modules::BenchmarkBaseline::OnPostBenchmark(const data::BenchmarkResults &results) noexcept
+{
+    if (save_path.empty() && compare_path.empty())
+        return;
 
-                // Generator value, if any.
-                if (elem.value)
-                {
-                    // Equals sign.
-                    terminal.Print(cur_style, "{}{}{}",
-                        style_generator_failed.value_separator,
-                        chars_generator_value_separator,
-                        style_generator_failed.value
-                    );
+    std::string name = MakeName(results, num_loops_in_repetition++);
 
-                    GeneratorValueShortener shortener(*elem.value, chars_generator_value_ellipsis, max_generator_value_prefix_length, max_generator_value_suffix_length);
+    if (!compare_path.empty())
+    {
+        auto iter = baseline_entries.find(name);
+        if (iter != baseline_entries.end() && !iter->second.empty())
+        {
+            std::vector<double> sorted = iter->second;
+            std::sort(sorted.begin(), sorted.end());
+            double baseline_median = sorted.size() % 2 ? sorted[sorted.size() / 2] : (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]) / 2;
 
-                    // The value, possibly shortened.
-                    if (shortener.is_short)
-                    {
-                        terminal.Print("{}", *elem.value);
-                    }
-                    else
-                    {
-                        terminal.Print(cur_style, "{}{}{}{}{}",
-                            shortener.long_prefix,
-                            style_generator_failed.value_ellipsis,
-                            chars_generator_value_ellipsis,
-                            style_generator_failed.value,
-                            shortener.long_suffix
-                        );
-                    }
+            if (results.median > baseline_median * (1 + threshold_percent / 100))
+            {
+                double p = MannWhitneyPValue(results.samples, iter->second);
+                if (p < significance_level)
+                {
+                    detail::ThreadState().FailCurrentTest();
+
+                    auto cur_style = terminal.MakeStyleGuard();
+                    terminal.Print(cur_style, "{}{}{}{}{}\n    median {} -> {} (+{:.1f}%, threshold {:g}%), p = {:.4f}\n\n",
+                        style_regression, chars_regression,
+                        style_name, name,
+                        style_details,
+                        BenchmarkPrinter::FormatNanoseconds(baseline_median),
+                        BenchmarkPrinter::FormatNanoseconds(results.median),
+                        (results.median / baseline_median - 1) * 100,
+                        threshold_percent,
+                        p
+                    );
                 }
-
-                terminal.Print("\n");
             }
         }
     }
 
-    // Reset per-test state after the last repetition.
-    // We also do this in `OnPreRunSingleTest()`, so this isn't strictly necessary.
-    if (data.is_last_generator_repetition)
-    {
-        state.test_counter++;
+    if (!save_path.empty())
+        saved_entries.insert_or_assign(std::move(name), results.samples);
+}
 
-        bool prev_test_failed = !state.per_test.failed_generator_stacks.empty();
-        state.per_test = {};
-        state.per_test.prev_failed = prev_test_failed;
-    }
-    else
-    {
-        state.per_test.per_repetition = {};
-    }
+void ta_test::modules::BenchmarkBaseline::OnPostRunTests(const data::RunTestsResults &data) noexcept
+{
+    (void)data;
+
+    if (!save_path.empty())
+        SaveFile(save_path, saved_entries);
 }
 
-void ta_test::modules::ProgressPrinter::OnPostGenerate(const data::GeneratorCallInfo &data) noexcept
+std::string ta_test::modules::BenchmarkBaseline::MakeName(const data::BenchmarkResults &results, std::size_t loop_index) const
 {
-    if (show_progress)
+    std::string ret(results.test->test->Name());
+
+    // Only the generators that were already visited in this repetition.
+    if (results.test->generator_index > 0)
     {
-        auto cur_style = terminal.MakeStyleGuard();
-        if (data.generating_new_value || state.per_test.per_repetition.prev_rep_failed)
-            PrintGeneratorInfo(cur_style, *data.test, *data.generator, !data.generating_new_value);
+        ret += "//";
+        ret += output::MakeGeneratorSummary(*results.test, results.test->generator_index, max_generator_summary_value_length).value_or("...");
     }
+
+    if (loop_index > 0)
+        ret += CFG_TA_FMT_NAMESPACE::format(":{}", loop_index + 1);
+
+    return ret;
 }
 
-void ta_test::modules::ProgressPrinter::OnPreFailTest(const data::RunSingleTestProgress &data) noexcept
+double ta_test::modules::BenchmarkBaseline::MannWhitneyPValue(std::span<const double> current, std::span<const double> baseline)
 {
-    // Remember the failed generator stack.
-    std::vector<State::PerTest::FailedGenerator> failed_generator_stack;
-    failed_generator_stack.reserve(data.generator_stack.size());
-    for (const auto &gen : data.generator_stack)
+    if (current.empty() || baseline.empty())
+        return 1;
+
+    const double n1 = double(current.size());
+    const double n2 = double(baseline.size());
+    const double n = n1 + n2;
+
+    // Rank the combined samples, averaging the ranks of the ties.
+    std::vector<std::pair<double, bool>> combined; // The bool is true for `current`.
+    combined.reserve(current.size() + baseline.size());
+    for (double x : current)
+        combined.emplace_back(x, true);
+    for (double x : baseline)
+        combined.emplace_back(x, false);
+    std::sort(combined.begin(), combined.end(), [](const auto &a, const auto &b){return a.first < b.first;});
+
+    double current_rank_sum = 0;
+    double tie_term = 0; // Sum of `t^3 - t` over the groups of ties.
+    for (std::size_t i = 0; i < combined.size();)
     {
-        failed_generator_stack.push_back({
-            .name = std::string(gen->Name()),
-            .index = gen->IsCustomValue() ? gen->NumCustomValues() : gen->NumGeneratedValues(),
-            .is_custom_value = gen->IsCustomValue(),
-            .value = gen->ValueConvertibleToString() ? std::optional(gen->ValueToString()) : std::nullopt,
-            .location = gen->SourceLocation(),
-        });
+        std::size_t j = i + 1;
+        while (j < combined.size() && combined[j].first == combined[i].first)
+            j++;
+
+        double rank = (double(i) + double(j) + 1) / 2; // The average of the 1-based ranks `i+1 .. j`.
+        for (std::size_t k = i; k < j; k++)
+        {
+            if (combined[k].second)
+                current_rank_sum += rank;
+        }
+
+        double t = double(j - i);
+        tie_term += t * t * t - t;
+        i = j;
     }
-    state.per_test.failed_generator_stacks.push_back(std::move(failed_generator_stack));
 
+    double u = current_rank_sum - n1 * (n1 + 1) / 2;
+    double mean = n1 * n2 / 2;
+    double variance = n1 * n2 / 12 * (n + 1 - tie_term / (n * (n - 1)));
+    if (!(variance > 0))
+        return 1; // All values are equal.
 
-    // Avoid printing the diagnoal separator on the next progress line. It's unnecessary after a bulky failure message.
-    state.per_test.last_repetition_counters_width = std::size_t(-1);
+    // With the continuity correction.
+    double z = (u - mean - 0.5) / std::sqrt(variance);
+    return std::erfc(z / std::sqrt(2.)) / 2;
+}
 
-    // Find group and test name.
-    std::string_view group;
-    std::string_view name = data.test->Name();
-    auto sep = name.find_last_of('/');
-    if (sep != std::string_view::npos)
+ta_test::modules::BenchmarkBaseline::Entries ta_test::modules::BenchmarkBaseline::LoadFile(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+        HardError(CFG_TA_FMT_NAMESPACE::format("Unable to open the benchmark baseline `{}`.", path), HardErrorKind::user);
+
+    Entries ret;
+
+    std::string line;
+    std::size_t line_number = 0;
+    while (std::getline(file, line))
     {
-        group = name.substr(0, sep + 1);
-        name = name.substr(sep + 1);
-    }
+        line_number++;
+        if (line.empty())
+            continue;
 
-    std::string generator_summary = MakeGeneratorSummary(data);
+        auto Fail = [&]
+        {
+            HardError(CFG_TA_FMT_NAMESPACE::format("In the benchmark baseline `{}`, line {}: expected `<number of samples> <samples...> <name>`.", path, line_number), HardErrorKind::user);
+        };
 
-    std::size_t separator_segment_width = text::chars::NumUtf8Chars(chars_test_failed_separator);
-    std::size_t separator_needed_width =
-        separator_line_width
-        - text::chars::NumUtf8Chars(chars_test_failed)
-        - data.test->Name().size()
-        - generator_summary.size() - 2 * !generator_summary.empty()
-        - 1/*space before separator*/;
-    std::string separator;
-    for (std::size_t i = 0; i + separator_segment_width - 1 < separator_needed_width; i += separator_segment_width)
-        separator += chars_test_failed_separator;
+        const char *cur = line.c_str();
+        const char *end = cur;
 
-    auto cur_style = terminal.MakeStyleGuard();
+        std::size_t num_samples = string_conv::strto<std::size_t>(cur, &end, 10);
+        if (end == cur || *end != ' ')
+            Fail();
+        cur = end + 1;
 
-    // The test failure message, and a separator after that.
-    terminal.Print(cur_style, "\n{}{}:\n{}{}{}{}{}{}{}{}{} {}{}\n",
-        common_data.style_path,
-        common_data.LocationToString(data.test->SourceLocation()),
-        common_data.style_error,
-        chars_test_failed,
-        style_failed_group_name,
-        group,
-        style_failed_name,
-        name,
-        style_failed_generator_summary,
-        !generator_summary.empty() ? "//" : "",
-        generator_summary,
-        style_test_failed_separator,
-        separator
-    );
+        std::vector<double> samples;
+        samples.reserve(num_samples);
+        for (std::size_t i = 0; i < num_samples; i++)
+        {
+            double sample = string_conv::strto<double>(cur, &end);
+            if (end == cur || *end != ' ' || !(sample >= 0))
+                Fail();
+            samples.push_back(sample);
+            cur = end + 1;
+        }
 
-    // Print the generator determinism warning, if needed.
-    if (data.generator_index < data.generator_stack.size() &&
-        // And if not all remaining generators failed due to exceptions...
-        // We still want to keep the previous condition, even if it looks redundant, in case `data.generator_index` somehow ends up larger than the stack size.
-        !std::all_of(data.generator_stack.begin() + std::ptrdiff_t(data.generator_index), data.generator_stack.end(), [](const auto &g){return g->CallbackThrewException();})
-    )
+        ret.insert_or_assign(std::string(cur), std::move(samples));
+    }
+
+    return ret;
+}
+
+void ta_test::modules::BenchmarkBaseline::SaveFile(const std::string &path, const Entries &entries)
+{
+    std::ofstream file(path);
+    if (!file)
+        HardError(CFG_TA_FMT_NAMESPACE::format("Unable to write the benchmark baseline `{}`.", path), HardErrorKind::user);
+
+    for (const auto &[name, samples] : entries)
     {
-        PrintWarning(cur_style, "Non-deterministic failure. Previous runs didn't fail here with the same generated values. Some generators will be pruned.");
+        file << samples.size();
+        for (double sample : samples)
+            file << CFG_TA_FMT_NAMESPACE::format(" {}", sample); // The shortest representation that roundtrips exactly.
+        file << ' ' << name << '\n';
     }
 
-    terminal.Print("\n");
+    if (!file)
+        HardError(CFG_TA_FMT_NAMESPACE::format("Unable to write the benchmark baseline `{}`.", path), HardErrorKind::user);
 }
 
 // --- modules::ResultsPrinter ---
@@ -5230,33 +8871,113 @@ void ta_test::modules::AssertionPrinter::PrintAssertionFrameLow(output::Terminal
         }
     }
 
+    // The extra details, after an empty line.
+    if (auto details = data.Details())
+    {
+        std::size_t line = canvas.NumLines() + 1;
+        text::chars::Split(*details, '\n', [&](std::string_view segment, bool last)
+        {
+            (void)last;
+            canvas.DrawString(line++, 0, segment, {.style = style_details, .important = true});
+            return false;
+        });
+    }
+
     canvas.InsertLineBefore(canvas.NumLines());
     canvas.Print(terminal, cur_style);
 }
 
 // --- modules::LogPrinter
 
+ta_test::modules::LogPrinter::LogPrinter()
+    : flag_log_capacity("log-capacity", '\0',
+        "Limit the unscoped log (`TA_LOG(...)`) of each test to this many last entries, to save memory. "
+        "Use `M,N` to keep the first M entries and the last N entries. The discarded entries are reported as omitted.",
+        [](const Runner &runner, BasicModule &this_module, std::string_view value)
+        {
+            (void)runner;
+
+            context::LogCapacity capacity{.limited = true};
+
+            auto ParseNumber = [&](std::string_view part) -> std::size_t
+            {
+                // Copy to get a null terminator.
+                std::string str(part);
+                const char *end = str.c_str();
+                std::size_t ret = string_conv::strto<std::size_t>(str.c_str(), &end, 10);
+                if (str.empty() || str.starts_with('-') || *end != '\0')
+                    HardError(CFG_TA_FMT_NAMESPACE::format("Expected `N` or `M,N` with non-negative integers after `--log-capacity`, but got `{}`.", value), HardErrorKind::user);
+                return ret;
+            };
+
+            if (auto comma = value.find(','); comma != std::string_view::npos)
+            {
+                capacity.keep_first = ParseNumber(value.substr(0, comma));
+                capacity.keep_last = ParseNumber(value.substr(comma + 1));
+            }
+            else
+            {
+                capacity.keep_last = ParseNumber(value);
+            }
+
+            // The cast should never fail.
+            dynamic_cast<LogPrinter &>(this_module).log_capacity = capacity;
+        }
+    )
+{}
+
+std::vector<ta_test::flags::BasicFlag *> ta_test::modules::LogPrinter::GetFlags() noexcept
+{
+    return {&flag_log_capacity};
+}
+
+void ta_test::modules::LogPrinter::OnChooseLogCapacity(context::LogCapacity &capacity) noexcept
+{
+    if (log_capacity.limited)
+        capacity = log_capacity;
+}
+
 void ta_test::modules::LogPrinter::OnPreRunSingleTest(const data::RunSingleTestInfo &data) noexcept
 {
     (void)data;
-    unscoped_log_pos = 0;
+    unscoped_log_next_id = 0;
+    unscoped_log_prev_size = 0;
 }
 
 void ta_test::modules::LogPrinter::OnPostRunSingleTest(const data::RunSingleTestResults &data) noexcept
 {
     // Doing it in both places (before and after a test) is redundant, but doesn't hurt.
     (void)data;
-    unscoped_log_pos = 0;
+    unscoped_log_next_id = 0;
+    unscoped_log_prev_size = 0;
 }
 
-bool ta_test::modules::LogPrinter::PrintLogEntries(output::Terminal::StyleGuard &cur_style, std::span<const context::LogEntry> unscoped_log, std::span<const context::LogEntry *const> scoped_log) noexcept
+bool ta_test::modules::LogPrinter::PrintLogEntries(output::Terminal::StyleGuard &cur_style, std::span<const context::LogEntry *const> unscoped_log, std::span<const context::LogEntry *const> scoped_log) noexcept
 {
-    if (unscoped_log_pos > unscoped_log.size())
-        HardError("Less entires in the unscoped log than expected.");
+    // How many entries were ever added to the log, including the omitted ones.
+    std::size_t unscoped_log_size = unscoped_log.size();
+    for (const context::LogEntry *entry : unscoped_log)
+    {
+        if (auto omitted = std::get_if<context::LogOmitted>(&entry->var))
+            unscoped_log_size += omitted->count - 1;
+    }
 
-    // Remove the already printed unscoped log messages.
-    unscoped_log = unscoped_log.last(unscoped_log.size() - unscoped_log_pos);
-    unscoped_log_pos += unscoped_log.size();
+    // Remove the already printed unscoped log messages. The IDs are increasing.
+    unscoped_log = unscoped_log.last(std::size_t(unscoped_log.end() - std::partition_point(unscoped_log.begin(), unscoped_log.end(),
+        [&](const context::LogEntry *entry){return entry->incremental_id < unscoped_log_next_id;}
+    )));
+    if (!unscoped_log.empty())
+        unscoped_log_next_id = unscoped_log.back()->incremental_id + 1;
+
+    // `LogOmitted::count` also includes the entries that were printed earlier and discarded later, so we don't use it directly.
+    // Everything that was added since the last time we printed the log and isn't in `unscoped_log` is omitted.
+    std::size_t num_omitted = unscoped_log_size - unscoped_log_prev_size;
+    for (const context::LogEntry *entry : unscoped_log)
+    {
+        if (!std::holds_alternative<context::LogOmitted>(entry->var))
+            num_omitted--;
+    }
+    unscoped_log_prev_size = unscoped_log_size;
 
     if (!unscoped_log.empty() || !scoped_log.empty())
     {
@@ -5268,9 +8989,9 @@ bool ta_test::modules::LogPrinter::PrintLogEntries(output::Terminal::StyleGuard
             else if (scoped_log.empty())
                 use_unscoped = true;
             else
-                use_unscoped = unscoped_log.front().incremental_id < scoped_log.front()->incremental_id;
+                use_unscoped = unscoped_log.front()->incremental_id < scoped_log.front()->incremental_id;
 
-            const context::LogEntry &entry = use_unscoped ? unscoped_log.front() : *scoped_log.front();
+            const context::LogEntry &entry = use_unscoped ? *unscoped_log.front() : *scoped_log.front();
 
             if (use_unscoped)
                 unscoped_log = unscoped_log.last(unscoped_log.size() - 1);
@@ -5286,6 +9007,16 @@ bool ta_test::modules::LogPrinter::PrintLogEntries(output::Terminal::StyleGuard
                         entry.Message()
                     );
                 },
+                [&](const context::LogOmitted &entry)
+                {
+                    (void)entry;
+                    terminal.Print(cur_style, "{}{}... {} {} omitted ...\n",
+                        style_message,
+                        chars_message_prefix,
+                        num_omitted,
+                        num_omitted == 1 ? "entry" : "entries"
+                    );
+                },
                 [&](const context::LogSourceLoc &entry)
                 {
                     // Source location.
@@ -5355,6 +9086,21 @@ void ta_test::modules::ExceptionPrinter::OnUncaughtException(const data::RunSing
     output::PrintContext(cur_style);
 }
 
+void ta_test::modules::ExceptionPrinter::OnTestProcessCrashed(const data::RunSingleTestInfo &test, std::string_view reason) noexcept
+{
+    (void)test;
+
+    auto cur_style = terminal.MakeStyleGuard();
+
+    terminal.Print(cur_style, "{}{}\n{}{}{}\n\n",
+        common_data.style_error,
+        chars_process_crashed,
+        style_exception_message,
+        chars_indent_type,
+        reason
+    );
+}
+
 // --- modules::MustThrowPrinter ---
 
 void ta_test::modules::MustThrowPrinter::OnMissingException(const data::MustThrowInfo &data) noexcept
@@ -5517,8 +9263,17 @@ bool ta_test::modules::DebuggerDetector::IsDebuggerAttached() const
 
 void ta_test::modules::DebuggerDetector::OnAssertionFailed(const data::BasicAssertion &data) noexcept
 {
-    if (break_on_failure ? *break_on_failure : IsDebuggerAttached())
+    bool debugger_attached = IsDebuggerAttached();
+
+    if (break_on_failure ? *break_on_failure : debugger_attached)
         data.should_break = true;
+
+    // If a debugger was attached or detached mid-test, make the next assertion recompute the cached catch policy.
+    if (!catch_exceptions)
+    {
+        if (auto *test = detail::ThreadState().current_test; test && test->should_catch == debugger_attached)
+            test->should_catch.reset();
+    }
 }
 
 void ta_test::modules::DebuggerDetector::OnUncaughtException(const data::RunSingleTestInfo &test, const data::BasicAssertion *assertion, const std::exception_ptr &e) noexcept
@@ -114,6 +114,9 @@ struct TryCompileParams
 
     bool werror = false;
     bool no_warnings = false;
+
+    // If true, link against the library built with `CFG_TA_TRACK_ALLOCATIONS=1`.
+    bool track_allocations = false;
 };
 
 // Tries to compile `code`, returns the compiler's exit status.
@@ -145,7 +148,19 @@ struct TryCompileParams
     else
     {
         *params.exe_filename = output_dir + "/tmp" + ext_exe;
-        compiler_command += " " + linker_flags + " -o " + *params.exe_filename;
+
+        if (params.track_allocations)
+        {
+            // This is only read when needed, so the other tests don't need this variable.
+            static const std::string linker_flags_track_allocations(ReadEnvVar("LINKER_FLAGS_TRACK_ALLOCATIONS"));
+            compiler_command += " -DCFG_TA_TRACK_ALLOCATIONS=1 " + linker_flags_track_allocations;
+        }
+        else
+        {
+            compiler_command += " " + linker_flags;
+        }
+
+        compiler_command += " -o " + *params.exe_filename;
     }
 
     if (params.werror)
@@ -295,6 +310,14 @@ struct CodeRunner
         CheckStringEquality(output, expected_output);
         return *this;
     }
+    CodeRunner &RunWithOutputMatching(std::string_view flags, std::regex regex, ta_test::SourceLoc source_loc = ta_test::SourceLoc::Current{})
+    {
+        TA_CONTEXT(source_loc);
+        std::string output;
+        TA_CHECK( RunLow(flags, &output) == 0 );
+        TA_CHECK( std::regex_search(output, regex) );
+        return *this;
+    }
     CodeRunner &FailWithOutputMatching(std::string_view flags, std::regex regex, ta_test::SourceLoc source_loc = ta_test::SourceLoc::Current{})
     {
         TA_CONTEXT(source_loc);
@@ -303,6 +326,14 @@ struct CodeRunner
         TA_CHECK( std::regex_search(output, regex) );
         return *this;
     }
+    // Runs the code with `flags`, expecting it to fail, and returns the output. For the runs that depend on the previous output.
+    [[nodiscard]] std::string FailAndGetOutput(std::string_view flags, ta_test::SourceLoc source_loc = ta_test::SourceLoc::Current{})
+    {
+        TA_CONTEXT(source_loc);
+        std::string output;
+        TA_CHECK( RunLow(flags, &output) != 0 );
+        return output;
+    }
 };
 // Compile the code and then run some checks on the exe.
 [[nodiscard]] CodeRunner MustCompileAndThen(std::string_view code, ta_test::SourceLoc source_loc = ta_test::SourceLoc::Current{})
@@ -314,6 +345,16 @@ struct CodeRunner
     TA_CHECK( TryCompile(code, params) == 0 );
     return runner;
 }
+// Same, but link against the library built with `CFG_TA_TRACK_ALLOCATIONS=1`.
+[[nodiscard]] CodeRunner MustCompileWithAllocationTrackingAndThen(std::string_view code, ta_test::SourceLoc source_loc = ta_test::SourceLoc::Current{})
+{
+    TA_CONTEXT(source_loc);
+    CodeRunner runner;
+    TryCompileParams params{.werror = true, .track_allocations = true};
+    params.exe_filename = &runner.exe_filename;
+    TA_CHECK( TryCompile(code, params) == 0 );
+    return runner;
+}
 
 // This version of `output::Terminal` redirects the output to a string.
 class TerminalToString : public ta_test::output::Terminal
@@ -2087,153 +2128,1012 @@ PASSED           2         0
     ;
 }
 
-TA_TEST( ta_test/none_registered )
-{
-    // What
-    MustCompileAndThen(common_program_prefix).FailWithExactOutput("", "\nNO TESTS ARE REGISTERED\n\n", int(ta_test::ExitCode::no_tests_to_run));
-}
-
-TA_TEST( ta_test/exceptions )
+TA_TEST( ta_test/jobs )
 {
-    // Throwing an exception fails the test.
+    // Without generators, running on worker threads should produce the same output as running on one thread.
     MustCompileAndThen(common_program_prefix + R"(
-TA_TEST(blah)
-{
-    throw std::runtime_error("Some message!");
-}
-)").FailWithExactOutput("", R"(
+TA_TEST(a/foo/bar) {}
+TA_TEST(a/foo/blah) {TA_CHECK(true);}
+TA_TEST(a/other) {}
+TA_TEST(b/blah) {TA_CHECK(true);}
+)")
+    .RunWithExactOutput("-j4", R"(
 Running tests...
-1/1 │  ● blah
-
-dir/subdir/file.cpp:5:
-TEST FAILED: blah ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+    │  ● a/
+    │  ·   ● foo/
+1/4 │  ·   ·   ● bar
+2/4 │  ·   ·   ● blah
+3/4 │  ·   ● other
+    │  ● b/
+4/4 │  ·   ● blah
 
-Uncaught exception:
-    std::runtime_error:
-        "Some message!"
+             Tests    Checks
+PASSED           4         2
 
-────────────────────────────────────────────────────────────────────────────────────────────────────
+)")
+    .RunWithExactOutput("--jobs=0", R"(
+Running tests...
+    │  ● a/
+    │  ·   ● foo/
+1/4 │  ·   ·   ● bar
+2/4 │  ·   ·   ● blah
+3/4 │  ·   ● other
+    │  ● b/
+4/4 │  ·   ● blah
 
-FOLLOWING TESTS FAILED:
+             Tests    Checks
+PASSED           4         2
 
-● blah      │ dir/subdir/file.cpp:5
+)")
+    .RunWithExactOutput("--processes=2", R"(
+Running tests...
+    │  ● a/
+    │  ·   ● foo/
+1/4 │  ·   ·   ● bar
+2/4 │  ·   ·   ● blah
+3/4 │  ·   ● other
+    │  ● b/
+4/4 │  ·   ● blah
 
              Tests    Checks
-FAILED           1         0
+PASSED           4         2
 
-)");
+)")
+    .FailWithExactOutput("--jobs x", "ta_test: Error: Expected a non-negative integer after `--jobs`, but got `x`.\n");
 
-    // Throwing `InterruptTestException` doesn't fail the test.
-    MustCompileAndThen(common_program_prefix + R"(
-TA_TEST(blah)
+    // Failing tests are reported from the worker's results, including the generator values, the logs, the exceptions and the shrinking.
+    // The output is the same as when running on one thread.
+    {
+        auto runner = MustCompileAndThen(common_program_prefix + R"(
+TA_TEST(a) {}
+TA_TEST(b)
 {
-    throw ta_test::InterruptTestException{};
+    int x = TA_GENERATE(x, {1,2,3,4,5});
+    int y = TA_GENERATE(y, {10,20});
+    TA_LOG("x={} y={}", x, y);
+    TA_CHECK(x != 3 || y != 20);
+    TA_CHECK(x != 4);
 }
-)").RunWithExactOutput("", R"(
+TA_TEST(c)
+{
+    int x = TA_GENERATE_FUNC(x, ta_test::RandomValues(20, ta_test::RandomInt<int>{0, 1000}, 1));
+    TA_CHECK(x < 500);
+}
+TA_TEST(d) {throw std::runtime_error("Boom!");}
+TA_TEST(e) {TA_CHECK(true);}
+)");
+        std::string expected_output = runner.FailAndGetOutput("-j1");
+        runner.FailWithExactOutput("-j2", expected_output);
+        runner.FailWithExactOutput("-j4", expected_output);
+        runner.FailWithExactOutput("--processes=3", expected_output);
+    }
+
+    // A failure that depends on the thread isn't rerun, the worker's verdict is reported as is.
+    MustCompileAndThen(common_program_prefix + R"(
+#include <thread>
+const std::thread::id main_thread_id = std::this_thread::get_id();
+TA_TEST(a) {}
+TA_TEST(b) {TA_CHECK(std::this_thread::get_id() != main_thread_id);}
+TA_TEST(c) {}
+)")
+    .RunWithExactOutput("-j2", R"(
 Running tests...
-1/1 │  ● blah
+1/3 │  ● a
+2/3 │  ● b
+3/3 │  ● c
 
              Tests    Checks
-PASSED           1         0
+PASSED           3         1
 
 )");
 
-    // Throwing an unknown exception.
+    // Splitting generator values between the worker threads.
     MustCompileAndThen(common_program_prefix + R"(
-TA_TEST(blah)
+TA_TEST(a)
 {
-    throw 42;
+    int x = TA_GENERATE(x, {1,2,3,4,5,6,7});
+    int y = TA_GENERATE(y, {10,20});
+    TA_CHECK(x + y > 0);
 }
-)").FailWithExactOutput("", R"(
-Running tests...
-1/1 │  ● blah
-
-dir/subdir/file.cpp:5:
-TEST FAILED: blah ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
-
-Uncaught exception:
-    Unknown exception.
+TA_TEST(b) {}
+)")
+    .Run("-j4 --split-generators")
+    .Run("-j1 --split-generators");
 
-────────────────────────────────────────────────────────────────────────────────────────────────────
+    MustCompileAndThen(common_program_prefix + R"(
+TA_TEST(a)
+{
+    int x = TA_GENERATE(x, {1,2,3,4,5,6,7});
+    TA_CHECK(x != 6);
+}
+)")
+    .Fail("-j4 --split-generators");
 
-FOLLOWING TESTS FAILED:
+    // Every value runs exactly once, and each job generates at most all values, so there are at most `num_jobs` generator calls per value.
+    MustCompileAndThen(common_program_prefix + R"(
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+std::mutex mutex;
+std::vector<int> seen_a, seen_b;
+std::atomic<int> num_calls = 0;
+struct Report
+{
+    ~Report()
+    {
+        std::sort(seen_a.begin(), seen_a.end());
+        std::sort(seen_b.begin(), seen_b.end());
+        std::printf("a:");
+        for (int x : seen_a) std::printf(" %d", x);
+        std::printf("\nb:");
+        for (int x : seen_b) std::printf(" %d", x);
+        std::printf("\ncalls within bound: %d\n", num_calls <= 20 * 4);
+    }
+} report;
+TA_TEST(a)
+{
+    int x = TA_GENERATE_FUNC(x, [i = 0](bool &repeat) mutable {num_calls++; repeat = i < 19; return i++;});
+    int y = TA_GENERATE(y, {0, 1});
+    std::lock_guard lock(mutex);
+    if (y == 0) seen_a.push_back(x);
+}
+TA_TEST(b)
+{
+    int x = TA_GENERATE(x, std::vector{0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19});
+    std::lock_guard lock(mutex);
+    seen_b.push_back(x);
+}
+)")
+    .RunWithOutputMatching("-j4 --split-generators", std::regex(R"([\s\S]*\na: 0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19\nb: 0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19\ncalls within bound: 1\n)"));
 
-● blah      │ dir/subdir/file.cpp:5
+    // A crash in a worker process fails only that test. The tests after it still run.
+    // The failures of the other tests are streamed back from their worker processes.
+    MustCompileAndThen(common_program_prefix + R"(
+TA_TEST(a) {}
+TA_TEST(b) {std::abort();}
+TA_TEST(c) {TA_CHECK(false);}
+TA_TEST(d) {TA_CHECK(true);}
+)")
+    .FailWithOutputMatching("-p2", std::regex(
+        R"(\n2/4 │  ● b\n\ndir/subdir/file\.cpp:6:\nTEST FAILED: b (?:━)+\n\n)"
+        R"(Crashed in a worker process:\n +The worker process was killed by signal [0-9]+ \([^)\n]*\)\.\n\n(?:─)+\n\n)"
+        R"(Continuing\.\.\.\n3/4 \[1\] │  ● c\n\ndir/subdir/file\.cpp:7:\nTEST FAILED: c (?:━)+\n\ndir/subdir/file\.cpp:7:\nAssertion failed:\n\n +TA_CHECK\( false \)\n\n(?:─)+\n\n)"
+        R"(Continuing\.\.\.\n4/4 \[2\] │  ● d\n\nFOLLOWING TESTS FAILED:\n\n● b +│ dir/subdir/file\.cpp:6\n● c +│ dir/subdir/file\.cpp:7\n\n)"
+        R"( +Tests +Checks\nExecuted +4 +2\nPassed +2 +1\nFAILED +2 +1\n)"
+    ));
+}
 
-             Tests    Checks
-FAILED           1         0
+TA_TEST( ta_test/generate_sample )
+{
+    // Both sized ranges, and generators that don't know their size.
+    MustCompileAndThen(common_program_prefix + R"(
+int num_repetitions = 0;
+TA_TEST(a)
+{
+    int x = TA_GENERATE(x, {1,2,3,4,5,6,7,8,9,10});
+    int y = TA_GENERATE(y, {1,2,3,4,5,6,7,8,9,10});
+    int z = TA_GENERATE_FUNC(z, [i = 0](bool &repeat) mutable {repeat = i < 9; return ++i;});
+    TA_CHECK(x >= 1 && x <= 10 && y >= 1 && y <= 10 && z >= 1 && z <= 10);
+    num_repetitions++;
+}
+TA_TEST(b)
+{
+    TA_CHECK(num_repetitions == 7);
+}
+)")
+    .Run("--generate-sample 7 --seed 42")
+    .Run("--generate-sample 7")
+    .Fail("--generate-sample 8 --seed 42")
+    .Fail();
 
-)");
+    // The outermost generator doesn't know its size, so we run at most one repetition per value.
+    MustCompileAndThen(common_program_prefix + R"(
+int num_repetitions = 0;
+TA_TEST(a)
+{
+    int x = TA_GENERATE_FUNC(x, [i = 0](bool &repeat) mutable {repeat = i < 2; return ++i;});
+    int y = TA_GENERATE(y, {1,2,3});
+    TA_CHECK(x >= 1 && x <= 3 && y >= 1 && y <= 3);
+    num_repetitions++;
+}
+TA_TEST(b)
+{
+    TA_CHECK(num_repetitions == 3);
+}
+)")
+    .Run("--generate-sample 100 --seed 1")
+    .Fail("--generate-sample 2 --seed 1");
 
-    // Throwing a nested exception.
+    // The outermost values don't repeat, and there are at most as many repetitions as there are outermost values.
     MustCompileAndThen(common_program_prefix + R"(
-TA_TEST(blah)
+#include <set>
+std::set<int> xs;
+int num_repetitions = 0;
+TA_TEST(a)
 {
-    try
-    {
-        try
-        {
-            throw std::runtime_error("1");
-        }
-        catch (...)
+    xs.insert(TA_GENERATE(x, {1,2,3,4}));
+    (void)TA_GENERATE(y, {1,2,3});
+    num_repetitions++;
+}
+TA_TEST(b)
+{
+    TA_CHECK($[xs.size()] == 4);
+    TA_CHECK($[num_repetitions] == 4);
+}
+)")
+    .Run("--generate-sample 4 --seed 1")
+    .Run("--generate-sample 4 --seed 2")
+    .Run("--generate-sample 4")
+    .Run("--generate-sample 100 --seed 1")
+    .Fail("--generate-sample 3 --seed 1");
+
+    { // The suggested `--generate` flag reproduces the failed repetition.
+        auto runner = MustCompileAndThen(common_program_prefix + R"(
+#include <iostream>
+TA_TEST(a)
+{
+    int x = TA_GENERATE(x, {1,2,3,4,5,6,7,8,9,10});
+    int y = TA_GENERATE(y, {1,2,3,4,5,6,7,8,9,10});
+    int z = TA_GENERATE_FUNC(z, [i = 0](bool &repeat) mutable {repeat = i < 9; return ++i;});
+    if (x + y + z > 20)
+        std::cout << "Failing with " << x << ' ' << y << ' ' << z << '\n';
+    TA_CHECK( x + y + z <= 20 );
+}
+)");
+
+        for (std::string_view seed_flag : {" --seed 3", ""})
         {
-            std::throw_with_nested(std::logic_error("2"));
+            TA_CONTEXT("Seed flag: `{}`", seed_flag);
+
+            std::string output = runner.FailAndGetOutput("--generate-sample 50" + std::string(seed_flag));
+            std::smatch match;
+            TA_CHECK( std::regex_search(output, match, std::regex(R"(\n(Failing with [0-9 ]+)\n[\s\S]*?Reproduce this repetition with `(--generate '[^']*')`\.\n)")) );
+            std::string values = match[1];
+            std::string generate_flag = match[2];
+
+            output = runner.FailAndGetOutput(generate_flag);
+            TA_CHECK( $[output].find("\n" + $[values] + "\n") != std::string::npos );
         }
     }
-    catch (...)
+}
+
+TA_TEST( ta_test/generate_coverage )
+{
+    // Three generators of three values each. Check that every pair of values was seen, in close to the optimal number of repetitions.
+    auto MakeProgram = [](std::string_view test_flags)
     {
-        std::throw_with_nested(std::domain_error("3"));
+        return common_program_prefix + R"(
+#include <array>
+#include <set>
+std::set<std::array<int, 4>> pairs; // `{generator_a, value_a, generator_b, value_b}`
+int num_repetitions = 0;
+TA_TEST(a)" + std::string(test_flags) + R"()
+{
+    int x = TA_GENERATE(x, {1,2,3});
+    int y = TA_GENERATE(y, {1,2,3});
+    int z = TA_GENERATE(z, {1,2,3});
+    pairs.insert({0, x, 1, y});
+    pairs.insert({0, x, 2, z});
+    pairs.insert({1, y, 2, z});
+    num_repetitions++;
+}
+TA_TEST(b)
+{
+    TA_CHECK(pairs.size() == 27);
+    // The optimum is 9, and exhaustive is 27. The greedy algorithm is allowed to be slightly worse than the optimum.
+    TA_CHECK($[num_repetitions] <= 11);
+}
+)";
+    };
+
+    MustCompileAndThen(MakeProgram(", ta_test::pairwise"))
+    .Run()
+    .Fail("--generate-coverage exhaustive");
+
+    MustCompileAndThen(MakeProgram(""))
+    .Fail()
+    .Run("--generate-coverage pairwise")
+    .FailWithExactOutput("--generate-coverage x", "ta_test: Error: Expected `default`, `pairwise`, or `exhaustive` after `--generate-coverage`, but got `x`.\n");
+
+    // Generators of different sizes. The two largest ones need at least 4*5 repetitions.
+    MustCompileAndThen(common_program_prefix + R"(
+#include <array>
+#include <set>
+std::set<std::array<int, 4>> pairs; // `{generator_a, value_a, generator_b, value_b}`
+int num_repetitions = 0;
+TA_TEST(a, ta_test::pairwise)
+{
+    std::array<int, 4> row = {
+        TA_GENERATE(x, {1,2,3,4}),
+        TA_GENERATE(y, {1,2,3,4,5}),
+        TA_GENERATE(z, {1,2}),
+        TA_GENERATE(w, {1,2,3}),
+    };
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = i + 1; j < 4; j++)
+            pairs.insert({i, row[i], j, row[j]});
     }
+    num_repetitions++;
 }
-)").FailWithExactOutput("", R"(
+TA_TEST(b)
+{
+    TA_CHECK($[pairs.size()] == 4*5 + 4*2 + 4*3 + 5*2 + 5*3 + 2*3);
+    TA_CHECK($[num_repetitions] <= 22);
+}
+)")
+    .Run();
+}
+
+TA_TEST( ta_test/shrink )
+{
+    // The failing value is shrunk to the boundary.
+    MustCompileAndThen(common_program_prefix + R"(
+TA_TEST(a)
+{
+    int x = TA_GENERATE_FUNC(x, ta_test::RandomValues(100, ta_test::RandomInt<int>{0, 1000}, 1));
+    TA_CHECK(x < 500);
+}
+)")
+    .FailWithOutputMatching("", std::regex("Shrunk `x` in [0-9]+ steps? \\([0-9]+ repetitions?\\), the simplest failing value is `500`\\."))
+    .Fail("--no-shrink");
+
+    // Only the original failure and the simplest one are printed, the failing candidates in between are quiet.
+    MustCompileAndThen(common_program_prefix + R"(
+TA_TEST(a)
+{
+    int x = TA_GENERATE_FUNC(x, ta_test::RandomValues(3, ta_test::RandomInt<int>{0, 1000}, 1));
+    TA_CHECK(x < 500);
+}
+)")
+    .FailWithExactOutput("", R"(
 Running tests...
-1/1 │  ● blah
+1/1 │  ● a
+1/1 │ 1 │  ● x[1] = 0
+1/1 │ 2 │  ● x[2] = 502
 
 dir/subdir/file.cpp:5:
-TEST FAILED: blah ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+TEST FAILED: a//x=502 ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
 
-Uncaught exception:
-    std::_Nested_exception<std::domain_error>:
-        "3"
-    std::_Nested_exception<std::logic_error>:
-        "2"
-    std::runtime_error:
-        "1"
+dir/subdir/file.cpp:8:
+Assertion failed:
+
+    TA_CHECK( x < 500 )
+
+────────────────────────────────────────────────────────────────────────────────────────────────────
+1/1 │ 30 [3] │ ● x[*28] = 500
+
+dir/subdir/file.cpp:5:
+TEST FAILED: a//x=500 ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+dir/subdir/file.cpp:8:
+Assertion failed:
 
+    TA_CHECK( x < 500 )
+
+Shrunk `x` in 2 steps (27 repetitions), the simplest failing value is `500`.
 ────────────────────────────────────────────────────────────────────────────────────────────────────
 
+dir/subdir/file.cpp:5:
+IN TEST a, 4/30 VARIANTS FAILED:
+
+● x[2] = 502
+● x[*9] = 501
+● x[*18] = 500
+● x[*28] = 500
+
 FOLLOWING TESTS FAILED:
 
-● blah      │ dir/subdir/file.cpp:5
+● a      │ dir/subdir/file.cpp:5
 
-             Tests    Checks
-FAILED           1         0
+             Tests  Variants    Checks
+Executed         1        30        30
+Passed           0        26        26
+FAILED           1         4         4
 
 )");
 
-    // Throwing a nested exception with an unknown exception in it.
+    // Vectors lose the elements that don't matter.
     MustCompileAndThen(common_program_prefix + R"(
-TA_TEST(blah)
+#include <vector>
+TA_TEST(a)
 {
-    try
-    {
-        try
-        {
-            throw 42;
-        }
-        catch (...)
-        {
-            std::throw_with_nested(std::logic_error("2"));
-        }
-    }
-    catch (...)
-    {
-        std::throw_with_nested(std::domain_error("3"));
-    }
+    auto v = TA_GENERATE_FUNC(v, ta_test::RandomValues(100, ta_test::RandomVector{ta_test::RandomInt<int>{-100, 100}}, 1));
+    for (int elem : v)
+        TA_CHECK(elem < 50);
+}
+)")
+    .FailWithOutputMatching("", std::regex("the simplest failing value is `\\[50\\]`\\."));
 }
-)").FailWithExactOutput("", R"(
-Running tests...
-1/1 │  ● blah
+
+TA_TEST( ta_test/generate_at )
+{
+    // Random-access ranges jump straight to the requested value, instead of generating all values before it.
+    MustCompileAndThen(common_program_prefix + R"(
+#include <ranges>
+int num_calls = 0;
+int last_value = -1;
+TA_TEST(a)
+{
+    last_value = TA_GENERATE_FUNC(x, ta_test::RangeToGeneratorFunc(std::views::iota(0, 10000) | std::views::transform([](int i){num_calls++; return i;})));
+}
+TA_TEST(b)
+{
+    TA_CHECK(num_calls == 1);
+    TA_CHECK(last_value == 5000);
+}
+)")
+    .Run("--generate a//x#5001")
+    .Fail();
+}
+
+TA_TEST( ta_test/shard )
+{
+    MustCompileAndThen(common_program_prefix + R"(
+TA_TEST(a) {}
+TA_TEST(b) {}
+TA_TEST(c) {}
+TA_TEST(d) {}
+)")
+    .RunWithExactOutput("--shard 1/2", R"(Skipping 2 tests, will run 2/4 tests.
+
+Running tests...
+1/2 │  ● a
+2/2 │  ● c
+
+             Tests    Checks
+Known            4
+Skipped          2
+PASSED           2         0
+
+)")
+    .RunWithExactOutput("--shard 2/2", R"(Skipping 2 tests, will run 2/4 tests.
+
+Running tests...
+1/2 │  ● b
+2/2 │  ● d
+
+             Tests    Checks
+Known            4
+Skipped          2
+PASSED           2         0
+
+)")
+    .RunWithExactOutput("--shard=1/1", R"(
+Running tests...
+1/4 │  ● a
+2/4 │  ● b
+3/4 │  ● c
+4/4 │  ● d
+
+             Tests    Checks
+PASSED           4         0
+
+)")
+    .FailWithExactOutput("--shard 0/2", "ta_test: Error: Expected `i/n` after `--shard`, where `1 <= i <= n`, but got `0/2`.\n")
+    .FailWithExactOutput("--shard 3/2", "ta_test: Error: Expected `i/n` after `--shard`, where `1 <= i <= n`, but got `3/2`.\n")
+    .FailWithExactOutput("--shard 1", "ta_test: Error: Expected `i/n` after `--shard`, where `1 <= i <= n`, but got `1`.\n");
+
+    // Balancing the shards by time. The slowest tests are assigned first, each to the least loaded shard.
+    const std::string weights_path = std::string(ReadEnvVar("OUTPUT_DIR")) + "/shard_weights.db";
+    {
+        std::ofstream file(weights_path);
+        file << "10 1 0 a\n1 1 0 b\n1 1 0 c\n8 1 0 d\n";
+    }
+
+    MustCompileAndThen(common_program_prefix + R"(
+TA_TEST(a) {}
+TA_TEST(b) {}
+TA_TEST(c) {}
+TA_TEST(d) {}
+)")
+    // 10 seconds vs 8+1+1.
+    .RunWithExactOutput("--shard 1/2 --shard-weights " + weights_path, R"(Skipping 3 tests, will run 1/4 tests.
+
+Running tests...
+1/1 │  ● a
+
+             Tests    Checks
+Known            4
+Skipped          3
+PASSED           1         0
+
+)")
+    .RunWithExactOutput("--shard 2/2 --shard-weights " + weights_path, R"(Skipping 1 test, will run 3/4 tests.
+
+Running tests...
+1/3 │  ● b
+2/3 │  ● c
+3/3 │  ● d
+
+             Tests    Checks
+Known            4
+Skipped          1
+PASSED           3         0
+
+)")
+    // Only the tests that are enabled are weighed, otherwise the first shard would be empty here. 8 seconds vs 1+1.
+    .RunWithExactOutput("--shard 1/2 --shard-weights " + weights_path + " --exclude a", R"(Skipping 3 tests, will run 1/4 tests.
+
+Running tests...
+1/1 │  ● d
+
+             Tests    Checks
+Known            4
+Skipped          3
+PASSED           1         0
+
+)")
+    .RunWithExactOutput("--shard 2/2 --shard-weights " + weights_path + " --exclude a", R"(Skipping 2 tests, will run 2/4 tests.
+
+Running tests...
+1/2 │  ● b
+2/2 │  ● c
+
+             Tests    Checks
+Known            4
+Skipped          2
+PASSED           2         0
+
+)");
+}
+
+TA_TEST( ta_test/timing_db )
+{
+    const std::string db_path = std::string(ReadEnvVar("OUTPUT_DIR")) + "/timing.db";
+
+    auto WriteDb = [&](std::string_view contents)
+    {
+        std::ofstream file(db_path);
+        file << contents;
+    };
+
+    auto runner = MustCompileAndThen(common_program_prefix + R"(
+TA_TEST(a) {}
+TA_TEST(b) {}
+TA_TEST(c) {}
+)");
+
+    WriteDb("0.1 1 0 a\n5 1 0 c\n1 1 0 b\n");
+    runner.RunWithExactOutput("--timing-db " + db_path + " --schedule longest-first", R"(
+Running tests...
+1/3 │  ● c
+2/3 │  ● b
+3/3 │  ● a
+
+             Tests    Checks
+PASSED           3         0
+
+)");
+
+    WriteDb("0 1 0 a\n0 1 2 c\n");
+    runner.RunWithExactOutput("--timing-db " + db_path + " --schedule failed-first", R"(
+Running tests...
+1/3 │  ● c
+2/3 │  ● a
+3/3 │  ● b
+
+             Tests    Checks
+PASSED           3         0
+
+)");
+
+    // The tests passed, so the fail streaks are reset.
+    runner.RunWithExactOutput("--timing-db " + db_path + " --schedule failed-first", R"(
+Running tests...
+1/3 │  ● a
+2/3 │  ● b
+3/3 │  ● c
+
+             Tests    Checks
+PASSED           3         0
+
+)");
+
+    // The groups aren't split. Each group is ordered by its slowest test.
+    WriteDb("1 1 0 x/a\n3 1 0 x/b\n2 1 0 y/a/a\n4 1 0 y/b\n5 1 0 z\n");
+    MustCompileAndThen(common_program_prefix + R"(
+TA_TEST(x/a) {}
+TA_TEST(y/a/a) {}
+TA_TEST(y/a/b) {}
+TA_TEST(x/b) {}
+TA_TEST(y/b) {}
+TA_TEST(z) {}
+)")
+    .RunWithExactOutput("--timing-db " + db_path + " --schedule longest-first", R"(
+Running tests...
+1/6 │  ● z
+    │  ● y/
+2/6 │  ·   ● b
+    │  ·   ● a/
+3/6 │  ·   ·   ● a
+4/6 │  ·   ·   ● b
+    │  ● x/
+5/6 │  ·   ● b
+6/6 │  ·   ● a
+
+             Tests    Checks
+PASSED           6         0
+
+)");
+
+    runner
+        .FailWithExactOutput("--schedule longest-first", "ta_test: Error: `--schedule` needs `--timing-db`.\n")
+        .FailWithExactOutput("--schedule x", "ta_test: Error: Expected `default`, `longest-first`, or `failed-first` after `--schedule`, but got `x`.\n");
+}
+
+TA_TEST( ta_test/slowest )
+{
+    // The durations aren't deterministic, so only the repetition that sleeps is guaranteed to be the slowest.
+    MustCompileAndThen(common_program_prefix + R"(
+#include <thread>
+TA_TEST(a) {}
+TA_TEST(b)
+{
+    int x = TA_GENERATE(x, {1,2,3});
+    if (x == 2)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+}
+)")
+    .RunWithOutputMatching("--slowest 1", std::regex(
+        R"(\nSLOWEST TESTS:\n\n +[0-9]+\.[0-9]{3}s  cpu [0-9]+\.[0-9]{3}s  b\n)"
+        R"(\nSLOWEST REPETITIONS:\n\n +[0-9]+\.[0-9]{3}s  cpu [0-9]+\.[0-9]{3}s  b//x=2\n\n)"
+    ))
+    // The workers report the individual repetitions too.
+    .RunWithOutputMatching("--slowest 1 -j2", std::regex(
+        R"(\nSLOWEST TESTS:\n\n +[0-9]+\.[0-9]{3}s  cpu [0-9]+\.[0-9]{3}s  b\n)"
+        R"(\nSLOWEST REPETITIONS:\n\n +[0-9]+\.[0-9]{3}s  cpu [0-9]+\.[0-9]{3}s  b//x=2\n\n)"
+    ))
+    .FailWithExactOutput("--slowest x", "ta_test: Error: Expected a non-negative integer after `--slowest`, but got `x`.\n");
+}
+
+TA_TEST( ta_test/benchmark )
+{
+    // The durations aren't deterministic, so we only check the format.
+    MustCompileAndThen(common_program_prefix + R"(
+#include <vector>
+TA_BENCHMARK(vec/push_back)
+{
+    int n = TA_GENERATE(n, {1, 100});
+    for (auto _ : ta_test::BenchmarkLoop{})
+    {
+        std::vector<int> v;
+        for (int i = 0; i < n; i++)
+            v.push_back(i);
+        ta_test::DoNotOptimize(v.data());
+        ta_test::ClobberMemory();
+    }
+}
+TA_BENCHMARK(skipped, ta_test::disabled)
+{
+    TA_FAIL;
+}
+TA_TEST(plain) {}
+)")
+    .RunWithOutputMatching("--benchmark-samples 3 --benchmark-sample-ms 1 --benchmark-warmup-ms 1", std::regex(
+        R"(● n\[1\] = 1\n    median [0-9.]+[nmu]?s, MAD [0-9.]+[nmu]?s, min [0-9.]+[nmu]?s, max [0-9.]+[nmu]?s, 3 samples x [0-9]+ iterations\n)"
+        R"([\s\S]*● n\[2\] = 100\n    median [0-9.]+[nmu]?s, MAD [0-9.]+[nmu]?s, min [0-9.]+[nmu]?s, max [0-9.]+[nmu]?s, 3 samples x [0-9]+ iterations\n)"
+        R"([\s\S]*● plain\n\n[\s\S]*\nSkipped +1\nPASSED +2 +3 +0\n)"
+    ))
+    // Zero-length samples have one iteration each.
+    .RunWithOutputMatching("--benchmark-samples 2 --benchmark-sample-ms 0 --benchmark-warmup-ms 0 -j2", std::regex(
+        R"(● n\[1\] = 1\n    median [0-9.]+[nmu]?s, MAD [0-9.]+[nmu]?s, min [0-9.]+[nmu]?s, max [0-9.]+[nmu]?s, 2 samples x 1 iterations\n)"
+    ))
+    // The counters are unavailable if the kernel disallows them, then we print a warning instead.
+    .RunWithOutputMatching("--benchmark-samples 2 --benchmark-sample-ms 1 --benchmark-warmup-ms 1 --benchmark-counters", std::regex(
+        R"(2 samples x [0-9]+ iterations\n    (cycles (n/a|[0-9.]+), .* per iteration|Hardware performance counters are unavailable, .*)\n)"
+    ))
+    .FailWithExactOutput("--benchmark-samples x", "ta_test: Error: Expected a non-negative integer after `--benchmark-samples`, but got `x`.\n");
+}
+
+TA_TEST( ta_test/benchmark_baseline )
+{
+    const std::string baseline_path = std::string(ReadEnvVar("OUTPUT_DIR")) + "/benchmark_baseline.txt";
+    const std::string saved_path = std::string(ReadEnvVar("OUTPUT_DIR")) + "/benchmark_saved.txt";
+
+    auto WriteFile = [&](std::string_view contents)
+    {
+        std::ofstream file(baseline_path);
+        file << contents;
+    };
+
+    auto runner = MustCompileAndThen(common_program_prefix + R"(
+#include <thread>
+TA_BENCHMARK(sleep)
+{
+    for (auto _ : ta_test::BenchmarkLoop{})
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+}
+)");
+
+    const std::string common_flags = " --benchmark-samples 5 --benchmark-sample-ms 1 --benchmark-warmup-ms 1";
+
+    // Much slower than the baseline, this is a regression.
+    WriteFile("5 0.001 0.001 0.001 0.001 0.001 sleep\n");
+    runner.Fail("--benchmark-compare " + baseline_path + common_flags);
+
+    // Much faster than the baseline.
+    WriteFile("5 1e12 1e12 1e12 1e12 1e12 sleep\n");
+    runner.Run("--benchmark-compare " + baseline_path + common_flags);
+
+    // Not in the baseline.
+    WriteFile("5 0.001 0.001 0.001 0.001 0.001 other\n");
+    runner.Run("--benchmark-compare " + baseline_path + common_flags);
+
+    // The sleep always takes at least 100us, so this is a regression only with a small enough threshold.
+    WriteFile("5 99999.5 99999.5 99999.5 99999.5 99999.5 sleep\n");
+    runner.Fail("--benchmark-compare " + baseline_path + " --benchmark-threshold 0.25" + common_flags);
+    runner.Run("--benchmark-compare " + baseline_path + " --benchmark-threshold 1e6" + common_flags);
+    runner.FailWithExactOutput("--benchmark-threshold x", "ta_test: Error: Expected a non-negative number after `--benchmark-threshold`, but got `x`.\n");
+    runner.FailWithExactOutput("--benchmark-threshold -1", "ta_test: Error: Expected a non-negative number after `--benchmark-threshold`, but got `-1`.\n");
+
+    // Saving.
+    std::filesystem::remove(saved_path);
+    runner.Run("--benchmark-save " + saved_path + common_flags);
+    {
+        std::ifstream file(saved_path);
+        std::string line;
+        TA_CHECK( std::getline(file, line) );
+        TA_CHECK( $[line].starts_with("5 ") && $[line].ends_with(" sleep") );
+    }
+    // The saved file can be compared against.
+    runner.Run("--benchmark-compare " + saved_path + " --benchmark-threshold 1e6" + common_flags);
+
+    WriteFile("blah\n");
+    runner.Fail("--benchmark-compare " + baseline_path);
+}
+
+TA_TEST( ta_test/allocations )
+{
+    // The main library used by the tests is built without `CFG_TA_TRACK_ALLOCATIONS`, so check that this is diagnosed. See below for the tracking build.
+    MustCompileAndThen(common_program_prefix + R"(
+TA_TEST(a) {}
+)")
+    .Run("--no-allocations")
+    .Fail("--allocations");
+
+    MustCompileAndThen(common_program_prefix + R"(
+#include <vector>
+TA_TEST(a)
+{
+    std::vector<int> v;
+    v.reserve(10);
+    TA_MUST_NOT_ALLOCATE( v.push_back(1); v.push_back(2); );
+    TA_MUST_NOT_ALLOCATE( v.push_back(3) )("Reserved {} elements.", 10);
+}
+)")
+    .Fail("");
+}
+
+TA_TEST( ta_test/allocations_tracked )
+{
+    // The counts and bytes are exact, since the tests below don't call anything that allocates behind the scenes.
+    MustCompileWithAllocationTrackingAndThen(common_program_prefix + R"(
+void *volatile leaked = nullptr;
+TA_TEST(a)
+{
+    void *volatile p = ::operator new(100);
+    ::operator delete(p);
+    p = ::operator new(50);
+    ::operator delete(p);
+}
+TA_TEST(b)
+{
+    leaked = ::operator new(40);
+}
+TA_TEST(c) {}
+)")
+    .RunWithExactOutput("--allocations", R"(
+Running tests...
+1/3 │  ● a
+2/3 │  ● b
+3/3 │  ● c
+
+HEAP ALLOCATIONS:
+
+       2 allocs          150 bytes, peak          100,          0 leaked  a
+       1 allocs           40 bytes, peak           40,         40 leaked  b
+
+             Tests    Checks
+PASSED           3         0
+
+)")
+    .RunWithExactOutput("", R"(
+Running tests...
+1/3 │  ● a
+2/3 │  ● b
+3/3 │  ● c
+
+             Tests    Checks
+PASSED           3         0
+
+)");
+
+    MustCompileWithAllocationTrackingAndThen(common_program_prefix + R"(
+#include <vector>
+TA_TEST(a)
+{
+    std::vector<int> v;
+    v.reserve(10);
+    TA_MUST_NOT_ALLOCATE( v.push_back(1); v.push_back(2); );
+    TA_MUST_NOT_ALLOCATE( v.assign(20, 3) )("Reserved {} elements.", 10);
+}
+)")
+    .FailWithExactOutput("", R"(
+Running tests...
+1/1 │  ● a
+
+dir/subdir/file.cpp:6:
+TEST FAILED: a ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+dir/subdir/file.cpp:11:
+Assertion failed: Reserved 10 elements.
+
+    TA_MUST_NOT_ALLOCATE( v.assign(20, 3) )
+
+────────────────────────────────────────────────────────────────────────────────────────────────────
+
+FOLLOWING TESTS FAILED:
+
+● a      │ dir/subdir/file.cpp:6
+
+             Tests    Checks
+Executed         1         2
+Passed           0         1
+FAILED           1         1
+
+)");
+}
+
+TA_TEST( ta_test/none_registered )
+{
+    // What
+    MustCompileAndThen(common_program_prefix).FailWithExactOutput("", "\nNO TESTS ARE REGISTERED\n\n", int(ta_test::ExitCode::no_tests_to_run));
+}
+
+TA_TEST( ta_test/exceptions )
+{
+    // Throwing an exception fails the test.
+    MustCompileAndThen(common_program_prefix + R"(
+TA_TEST(blah)
+{
+    throw std::runtime_error("Some message!");
+}
+)").FailWithExactOutput("", R"(
+Running tests...
+1/1 │  ● blah
+
+dir/subdir/file.cpp:5:
+TEST FAILED: blah ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+Uncaught exception:
+    std::runtime_error:
+        "Some message!"
+
+────────────────────────────────────────────────────────────────────────────────────────────────────
+
+FOLLOWING TESTS FAILED:
+
+● blah      │ dir/subdir/file.cpp:5
+
+             Tests    Checks
+FAILED           1         0
+
+)");
+
+    // Throwing `InterruptTestException` doesn't fail the test.
+    MustCompileAndThen(common_program_prefix + R"(
+TA_TEST(blah)
+{
+    throw ta_test::InterruptTestException{};
+}
+)").RunWithExactOutput("", R"(
+Running tests...
+1/1 │  ● blah
+
+             Tests    Checks
+PASSED           1         0
+
+)");
+
+    // Throwing an unknown exception.
+    MustCompileAndThen(common_program_prefix + R"(
+TA_TEST(blah)
+{
+    throw 42;
+}
+)").FailWithExactOutput("", R"(
+Running tests...
+1/1 │  ● blah
+
+dir/subdir/file.cpp:5:
+TEST FAILED: blah ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+Uncaught exception:
+    Unknown exception.
+
+────────────────────────────────────────────────────────────────────────────────────────────────────
+
+FOLLOWING TESTS FAILED:
+
+● blah      │ dir/subdir/file.cpp:5
+
+             Tests    Checks
+FAILED           1         0
+
+)");
+
+    // Throwing a nested exception.
+    MustCompileAndThen(common_program_prefix + R"(
+TA_TEST(blah)
+{
+    try
+    {
+        try
+        {
+            throw std::runtime_error("1");
+        }
+        catch (...)
+        {
+            std::throw_with_nested(std::logic_error("2"));
+        }
+    }
+    catch (...)
+    {
+        std::throw_with_nested(std::domain_error("3"));
+    }
+}
+)").FailWithExactOutput("", R"(
+Running tests...
+1/1 │  ● blah
+
+dir/subdir/file.cpp:5:
+TEST FAILED: blah ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+Uncaught exception:
+    std::_Nested_exception<std::domain_error>:
+        "3"
+    std::_Nested_exception<std::logic_error>:
+        "2"
+    std::runtime_error:
+        "1"
+
+────────────────────────────────────────────────────────────────────────────────────────────────────
+
+FOLLOWING TESTS FAILED:
+
+● blah      │ dir/subdir/file.cpp:5
+
+             Tests    Checks
+FAILED           1         0
+
+)");
+
+    // Throwing a nested exception with an unknown exception in it.
+    MustCompileAndThen(common_program_prefix + R"(
+TA_TEST(blah)
+{
+    try
+    {
+        try
+        {
+            throw 42;
+        }
+        catch (...)
+        {
+            std::throw_with_nested(std::logic_error("2"));
+        }
+    }
+    catch (...)
+    {
+        std::throw_with_nested(std::domain_error("3"));
+    }
+}
+)").FailWithExactOutput("", R"(
+Running tests...
+1/1 │  ● blah
 
 dir/subdir/file.cpp:5:
 TEST FAILED: blah ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
@@ -2602,6 +3502,144 @@ FAILED           1         4
 )");
 }
 
+TA_TEST( ta_check/ranges_equal )
+{
+    // Contiguous integer ranges are compared bytewise, others element-wise. Only the elements around the first mismatch are printed.
+    MustCompileAndThen(common_program_prefix + R"(
+#include <list>
+#include <numeric>
+TA_TEST(blah)
+{
+    std::vector<int> a(100), b(100);
+    std::iota(a.begin(), a.end(), 0);
+    std::iota(b.begin(), b.end(), 0);
+    TA_CHECK_RANGES_EQUAL(a, b);
+    b[50] = -1;
+    TA_CHECK_RANGES_EQUAL(a, b)(ta_test::soft);
+    b[50] = 50;
+    b.resize(102, 7);
+    TA_CHECK_RANGES_EQUAL(a, b)(ta_test::soft);
+    std::list<std::string> c{"x", "y"}, d{"x", "z"};
+    TA_CHECK_RANGES_EQUAL(c, d)("strings");
+}
+)").FailWithExactOutput("", R"(
+Running tests...
+1/1 │  ● blah
+
+dir/subdir/file.cpp:7:
+TEST FAILED: blah ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+dir/subdir/file.cpp:14:
+Assertion failed:
+
+    TA_CHECK_RANGES_EQUAL( a, b )
+
+First mismatch at index 50 of 100.
+    [47] 47 == 47
+    [48] 48 == 48
+    [49] 49 == 49
+  > [50] 50 != -1
+    [51] 51 == 51
+    [52] 52 == 52
+    [53] 53 == 53
+
+dir/subdir/file.cpp:17:
+Assertion failed:
+
+    TA_CHECK_RANGES_EQUAL( a, b )
+
+Length mismatch: 100 vs 102 elements, the first 100 are equal.
+    [97]  97    == 97
+    [98]  98    == 98
+    [99]  99    == 99
+  > [100] <end> != 7
+    [101] <end> != 7
+
+dir/subdir/file.cpp:19:
+Assertion failed: strings
+
+    TA_CHECK_RANGES_EQUAL( c, d )
+
+First mismatch at index 1 of 2.
+    [0] "x" == "x"
+  > [1] "y" != "z"
+
+────────────────────────────────────────────────────────────────────────────────────────────────────
+
+FOLLOWING TESTS FAILED:
+
+● blah      │ dir/subdir/file.cpp:7
+
+             Tests    Checks
+Executed         1         4
+Passed           0         1
+FAILED           1         3
+
+)");
+}
+
+TA_TEST( ta_check/ranges_approx )
+{
+    // NaNs and infinities give infinite errors, unless they match exactly.
+    MustCompileAndThen(common_program_prefix + R"(
+#include <cmath>
+#include <limits>
+TA_TEST(blah)
+{
+    std::vector<float> x{1.f, 2.f}, y{std::nextafter(1.f, 2.f), 2.f};
+    TA_CHECK_RANGES_APPROX(x, y, ta_test::FloatTolerance::Ulp(1));
+    y.push_back(3.f);
+    TA_CHECK_RANGES_APPROX(x, y, ta_test::FloatTolerance::Ulp(1))(ta_test::soft);
+    std::vector<double> a{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    std::vector<double> b = a;
+    b[2] = 3.5;
+    b[5] = std::numeric_limits<double>::quiet_NaN();
+    b[8] = 9.0625;
+    TA_CHECK_RANGES_APPROX(a, b, ta_test::FloatTolerance::Absolute(0.1));
+}
+)").FailWithExactOutput("", R"(
+Running tests...
+1/1 │  ● blah
+
+dir/subdir/file.cpp:7:
+TEST FAILED: blah ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+dir/subdir/file.cpp:12:
+Assertion failed:
+
+    TA_CHECK_RANGES_APPROX( x, y, ta_test::FloatTolerance::Ulp(1) )
+
+Length mismatch: 2 vs 3 elements.
+The first 2 elements are equal.
+
+dir/subdir/file.cpp:18:
+Assertion failed:
+
+    TA_CHECK_RANGES_APPROX( a, b, ta_test::FloatTolerance::Absolute(0.1) )
+
+2 of 10 elements exceed the absolute tolerance 0.1.
+Max error: inf at index 5: 6 vs nan
+First mismatch at index 2: 3 vs 3.5
+Error histogram:
+    0            │ 7
+    [1e-2, 1e-1) │ 1
+    [1e-1, 1e0)  │ 1
+    inf          │ 1
+
+────────────────────────────────────────────────────────────────────────────────────────────────────
+
+FOLLOWING TESTS FAILED:
+
+● blah      │ dir/subdir/file.cpp:7
+
+             Tests    Checks
+Executed         1         3
+Passed           0         1
+FAILED           1         2
+
+)");
+}
+
 TA_TEST( ta_check/context )
 {
     // One assertion failing inside another's `$[...]`.
@@ -2638,107 +3676,317 @@ FOLLOWING TESTS FAILED:
 ● blah      │ dir/subdir/file.cpp:6
 
              Tests    Checks
-Executed         1         2
-Passed           0         1
-FAILED           1         1
+Executed         1         2
+Passed           0         1
+FAILED           1         1
+
+)");
+
+    // One assertion failing inside another's `$[...]` (nested);
+    MustCompileAndThen(common_program_prefix + R"(
+bool foo() {TA_CHECK(false)(ta_test::soft, "inner"); return true;}
+TA_TEST(blah)
+{
+    TA_CHECK( $[$[true] && $[foo()]] && $[true] )("outer");
+}
+)").FailWithExactOutput("", R"(
+Running tests...
+1/1 │  ● blah
+
+dir/subdir/file.cpp:6:
+TEST FAILED: blah ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+dir/subdir/file.cpp:5:
+Assertion failed: inner
+
+    TA_CHECK( false )
+
+dir/subdir/file.cpp:8:
+While checking assertion: outer
+                            in here
+                            ╭─────╮
+    TA_CHECK( $[$[true] && $[foo()]] && $[true] )
+                   │
+                  true
+
+────────────────────────────────────────────────────────────────────────────────────────────────────
+
+FOLLOWING TESTS FAILED:
+
+● blah      │ dir/subdir/file.cpp:6
+
+             Tests    Checks
+Executed         1         2
+Passed           0         1
+FAILED           1         1
+
+)");
+
+    // One assertion failing inside another, but outside of `$[...]`;
+    MustCompileAndThen(common_program_prefix + R"(
+bool foo() {TA_CHECK(false)(ta_test::soft, "inner"); return true;}
+TA_TEST(blah)
+{
+    TA_CHECK( $[true] && foo() && $[true] )("outer");
+}
+)").FailWithExactOutput("", R"(
+Running tests...
+1/1 │  ● blah
+
+dir/subdir/file.cpp:6:
+TEST FAILED: blah ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+dir/subdir/file.cpp:5:
+Assertion failed: inner
+
+    TA_CHECK( false )
+
+dir/subdir/file.cpp:8:
+While checking assertion: outer
+
+    TA_CHECK( $[true] && foo() && $[true] )
+                 │
+                true
+
+────────────────────────────────────────────────────────────────────────────────────────────────────
+
+FOLLOWING TESTS FAILED:
+
+● blah      │ dir/subdir/file.cpp:6
+
+             Tests    Checks
+Executed         1         2
+Passed           0         1
+FAILED           1         1
+
+)");
+
+    // ---
+
+    // Make sure the context DOESN'T extend to the end of full expression.
+    MustCompileAndThen(common_program_prefix + R"(
+TA_TEST(blah)
+{
+    TA_CHECK(true), TA_CHECK(false);
+}
+)").FailWithExactOutput("", R"(
+Running tests...
+1/1 │  ● blah
+
+dir/subdir/file.cpp:5:
+TEST FAILED: blah ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+dir/subdir/file.cpp:7:
+Assertion failed:
+
+    TA_CHECK( false )
+
+────────────────────────────────────────────────────────────────────────────────────────────────────
+
+FOLLOWING TESTS FAILED:
+
+● blah      │ dir/subdir/file.cpp:5
+
+             Tests    Checks
+Executed         1         2
+Passed           0         1
+FAILED           1         1
+
+)");
+}
+
+TA_TEST( ta_log/deferred )
+{
+    // The arguments are copied when logging, even if the formatting is deferred.
+    MustCompileAndThen(common_program_prefix + R"(
+TA_TEST(blah)
+{
+    int x = 1;
+    TA_LOG("x = {}", x);
+    TA_CONTEXT("y = {}", x);
+    x = 2;
+    TA_CHECK(x == 2);
+    TA_CHECK(false)("fail");
+}
+)").FailWithExactOutput("", R"(
+Running tests...
+1/1 │  ● blah
+
+dir/subdir/file.cpp:5:
+TEST FAILED: blah ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+// x = 1
+// y = 1
+
+dir/subdir/file.cpp:12:
+Assertion failed: fail
+
+    TA_CHECK( false )
+
+────────────────────────────────────────────────────────────────────────────────────────────────────
+
+FOLLOWING TESTS FAILED:
+
+● blah      │ dir/subdir/file.cpp:5
+
+             Tests    Checks
+Executed         1         2
+Passed           0         1
+FAILED           1         1
+
+)");
+
+    // The messages of a passing test are never formatted, if all their arguments are arithmetic or enums.
+    // Other arguments are formatted right away.
+    MustCompileAndThen(common_program_prefix + R"(
+#include <cstdio>
+int num_enum_formats = 0, num_struct_formats = 0;
+enum class E {e};
+struct S {};
+template <>
+struct CFG_TA_FMT_NAMESPACE::formatter<E, char>
+{
+    constexpr auto parse(CFG_TA_FMT_NAMESPACE::basic_format_parse_context<char> &parse_ctx) {return parse_ctx.begin();}
+    template <typename OutputIt>
+    auto format(E, CFG_TA_FMT_NAMESPACE::basic_format_context<OutputIt, char> &format_ctx) const
+    {
+        num_enum_formats++;
+        return CFG_TA_FMT_NAMESPACE::format_to(format_ctx.out(), "E");
+    }
+};
+template <>
+struct CFG_TA_FMT_NAMESPACE::formatter<S, char>
+{
+    constexpr auto parse(CFG_TA_FMT_NAMESPACE::basic_format_parse_context<char> &parse_ctx) {return parse_ctx.begin();}
+    template <typename OutputIt>
+    auto format(S, CFG_TA_FMT_NAMESPACE::basic_format_context<OutputIt, char> &format_ctx) const
+    {
+        num_struct_formats++;
+        return CFG_TA_FMT_NAMESPACE::format_to(format_ctx.out(), "S");
+    }
+};
+struct Report
+{
+    ~Report() {std::printf("enum: %d, struct: %d\n", num_enum_formats, num_struct_formats);}
+} report;
+TA_TEST(blah)
+{
+    TA_LOG("{} {}", E::e, 42);
+    TA_LOG("{}", S{});
+    TA_CHECK(true);
+}
+)").RunWithExactOutput("", R"(
+Running tests...
+1/1 │  ● blah
+
+             Tests    Checks
+PASSED           1         1
 
+enum: 0, struct: 1
 )");
+}
 
-    // One assertion failing inside another's `$[...]` (nested);
+TA_TEST( ta_log/capacity )
+{
+    // Keep the first 2 and the last 3 entries.
     MustCompileAndThen(common_program_prefix + R"(
-bool foo() {TA_CHECK(false)(ta_test::soft, "inner"); return true;}
 TA_TEST(blah)
 {
-    TA_CHECK( $[$[true] && $[foo()]] && $[true] )("outer");
+    for (int i = 0; i < 10; i++)
+        TA_LOG("i = {}", i);
+    TA_CHECK(false)("fail");
 }
-)").FailWithExactOutput("", R"(
+)")
+    .FailWithExactOutput("--log-capacity 2,3", R"(
 Running tests...
 1/1 │  ● blah
 
-dir/subdir/file.cpp:6:
+dir/subdir/file.cpp:5:
 TEST FAILED: blah ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
 
-dir/subdir/file.cpp:5:
-Assertion failed: inner
+// i = 0
+// i = 1
+// ... 5 entries omitted ...
+// i = 7
+// i = 8
+// i = 9
 
-    TA_CHECK( false )
+dir/subdir/file.cpp:9:
+Assertion failed: fail
 
-dir/subdir/file.cpp:8:
-While checking assertion: outer
-                            in here
-                            ╭─────╮
-    TA_CHECK( $[$[true] && $[foo()]] && $[true] )
-                   │
-                  true
+    TA_CHECK( false )
 
 ────────────────────────────────────────────────────────────────────────────────────────────────────
 
 FOLLOWING TESTS FAILED:
 
-● blah      │ dir/subdir/file.cpp:6
+● blah      │ dir/subdir/file.cpp:5
 
              Tests    Checks
-Executed         1         2
-Passed           0         1
 FAILED           1         1
 
-)");
-
-    // One assertion failing inside another, but outside of `$[...]`;
-    MustCompileAndThen(common_program_prefix + R"(
-bool foo() {TA_CHECK(false)(ta_test::soft, "inner"); return true;}
-TA_TEST(blah)
-{
-    TA_CHECK( $[true] && foo() && $[true] )("outer");
-}
-)").FailWithExactOutput("", R"(
+)")
+    // Only the last entry.
+    .FailWithExactOutput("--log-capacity 1", R"(
 Running tests...
 1/1 │  ● blah
 
-dir/subdir/file.cpp:6:
-TEST FAILED: blah ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
-
 dir/subdir/file.cpp:5:
-Assertion failed: inner
+TEST FAILED: blah ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
 
-    TA_CHECK( false )
+// ... 9 entries omitted ...
+// i = 9
 
-dir/subdir/file.cpp:8:
-While checking assertion: outer
+dir/subdir/file.cpp:9:
+Assertion failed: fail
 
-    TA_CHECK( $[true] && foo() && $[true] )
-                 │
-                true
+    TA_CHECK( false )
 
 ────────────────────────────────────────────────────────────────────────────────────────────────────
 
 FOLLOWING TESTS FAILED:
 
-● blah      │ dir/subdir/file.cpp:6
+● blah      │ dir/subdir/file.cpp:5
 
              Tests    Checks
-Executed         1         2
-Passed           0         1
 FAILED           1         1
 
-)");
-
-    // ---
+)")
+    .FailWithExactOutput("--log-capacity 1,x", "ta_test: Error: Expected `N` or `M,N` with non-negative integers after `--log-capacity`, but got `1,x`.\n");
 
-    // Make sure the context DOESN'T extend to the end of full expression.
+    // The second failure only counts the entries omitted since the first one.
     MustCompileAndThen(common_program_prefix + R"(
 TA_TEST(blah)
 {
-    TA_CHECK(true), TA_CHECK(false);
+    for (int i = 0; i < 10; i++)
+        TA_LOG("i = {}", i);
+    TA_CHECK( false )(ta_test::soft);
+    for (int i = 10; i < 15; i++)
+        TA_LOG("i = {}", i);
+    TA_CHECK( false )(ta_test::soft);
 }
-)").FailWithExactOutput("", R"(
+)")
+    .FailWithExactOutput("--log-capacity 2", R"(
 Running tests...
 1/1 │  ● blah
 
 dir/subdir/file.cpp:5:
 TEST FAILED: blah ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
 
-dir/subdir/file.cpp:7:
+// ... 8 entries omitted ...
+// i = 8
+// i = 9
+
+dir/subdir/file.cpp:9:
+Assertion failed:
+
+    TA_CHECK( false )
+
+// ... 3 entries omitted ...
+// i = 13
+// i = 14
+
+dir/subdir/file.cpp:12:
 Assertion failed:
 
     TA_CHECK( false )
@@ -2750,11 +3998,23 @@ FOLLOWING TESTS FAILED:
 ● blah      │ dir/subdir/file.cpp:5
 
              Tests    Checks
-Executed         1         2
-Passed           0         1
-FAILED           1         1
+FAILED           1         2
 
 )");
+
+    // The workers don't call the modules, but still respect the capacity.
+    MustCompileAndThen(common_program_prefix + R"(
+TA_TEST(a)
+{
+    for (int i = 0; i < 10; i++)
+        TA_LOG("i = {}", i);
+    TA_CHECK( $[ta_test::detail::ThreadState().current_test->unscoped_log.NumOmitted()] == 5 );
+}
+TA_TEST(b) {}
+)")
+    .Run("--log-capacity 2,3")
+    .Run("--log-capacity 2,3 -j2")
+    .Run("--log-capacity 2,3 --processes 2");
 }
 
 TA_TEST( ta_check/nesting )
@@ -3549,6 +4809,223 @@ FAILED           1         1
 )");
 }
 
+TA_TEST( ta_check/laziness_large )
+{
+    // Objects that don't fit into `CFG_TA_ARG_STORAGE_SIZE`, and containers, are also converted to strings lazily.
+    MustCompileAndThen(common_program_prefix + R"(
+#include <iostream>
+#include <vector>
+
+struct LazyToString
+{
+    int x = 43;
+};
+struct LargeLazyToString
+{
+    int x = 44;
+    char padding[100]{};
+};
+
+template <typename T>
+requires std::is_same_v<T, LazyToString> || std::is_same_v<T, LargeLazyToString>
+struct CFG_TA_FMT_NAMESPACE::formatter<T, char>
+{
+    constexpr auto parse(CFG_TA_FMT_NAMESPACE::basic_format_parse_context<char> &parse_ctx)
+    {
+        return parse_ctx.begin();
+    }
+
+    template <typename OutputIt>
+    constexpr auto format(const T &value, CFG_TA_FMT_NAMESPACE::basic_format_context<OutputIt, char> &format_ctx) const
+    {
+        std::cout << "Serializing x=" << value.x << '\n';
+        return CFG_TA_FMT_NAMESPACE::format_to(format_ctx.out(), "{}", value.x);
+    }
+};
+
+TA_TEST(foo)
+{
+    std::vector<LazyToString> vec = {{1}, {2}};
+    std::cout << "---\n";
+    TA_CHECK( $[LargeLazyToString{10}].x + $[vec].size() > 0 );
+    std::cout << "---\n";
+    TA_CHECK( $[LargeLazyToString{20}].x + $[vec].size() < 0 );
+}
+)").FailWithExactOutput("", R"(
+Running tests...
+1/1 │  ● foo
+---
+---
+
+dir/subdir/file.cpp:35:
+TEST FAILED: foo ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+Serializing x=20
+Serializing x=1
+Serializing x=2
+dir/subdir/file.cpp:41:
+Assertion failed:
+
+    TA_CHECK( $[LargeLazyToString{20}].x + $[vec].size() < 0 )
+               ╰──────────┬──────────╯        │
+                          20                [1, 2]
+
+────────────────────────────────────────────────────────────────────────────────────────────────────
+
+FOLLOWING TESTS FAILED:
+
+● foo      │ dir/subdir/file.cpp:35
+
+             Tests    Checks
+Executed         1         2
+Passed           0         1
+FAILED           1         1
+
+)");
+
+    // The large objects are stored in the argument arena after the assertion's own arguments, and are destroyed with them.
+    // This includes the nested assertions, and assertions large enough to need a new arena chunk.
+    MustCompileAndThen(common_program_prefix + R"(
+#include <iostream>
+
+int num_alive = 0;
+
+struct Large
+{
+    int x = 0;
+    char padding[1000]{};
+
+    Large(int x) : x(x) {num_alive++;}
+    Large(const Large &other) : x(other.x) {num_alive++;}
+    Large &operator=(const Large &) = default;
+    ~Large() {num_alive--;}
+};
+
+template <>
+struct CFG_TA_FMT_NAMESPACE::formatter<Large, char>
+{
+    constexpr auto parse(CFG_TA_FMT_NAMESPACE::basic_format_parse_context<char> &parse_ctx)
+    {
+        return parse_ctx.begin();
+    }
+
+    template <typename OutputIt>
+    constexpr auto format(const Large &value, CFG_TA_FMT_NAMESPACE::basic_format_context<OutputIt, char> &format_ctx) const
+    {
+        return CFG_TA_FMT_NAMESPACE::format_to(format_ctx.out(), "{}", value.x);
+    }
+};
+
+template <>
+struct ta_test::string_conv::MaybeLazyToString<Large>
+{
+    Large operator()(const Large &value) const {return value;}
+};
+
+int Nested(int x)
+{
+    TA_CHECK( $[Large(x)].x + $[Large(x + 1)].x > 0 );
+    return x;
+}
+
+TA_TEST(foo)
+{
+    for (int i = 0; i < 10; i++)
+        TA_CHECK( $[Large(1)].x + $[Nested(i + 1)] + $[Large(2)].x > 0 );
+    std::cout << "alive: " << num_alive << '\n';
+    TA_CHECK( $[Large(3)].x + $[Nested(4)] < 0 );
+}
+)")
+    .FailWithOutputMatching("", std::regex(
+        R"(\nalive: 0\n[\s\S]*)"
+        R"(\n +TA_CHECK\( \$\[Large\(3\)\]\.x \+ \$\[Nested\(4\)\] < 0 \)\n +╰(?:─)+┬(?:─)+╯ +╰(?:─)+┬(?:─)+╯\n +3 +4\n)"
+    ));
+}
+
+TA_TEST( ta_check/laziness_by_reference )
+{
+    // Named lvalues are captured by reference, and converted to strings lazily regardless of their type.
+    MustCompileAndThen(common_program_prefix + R"(
+#include <iostream>
+
+struct NonLazyToString
+{
+    int x = 42;
+    // A non-trivial destructor to disable the lazy behavior.
+    ~NonLazyToString() {}
+};
+
+template <>
+struct CFG_TA_FMT_NAMESPACE::formatter<NonLazyToString, char>
+{
+    constexpr auto parse(CFG_TA_FMT_NAMESPACE::basic_format_parse_context<char> &parse_ctx)
+    {
+        return parse_ctx.begin();
+    }
+
+    template <typename OutputIt>
+    constexpr auto format(const NonLazyToString &value, CFG_TA_FMT_NAMESPACE::basic_format_context<OutputIt, char> &format_ctx) const
+    {
+        std::cout << "Serializing x=" << value.x << '\n';
+        return CFG_TA_FMT_NAMESPACE::format_to(format_ctx.out(), "{}", value.x);
+    }
+};
+
+struct Wrapper
+{
+    NonLazyToString member{10};
+};
+
+TA_TEST(foo)
+{
+    NonLazyToString a{1};
+    Wrapper w;
+    Wrapper *p = &w;
+    std::cout << "---\n";
+    TA_CHECK( $[a].x + $[w.member].x + $[ p->member ].x > 0 );
+    std::cout << "---\n";
+    // Not a name, must be serialized immediately.
+    TA_CHECK( $[NonLazyToString{2}].x > 0 );
+    // Inside of a lambda, must be serialized immediately.
+    TA_CHECK( [&]{NonLazyToString b{3}; return $[b].x > 0;}() );
+    std::cout << "---\n";
+    a.x = 4;
+    TA_CHECK( $[a].x < 0 );
+}
+)").FailWithExactOutput("", R"(
+Running tests...
+1/1 │  ● foo
+---
+---
+Serializing x=2
+Serializing x=3
+---
+
+dir/subdir/file.cpp:35:
+TEST FAILED: foo ━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━
+
+Serializing x=4
+dir/subdir/file.cpp:49:
+Assertion failed:
+
+    TA_CHECK( $[a].x < 0 )
+                │
+                4
+
+────────────────────────────────────────────────────────────────────────────────────────────────────
+
+FOLLOWING TESTS FAILED:
+
+● foo      │ dir/subdir/file.cpp:35
+
+             Tests    Checks
+Executed         1         4
+Passed           0         3
+FAILED           1         1
+
+)");
+}
+
 TA_TEST( ta_check/parsing_challenges )
 {
     // Deep argument nesting.